@@ -0,0 +1,137 @@
+// cost of a round trip through the wrapper: the same cheap call made
+// through libEGL and straight to the driver. Meant for the mock driver,
+// run it with EGL_DRIVER_PATH=<build>/mock_driver; the driver is loaded
+// when libEGL is, so the variable has to be set before the process starts.
+
+#include "logger.h"
+
+#include <EGL/egl.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+template <typename Call>
+double ns_per_call(Call&& call, int iterations)
+{
+    auto begin = clock_type::now();
+    for (int i = 0; i < iterations; i++)
+        call();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  clock_type::now() - begin)
+                  .count();
+    return static_cast<double>(ns) / iterations;
+}
+
+void report(const char* name, double wrapped, double direct)
+{
+    if (direct > 0)
+        printf("%-22s %8.1f ns  driver %8.1f ns  overhead %8.1f ns\n", name,
+               wrapped, direct, wrapped - direct);
+    else
+        printf("%-22s %8.1f ns\n", name, wrapped);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    logger::log_t::set_log_level(logger::LOG_WARN);
+
+    int iterations = argc > 1 ? atoi(argv[1]) : 10000000;
+    if (iterations <= 0)
+        iterations = 10000000;
+
+    // pbuffers only, the default display must not turn into a wayland one
+    unsetenv("WAYLAND_DISPLAY");
+    EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (!eglInitialize(dpy, nullptr, nullptr))
+    {
+        logger::log_error() << "eglInitialize failed: " << std::hex
+                            << eglGetError();
+        return 1;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+    EGLContext ctx = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (eglChooseConfig(dpy, config_attribs, &config, 1, &count) && count)
+    {
+        ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, context_attribs);
+        surface = eglCreatePbufferSurface(dpy, config, pbuffer_attribs);
+    }
+    if (ctx == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(dpy, surface, surface, ctx))
+    {
+        logger::log_error() << "cannot make a pbuffer context current";
+        return 1;
+    }
+
+    // the driver's own entry points, when we know where it is
+    decltype(&eglGetCurrentContext) driver_get_current_context = nullptr;
+    decltype(&eglGetError) driver_get_error = nullptr;
+    if (const char* dir = getenv("EGL_DRIVER_PATH"))
+    {
+        std::string path = std::string{dir} + "/libEGL.so";
+        if (void* driver = dlopen(path.c_str(), RTLD_NOW | RTLD_NOLOAD))
+        {
+            driver_get_current_context = reinterpret_cast<
+                decltype(&eglGetCurrentContext)>(
+                dlsym(driver, "eglGetCurrentContext"));
+            driver_get_error = reinterpret_cast<decltype(&eglGetError)>(
+                dlsym(driver, "eglGetError"));
+        }
+    }
+
+    printf("%d calls each\n", iterations);
+
+    int failed = 0;
+    auto get_current_context = [&] {
+        if (eglGetCurrentContext() != ctx)
+            failed++;
+    };
+    double wrapped = ns_per_call(get_current_context, iterations);
+    double direct = 0;
+    if (driver_get_current_context)
+    {
+        direct = ns_per_call([&] { driver_get_current_context(); },
+                             iterations);
+    }
+    report("eglGetCurrentContext", wrapped, direct);
+
+    wrapped = ns_per_call([] { eglGetError(); }, iterations);
+    direct = 0;
+    if (driver_get_error)
+        direct = ns_per_call([&] { driver_get_error(); }, iterations);
+    report("eglGetError", wrapped, direct);
+
+    // the same context again, the common case of a render loop
+    wrapped = ns_per_call([&] { eglMakeCurrent(dpy, surface, surface, ctx); },
+                          iterations / 10);
+    report("eglMakeCurrent", wrapped, 0);
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(dpy, surface);
+    eglDestroyContext(dpy, ctx);
+    eglTerminate(dpy);
+
+    if (failed)
+    {
+        logger::log_error() << failed
+                            << " calls returned the wrong context";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+// presents a few frames of a WaylandNativeWindow to a headless compositor
+// which only knows wl_compositor and zwp_linux_dmabuf_v1, no android_wlegl
+// or wl_shm, so every frame has to go through the dma-buf path.
+
+#include "gralloc_adapter.h"
+#include "headless_compositor.h"
+#include "logger.h"
+#include "platform_wayland.h"
+
+int main()
+{
+    logger::log_t::set_log_level(logger::LOG_DEBUG);
+
+    // the compositor takes linear ABGR8888 only, that needs a gralloc buffer
+    // which can be shared as a dma-buf
+    auto adapter = gralloc_loader::getInstance().get_adapter();
+    auto probe = adapter->allocate_buffer(
+        64, 64, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+        AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
+            AHARDWAREBUFFER_USAGE_GPU_FRAMEBUFFER);
+    gralloc_dmabuf_layout layout = {};
+    if (!probe || !probe->export_dmabuf(&layout))
+    {
+        logger::log_info() << "skipped, gralloc buffers cannot be exported as "
+                              "dma-bufs here";
+        return 0;
+    }
+    probe = nullptr;
+
+    headless_compositor compositor;
+    headless_surface client;
+    if (!compositor.start({.wlegl = false, .dmabuf = true}) ||
+        !client.connect(compositor.socket(), 64, 64))
+    {
+        logger::log_error() << "cannot start the headless compositor";
+        return 1;
+    }
+
+    int rval = 1;
+    {
+        wayland_wrapper_t wrapper{client.display};
+        ANativeWindow* win = nullptr;
+        if (wrapper.initialize() && (win = wrapper.create_window(client.window)))
+        {
+            constexpr int frames = 8;
+            for (int i = 0; i < frames; i++)
+            {
+                ANativeWindowBuffer* buffer = nullptr;
+                int fence = -1;
+                if (win->dequeueBuffer(win, &buffer, &fence) != 0)
+                    break;
+                win->queueBuffer(win, buffer, -1);
+                wrapper.finish_swap(win);
+            }
+            wl_display_roundtrip(client.display);
+
+            logger::log_info() << "dmabuf buffers: " << compositor.dmabuf_buffers
+                               << ", commits: " << compositor.commits;
+            rval = compositor.dmabuf_buffers > 0 &&
+                           compositor.commits == frames
+                       ? 0
+                       : 1;
+            wrapper.destroy_window(win);
+        }
+        wrapper.terminate();
+    }
+
+    client.disconnect();
+    compositor.stop();
+
+    logger::log_info() << (rval == 0 ? "dmabuf test passed"
+                                     : "dmabuf test failed");
+    return rval;
+}
@@ -0,0 +1,334 @@
+#include "headless_compositor.h"
+#include "logger.h"
+#include "platform_wayland.h"
+
+#include <linux-dmabuf-unstable-v1-server-protocol-core.h>
+#include <wayland-client-protocol-core.h>
+#include <wayland-server-protocol-core.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr uint32_t fourcc_abgr8888 = 0x34324241; // 'AB24'
+constexpr uint32_t fourcc_xbgr8888 = 0x34324258; // 'XB24'
+
+struct dmabuf_params
+{
+    headless_compositor* compositor;
+    std::vector<int> fds;
+    bool used = false;
+
+    ~dmabuf_params()
+    {
+        for (auto fd : fds)
+            close(fd);
+    }
+};
+
+struct surface_state
+{
+    headless_compositor* compositor;
+    struct wl_resource* pending = nullptr;
+    bool attached = false;
+    struct wl_resource* current = nullptr;
+    struct wl_listener pending_destroy;
+    struct wl_listener current_destroy;
+    std::vector<struct wl_resource*> frame_callbacks;
+
+    surface_state(headless_compositor* compositor) : compositor(compositor)
+    {
+        pending_destroy.notify = +[](struct wl_listener* listener, void*) {
+            surface_state* self;
+            self = wl_container_of(listener, self, pending_destroy);
+            self->pending = nullptr;
+        };
+        current_destroy.notify = +[](struct wl_listener* listener, void*) {
+            surface_state* self;
+            self = wl_container_of(listener, self, current_destroy);
+            self->current = nullptr;
+        };
+    }
+
+    ~surface_state()
+    {
+        set_buffer(&pending, &pending_destroy, nullptr);
+        set_buffer(&current, &current_destroy, nullptr);
+        for (auto callback : frame_callbacks)
+            wl_resource_destroy(callback);
+    }
+
+    static void set_buffer(struct wl_resource** slot,
+                           struct wl_listener* listener,
+                           struct wl_resource* buffer)
+    {
+        if (*slot)
+            wl_list_remove(&listener->link);
+        *slot = buffer;
+        if (buffer)
+            wl_resource_add_destroy_listener(buffer, listener);
+    }
+};
+
+struct wl_buffer_interface buffer_impl = {
+    // clang-format off
+    .destroy = +[](struct wl_client* client, struct wl_resource* resource) {
+        wl_resource_destroy(resource);
+    },
+    // clang-format on
+};
+
+struct zwp_linux_buffer_params_v1_interface dmabuf_params_impl = {
+    // clang-format off
+    .destroy = +[](struct wl_client* client, struct wl_resource* resource) {
+        wl_resource_destroy(resource);
+    },
+    .add = +[](struct wl_client* client, struct wl_resource* resource,
+               int32_t fd, uint32_t plane_idx, uint32_t offset, uint32_t stride,
+               uint32_t modifier_hi, uint32_t modifier_lo) {
+        auto params = static_cast<dmabuf_params*>(wl_resource_get_user_data(resource));
+        params->fds.push_back(fd);
+    },
+    .create = +[](struct wl_client* client, struct wl_resource* resource,
+                  int32_t width, int32_t height, uint32_t format, uint32_t flags) {
+        zwp_linux_buffer_params_v1_send_failed(resource);
+    },
+    .create_immed = +[](struct wl_client* client, struct wl_resource* resource,
+                        uint32_t buffer_id, int32_t width, int32_t height,
+                        uint32_t format, uint32_t flags) {
+        auto params = static_cast<dmabuf_params*>(wl_resource_get_user_data(resource));
+        if (params->used || params->fds.empty()) {
+            wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE,
+                                   "no planes");
+            return;
+        }
+        params->used = true;
+        params->compositor->dmabuf_buffers++;
+
+        auto buffer = wl_resource_create(client, &wl_buffer_interface, 1, buffer_id);
+        wl_resource_set_implementation(buffer, &buffer_impl, nullptr, nullptr);
+    },
+    // clang-format on
+};
+
+struct zwp_linux_dmabuf_v1_interface dmabuf_impl = {
+    // clang-format off
+    .destroy = +[](struct wl_client* client, struct wl_resource* resource) {
+        wl_resource_destroy(resource);
+    },
+    .create_params = +[](struct wl_client* client, struct wl_resource* resource,
+                         uint32_t params_id) {
+        auto params = new dmabuf_params{};
+        params->compositor =
+            static_cast<headless_compositor*>(wl_resource_get_user_data(resource));
+        auto params_resource = wl_resource_create(client,
+            &zwp_linux_buffer_params_v1_interface,
+            wl_resource_get_version(resource), params_id);
+        wl_resource_set_implementation(params_resource, &dmabuf_params_impl, params,
+                                       +[](struct wl_resource* resource) {
+            delete static_cast<dmabuf_params*>(wl_resource_get_user_data(resource));
+        });
+    },
+    // clang-format on
+};
+
+struct wl_surface_interface surface_impl = {
+    // clang-format off
+    .destroy = +[](struct wl_client* client, struct wl_resource* resource) {
+        wl_resource_destroy(resource);
+    },
+    .attach = +[](struct wl_client* client, struct wl_resource* resource,
+                  struct wl_resource* buffer, int32_t x, int32_t y) {
+        auto surface = static_cast<surface_state*>(wl_resource_get_user_data(resource));
+        surface_state::set_buffer(&surface->pending, &surface->pending_destroy, buffer);
+        surface->attached = true;
+    },
+    .damage = +[](struct wl_client* client, struct wl_resource* resource,
+                  int32_t x, int32_t y, int32_t width, int32_t height) {},
+    .frame = +[](struct wl_client* client, struct wl_resource* resource,
+                 uint32_t callback) {
+        auto surface = static_cast<surface_state*>(wl_resource_get_user_data(resource));
+        surface->frame_callbacks.push_back(
+            wl_resource_create(client, &wl_callback_interface, 1, callback));
+    },
+    .set_opaque_region = +[](struct wl_client* client, struct wl_resource* resource,
+                             struct wl_resource* region) {},
+    .set_input_region = +[](struct wl_client* client, struct wl_resource* resource,
+                            struct wl_resource* region) {},
+    .commit = +[](struct wl_client* client, struct wl_resource* resource) {
+        auto surface = static_cast<surface_state*>(wl_resource_get_user_data(resource));
+        surface->compositor->commits++;
+        if (surface->attached) {
+            // the new buffer replaces the old one on screen
+            if (surface->current && surface->current != surface->pending)
+                queue_buffer_release(surface->current);
+            surface_state::set_buffer(&surface->current, &surface->current_destroy,
+                                      surface->pending);
+            surface_state::set_buffer(&surface->pending, &surface->pending_destroy,
+                                      nullptr);
+            surface->attached = false;
+        }
+        for (auto callback : surface->frame_callbacks) {
+            wl_callback_send_done(callback, 0);
+            wl_resource_destroy(callback);
+        }
+        surface->frame_callbacks.clear();
+    },
+    .set_buffer_transform = +[](struct wl_client* client, struct wl_resource* resource,
+                                int32_t transform) {},
+    .set_buffer_scale = +[](struct wl_client* client, struct wl_resource* resource,
+                            int32_t scale) {},
+    .damage_buffer = +[](struct wl_client* client, struct wl_resource* resource,
+                         int32_t x, int32_t y, int32_t width, int32_t height) {},
+    // clang-format on
+};
+
+struct wl_compositor_interface compositor_impl = {
+    // clang-format off
+    .create_surface = +[](struct wl_client* client, struct wl_resource* resource,
+                          uint32_t id) {
+        auto surface = new surface_state{
+            static_cast<headless_compositor*>(wl_resource_get_user_data(resource))};
+        auto surface_resource = wl_resource_create(client, &wl_surface_interface,
+            wl_resource_get_version(resource), id);
+        wl_resource_set_implementation(surface_resource, &surface_impl, surface,
+                                       +[](struct wl_resource* resource) {
+            delete static_cast<surface_state*>(wl_resource_get_user_data(resource));
+        });
+    },
+    .create_region = +[](struct wl_client* client, struct wl_resource* resource,
+                         uint32_t id) {
+        wl_client_post_no_memory(client);
+    },
+    // clang-format on
+};
+} // namespace
+
+headless_compositor::~headless_compositor()
+{
+    stop();
+}
+
+bool headless_compositor::start(const options& opts)
+{
+    m_display = wl_display_create();
+    m_socket = m_display ? wl_display_add_socket_auto(m_display) : nullptr;
+    if (!m_socket)
+    {
+        logger::log_error() << "cannot create the headless compositor socket";
+        return false;
+    }
+
+    // clang-format off
+    m_logger = wl_display_add_protocol_logger(m_display,
+        +[](void* data, enum wl_protocol_logger_type type,
+            const struct wl_protocol_logger_message* message) {
+        if (type == WL_PROTOCOL_LOGGER_REQUEST)
+            static_cast<headless_compositor*>(data)->requests++;
+    }, this);
+
+    wl_global_create(m_display, &wl_compositor_interface, 4, this,
+        +[](struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+        auto resource = wl_resource_create(client, &wl_compositor_interface, version, id);
+        wl_resource_set_implementation(resource, &compositor_impl, data, nullptr);
+    });
+    if (opts.dmabuf) {
+        wl_global_create(m_display, &zwp_linux_dmabuf_v1_interface, 3, this,
+            +[](struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+            auto resource = wl_resource_create(client, &zwp_linux_dmabuf_v1_interface, version, id);
+            wl_resource_set_implementation(resource, &dmabuf_impl, data, nullptr);
+            for (auto format : {fourcc_abgr8888, fourcc_xbgr8888}) {
+                // linear only, like a compositor without a gpu
+                zwp_linux_dmabuf_v1_send_modifier(resource, format, 0, 0);
+            }
+        });
+    }
+    // clang-format on
+    if (opts.shm)
+        wl_display_init_shm(m_display);
+    if (opts.wlegl)
+        m_wlegl = create_server_wlegl(m_display);
+
+    m_running = true;
+    m_thread = std::thread{[this] {
+        auto loop = wl_display_get_event_loop(m_display);
+        while (m_running)
+        {
+            wl_display_flush_clients(m_display);
+            wl_event_loop_dispatch(loop, 10);
+        }
+    }};
+    return true;
+}
+
+void headless_compositor::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_display)
+    {
+        // clients first, their buffers go back through server_wlegl
+        wl_display_destroy_clients(m_display);
+        if (m_wlegl)
+            delete_server_wlegl(m_wlegl);
+        if (m_logger)
+            wl_protocol_logger_destroy(m_logger);
+        wl_display_destroy(m_display);
+    }
+    m_wlegl = nullptr;
+    m_logger = nullptr;
+    m_display = nullptr;
+    m_socket = nullptr;
+}
+
+bool headless_surface::connect(const char* socket, int width, int height)
+{
+    display = wl_display_connect(socket);
+    if (!display)
+    {
+        logger::log_error() << "cannot connect to " << socket;
+        return false;
+    }
+
+    registry = wl_display_get_registry(display);
+    static const wl_registry_listener registry_listener = {
+        // clang-format off
+        .global = +[](void* data, struct wl_registry* registry, uint32_t name,
+                      const char* interface, uint32_t version) {
+            auto self = static_cast<headless_surface*>(data);
+            if (strcmp(interface, "wl_compositor") == 0)
+                self->compositor = static_cast<struct wl_compositor*>(
+                    wl_registry_bind(registry, name, &wl_compositor_interface, 4));
+        },
+        .global_remove = +[](void* data, struct wl_registry* registry, uint32_t name) {},
+        // clang-format on
+    };
+    wl_registry_add_listener(registry, &registry_listener, this);
+    if (wl_display_roundtrip(display) < 0 || !compositor)
+    {
+        logger::log_error() << "no wl_compositor";
+        return false;
+    }
+
+    surface = wl_compositor_create_surface(compositor);
+    window = wl_egl_window_create(surface, width, height);
+    return window != nullptr;
+}
+
+void headless_surface::disconnect()
+{
+    if (window)
+        wl_egl_window_destroy(window);
+    if (surface)
+        wl_surface_destroy(surface);
+    if (compositor)
+        wl_compositor_destroy(compositor);
+    if (registry)
+        wl_registry_destroy(registry);
+    if (display)
+        wl_display_disconnect(display);
+    *this = {};
+}
@@ -0,0 +1,65 @@
+#ifndef EGL_HEADLESS_COMPOSITOR_H_
+#define EGL_HEADLESS_COMPOSITOR_H_
+
+// A wayland compositor for tests and benchmarks, running on its own thread
+// in the same process. It shows nothing: a committed buffer is released by
+// the next commit and frame callbacks are done right at commit time.
+
+#include <wayland-client-core.h>
+#include <wayland-egl.h>
+#include <wayland-server-core.h>
+
+#include <atomic>
+#include <thread>
+
+struct server_wlegl;
+
+class headless_compositor {
+  public:
+    // the globals offered besides wl_compositor
+    struct options
+    {
+        bool wlegl = true;
+        bool dmabuf = false;
+        bool shm = false;
+    };
+
+    headless_compositor() = default;
+    ~headless_compositor();
+
+    bool start(const options& opts);
+    void stop();
+
+    const char* socket() const
+    {
+        return m_socket;
+    }
+
+    // requests received from every client
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> dmabuf_buffers{0};
+
+  private:
+    struct wl_display* m_display = nullptr;
+    struct server_wlegl* m_wlegl = nullptr;
+    struct wl_protocol_logger* m_logger = nullptr;
+    const char* m_socket = nullptr;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+};
+
+// the client side: one wl_egl_window on a fresh connection
+struct headless_surface
+{
+    struct wl_display* display = nullptr;
+    struct wl_registry* registry = nullptr;
+    struct wl_compositor* compositor = nullptr;
+    struct wl_surface* surface = nullptr;
+    struct wl_egl_window* window = nullptr;
+
+    bool connect(const char* socket, int width, int height);
+    void disconnect();
+};
+
+#endif // EGL_HEADLESS_COMPOSITOR_H_
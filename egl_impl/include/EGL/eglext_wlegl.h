@@ -0,0 +1,30 @@
+// eglext_wlegl.h: private extensions of this libEGL wrapper on top of
+// EGL_WL_bind_wayland_display, the tokens are not registered with Khronos.
+
+#ifndef INCLUDE_EGL_EGLEXT_WLEGL_
+#define INCLUDE_EGL_EGLEXT_WLEGL_
+
+#include <EGL/eglext.h>
+
+// clang-format off
+
+#ifndef EGL_WLEGL_query_wayland_buffer
+#define EGL_WLEGL_query_wayland_buffer 1
+struct native_handle;
+struct AHardwareBuffer;
+// eglQueryWaylandBufferWL attributes, usage is split in two 32 bit halves
+#define EGL_WAYLAND_BUFFER_USAGE_WLEGL          0x3F00
+#define EGL_WAYLAND_BUFFER_USAGE_HI_WLEGL       0x3F01
+#define EGL_WAYLAND_BUFFER_STRIDE_WLEGL         0x3F02
+#define EGL_WAYLAND_BUFFER_ANDROID_FORMAT_WLEGL 0x3F03
+#define EGL_WAYLAND_BUFFER_OPAQUE_WLEGL         0x3F04
+#define EGL_WAYLAND_BUFFER_CPU_ACCESS_WLEGL     0x3F05
+// from eglGetProcAddress only, both return objects owned by the wl_buffer,
+// valid until it is destroyed
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETWAYLANDBUFFERNATIVEHANDLEWLEGLPROC) (EGLDisplay dpy, struct wl_resource *buffer, const struct native_handle **handle);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETWAYLANDBUFFERHARDWAREBUFFERWLEGLPROC) (EGLDisplay dpy, struct wl_resource *buffer, struct AHardwareBuffer **hardware_buffer);
+#endif /* EGL_WLEGL_query_wayland_buffer */
+
+// clang-format on
+
+#endif // INCLUDE_EGL_EGLEXT_WLEGL_
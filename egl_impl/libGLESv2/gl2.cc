@@ -24,12 +24,230 @@
 
 #include <string>
 #include <memory>
+#include <tuple>
 
 #include "logger.h"
 #include "loader/loader.h"
+#include "platform/egl_gl_thread.h"
 
 using namespace egl_wrapper;
 
+namespace {
+using gl_t = gl_hooks_t::gl_t;
+
+template <auto a, auto b>
+constexpr bool same_api = false;
+template <auto a>
+constexpr bool same_api<a, a> = true;
+
+// a pointer the call does not read: an offset into a buffer, or an array
+// a later draw reads
+template <auto api>
+constexpr bool pointer_not_read =
+    same_api<api, &gl_t::glVertexAttribPointer> ||
+    same_api<api, &gl_t::glVertexAttribIPointer> ||
+    same_api<api, &gl_t::glDrawArraysIndirect> ||
+    same_api<api, &gl_t::glDrawElementsIndirect>;
+
+template <auto api>
+constexpr bool draws_arrays = same_api<api, &gl_t::glDrawArrays> ||
+                              same_api<api, &gl_t::glDrawArraysInstanced>;
+
+template <auto api>
+constexpr bool draws_elements =
+    same_api<api, &gl_t::glDrawElements> ||
+    same_api<api, &gl_t::glDrawElementsInstanced> ||
+    same_api<api, &gl_t::glDrawRangeElements> ||
+    same_api<api, &gl_t::glDrawElementsBaseVertex> ||
+    same_api<api, &gl_t::glDrawRangeElementsBaseVertex> ||
+    same_api<api, &gl_t::glDrawElementsInstancedBaseVertex>;
+
+// an array the call reads before it returns, copied into the ring
+struct copied_t
+{
+    // the argument with the number of elements, -1 for one
+    int count;
+    size_t bytes;
+};
+
+template <auto api>
+constexpr copied_t copied{0, 0};
+
+#define GL_COPIED(_api, _count, _bytes)                                        \
+    template <>                                                                \
+    constexpr copied_t copied<&gl_t::_api>{_count, _bytes};
+
+// clang-format off
+GL_COPIED(glUniform1fv, 1, 4) GL_COPIED(glUniform2fv, 1, 8)
+GL_COPIED(glUniform3fv, 1, 12) GL_COPIED(glUniform4fv, 1, 16)
+GL_COPIED(glUniform1iv, 1, 4) GL_COPIED(glUniform2iv, 1, 8)
+GL_COPIED(glUniform3iv, 1, 12) GL_COPIED(glUniform4iv, 1, 16)
+GL_COPIED(glUniform1uiv, 1, 4) GL_COPIED(glUniform2uiv, 1, 8)
+GL_COPIED(glUniform3uiv, 1, 12) GL_COPIED(glUniform4uiv, 1, 16)
+GL_COPIED(glUniformMatrix2fv, 1, 16) GL_COPIED(glUniformMatrix3fv, 1, 36)
+GL_COPIED(glUniformMatrix4fv, 1, 64)
+GL_COPIED(glUniformMatrix2x3fv, 1, 24) GL_COPIED(glUniformMatrix3x2fv, 1, 24)
+GL_COPIED(glUniformMatrix2x4fv, 1, 32) GL_COPIED(glUniformMatrix4x2fv, 1, 32)
+GL_COPIED(glUniformMatrix3x4fv, 1, 48) GL_COPIED(glUniformMatrix4x3fv, 1, 48)
+GL_COPIED(glProgramUniform1fv, 2, 4) GL_COPIED(glProgramUniform2fv, 2, 8)
+GL_COPIED(glProgramUniform3fv, 2, 12) GL_COPIED(glProgramUniform4fv, 2, 16)
+GL_COPIED(glProgramUniform1iv, 2, 4) GL_COPIED(glProgramUniform2iv, 2, 8)
+GL_COPIED(glProgramUniform3iv, 2, 12) GL_COPIED(glProgramUniform4iv, 2, 16)
+GL_COPIED(glProgramUniform1uiv, 2, 4) GL_COPIED(glProgramUniform2uiv, 2, 8)
+GL_COPIED(glProgramUniform3uiv, 2, 12) GL_COPIED(glProgramUniform4uiv, 2, 16)
+GL_COPIED(glProgramUniformMatrix2fv, 2, 16)
+GL_COPIED(glProgramUniformMatrix3fv, 2, 36)
+GL_COPIED(glProgramUniformMatrix4fv, 2, 64)
+GL_COPIED(glProgramUniformMatrix2x3fv, 2, 24)
+GL_COPIED(glProgramUniformMatrix3x2fv, 2, 24)
+GL_COPIED(glProgramUniformMatrix2x4fv, 2, 32)
+GL_COPIED(glProgramUniformMatrix4x2fv, 2, 32)
+GL_COPIED(glProgramUniformMatrix3x4fv, 2, 48)
+GL_COPIED(glProgramUniformMatrix4x3fv, 2, 48)
+GL_COPIED(glVertexAttrib1fv, -1, 4) GL_COPIED(glVertexAttrib2fv, -1, 8)
+GL_COPIED(glVertexAttrib3fv, -1, 12) GL_COPIED(glVertexAttrib4fv, -1, 16)
+GL_COPIED(glVertexAttribI4iv, -1, 16) GL_COPIED(glVertexAttribI4uiv, -1, 16)
+GL_COPIED(glClearBufferfv, -1, 4) GL_COPIED(glClearBufferiv, -1, 4)
+GL_COPIED(glClearBufferuiv, -1, 4)
+GL_COPIED(glDrawBuffers, 0, 4)
+GL_COPIED(glInvalidateFramebuffer, 1, 4)
+GL_COPIED(glInvalidateSubFramebuffer, 1, 4)
+GL_COPIED(glBufferData, 1, 1) GL_COPIED(glBufferSubData, 2, 1)
+GL_COPIED(glDeleteBuffers, 0, 4) GL_COPIED(glDeleteTextures, 0, 4)
+GL_COPIED(glDeleteFramebuffers, 0, 4) GL_COPIED(glDeleteRenderbuffers, 0, 4)
+GL_COPIED(glDeleteVertexArrays, 0, 4) GL_COPIED(glDeleteQueries, 0, 4)
+GL_COPIED(glDeleteSamplers, 0, 4) GL_COPIED(glDeleteTransformFeedbacks, 0, 4)
+GL_COPIED(glDeleteProgramPipelines, 0, 4)
+// clang-format on
+
+#undef GL_COPIED
+
+template <auto api, typename... Args>
+size_t copied_bytes(Args... args)
+{
+    constexpr copied_t entry = copied<api>;
+    std::tuple<Args...> arguments{args...};
+    size_t count = 1;
+    if constexpr (entry.count >= 0)
+    {
+        auto n = std::get<entry.count>(arguments);
+        if (n < 0)
+            return SIZE_MAX;
+        count = n;
+    }
+    if constexpr (same_api<api, &gl_t::glClearBufferfv> ||
+                  same_api<api, &gl_t::glClearBufferiv> ||
+                  same_api<api, &gl_t::glClearBufferuiv>)
+    {
+        count = std::get<0>(arguments) == GL_COLOR ? 4 : 1;
+    }
+    return count * entry.bytes;
+}
+
+template <typename T>
+const void* data_of(T arg)
+{
+    if constexpr (std::is_pointer_v<T>)
+        return arg;
+    else
+        return nullptr;
+}
+
+template <typename T>
+T with_copy(T arg, const void* copy)
+{
+    if constexpr (std::is_pointer_v<T>)
+        return arg ? static_cast<T>(copy) : arg;
+    else
+        return arg;
+}
+
+// the driver's entry, or the wrapper's own of the same name when there is
+// one
+template <auto api, auto wrapper, typename... Args>
+auto invoke(const gl_t& gl, Args... args)
+{
+    if constexpr (std::is_null_pointer_v<decltype(wrapper)>)
+        return (gl.*api)(args...);
+    else
+        return (egl_get_system()->platform.*wrapper)(args...);
+}
+
+// post what returns nothing and reads no memory of the app past the call,
+// wait for the rest
+template <auto api, auto wrapper = nullptr>
+struct threaded_call
+{
+    egl_gl_thread_t* thread;
+
+    template <typename... Args>
+    auto operator()(Args... args) const;
+};
+
+template <auto api, auto wrapper>
+template <typename... Args>
+auto threaded_call<api, wrapper>::operator()(Args... args) const
+{
+    using result_t = decltype((std::declval<const gl_t&>().*api)(args...));
+    auto run = [=](const gl_t& gl) {
+        return invoke<api, wrapper>(gl, args...);
+    };
+    if constexpr (!std::is_void_v<result_t> ||
+                  same_api<api, &gl_t::glFinish>)
+    {
+        return thread->call(run);
+    }
+    else
+    {
+        std::tuple<Args...> arguments{args...};
+        auto& vertex_arrays = thread->vertex_arrays;
+        if constexpr (same_api<api, &gl_t::glBindBuffer>)
+            vertex_arrays.bind_buffer(args...);
+        else if constexpr (same_api<api, &gl_t::glBindVertexArray>)
+            vertex_arrays.bind_vertex_array(args...);
+        else if constexpr (same_api<api, &gl_t::glVertexAttribPointer>)
+            vertex_arrays.attrib_pointer(std::get<0>(arguments),
+                                         std::get<5>(arguments));
+        else if constexpr (same_api<api, &gl_t::glVertexAttribIPointer>)
+            vertex_arrays.attrib_pointer(std::get<0>(arguments),
+                                         std::get<4>(arguments));
+        else if constexpr (same_api<api, &gl_t::glDeleteBuffers>)
+            vertex_arrays.delete_buffers(args...);
+        else if constexpr (same_api<api, &gl_t::glDeleteVertexArrays>)
+            vertex_arrays.delete_vertex_arrays(args...);
+
+        if constexpr (draws_arrays<api> || draws_elements<api>)
+        {
+            if (vertex_arrays.reads_client(draws_elements<api>))
+                return thread->call(run);
+            thread->post(run);
+        }
+        else if constexpr (pointer_not_read<api> ||
+                           (... && (!std::is_pointer_v<Args> ||
+                                    std::is_same_v<Args, GLsync>)))
+        {
+            thread->post(run);
+        }
+        else if constexpr (copied<api>.bytes != 0)
+        {
+            const void* data = nullptr;
+            ((data = data ? data : data_of(args)), ...);
+            size_t size = data ? copied_bytes<api>(args...) : 0;
+            if (!thread->post(data, size,
+                              [=](const gl_t& gl, const void* copy) {
+                                  invoke<api, wrapper>(
+                                      gl, with_copy(args, copy)...);
+                              }))
+                thread->call(run);
+        }
+        else
+        {
+            thread->call(run);
+        }
+    }
+}
+} // namespace
+
 class check_gl_rval {
     std::string func;
     std::stringstream ss{};
@@ -81,11 +299,16 @@ class check_gl_rval {
     ~check_gl_rval()
     {
         const auto& gl = egl_get_system()->hooks[egl_system_t::GLESv2_INDEX].gl;
+        GLenum error = GL_NO_ERROR;
+        if (auto thread = egl_gl_thread_t::current(); thread && gl.glGetError)
+            error = thread->call([](const gl_t& gl) {
+                return gl.glGetError();
+            });
+        else if (gl.glGetError)
+            error = gl.glGetError();
         logger::log_info() << "call " << func << "(" << ss.str() << ")"
                            << " with glError: " << std::showbase << std::hex
-                           << static_cast<uint32_t>(gl.glGetError
-                                                        ? gl.glGetError()
-                                                        : GL_NO_ERROR);
+                           << static_cast<uint32_t>(error);
     }
 };
 
@@ -109,7 +332,13 @@ class check_gl_rval {
 #define API_ENTRY(_api) _api
 
 #define CALL_GL_API_INTERNAL_CALL(_api, ...)                                   \
-    const auto& gl = egl_get_system()->hooks[egl_system_t::GLESv2_INDEX].gl;   \
+    auto system = egl_get_system();                                            \
+    const auto& gl = system->hooks[egl_system_t::GLESv2_INDEX].gl;             \
+    if (system->gl_threaded.load(std::memory_order_relaxed) && gl._api)        \
+    {                                                                          \
+        if (auto thread = egl_gl_thread_t::current())                          \
+            return threaded_call<&gl_t::_api>{thread}(__VA_ARGS__);            \
+    }                                                                          \
     if (gl._api) [[likely]]                                                    \
         return gl._api(__VA_ARGS__);                                           \
     else                                                                       \
@@ -148,38 +377,729 @@ extern "C" {
 #undef CALL_GL_API_INTERNAL_DO_RETURN
 #undef CALL_GL_API_RETURN
 
-const GLubyte* glGetString(GLenum name)
+namespace {
+// a limit of the context bound with a driver thread, without waiting for
+// it; the rest of glGet* goes there
+template <typename T>
+bool threaded_limit(GLenum pname, T* data)
 {
     auto system = egl_get_system();
-    return system->platform.glGetString(name);
+    if (!system->gl_threaded.load(std::memory_order_relaxed))
+        return false;
+    auto thread = egl_gl_thread_t::current();
+    return thread && thread->limits.get(pname, data);
+}
+} // namespace
+
+// the wrapper's own entries run where the driver calls they make run
+#define CALL_PLATFORM_API(_api, ...)                                           \
+    auto system = egl_get_system();                                            \
+    if (system->gl_threaded.load(std::memory_order_relaxed))                   \
+    {                                                                          \
+        if (auto thread = egl_gl_thread_t::current())                          \
+            return thread->call([&](const gl_t&) {                             \
+                return system->platform._api(__VA_ARGS__);                     \
+            });                                                                \
+    }                                                                          \
+    return system->platform._api(__VA_ARGS__);
+
+const GLubyte* glGetString(GLenum name)
+{
+    CALL_PLATFORM_API(glGetString, name);
 }
 
 const GLubyte* glGetStringi(GLenum name, GLuint index)
 {
-    auto system = egl_get_system();
-    return system->platform.glGetStringi(name, index);
+    CALL_PLATFORM_API(glGetStringi, name, index);
 }
 
 void glGetBooleanv(GLenum pname, GLboolean* data)
 {
-    auto system = egl_get_system();
-    return system->platform.glGetBooleanv(pname, data);
+    if (threaded_limit(pname, data))
+        return;
+    CALL_PLATFORM_API(glGetBooleanv, pname, data);
 }
 
 void glGetFloatv(GLenum pname, GLfloat* data)
 {
-    auto system = egl_get_system();
-    return system->platform.glGetFloatv(pname, data);
+    if (threaded_limit(pname, data))
+        return;
+    CALL_PLATFORM_API(glGetFloatv, pname, data);
 }
 
 void glGetIntegerv(GLenum pname, GLint* data)
 {
-    auto system = egl_get_system();
-    return system->platform.glGetIntegerv(pname, data);
+    if (threaded_limit(pname, data))
+        return;
+    CALL_PLATFORM_API(glGetIntegerv, pname, data);
 }
 
 void glGetInteger64v(GLenum pname, GLint64* data)
 {
-    auto system = egl_get_system();
-    return system->platform.glGetInteger64v(pname, data);
+    if (threaded_limit(pname, data))
+        return;
+    CALL_PLATFORM_API(glGetInteger64v, pname, data);
+}
+
+void glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string,
+                    const GLint* length)
+{
+    CALL_PLATFORM_API(glShaderSource, shader, count, string, length);
+}
+
+void glCompileShader(GLuint shader)
+{
+    CALL_PLATFORM_API(glCompileShader, shader);
+}
+
+void glGetShaderiv(GLuint shader, GLenum pname, GLint* params)
+{
+    CALL_PLATFORM_API(glGetShaderiv, shader, pname, params);
+}
+
+void glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length,
+                        GLchar* infoLog)
+{
+    CALL_PLATFORM_API(glGetShaderInfoLog, shader, bufSize, length, infoLog);
+}
+
+void glDeleteShader(GLuint shader)
+{
+    CALL_PLATFORM_API(glDeleteShader, shader);
+}
+
+void glLinkProgram(GLuint program)
+{
+    CALL_PLATFORM_API(glLinkProgram, program);
+}
+
+void glDeleteProgram(GLuint program)
+{
+    CALL_PLATFORM_API(glDeleteProgram, program);
+}
+
+void glBindAttribLocation(GLuint program, GLuint index, const GLchar* name)
+{
+    CALL_PLATFORM_API(glBindAttribLocation, program, index, name);
+}
+
+void glProgramParameteri(GLuint program, GLenum pname, GLint value)
+{
+    CALL_PLATFORM_API(glProgramParameteri, program, pname, value);
+}
+
+void glTransformFeedbackVaryings(GLuint program, GLsizei count,
+                                 const GLchar* const* varyings,
+                                 GLenum bufferMode)
+{
+    CALL_PLATFORM_API(glTransformFeedbackVaryings, program, count, varyings,
+                      bufferMode);
+}
+
+void glGetShaderSource(GLuint shader, GLsizei bufSize, GLsizei* length,
+                       GLchar* source)
+{
+    CALL_PLATFORM_API(glGetShaderSource, shader, bufSize, length, source);
+}
+
+void glAttachShader(GLuint program, GLuint shader)
+{
+    CALL_PLATFORM_API(glAttachShader, program, shader);
+}
+
+void glDetachShader(GLuint program, GLuint shader)
+{
+    CALL_PLATFORM_API(glDetachShader, program, shader);
+}
+
+void glGetProgramiv(GLuint program, GLenum pname, GLint* params)
+{
+    CALL_PLATFORM_API(glGetProgramiv, program, pname, params);
+}
+
+void glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length,
+                         GLchar* infoLog)
+{
+    CALL_PLATFORM_API(glGetProgramInfoLog, program, bufSize, length, infoLog);
+}
+
+void glValidateProgram(GLuint program)
+{
+    CALL_PLATFORM_API(glValidateProgram, program);
+}
+
+void glUseProgramStages(GLuint pipeline, GLbitfield stages, GLuint program)
+{
+    CALL_PLATFORM_API(glUseProgramStages, pipeline, stages, program);
+}
+
+void glGetProgramBinary(GLuint program, GLsizei bufSize, GLsizei* length,
+                        GLenum* binaryFormat, void* binary)
+{
+    CALL_PLATFORM_API(glGetProgramBinary, program, bufSize, length,
+                      binaryFormat, binary);
+}
+
+void glProgramBinary(GLuint program, GLenum binaryFormat, const void* binary,
+                     GLsizei length)
+{
+    CALL_PLATFORM_API(glProgramBinary, program, binaryFormat, binary, length);
+}
+
+GLint glGetAttribLocation(GLuint program, const GLchar* name)
+{
+    CALL_PLATFORM_API(glGetAttribLocation, program, name);
+}
+
+GLint glGetUniformLocation(GLuint program, const GLchar* name)
+{
+    CALL_PLATFORM_API(glGetUniformLocation, program, name);
+}
+
+GLint glGetFragDataLocation(GLuint program, const GLchar* name)
+{
+    CALL_PLATFORM_API(glGetFragDataLocation, program, name);
+}
+
+void glGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize,
+                       GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+{
+    CALL_PLATFORM_API(glGetActiveAttrib, program, index, bufSize, length, size,
+                      type, name);
+}
+
+void glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize,
+                        GLsizei* length, GLint* size, GLenum* type,
+                        GLchar* name)
+{
+    CALL_PLATFORM_API(glGetActiveUniform, program, index, bufSize, length, size,
+                      type, name);
+}
+
+void glGetUniformIndices(GLuint program, GLsizei uniformCount,
+                         const GLchar* const* uniformNames,
+                         GLuint* uniformIndices)
+{
+    CALL_PLATFORM_API(glGetUniformIndices, program, uniformCount, uniformNames,
+                      uniformIndices);
+}
+
+void glGetActiveUniformsiv(GLuint program, GLsizei uniformCount,
+                           const GLuint* uniformIndices, GLenum pname,
+                           GLint* params)
+{
+    CALL_PLATFORM_API(glGetActiveUniformsiv, program, uniformCount,
+                      uniformIndices, pname, params);
+}
+
+GLuint glGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName)
+{
+    CALL_PLATFORM_API(glGetUniformBlockIndex, program, uniformBlockName);
+}
+
+void glGetActiveUniformBlockiv(GLuint program, GLuint uniformBlockIndex,
+                               GLenum pname, GLint* params)
+{
+    CALL_PLATFORM_API(glGetActiveUniformBlockiv, program, uniformBlockIndex,
+                      pname, params);
+}
+
+void glGetActiveUniformBlockName(GLuint program, GLuint uniformBlockIndex,
+                                 GLsizei bufSize, GLsizei* length,
+                                 GLchar* uniformBlockName)
+{
+    CALL_PLATFORM_API(glGetActiveUniformBlockName, program, uniformBlockIndex,
+                      bufSize, length, uniformBlockName);
+}
+
+void glUniformBlockBinding(GLuint program, GLuint uniformBlockIndex,
+                           GLuint uniformBlockBinding)
+{
+    CALL_PLATFORM_API(glUniformBlockBinding, program, uniformBlockIndex,
+                      uniformBlockBinding);
+}
+
+void glGetUniformfv(GLuint program, GLint location, GLfloat* params)
+{
+    CALL_PLATFORM_API(glGetUniformfv, program, location, params);
+}
+
+void glGetUniformiv(GLuint program, GLint location, GLint* params)
+{
+    CALL_PLATFORM_API(glGetUniformiv, program, location, params);
+}
+
+void glGetUniformuiv(GLuint program, GLint location, GLuint* params)
+{
+    CALL_PLATFORM_API(glGetUniformuiv, program, location, params);
+}
+
+namespace {
+bool streamed()
+{
+    return egl_get_system()->vertex_streamed.load(std::memory_order_relaxed);
+}
+
+bool filtered()
+{
+    return egl_get_system()->state_filtered.load(std::memory_order_relaxed);
+}
+
+bool compiled()
+{
+    return egl_get_system()->shaders_compiled.load(std::memory_order_relaxed);
+}
+} // namespace
+
+// the wrapper's entries that keep state of their own, taken only once a
+// context keeps it, see egl_vertex_stream_t, egl_state_filter_t and
+// egl_compile_pool_t; on the driver thread they are posted or waited for
+// as the driver's own would be
+#define CALL_WRAPPED_API(_wrapped, _api, ...)                                  \
+    if (!(_wrapped))                                                           \
+        return __##_api(__VA_ARGS__);                                          \
+    auto system = egl_get_system();                                            \
+    if (system->gl_threaded.load(std::memory_order_relaxed))                   \
+    {                                                                          \
+        if (auto thread = egl_gl_thread_t::current())                          \
+            return threaded_call<&gl_t::_api, &platform_impl_t::_api>{        \
+                thread}(__VA_ARGS__);                                          \
+    }                                                                          \
+    return system->platform._api(__VA_ARGS__);
+
+void glBindBuffer(GLenum target, GLuint buffer)
+{
+    CALL_WRAPPED_API(streamed() || filtered(), glBindBuffer, target, buffer);
+}
+
+void glBindVertexArray(GLuint array)
+{
+    CALL_WRAPPED_API(streamed(), glBindVertexArray, array);
+}
+
+void glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    CALL_WRAPPED_API(streamed() || filtered(), glDeleteBuffers, n, buffers);
+}
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                           GLboolean normalized, GLsizei stride,
+                           const void* pointer)
+{
+    CALL_WRAPPED_API(streamed(), glVertexAttribPointer, index, size, type,
+                     normalized, stride, pointer);
+}
+
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type,
+                            GLsizei stride, const void* pointer)
+{
+    CALL_WRAPPED_API(streamed(), glVertexAttribIPointer, index, size, type,
+                     stride, pointer);
+}
+
+void glEnableVertexAttribArray(GLuint index)
+{
+    CALL_WRAPPED_API(streamed(), glEnableVertexAttribArray, index);
+}
+
+void glDisableVertexAttribArray(GLuint index)
+{
+    CALL_WRAPPED_API(streamed(), glDisableVertexAttribArray, index);
+}
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+    CALL_WRAPPED_API(streamed(), glVertexAttribDivisor, index, divisor);
+}
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawArrays, mode, first,
+                     count);
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                    const void* indices)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawElements, mode, count,
+                     type, indices);
+}
+
+void glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count,
+                         GLenum type, const void* indices)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawRangeElements, mode,
+                     start, end, count, type, indices);
+}
+
+void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count,
+                           GLsizei instancecount)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawArraysInstanced, mode,
+                     first, count, instancecount);
+}
+
+void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
+                             const void* indices, GLsizei instancecount)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawElementsInstanced, mode,
+                     count, type, indices, instancecount);
+}
+
+void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                              const void* indices, GLint basevertex)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawElementsBaseVertex, mode,
+                     count, type, indices, basevertex);
+}
+
+void glDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end,
+                                   GLsizei count, GLenum type,
+                                   const void* indices, GLint basevertex)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawRangeElementsBaseVertex,
+                     mode, start, end, count, type, indices, basevertex);
+}
+
+void glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count,
+                                       GLenum type, const void* indices,
+                                       GLsizei instancecount, GLint basevertex)
+{
+    CALL_WRAPPED_API(streamed() || compiled(),
+                     glDrawElementsInstancedBaseVertex, mode, count, type,
+                     indices, instancecount, basevertex);
+}
+
+void glDrawArraysIndirect(GLenum mode, const void* indirect)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawArraysIndirect, mode,
+                     indirect);
+}
+
+void glDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect)
+{
+    CALL_WRAPPED_API(streamed() || compiled(), glDrawElementsIndirect, mode,
+                     type, indirect);
+}
+
+void glGetVertexAttribiv(GLuint index, GLenum pname, GLint* params)
+{
+    CALL_WRAPPED_API(streamed(), glGetVertexAttribiv, index, pname, params);
+}
+
+void glGetVertexAttribPointerv(GLuint index, GLenum pname, void** pointer)
+{
+    CALL_WRAPPED_API(streamed(), glGetVertexAttribPointerv, index, pname,
+                     pointer);
+}
+
+void glGetVertexAttribfv(GLuint index, GLenum pname, GLfloat* params)
+{
+    CALL_WRAPPED_API(streamed(), glGetVertexAttribfv, index, pname, params);
+}
+
+void glGetVertexAttribIiv(GLuint index, GLenum pname, GLint* params)
+{
+    CALL_WRAPPED_API(streamed(), glGetVertexAttribIiv, index, pname, params);
+}
+
+void glGetVertexAttribIuiv(GLuint index, GLenum pname, GLuint* params)
+{
+    CALL_WRAPPED_API(streamed(), glGetVertexAttribIuiv, index, pname, params);
+}
+
+void glDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+    CALL_WRAPPED_API(streamed(), glDeleteVertexArrays, n, arrays);
+}
+
+void glUseProgram(GLuint program)
+{
+    CALL_WRAPPED_API(compiled() || filtered(), glUseProgram, program);
+}
+
+void glUniform1f(GLint location, GLfloat v0)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1f, location, v0);
+}
+
+void glUniform1fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1fv, location, count, value);
+}
+
+void glUniform1i(GLint location, GLint v0)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1i, location, v0);
+}
+
+void glUniform1iv(GLint location, GLsizei count, const GLint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1iv, location, count, value);
+}
+
+void glUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2f, location, v0, v1);
+}
+
+void glUniform2fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2fv, location, count, value);
+}
+
+void glUniform2i(GLint location, GLint v0, GLint v1)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2i, location, v0, v1);
+}
+
+void glUniform2iv(GLint location, GLsizei count, const GLint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2iv, location, count, value);
+}
+
+void glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3f, location, v0, v1, v2);
+}
+
+void glUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3fv, location, count, value);
+}
+
+void glUniform3i(GLint location, GLint v0, GLint v1, GLint v2)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3i, location, v0, v1, v2);
+}
+
+void glUniform3iv(GLint location, GLsizei count, const GLint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3iv, location, count, value);
+}
+
+void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4f, location, v0, v1, v2, v3);
+}
+
+void glUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4fv, location, count, value);
+}
+
+void glUniform4i(GLint location, GLint v0, GLint v1, GLint v2, GLint v3)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4i, location, v0, v1, v2, v3);
+}
+
+void glUniform4iv(GLint location, GLsizei count, const GLint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4iv, location, count, value);
+}
+
+void glUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose,
+                        const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix2fv, location, count, transpose,
+                     value);
+}
+
+void glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose,
+                        const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix3fv, location, count, transpose,
+                     value);
+}
+
+void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose,
+                        const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix4fv, location, count, transpose,
+                     value);
+}
+
+void glUniformMatrix2x3fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix2x3fv, location, count,
+                     transpose, value);
+}
+
+void glUniformMatrix3x2fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix3x2fv, location, count,
+                     transpose, value);
+}
+
+void glUniformMatrix2x4fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix2x4fv, location, count,
+                     transpose, value);
+}
+
+void glUniformMatrix4x2fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix4x2fv, location, count,
+                     transpose, value);
+}
+
+void glUniformMatrix3x4fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix3x4fv, location, count,
+                     transpose, value);
+}
+
+void glUniformMatrix4x3fv(GLint location, GLsizei count, GLboolean transpose,
+                          const GLfloat* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniformMatrix4x3fv, location, count,
+                     transpose, value);
+}
+
+void glUniform1ui(GLint location, GLuint v0)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1ui, location, v0);
+}
+
+void glUniform2ui(GLint location, GLuint v0, GLuint v1)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2ui, location, v0, v1);
+}
+
+void glUniform3ui(GLint location, GLuint v0, GLuint v1, GLuint v2)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3ui, location, v0, v1, v2);
+}
+
+void glUniform4ui(GLint location, GLuint v0, GLuint v1, GLuint v2, GLuint v3)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4ui, location, v0, v1, v2, v3);
+}
+
+void glUniform1uiv(GLint location, GLsizei count, const GLuint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform1uiv, location, count, value);
+}
+
+void glUniform2uiv(GLint location, GLsizei count, const GLuint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform2uiv, location, count, value);
+}
+
+void glUniform3uiv(GLint location, GLsizei count, const GLuint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform3uiv, location, count, value);
+}
+
+void glUniform4uiv(GLint location, GLsizei count, const GLuint* value)
+{
+    CALL_WRAPPED_API(compiled(), glUniform4uiv, location, count, value);
+}
+
+void glActiveTexture(GLenum texture)
+{
+    CALL_WRAPPED_API(filtered(), glActiveTexture, texture);
+}
+
+void glBindTexture(GLenum target, GLuint texture)
+{
+    CALL_WRAPPED_API(filtered(), glBindTexture, target, texture);
+}
+
+void glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    CALL_WRAPPED_API(filtered(), glBindFramebuffer, target, framebuffer);
+}
+
+void glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+    CALL_WRAPPED_API(filtered(), glBindRenderbuffer, target, renderbuffer);
+}
+
+void glEnable(GLenum cap)
+{
+    CALL_WRAPPED_API(filtered(), glEnable, cap);
+}
+
+void glDisable(GLenum cap)
+{
+    CALL_WRAPPED_API(filtered(), glDisable, cap);
+}
+
+void glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    CALL_WRAPPED_API(filtered(), glBlendFunc, sfactor, dfactor);
+}
+
+void glBlendFuncSeparate(GLenum sfactorRGB, GLenum dfactorRGB,
+                         GLenum sfactorAlpha, GLenum dfactorAlpha)
+{
+    CALL_WRAPPED_API(filtered(), glBlendFuncSeparate, sfactorRGB, dfactorRGB,
+                     sfactorAlpha, dfactorAlpha);
+}
+
+void glBlendEquation(GLenum mode)
+{
+    CALL_WRAPPED_API(filtered(), glBlendEquation, mode);
+}
+
+void glBlendEquationSeparate(GLenum modeRGB, GLenum modeAlpha)
+{
+    CALL_WRAPPED_API(filtered(), glBlendEquationSeparate, modeRGB, modeAlpha);
+}
+
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    CALL_WRAPPED_API(filtered(), glViewport, x, y, width, height);
+}
+
+void glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    CALL_WRAPPED_API(filtered(), glScissor, x, y, width, height);
+}
+
+void glColorMask(GLboolean red, GLboolean green, GLboolean blue,
+                 GLboolean alpha)
+{
+    CALL_WRAPPED_API(filtered(), glColorMask, red, green, blue, alpha);
+}
+
+void glDepthMask(GLboolean flag)
+{
+    CALL_WRAPPED_API(filtered(), glDepthMask, flag);
+}
+
+void glDepthFunc(GLenum func)
+{
+    CALL_WRAPPED_API(filtered(), glDepthFunc, func);
+}
+
+void glCullFace(GLenum mode)
+{
+    CALL_WRAPPED_API(filtered(), glCullFace, mode);
+}
+
+void glFrontFace(GLenum mode)
+{
+    CALL_WRAPPED_API(filtered(), glFrontFace, mode);
+}
+
+void glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+    CALL_WRAPPED_API(filtered(), glDeleteTextures, n, textures);
+}
+
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+{
+    CALL_WRAPPED_API(filtered(), glDeleteFramebuffers, n, framebuffers);
+}
+
+void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+{
+    CALL_WRAPPED_API(filtered(), glDeleteRenderbuffers, n, renderbuffers);
 }
@@ -4,6 +4,8 @@
 #include <dlfcn.h>
 #include <stdlib.h>
 
+#include <string>
+
 #include "logger.h"
 
 using namespace egl_wrapper;
@@ -65,13 +67,30 @@ char const * const platform_names[] = {
 #undef GL_ENTRY
 #undef EGL_ENTRY
 
+// loads the driver when libEGL is loaded
 auto& loader = egl_system_t::loader::getInstance();
+
+// EGL_DRIVER_PATH overrides the directory of the vendor driver, a mock
+// driver on a host for instance
+void* open_driver_lib(const char* name)
+{
+    const char* dir = getenv("EGL_DRIVER_PATH");
+    std::string path = dir && *dir ? dir : SYSTEM_LIB_PATH;
+    path = path + "/" + name;
+    void* lib = dlopen(path.c_str(), RTLD_NOW);
+    if (!lib)
+        logger::log_error() << dlerror();
+    return lib;
+}
 } // namespace
 
+egl_system_t* egl_wrapper::g_egl_system = nullptr;
+
 egl_system_t::loader& egl_system_t::loader::getInstance()
 {
-    static egl_system_t::loader loader{};
-    return loader;
+    // never destroyed, see g_egl_system
+    static auto* loader = new egl_system_t::loader{};
+    return *loader;
 }
 
 egl_system_t::loader::loader() : getProcAddress(nullptr)
@@ -82,15 +101,9 @@ egl_system_t::loader::loader() : getProcAddress(nullptr)
     auto restored = systemloader.create_ldenv_restore();
 #endif
 
-    libEgl = dlopen(SYSTEM_LIB_PATH "/libEGL.so", RTLD_NOW);
-    if (!libEgl)
-        logger::log_error() << dlerror();
-    libGles1 = dlopen(SYSTEM_LIB_PATH "/libGLESv1_CM.so", RTLD_NOW);
-    if (!libGles1)
-        logger::log_error() << dlerror();
-    libGles2 = dlopen(SYSTEM_LIB_PATH "/libGLESv2.so", RTLD_NOW);
-    if (!libGles2)
-        logger::log_error() << dlerror();
+    libEgl = open_driver_lib("libEGL.so");
+    libGles1 = open_driver_lib("libGLESv1_CM.so");
+    libGles2 = open_driver_lib("libGLESv2.so");
 
     if (!(libEgl && libGles1 && libGles2))
     {
@@ -105,9 +118,10 @@ egl_system_t::loader::loader() : getProcAddress(nullptr)
         logger::log_fatal() << "load function eglGetProcAddress failed";
     }
 
-    system = std::shared_ptr<egl_system_t>{new egl_system_t};
+    system = new egl_system_t;
     init_libegl_api();
     init_libgles_api();
+    g_egl_system = system;
 }
 
 void egl_system_t::loader::init_libegl_api()
@@ -182,6 +196,27 @@ void egl_system_t::loader::init_libgles_api()
         gles2++;
     }
 
+    // an ES2 driver may only have the OES or EXT names of the entries the
+    // wrapper implements, which it calls by their core names
+    auto* hooks = reinterpret_cast<__eglMustCastToProperFunctionPointerType*>(
+        &system->hooks[GLESv2_INDEX].gl);
+    for (const char* const* name = platform_names; *name; name++)
+    {
+        if (strncmp(*name, "gl", 2) != 0)
+            continue;
+        size_t index = 0;
+        while (gl_names[index] && strcmp(gl_names[index], *name) != 0)
+            index++;
+        if (!gl_names[index] || hooks[index])
+            continue;
+        for (const char* suffix : {"OES", "EXT"})
+        {
+            std::string alias = std::string{*name} + suffix;
+            if ((hooks[index] = getProcAddress(alias.c_str())))
+                break;
+        }
+    }
+
     api = gl_ext_name;
     auto* glext = reinterpret_cast<__eglMustCastToProperFunctionPointerType*>(
         &system->glext);
@@ -197,21 +232,12 @@ void egl_system_t::loader::init_libgles_api()
     }
 }
 
-egl_system_t::loader::~loader()
-{
-    getProcAddress = nullptr;
-
-    dlclose(libEgl);
-    dlclose(libGles1);
-    dlclose(libGles2);
-}
-
 egl_system_t::egl_system_t()
 {
     fullPlatformImpl(platform);
 }
 
-std::shared_ptr<egl_system_t> egl_wrapper::egl_get_system()
+egl_system_t* egl_wrapper::egl_get_system()
 {
-    return loader.system;
+    return g_egl_system;
 }
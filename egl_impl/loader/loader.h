@@ -4,7 +4,8 @@
 #include "hooks.h"
 #include "utils.h"
 #include <EGL/egl.h>
-#include <memory>
+
+#include <atomic>
 
 namespace egl_wrapper {
 class egl_system_t {
@@ -20,6 +21,18 @@ class egl_system_t {
     // Functions implemented or redirected by platform libraries
     platform_impl_t platform;
 
+    // set once a context runs its GL calls on a driver thread, see
+    // egl_gl_thread_t
+    std::atomic<bool> gl_threaded{false};
+    // set once a context streams client vertex arrays, see
+    // egl_vertex_stream_t
+    std::atomic<bool> vertex_streamed{false};
+    // set once a context filters its state calls, see egl_state_filter_t
+    std::atomic<bool> state_filtered{false};
+    // set once a context compiles its shaders on workers, see
+    // egl_compile_pool_t
+    std::atomic<bool> shaders_compiled{false};
+
     class loader {
         using getProcAddressType =
             __eglMustCastToProperFunctionPointerType (*)(const char*);
@@ -37,7 +50,6 @@ class egl_system_t {
 
       public:
         static loader& getInstance();
-        ~loader();
 
         loader(const loader&) = delete;
         loader& operator=(const loader&) = delete;
@@ -45,11 +57,17 @@ class egl_system_t {
         void* libEgl;
         void* libGles1;
         void* libGles2;
-        std::shared_ptr<egl_system_t> system;
+        egl_system_t* system = nullptr;
     };
 };
 
-EGLAPI std::shared_ptr<egl_system_t> egl_get_system();
+// The loaded driver. Set while libEGL is being loaded and never freed, and
+// the driver libraries are never closed, so a thread still calling in
+// while the process exits finds both intact. The entry points of libEGL
+// read it directly, libGLES* through egl_get_system().
+__attribute__((visibility("hidden"))) extern egl_system_t* g_egl_system;
+
+EGLAPI egl_system_t* egl_get_system();
 } // namespace egl_wrapper
 
 #endif // LOADER_H_
@@ -0,0 +1,1456 @@
+// mock vendor libEGL: one display, a fixed config table, surfaces on
+// ANativeWindow or pbuffers without storage, contexts that render nothing
+// and fences that signal after MOCK_GPU_LATENCY_US.
+
+#include "mock_driver.h"
+#include "logger.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <system/window.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+struct config_desc
+{
+    EGLint id;
+    EGLint red, green, blue, alpha;
+    EGLint depth, stencil;
+    EGLint samples;
+    // HAL_PIXEL_FORMAT_* of the window buffers
+    EGLint visual;
+};
+
+// clang-format off
+constexpr config_desc configs[] = {
+    {.id = 1, .red = 8, .green = 8, .blue = 8, .alpha = 8, .depth = 24, .stencil = 8, .samples = 0, .visual = 1},
+    {.id = 2, .red = 8, .green = 8, .blue = 8, .alpha = 8, .depth = 0,  .stencil = 0, .samples = 0, .visual = 1},
+    {.id = 3, .red = 8, .green = 8, .blue = 8, .alpha = 0, .depth = 24, .stencil = 8, .samples = 0, .visual = 2},
+    {.id = 4, .red = 5, .green = 6, .blue = 5, .alpha = 0, .depth = 16, .stencil = 0, .samples = 0, .visual = 4},
+    {.id = 5, .red = 8, .green = 8, .blue = 8, .alpha = 8, .depth = 24, .stencil = 8, .samples = 4, .visual = 1},
+};
+// clang-format on
+
+constexpr EGLint config_count = sizeof(configs) / sizeof(configs[0]);
+constexpr EGLint surface_types = EGL_WINDOW_BIT | EGL_PBUFFER_BIT;
+constexpr EGLint renderable_types =
+    EGL_OPENGL_ES_BIT | EGL_OPENGL_ES2_BIT | EGL_OPENGL_ES3_BIT_KHR;
+constexpr EGLint max_pbuffer_size = 16384;
+
+const char* const display_extensions =
+    "EGL_KHR_fence_sync EGL_KHR_reusable_sync EGL_KHR_wait_sync "
+    "EGL_KHR_image_base EGL_ANDROID_image_native_buffer "
+    "EGL_KHR_swap_buffers_with_damage EGL_KHR_create_context "
+    "EGL_KHR_surfaceless_context EGL_ANDROID_blob_cache";
+const char* const client_extensions =
+    "EGL_EXT_client_extensions EGL_EXT_platform_base "
+    "EGL_KHR_platform_android";
+
+struct surface_t
+{
+    const config_desc* config;
+    // null for a pbuffer
+    ANativeWindow* window = nullptr;
+    // the buffer rendered into, dequeued on the first swap after a queue
+    ANativeWindowBuffer* buffer = nullptr;
+    int fence = -1;
+    EGLint width = 0;
+    EGLint height = 0;
+    EGLint swap_behavior = EGL_BUFFER_DESTROYED;
+    // threads it is current on and whether the handle is already gone
+    int bound = 0;
+    bool destroyed = false;
+
+    ~surface_t()
+    {
+        if (!window)
+            return;
+        if (buffer)
+            window->cancelBuffer(window, buffer, fence);
+        native_window_api_disconnect(window, NATIVE_WINDOW_API_EGL);
+        window->common.decRef(&window->common);
+    }
+};
+
+struct context_t
+{
+    const config_desc* config;
+    EGLint version;
+    int bound = 0;
+    bool destroyed = false;
+};
+
+struct sync_t
+{
+    EGLenum type;
+    // fences are done at this point, reusable syncs when signaled
+    mock_driver::clock_type::time_point done;
+    bool signaled = false;
+};
+
+struct image_t
+{
+    EGLenum target;
+    ANativeWindowBuffer* buffer = nullptr;
+
+    ~image_t()
+    {
+        if (buffer)
+            buffer->common.decRef(&buffer->common);
+    }
+};
+
+struct display_t
+{
+    std::mutex mutex;
+    // wakes the waiters of reusable syncs
+    std::condition_variable signal;
+    bool initialized = false;
+    std::set<surface_t*> surfaces;
+    std::set<context_t*> contexts;
+    std::set<sync_t*> syncs;
+    std::set<image_t*> images;
+    // set once per process, nothing is compiled to store in them
+    EGLSetBlobFuncANDROID set_blob = nullptr;
+    EGLGetBlobFuncANDROID get_blob = nullptr;
+} display;
+
+struct thread_state
+{
+    EGLint error = EGL_SUCCESS;
+    EGLenum api = EGL_OPENGL_ES_API;
+    context_t* context = nullptr;
+    surface_t* draw = nullptr;
+    surface_t* read = nullptr;
+};
+
+thread_local thread_state current;
+
+template <typename T>
+T set_error(EGLint error, T ret)
+{
+    current.error = error;
+    return ret;
+}
+
+// EGL_NOT_INITIALIZED is only an error when the call needs the display
+bool check_display(EGLDisplay dpy, bool initialized = true)
+{
+    if (dpy != &display)
+        return set_error(EGL_BAD_DISPLAY, false);
+    if (initialized && !display.initialized)
+        return set_error(EGL_NOT_INITIALIZED, false);
+    return true;
+}
+
+template <typename T>
+T* find(std::set<T*>& objects, void* handle)
+{
+    auto iter = objects.find(static_cast<T*>(handle));
+    return iter != objects.end() ? *iter : nullptr;
+}
+
+const config_desc* find_config(EGLConfig config)
+{
+    auto desc = static_cast<const config_desc*>(config);
+    if (desc < configs || desc >= configs + config_count)
+        return nullptr;
+    return desc;
+}
+
+bool config_attrib(const config_desc& config, EGLint attribute, EGLint* value)
+{
+    switch (attribute)
+    {
+    case EGL_BUFFER_SIZE:
+        *value = config.red + config.green + config.blue + config.alpha;
+        break;
+    case EGL_RED_SIZE:
+        *value = config.red;
+        break;
+    case EGL_GREEN_SIZE:
+        *value = config.green;
+        break;
+    case EGL_BLUE_SIZE:
+        *value = config.blue;
+        break;
+    case EGL_ALPHA_SIZE:
+        *value = config.alpha;
+        break;
+    case EGL_DEPTH_SIZE:
+        *value = config.depth;
+        break;
+    case EGL_STENCIL_SIZE:
+        *value = config.stencil;
+        break;
+    case EGL_SAMPLES:
+        *value = config.samples;
+        break;
+    case EGL_SAMPLE_BUFFERS:
+        *value = config.samples ? 1 : 0;
+        break;
+    case EGL_CONFIG_ID:
+        *value = config.id;
+        break;
+    case EGL_NATIVE_VISUAL_ID:
+        *value = config.visual;
+        break;
+    case EGL_SURFACE_TYPE:
+        *value = surface_types;
+        break;
+    case EGL_RENDERABLE_TYPE:
+    case EGL_CONFORMANT:
+        *value = renderable_types;
+        break;
+    case EGL_CONFIG_CAVEAT:
+    case EGL_TRANSPARENT_TYPE:
+        *value = EGL_NONE;
+        break;
+    case EGL_COLOR_BUFFER_TYPE:
+        *value = EGL_RGB_BUFFER;
+        break;
+    case EGL_MAX_PBUFFER_WIDTH:
+    case EGL_MAX_PBUFFER_HEIGHT:
+        *value = max_pbuffer_size;
+        break;
+    case EGL_MAX_PBUFFER_PIXELS:
+        *value = max_pbuffer_size * max_pbuffer_size;
+        break;
+    case EGL_NATIVE_RENDERABLE:
+    case EGL_RECORDABLE_ANDROID:
+    case EGL_FRAMEBUFFER_TARGET_ANDROID:
+        *value = EGL_TRUE;
+        break;
+    case EGL_BIND_TO_TEXTURE_RGB:
+    case EGL_BIND_TO_TEXTURE_RGBA:
+        *value = EGL_FALSE;
+        break;
+    case EGL_MAX_SWAP_INTERVAL:
+        *value = 1;
+        break;
+    case EGL_LEVEL:
+    case EGL_NATIVE_VISUAL_TYPE:
+    case EGL_MIN_SWAP_INTERVAL:
+    case EGL_LUMINANCE_SIZE:
+    case EGL_ALPHA_MASK_SIZE:
+    case EGL_TRANSPARENT_RED_VALUE:
+    case EGL_TRANSPARENT_GREEN_VALUE:
+    case EGL_TRANSPARENT_BLUE_VALUE:
+        *value = 0;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+enum class match_rule
+{
+    exact,
+    at_least,
+    mask,
+    ignored,
+};
+
+match_rule rule_of(EGLint attribute)
+{
+    switch (attribute)
+    {
+    case EGL_SURFACE_TYPE:
+    case EGL_RENDERABLE_TYPE:
+    case EGL_CONFORMANT:
+        return match_rule::mask;
+    case EGL_BUFFER_SIZE:
+    case EGL_RED_SIZE:
+    case EGL_GREEN_SIZE:
+    case EGL_BLUE_SIZE:
+    case EGL_ALPHA_SIZE:
+    case EGL_DEPTH_SIZE:
+    case EGL_STENCIL_SIZE:
+    case EGL_SAMPLES:
+    case EGL_SAMPLE_BUFFERS:
+    case EGL_LUMINANCE_SIZE:
+    case EGL_ALPHA_MASK_SIZE:
+        return match_rule::at_least;
+    case EGL_MAX_PBUFFER_WIDTH:
+    case EGL_MAX_PBUFFER_HEIGHT:
+    case EGL_MAX_PBUFFER_PIXELS:
+    case EGL_NATIVE_VISUAL_ID:
+        return match_rule::ignored;
+    default:
+        return match_rule::exact;
+    }
+}
+
+// the configs matching attrib_list, sorted the way EGL 1.5 3.4.1.2 asks
+template <typename AttribType>
+bool choose_configs(const AttribType* attrib_list,
+                    std::vector<const config_desc*>& matches)
+{
+    for (const auto& config : configs)
+        matches.push_back(&config);
+
+    // the color sizes asked for, their sum is the first sort key
+    bool red = false, green = false, blue = false, alpha = false;
+    for (auto attr = attrib_list; attr && attr[0] != EGL_NONE; attr += 2)
+    {
+        EGLint attribute = static_cast<EGLint>(attr[0]);
+        EGLint wanted = static_cast<EGLint>(attr[1]);
+        EGLint value;
+        if (!config_attrib(configs[0], attribute, &value))
+            return set_error(EGL_BAD_ATTRIBUTE, false);
+        if (wanted == EGL_DONT_CARE)
+            continue;
+
+        bool requested = wanted > 0;
+        if (attribute == EGL_RED_SIZE)
+            red = requested;
+        else if (attribute == EGL_GREEN_SIZE)
+            green = requested;
+        else if (attribute == EGL_BLUE_SIZE)
+            blue = requested;
+        else if (attribute == EGL_ALPHA_SIZE)
+            alpha = requested;
+
+        auto rule = rule_of(attribute);
+        if (rule == match_rule::ignored)
+            continue;
+        auto mismatch = [&](const config_desc* config) {
+            config_attrib(*config, attribute, &value);
+            switch (rule)
+            {
+            case match_rule::mask:
+                return (value & wanted) != wanted;
+            case match_rule::at_least:
+                return value < wanted;
+            default:
+                return value != wanted;
+            }
+        };
+        matches.erase(std::remove_if(matches.begin(), matches.end(), mismatch),
+                      matches.end());
+    }
+
+    auto color_bits = [&](const config_desc* config) {
+        return (red ? config->red : 0) + (green ? config->green : 0) +
+               (blue ? config->blue : 0) + (alpha ? config->alpha : 0);
+    };
+    auto buffer_size = [](const config_desc* config) {
+        return config->red + config->green + config->blue + config->alpha;
+    };
+    // the table is in EGL_CONFIG_ID order, the last key
+    std::stable_sort(matches.begin(), matches.end(),
+                     [&](const config_desc* a, const config_desc* b) {
+                         if (color_bits(a) != color_bits(b))
+                             return color_bits(a) > color_bits(b);
+                         if (buffer_size(a) != buffer_size(b))
+                             return buffer_size(a) < buffer_size(b);
+                         if (a->samples != b->samples)
+                             return a->samples < b->samples;
+                         if (a->depth != b->depth)
+                             return a->depth < b->depth;
+                         return a->stencil < b->stencil;
+                     });
+    return true;
+}
+
+// drops a binding of a context or surface, the last one of an object whose
+// handle is already destroyed frees it. Called with display.mutex held.
+template <typename T>
+void unbind(T* object)
+{
+    if (object && --object->bound == 0 && object->destroyed)
+        delete object;
+}
+
+template <typename T>
+void bind(T* object)
+{
+    if (object)
+        object->bound++;
+}
+
+// the handle goes away now, the object once nothing has it current
+template <typename T>
+void destroy(std::set<T*>& objects, T* object)
+{
+    objects.erase(object);
+    if (object->bound)
+        object->destroyed = true;
+    else
+        delete object;
+}
+
+bool dequeue(surface_t* surface)
+{
+    ANativeWindow* win = surface->window;
+    if (win->dequeueBuffer(win, &surface->buffer, &surface->fence) != 0)
+    {
+        surface->buffer = nullptr;
+        return false;
+    }
+    surface->width = surface->buffer->width;
+    surface->height = surface->buffer->height;
+    return true;
+}
+
+EGLSurface create_window_surface(EGLDisplay dpy, EGLConfig config,
+                                 ANativeWindow* window)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    auto desc = find_config(config);
+    if (!desc)
+        return set_error(EGL_BAD_CONFIG, EGL_NO_SURFACE);
+    if (!window || window->common.magic != ANDROID_NATIVE_WINDOW_MAGIC)
+        return set_error(EGL_BAD_NATIVE_WINDOW, EGL_NO_SURFACE);
+    for (auto surface : display.surfaces)
+    {
+        if (surface->window == window)
+            return set_error(EGL_BAD_ALLOC, EGL_NO_SURFACE);
+    }
+
+    if (native_window_api_connect(window, NATIVE_WINDOW_API_EGL) != 0)
+    {
+        logger::log_error() << "mock driver: cannot connect to the window";
+        return set_error(EGL_BAD_ALLOC, EGL_NO_SURFACE);
+    }
+    native_window_set_buffers_format(window, desc->visual);
+    window->common.incRef(&window->common);
+
+    auto surface = new surface_t{.config = desc, .window = window};
+    window->query(window, NATIVE_WINDOW_WIDTH, &surface->width);
+    window->query(window, NATIVE_WINDOW_HEIGHT, &surface->height);
+    display.surfaces.insert(surface);
+    return surface;
+}
+
+template <typename AttribType>
+EGLImageKHR create_image(EGLDisplay dpy, EGLContext ctx, EGLenum target,
+                         EGLClientBuffer buffer, const AttribType* attrib_list)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_NO_IMAGE_KHR;
+    if (target != EGL_NATIVE_BUFFER_ANDROID)
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_IMAGE_KHR);
+    if (ctx != EGL_NO_CONTEXT)
+        return set_error(EGL_BAD_CONTEXT, EGL_NO_IMAGE_KHR);
+
+    auto native = reinterpret_cast<ANativeWindowBuffer*>(buffer);
+    if (!native || native->common.magic != ANDROID_NATIVE_BUFFER_MAGIC)
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_IMAGE_KHR);
+    for (auto attr = attrib_list; attr && attr[0] != EGL_NONE; attr += 2)
+    {
+        if (attr[0] != EGL_IMAGE_PRESERVED_KHR)
+            return set_error(EGL_BAD_PARAMETER, EGL_NO_IMAGE_KHR);
+    }
+
+    native->common.incRef(&native->common);
+    auto image = new image_t{.target = target, .buffer = native};
+    display.images.insert(image);
+    return image;
+}
+
+EGLBoolean destroy_image(EGLDisplay dpy, EGLImageKHR image)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.images, image);
+    if (!object)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    display.images.erase(object);
+    delete object;
+    return EGL_TRUE;
+}
+
+template <typename AttribType>
+EGLSyncKHR create_sync(EGLDisplay dpy, EGLenum type,
+                       const AttribType* attrib_list)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_NO_SYNC_KHR;
+    if (attrib_list && attrib_list[0] != EGL_NONE)
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_NO_SYNC_KHR);
+
+    auto sync = new sync_t{.type = type, .done = {}};
+    switch (type)
+    {
+    case EGL_SYNC_FENCE_KHR:
+        if (!current.context)
+        {
+            delete sync;
+            return set_error(EGL_BAD_MATCH, EGL_NO_SYNC_KHR);
+        }
+        sync->done = mock_driver::submit();
+        break;
+    case EGL_SYNC_REUSABLE_KHR:
+        break;
+    default:
+        // EGL_SYNC_NATIVE_FENCE_ANDROID needs real fds
+        delete sync;
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_NO_SYNC_KHR);
+    }
+    display.syncs.insert(sync);
+    return sync;
+}
+
+EGLBoolean destroy_sync(EGLDisplay dpy, EGLSyncKHR sync)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.syncs, sync);
+    if (!object)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    display.syncs.erase(object);
+    delete object;
+    // waiters on it return
+    display.signal.notify_all();
+    return EGL_TRUE;
+}
+
+EGLint client_wait_sync(EGLDisplay dpy, EGLSyncKHR sync, EGLTimeKHR timeout)
+{
+    using namespace std::chrono;
+    std::unique_lock lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.syncs, sync);
+    if (!object)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    bool forever = timeout == EGL_FOREVER_KHR;
+    // far enough for anyone and no overflow of the clock
+    auto deadline = mock_driver::clock_type::now() +
+                    nanoseconds(std::min<EGLTimeKHR>(timeout, 1ull << 62));
+
+    if (object->type == EGL_SYNC_FENCE_KHR)
+    {
+        auto done = object->done;
+        lock.unlock();
+        mock_driver::wait_until(forever ? done : std::min(done, deadline));
+        return mock_driver::clock_type::now() >= done
+                   ? EGL_CONDITION_SATISFIED_KHR
+                   : EGL_TIMEOUT_EXPIRED_KHR;
+    }
+
+    auto ready = [&] {
+        return !find(display.syncs, sync) || object->signaled;
+    };
+    if (forever)
+        display.signal.wait(lock, ready);
+    else if (!display.signal.wait_until(lock, deadline, ready))
+        return EGL_TIMEOUT_EXPIRED_KHR;
+    return EGL_CONDITION_SATISFIED_KHR;
+}
+
+template <typename ValueType>
+EGLBoolean get_sync_attrib(EGLDisplay dpy, EGLSyncKHR sync, EGLint attribute,
+                           ValueType* value)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.syncs, sync);
+    if (!object)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    if (!value)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    bool fence = object->type == EGL_SYNC_FENCE_KHR;
+    switch (attribute)
+    {
+    case EGL_SYNC_TYPE_KHR:
+        *value = object->type;
+        break;
+    case EGL_SYNC_STATUS_KHR:
+        if (fence)
+            object->signaled = mock_driver::clock_type::now() >= object->done;
+        *value = object->signaled ? EGL_SIGNALED_KHR : EGL_UNSIGNALED_KHR;
+        break;
+    case EGL_SYNC_CONDITION_KHR:
+        if (!fence)
+            return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+        *value = EGL_SYNC_PRIOR_COMMANDS_COMPLETE_KHR;
+        break;
+    default:
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+    }
+    return EGL_TRUE;
+}
+
+EGLBoolean wait_sync(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags)
+{
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    if (!find(display.syncs, sync))
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    if (flags != 0)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    if (!current.context)
+        return set_error(EGL_BAD_MATCH, EGL_FALSE);
+    // the wait happens on the gpu, which does not exist
+    return EGL_TRUE;
+}
+
+EGLBoolean swap_buffers(EGLDisplay dpy, EGLSurface surface)
+{
+    surface_t* object;
+    {
+        std::lock_guard lock{display.mutex};
+        if (!check_display(dpy))
+            return EGL_FALSE;
+        object = find(display.surfaces, surface);
+        // bound to this thread, so nobody frees it under us
+        if (!object || object != current.draw)
+            return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+    }
+    if (!object->window)
+        return EGL_TRUE;
+
+    // the frame is rendered before it is queued, there is no fence to pass
+    mock_driver::wait_until(mock_driver::submit());
+    if (!object->buffer && !dequeue(object))
+        return set_error(EGL_BAD_NATIVE_WINDOW, EGL_FALSE);
+    if (object->fence >= 0)
+        close(object->fence);
+
+    ANativeWindow* win = object->window;
+    int err = win->queueBuffer(win, object->buffer, -1);
+    object->buffer = nullptr;
+    object->fence = -1;
+    if (err != 0)
+        return set_error(EGL_BAD_NATIVE_WINDOW, EGL_FALSE);
+    return EGL_TRUE;
+}
+
+// the gpu is idle once the work submitted so far is done
+void wait_client()
+{
+    if (current.context)
+        mock_driver::wait_until(mock_driver::submit());
+}
+} // namespace
+
+extern "C" {
+EGLDisplay eglGetDisplay(EGLNativeDisplayType display_id)
+{
+    MOCK_RECORD(eglGetDisplay);
+    if (display_id != EGL_DEFAULT_DISPLAY)
+        return EGL_NO_DISPLAY;
+    return &display;
+}
+
+EGLDisplay eglGetPlatformDisplay(EGLenum platform, void* native_display,
+                                 const EGLAttrib*)
+{
+    MOCK_RECORD(eglGetPlatformDisplay);
+    if (platform != EGL_PLATFORM_ANDROID_KHR)
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_DISPLAY);
+    if (native_display != EGL_DEFAULT_DISPLAY)
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_DISPLAY);
+    return &display;
+}
+
+EGLBoolean eglInitialize(EGLDisplay dpy, EGLint* major, EGLint* minor)
+{
+    MOCK_RECORD(eglInitialize);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy, false))
+        return EGL_FALSE;
+    display.initialized = true;
+    if (major)
+        *major = 1;
+    if (minor)
+        *minor = 5;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglTerminate(EGLDisplay dpy)
+{
+    MOCK_RECORD(eglTerminate);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy, false))
+        return EGL_FALSE;
+
+    // what is current stays alive until it is released
+    while (!display.surfaces.empty())
+        destroy(display.surfaces, *display.surfaces.begin());
+    while (!display.contexts.empty())
+        destroy(display.contexts, *display.contexts.begin());
+    for (auto sync : display.syncs)
+        delete sync;
+    display.syncs.clear();
+    for (auto image : display.images)
+        delete image;
+    display.images.clear();
+    display.signal.notify_all();
+
+    display.initialized = false;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglGetConfigs(EGLDisplay dpy, EGLConfig* configs_out,
+                         EGLint config_size, EGLint* num_config)
+{
+    MOCK_RECORD(eglGetConfigs);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    if (!num_config)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    EGLint count = configs_out ? std::min(config_size, config_count)
+                               : config_count;
+    for (EGLint i = 0; configs_out && i < count; i++)
+        configs_out[i] = const_cast<config_desc*>(&configs[i]);
+    *num_config = std::max(count, 0);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglChooseConfig(EGLDisplay dpy, const EGLint* attrib_list,
+                           EGLConfig* configs_out, EGLint config_size,
+                           EGLint* num_config)
+{
+    MOCK_RECORD(eglChooseConfig);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    if (!num_config)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    std::vector<const config_desc*> matches;
+    if (!choose_configs(attrib_list, matches))
+        return EGL_FALSE;
+
+    EGLint count = static_cast<EGLint>(matches.size());
+    if (configs_out)
+        count = std::max(std::min(count, config_size), 0);
+    for (EGLint i = 0; configs_out && i < count; i++)
+        configs_out[i] = const_cast<config_desc*>(matches[i]);
+    *num_config = count;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglGetConfigAttrib(EGLDisplay dpy, EGLConfig config,
+                              EGLint attribute, EGLint* value)
+{
+    MOCK_RECORD(eglGetConfigAttrib);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto desc = find_config(config);
+    if (!desc)
+        return set_error(EGL_BAD_CONFIG, EGL_FALSE);
+    if (!value)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    if (!config_attrib(*desc, attribute, value))
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+    return EGL_TRUE;
+}
+
+EGLSurface eglCreateWindowSurface(EGLDisplay dpy, EGLConfig config,
+                                  EGLNativeWindowType win,
+                                  const EGLint*)
+{
+    MOCK_RECORD(eglCreateWindowSurface);
+    return create_window_surface(dpy, config,
+                                 reinterpret_cast<ANativeWindow*>(win));
+}
+
+EGLSurface eglCreatePlatformWindowSurface(EGLDisplay dpy, EGLConfig config,
+                                          void* native_window,
+                                          const EGLAttrib*)
+{
+    MOCK_RECORD(eglCreatePlatformWindowSurface);
+    return create_window_surface(dpy, config,
+                                 static_cast<ANativeWindow*>(native_window));
+}
+
+EGLSurface eglCreatePlatformWindowSurfaceEXT(EGLDisplay dpy, EGLConfig config,
+                                             void* native_window,
+                                             const EGLint*)
+{
+    MOCK_RECORD(eglCreatePlatformWindowSurfaceEXT);
+    return create_window_surface(dpy, config,
+                                 static_cast<ANativeWindow*>(native_window));
+}
+
+EGLSurface eglCreatePixmapSurface(EGLDisplay dpy, EGLConfig,
+                                  EGLNativePixmapType, const EGLint*)
+{
+    MOCK_RECORD(eglCreatePixmapSurface);
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    return set_error(EGL_BAD_MATCH, EGL_NO_SURFACE);
+}
+
+EGLSurface eglCreatePlatformPixmapSurface(EGLDisplay dpy, EGLConfig, void*,
+                                          const EGLAttrib*)
+{
+    MOCK_RECORD(eglCreatePlatformPixmapSurface);
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    return set_error(EGL_BAD_MATCH, EGL_NO_SURFACE);
+}
+
+EGLSurface eglCreatePlatformPixmapSurfaceEXT(EGLDisplay dpy, EGLConfig,
+                                             void*, const EGLint*)
+{
+    MOCK_RECORD(eglCreatePlatformPixmapSurfaceEXT);
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    return set_error(EGL_BAD_MATCH, EGL_NO_SURFACE);
+}
+
+EGLSurface eglCreatePbufferSurface(EGLDisplay dpy, EGLConfig config,
+                                   const EGLint* attrib_list)
+{
+    MOCK_RECORD(eglCreatePbufferSurface);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    auto desc = find_config(config);
+    if (!desc)
+        return set_error(EGL_BAD_CONFIG, EGL_NO_SURFACE);
+
+    EGLint width = 0, height = 0;
+    for (auto attr = attrib_list; attr && attr[0] != EGL_NONE; attr += 2)
+    {
+        switch (attr[0])
+        {
+        case EGL_WIDTH:
+            width = attr[1];
+            break;
+        case EGL_HEIGHT:
+            height = attr[1];
+            break;
+        case EGL_TEXTURE_FORMAT:
+        case EGL_TEXTURE_TARGET:
+            if (attr[1] != EGL_NO_TEXTURE)
+                return set_error(EGL_BAD_MATCH, EGL_NO_SURFACE);
+            break;
+        case EGL_LARGEST_PBUFFER:
+        case EGL_MIPMAP_TEXTURE:
+        case EGL_GL_COLORSPACE:
+        case EGL_VG_ALPHA_FORMAT:
+        case EGL_VG_COLORSPACE:
+            break;
+        default:
+            return set_error(EGL_BAD_ATTRIBUTE, EGL_NO_SURFACE);
+        }
+    }
+    if (width < 0 || height < 0)
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_SURFACE);
+    if (width > max_pbuffer_size || height > max_pbuffer_size)
+        return set_error(EGL_BAD_MATCH, EGL_NO_SURFACE);
+
+    auto surface =
+        new surface_t{.config = desc, .width = width, .height = height};
+    display.surfaces.insert(surface);
+    return surface;
+}
+
+EGLSurface eglCreatePbufferFromClientBuffer(EGLDisplay dpy, EGLenum,
+                                            EGLClientBuffer, EGLConfig,
+                                            const EGLint*)
+{
+    MOCK_RECORD(eglCreatePbufferFromClientBuffer);
+    if (!check_display(dpy))
+        return EGL_NO_SURFACE;
+    return set_error(EGL_BAD_PARAMETER, EGL_NO_SURFACE);
+}
+
+EGLBoolean eglDestroySurface(EGLDisplay dpy, EGLSurface surface)
+{
+    MOCK_RECORD(eglDestroySurface);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.surfaces, surface);
+    if (!object)
+        return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+    destroy(display.surfaces, object);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglQuerySurface(EGLDisplay dpy, EGLSurface surface,
+                           EGLint attribute, EGLint* value)
+{
+    MOCK_RECORD(eglQuerySurface);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.surfaces, surface);
+    if (!object)
+        return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+    if (!value)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    ANativeWindow* win = object->window;
+    switch (attribute)
+    {
+    case EGL_WIDTH:
+        // the next buffer gets the size the window has now
+        if (win && !object->buffer)
+            win->query(win, NATIVE_WINDOW_WIDTH, &object->width);
+        *value = object->width;
+        break;
+    case EGL_HEIGHT:
+        if (win && !object->buffer)
+            win->query(win, NATIVE_WINDOW_HEIGHT, &object->height);
+        *value = object->height;
+        break;
+    case EGL_CONFIG_ID:
+        *value = object->config->id;
+        break;
+    case EGL_RENDER_BUFFER:
+        *value = EGL_BACK_BUFFER;
+        break;
+    case EGL_SWAP_BEHAVIOR:
+        *value = object->swap_behavior;
+        break;
+    case EGL_MULTISAMPLE_RESOLVE:
+        *value = EGL_MULTISAMPLE_RESOLVE_DEFAULT;
+        break;
+    case EGL_TEXTURE_FORMAT:
+    case EGL_TEXTURE_TARGET:
+        *value = EGL_NO_TEXTURE;
+        break;
+    case EGL_LARGEST_PBUFFER:
+    case EGL_MIPMAP_TEXTURE:
+    case EGL_MIPMAP_LEVEL:
+        *value = 0;
+        break;
+    case EGL_HORIZONTAL_RESOLUTION:
+    case EGL_VERTICAL_RESOLUTION:
+    case EGL_PIXEL_ASPECT_RATIO:
+        *value = EGL_UNKNOWN;
+        break;
+    default:
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+    }
+    return EGL_TRUE;
+}
+
+EGLBoolean eglSurfaceAttrib(EGLDisplay dpy, EGLSurface surface,
+                            EGLint attribute, EGLint value)
+{
+    MOCK_RECORD(eglSurfaceAttrib);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.surfaces, surface);
+    if (!object)
+        return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+
+    switch (attribute)
+    {
+    case EGL_SWAP_BEHAVIOR:
+        // no config has EGL_SWAP_BEHAVIOR_PRESERVED_BIT
+        if (value != EGL_BUFFER_DESTROYED)
+            return set_error(EGL_BAD_MATCH, EGL_FALSE);
+        object->swap_behavior = value;
+        return EGL_TRUE;
+    case EGL_MULTISAMPLE_RESOLVE:
+        if (value != EGL_MULTISAMPLE_RESOLVE_DEFAULT)
+            return set_error(EGL_BAD_MATCH, EGL_FALSE);
+        return EGL_TRUE;
+    case EGL_MIPMAP_LEVEL:
+        return EGL_TRUE;
+    default:
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+    }
+}
+
+EGLBoolean eglBindTexImage(EGLDisplay dpy, EGLSurface, EGLint)
+{
+    MOCK_RECORD(eglBindTexImage);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    // EGL_TEXTURE_FORMAT is always EGL_NO_TEXTURE
+    return set_error(EGL_BAD_MATCH, EGL_FALSE);
+}
+
+EGLBoolean eglReleaseTexImage(EGLDisplay dpy, EGLSurface, EGLint)
+{
+    MOCK_RECORD(eglReleaseTexImage);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    return set_error(EGL_BAD_MATCH, EGL_FALSE);
+}
+
+EGLBoolean eglLockSurfaceKHR(EGLDisplay dpy, EGLSurface, const EGLint*)
+{
+    MOCK_RECORD(eglLockSurfaceKHR);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    return set_error(EGL_BAD_ACCESS, EGL_FALSE);
+}
+
+EGLBoolean eglUnlockSurfaceKHR(EGLDisplay dpy, EGLSurface)
+{
+    MOCK_RECORD(eglUnlockSurfaceKHR);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    return set_error(EGL_BAD_ACCESS, EGL_FALSE);
+}
+
+EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config,
+                            EGLContext share_context, const EGLint* attrib_list)
+{
+    MOCK_RECORD(eglCreateContext);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_NO_CONTEXT;
+    auto desc = find_config(config);
+    if (!desc)
+        return set_error(EGL_BAD_CONFIG, EGL_NO_CONTEXT);
+    if (current.api != EGL_OPENGL_ES_API)
+        return set_error(EGL_BAD_MATCH, EGL_NO_CONTEXT);
+    if (share_context != EGL_NO_CONTEXT &&
+        !find(display.contexts, share_context))
+        return set_error(EGL_BAD_CONTEXT, EGL_NO_CONTEXT);
+
+    EGLint version = 1;
+    for (auto attr = attrib_list; attr && attr[0] != EGL_NONE; attr += 2)
+    {
+        switch (attr[0])
+        {
+        case EGL_CONTEXT_MAJOR_VERSION:
+            version = attr[1];
+            break;
+        case EGL_CONTEXT_MINOR_VERSION:
+        case EGL_CONTEXT_FLAGS_KHR:
+        case EGL_CONTEXT_OPENGL_DEBUG:
+        case EGL_CONTEXT_OPENGL_ROBUST_ACCESS:
+        case EGL_CONTEXT_OPENGL_RESET_NOTIFICATION_STRATEGY:
+            break;
+        default:
+            return set_error(EGL_BAD_ATTRIBUTE, EGL_NO_CONTEXT);
+        }
+    }
+    if (version < 1 || version > 3)
+        return set_error(EGL_BAD_MATCH, EGL_NO_CONTEXT);
+
+    auto context = new context_t{.config = desc, .version = version};
+    display.contexts.insert(context);
+    return context;
+}
+
+EGLBoolean eglDestroyContext(EGLDisplay dpy, EGLContext ctx)
+{
+    MOCK_RECORD(eglDestroyContext);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.contexts, ctx);
+    if (!object)
+        return set_error(EGL_BAD_CONTEXT, EGL_FALSE);
+    destroy(display.contexts, object);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read,
+                          EGLContext ctx)
+{
+    MOCK_RECORD(eglMakeCurrent);
+    std::lock_guard lock{display.mutex};
+    bool release = ctx == EGL_NO_CONTEXT && draw == EGL_NO_SURFACE &&
+                   read == EGL_NO_SURFACE;
+    if (!check_display(dpy, !release))
+        return EGL_FALSE;
+
+    context_t* context = nullptr;
+    surface_t* draw_surface = nullptr;
+    surface_t* read_surface = nullptr;
+    if (!release)
+    {
+        if (ctx == EGL_NO_CONTEXT)
+            return set_error(EGL_BAD_MATCH, EGL_FALSE);
+        context = find(display.contexts, ctx);
+        if (!context)
+            return set_error(EGL_BAD_CONTEXT, EGL_FALSE);
+        if (context->bound && context != current.context)
+            return set_error(EGL_BAD_ACCESS, EGL_FALSE);
+        // EGL_KHR_surfaceless_context allows neither, not just one
+        if ((draw == EGL_NO_SURFACE) != (read == EGL_NO_SURFACE))
+            return set_error(EGL_BAD_MATCH, EGL_FALSE);
+        if (draw != EGL_NO_SURFACE)
+        {
+            draw_surface = find(display.surfaces, draw);
+            read_surface = find(display.surfaces, read);
+            if (!draw_surface || !read_surface)
+                return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+        }
+    }
+
+    bind(context);
+    bind(draw_surface);
+    bind(read_surface);
+    unbind(current.context);
+    unbind(current.draw);
+    unbind(current.read);
+    current.context = context;
+    current.draw = draw_surface;
+    current.read = read_surface;
+    return EGL_TRUE;
+}
+
+EGLContext eglGetCurrentContext(void)
+{
+    MOCK_RECORD(eglGetCurrentContext);
+    return current.context ? current.context : EGL_NO_CONTEXT;
+}
+
+EGLSurface eglGetCurrentSurface(EGLint readdraw)
+{
+    MOCK_RECORD(eglGetCurrentSurface);
+    switch (readdraw)
+    {
+    case EGL_DRAW:
+        return current.draw ? current.draw : EGL_NO_SURFACE;
+    case EGL_READ:
+        return current.read ? current.read : EGL_NO_SURFACE;
+    default:
+        return set_error(EGL_BAD_PARAMETER, EGL_NO_SURFACE);
+    }
+}
+
+EGLDisplay eglGetCurrentDisplay(void)
+{
+    MOCK_RECORD(eglGetCurrentDisplay);
+    return current.context ? &display : EGL_NO_DISPLAY;
+}
+
+EGLBoolean eglQueryContext(EGLDisplay dpy, EGLContext ctx, EGLint attribute,
+                           EGLint* value)
+{
+    MOCK_RECORD(eglQueryContext);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.contexts, ctx);
+    if (!object)
+        return set_error(EGL_BAD_CONTEXT, EGL_FALSE);
+    if (!value)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    switch (attribute)
+    {
+    case EGL_CONFIG_ID:
+        *value = object->config->id;
+        break;
+    case EGL_CONTEXT_CLIENT_TYPE:
+        *value = EGL_OPENGL_ES_API;
+        break;
+    case EGL_CONTEXT_CLIENT_VERSION:
+        *value = object->version;
+        break;
+    case EGL_RENDER_BUFFER:
+        *value = object == current.context && current.draw ? EGL_BACK_BUFFER
+                                                           : EGL_NONE;
+        break;
+    default:
+        return set_error(EGL_BAD_ATTRIBUTE, EGL_FALSE);
+    }
+    return EGL_TRUE;
+}
+
+EGLBoolean eglWaitGL(void)
+{
+    MOCK_RECORD(eglWaitGL);
+    wait_client();
+    return EGL_TRUE;
+}
+
+EGLBoolean eglWaitClient(void)
+{
+    MOCK_RECORD(eglWaitClient);
+    wait_client();
+    return EGL_TRUE;
+}
+
+EGLBoolean eglWaitNative(EGLint engine)
+{
+    MOCK_RECORD(eglWaitNative);
+    if (engine != EGL_CORE_NATIVE_ENGINE)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    MOCK_RECORD(eglSwapBuffers);
+    return swap_buffers(dpy, surface);
+}
+
+EGLBoolean eglSwapBuffersWithDamageKHR(EGLDisplay dpy, EGLSurface surface,
+                                       const EGLint* rects, EGLint n_rects)
+{
+    MOCK_RECORD(eglSwapBuffersWithDamageKHR);
+    if (n_rects < 0 || (n_rects > 0 && !rects))
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    return swap_buffers(dpy, surface);
+}
+
+EGLBoolean eglSetDamageRegionKHR(EGLDisplay dpy, EGLSurface, EGLint*, EGLint)
+{
+    MOCK_RECORD(eglSetDamageRegionKHR);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    // EGL_KHR_partial_update is not offered
+    return set_error(EGL_BAD_ACCESS, EGL_FALSE);
+}
+
+void eglSetBlobCacheFuncsANDROID(EGLDisplay dpy, EGLSetBlobFuncANDROID set,
+                                 EGLGetBlobFuncANDROID get)
+{
+    MOCK_RECORD(eglSetBlobCacheFuncsANDROID);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return;
+    if (!set || !get || display.set_blob)
+    {
+        set_error(EGL_BAD_PARAMETER, false);
+        return;
+    }
+    display.set_blob = set;
+    display.get_blob = get;
+}
+
+EGLBoolean eglCopyBuffers(EGLDisplay dpy, EGLSurface, EGLNativePixmapType)
+{
+    MOCK_RECORD(eglCopyBuffers);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    return set_error(EGL_BAD_NATIVE_PIXMAP, EGL_FALSE);
+}
+
+EGLBoolean eglSwapInterval(EGLDisplay dpy, EGLint interval)
+{
+    MOCK_RECORD(eglSwapInterval);
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    if (!current.context)
+        return set_error(EGL_BAD_CONTEXT, EGL_FALSE);
+    if (!current.draw)
+        return set_error(EGL_BAD_SURFACE, EGL_FALSE);
+    if (ANativeWindow* win = current.draw->window)
+        win->setSwapInterval(win, std::clamp(interval, 0, 1));
+    return EGL_TRUE;
+}
+
+EGLint eglGetError(void)
+{
+    MOCK_RECORD(eglGetError);
+    EGLint error = current.error;
+    current.error = EGL_SUCCESS;
+    return error;
+}
+
+const char* eglQueryString(EGLDisplay dpy, EGLint name)
+{
+    MOCK_RECORD(eglQueryString);
+    if (dpy == EGL_NO_DISPLAY)
+    {
+        if (name == EGL_EXTENSIONS)
+            return client_extensions;
+        if (name == EGL_VERSION)
+            return "1.5 mock";
+    }
+    if (!check_display(dpy))
+        return nullptr;
+
+    switch (name)
+    {
+    case EGL_VENDOR:
+        return "EGL_ext mock";
+    case EGL_VERSION:
+        return "1.5 mock";
+    case EGL_CLIENT_APIS:
+        return "OpenGL_ES";
+    case EGL_EXTENSIONS:
+        return display_extensions;
+    default:
+        return set_error(EGL_BAD_PARAMETER, nullptr);
+    }
+}
+
+EGLBoolean eglBindAPI(EGLenum api)
+{
+    MOCK_RECORD(eglBindAPI);
+    if (api != EGL_OPENGL_ES_API)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    current.api = api;
+    return EGL_TRUE;
+}
+
+EGLenum eglQueryAPI(void)
+{
+    MOCK_RECORD(eglQueryAPI);
+    return current.api;
+}
+
+EGLBoolean eglReleaseThread(void)
+{
+    MOCK_RECORD(eglReleaseThread);
+    {
+        std::lock_guard lock{display.mutex};
+        unbind(current.context);
+        unbind(current.draw);
+        unbind(current.read);
+    }
+    current = {};
+    return EGL_TRUE;
+}
+
+EGLImage eglCreateImage(EGLDisplay dpy, EGLContext ctx, EGLenum target,
+                        EGLClientBuffer buffer, const EGLAttrib* attrib_list)
+{
+    MOCK_RECORD(eglCreateImage);
+    return create_image(dpy, ctx, target, buffer, attrib_list);
+}
+
+EGLImageKHR eglCreateImageKHR(EGLDisplay dpy, EGLContext ctx, EGLenum target,
+                              EGLClientBuffer buffer, const EGLint* attrib_list)
+{
+    MOCK_RECORD(eglCreateImageKHR);
+    return create_image(dpy, ctx, target, buffer, attrib_list);
+}
+
+EGLBoolean eglDestroyImage(EGLDisplay dpy, EGLImage image)
+{
+    MOCK_RECORD(eglDestroyImage);
+    return destroy_image(dpy, image);
+}
+
+EGLBoolean eglDestroyImageKHR(EGLDisplay dpy, EGLImageKHR image)
+{
+    MOCK_RECORD(eglDestroyImageKHR);
+    return destroy_image(dpy, image);
+}
+
+EGLSync eglCreateSync(EGLDisplay dpy, EGLenum type,
+                      const EGLAttrib* attrib_list)
+{
+    MOCK_RECORD(eglCreateSync);
+    return create_sync(dpy, type, attrib_list);
+}
+
+EGLSyncKHR eglCreateSyncKHR(EGLDisplay dpy, EGLenum type,
+                            const EGLint* attrib_list)
+{
+    MOCK_RECORD(eglCreateSyncKHR);
+    return create_sync(dpy, type, attrib_list);
+}
+
+EGLBoolean eglDestroySync(EGLDisplay dpy, EGLSync sync)
+{
+    MOCK_RECORD(eglDestroySync);
+    return destroy_sync(dpy, sync);
+}
+
+EGLBoolean eglDestroySyncKHR(EGLDisplay dpy, EGLSyncKHR sync)
+{
+    MOCK_RECORD(eglDestroySyncKHR);
+    return destroy_sync(dpy, sync);
+}
+
+EGLint eglClientWaitSync(EGLDisplay dpy, EGLSync sync, EGLint,
+                         EGLTime timeout)
+{
+    MOCK_RECORD(eglClientWaitSync);
+    return client_wait_sync(dpy, sync, timeout);
+}
+
+EGLint eglClientWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLint,
+                            EGLTimeKHR timeout)
+{
+    MOCK_RECORD(eglClientWaitSyncKHR);
+    return client_wait_sync(dpy, sync, timeout);
+}
+
+EGLBoolean eglGetSyncAttrib(EGLDisplay dpy, EGLSync sync, EGLint attribute,
+                            EGLAttrib* value)
+{
+    MOCK_RECORD(eglGetSyncAttrib);
+    return get_sync_attrib(dpy, sync, attribute, value);
+}
+
+EGLBoolean eglGetSyncAttribKHR(EGLDisplay dpy, EGLSyncKHR sync,
+                               EGLint attribute, EGLint* value)
+{
+    MOCK_RECORD(eglGetSyncAttribKHR);
+    return get_sync_attrib(dpy, sync, attribute, value);
+}
+
+EGLBoolean eglWaitSync(EGLDisplay dpy, EGLSync sync, EGLint flags)
+{
+    MOCK_RECORD(eglWaitSync);
+    return wait_sync(dpy, sync, flags);
+}
+
+EGLint eglWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags)
+{
+    MOCK_RECORD(eglWaitSyncKHR);
+    return wait_sync(dpy, sync, flags);
+}
+
+EGLBoolean eglSignalSyncKHR(EGLDisplay dpy, EGLSyncKHR sync, EGLenum mode)
+{
+    MOCK_RECORD(eglSignalSyncKHR);
+    std::lock_guard lock{display.mutex};
+    if (!check_display(dpy))
+        return EGL_FALSE;
+    auto object = find(display.syncs, sync);
+    if (!object)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+    if (object->type != EGL_SYNC_REUSABLE_KHR)
+        return set_error(EGL_BAD_MATCH, EGL_FALSE);
+    if (mode != EGL_SIGNALED_KHR && mode != EGL_UNSIGNALED_KHR)
+        return set_error(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    object->signaled = mode == EGL_SIGNALED_KHR;
+    if (object->signaled)
+        display.signal.notify_all();
+    return EGL_TRUE;
+}
+
+__eglMustCastToProperFunctionPointerType eglGetProcAddress(const char* procname)
+{
+    MOCK_RECORD(eglGetProcAddress);
+#define EGL_ENTRY(_r, _api, ...)                                               \
+    {#_api, reinterpret_cast<__eglMustCastToProperFunctionPointerType>(_api)},
+
+    // clang-format off
+    static const struct {
+        const char* name;
+        __eglMustCastToProperFunctionPointerType proc;
+    } procs[] = {
+        #include "egl_entries.in"
+        #include "egl_ext_entries.in"
+    };
+    // clang-format on
+#undef EGL_ENTRY
+
+    if (!procname)
+        return nullptr;
+    for (const auto& proc : procs)
+    {
+        if (strcmp(proc.name, procname) == 0)
+            return proc.proc;
+    }
+    return nullptr;
+}
+}
@@ -0,0 +1,56 @@
+// every entry point of the mock libGLESv1_CM/libGLESv2, generated from the
+// same lists the wrapper is: a counted call doing nothing and returning 0.
+// The few that need an answer are overridden in gles_state.cc.
+
+#include "mock_driver.h"
+
+#if MOCK_GLES_VERSION >= 2
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
+#else
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+#endif
+
+#if MOCK_GLES_VERSION < 2
+// glGetString is named __glGetString in the list
+#define __glGetString glGetString
+#endif
+
+#define API_ENTRY(_api) __attribute__((weak)) _api
+
+#define CALL_GL_API(_api, ...) MOCK_RECORD(_api);
+
+#define CALL_GL_API_RETURN(_api, ...)                                          \
+    MOCK_RECORD(_api);                                                         \
+    return 0;
+
+extern "C" {
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#if MOCK_GLES_VERSION >= 2
+#include "gl2_api.in"
+#else
+#include "gl_api.in"
+#endif
+#pragma GCC diagnostic warning "-Wunused-parameter"
+}
+
+#undef API_ENTRY
+#undef CALL_GL_API
+#undef CALL_GL_API_RETURN
+
+#if MOCK_GLES_VERSION >= 2
+// the entries the wrapper implements itself are named __glX in the list,
+// exported under their own name too
+#define GL_ENTRY(_r, _api, ...)                                                \
+    MOCK_DRIVER_API _r _api(__VA_ARGS__)                                       \
+        __attribute__((weak, alias("__" #_api)));
+#define EGL_ENTRY(_r, _api, ...)
+
+extern "C" {
+#include "platform_entries.in"
+}
+
+#undef GL_ENTRY
+#undef EGL_ENTRY
+#endif
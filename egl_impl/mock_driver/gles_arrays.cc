@@ -0,0 +1,326 @@
+// the vertex arrays of the mock libGLESv2: buffers keep their data and the
+// draws read the vertices of their arrays, from buffers or the app's
+// memory, so a test can see what the wrapper made the driver draw.
+//
+// One set of arrays and bindings for every context, vertex array objects
+// are not kept. Instanced arrays read what the first instance reads.
+
+#include "mock_driver.h"
+
+#include <GLES3/gl32.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+constexpr GLuint max_attribs = 16;
+
+struct attrib_t
+{
+    bool enabled = false;
+    GLint size = 4;
+    GLenum type = GL_FLOAT;
+    GLsizei stride = 0;
+    GLuint divisor = 0;
+    GLuint buffer = 0;
+    const void* pointer = nullptr;
+};
+
+struct arrays_t
+{
+    std::mutex mutex;
+    std::map<GLuint, std::vector<uint8_t>> buffers;
+    GLuint array_buffer = 0;
+    GLuint element_buffer = 0;
+    attrib_t attribs[max_attribs];
+    // what each attribute read for the last draw
+    std::vector<uint8_t> drawn[max_attribs];
+};
+
+arrays_t& arrays()
+{
+    static arrays_t* arrays = new arrays_t;
+    return *arrays;
+}
+
+GLsizei type_bytes(GLenum type)
+{
+    switch (type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return 2;
+    }
+    return 4;
+}
+
+GLuint* binding(arrays_t& state, GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return &state.array_buffer;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return &state.element_buffer;
+    }
+    return nullptr;
+}
+
+// memory at offset of a buffer, or the app's pointer without one
+const uint8_t* address(arrays_t& state, GLuint buffer, const void* pointer)
+{
+    if (!buffer)
+        return static_cast<const uint8_t*>(pointer);
+    auto iter = state.buffers.find(buffer);
+    if (iter == state.buffers.end())
+        return nullptr;
+    auto offset = reinterpret_cast<uintptr_t>(pointer);
+    return offset < iter->second.size() ? iter->second.data() + offset
+                                        : nullptr;
+}
+
+// the enabled arrays read vertex after vertex
+void draw(arrays_t& state, const std::vector<GLint>& vertices)
+{
+    for (GLuint index = 0; index < max_attribs; index++)
+    {
+        const auto& attrib = state.attribs[index];
+        auto& drawn = state.drawn[index];
+        drawn.clear();
+        if (!attrib.enabled)
+            continue;
+        GLsizei bytes = attrib.size * type_bytes(attrib.type);
+        GLsizei stride = attrib.stride ? attrib.stride : bytes;
+        const uint8_t* base = address(state, attrib.buffer, attrib.pointer);
+        if (!base)
+            continue;
+        for (GLint vertex : vertices)
+        {
+            if (attrib.divisor)
+                vertex = 0;
+            const uint8_t* from = base + ptrdiff_t{vertex} * stride;
+            drawn.insert(drawn.end(), from, from + bytes);
+        }
+    }
+}
+
+std::vector<GLint> read_indices(arrays_t& state, GLsizei count, GLenum type,
+                                const void* indices, GLint basevertex)
+{
+    std::vector<GLint> vertices;
+    const uint8_t* from = address(state, state.element_buffer, indices);
+    for (GLsizei i = 0; from && i < count; i++)
+    {
+        GLuint index = 0;
+        if (type == GL_UNSIGNED_BYTE)
+            index = from[i];
+        else if (type == GL_UNSIGNED_SHORT)
+            index = reinterpret_cast<const GLushort*>(from)[i];
+        else
+            index = reinterpret_cast<const GLuint*>(from)[i];
+        vertices.push_back(static_cast<GLint>(index) + basevertex);
+    }
+    return vertices;
+}
+
+void draw_arrays(GLint first, GLsizei count)
+{
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    std::vector<GLint> vertices;
+    for (GLsizei i = 0; i < count; i++)
+        vertices.push_back(first + i);
+    draw(state, vertices);
+}
+
+void draw_elements(GLsizei count, GLenum type, const void* indices,
+                   GLint basevertex)
+{
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    draw(state, read_indices(state, count, type, indices, basevertex));
+}
+
+void attrib_pointer(GLuint index, GLint size, GLenum type, GLsizei stride,
+                    const void* pointer)
+{
+    if (index >= max_attribs)
+        return;
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    auto& attrib = state.attribs[index];
+    attrib.size = size;
+    attrib.type = type;
+    attrib.stride = stride;
+    attrib.buffer = state.array_buffer;
+    attrib.pointer = pointer;
+}
+
+void enable_array(GLuint index, bool enable)
+{
+    if (index >= max_attribs)
+        return;
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    state.attribs[index].enabled = enable;
+}
+} // namespace
+
+size_t mock_driver_draw_data(unsigned int index, void* data, size_t size)
+{
+    if (index >= max_attribs)
+        return 0;
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    const auto& drawn = state.drawn[index];
+    memcpy(data, drawn.data(), std::min(size, drawn.size()));
+    return drawn.size();
+}
+
+extern "C" {
+void glBindBuffer(GLenum target, GLuint buffer)
+{
+    MOCK_RECORD(glBindBuffer);
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    if (auto bound = binding(state, target))
+        *bound = buffer;
+}
+
+void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum)
+{
+    MOCK_RECORD(glBufferData);
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    auto bound = binding(state, target);
+    if (!bound || !*bound || size < 0)
+        return;
+    auto& storage = state.buffers[*bound];
+    storage.assign(size, 0);
+    if (data)
+        memcpy(storage.data(), data, size);
+}
+
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
+                     const void* data)
+{
+    MOCK_RECORD(glBufferSubData);
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    auto bound = binding(state, target);
+    if (!bound || !*bound)
+        return;
+    auto& storage = state.buffers[*bound];
+    if (offset < 0 || size < 0 || size_t(offset + size) > storage.size())
+        return;
+    memcpy(storage.data() + offset, data, size);
+}
+
+void glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    MOCK_RECORD(glDeleteBuffers);
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    for (GLsizei i = 0; i < n; i++)
+    {
+        state.buffers.erase(buffers[i]);
+        if (state.array_buffer == buffers[i])
+            state.array_buffer = 0;
+        if (state.element_buffer == buffers[i])
+            state.element_buffer = 0;
+    }
+}
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean,
+                           GLsizei stride, const void* pointer)
+{
+    MOCK_RECORD(glVertexAttribPointer);
+    attrib_pointer(index, size, type, stride, pointer);
+}
+
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type,
+                            GLsizei stride, const void* pointer)
+{
+    MOCK_RECORD(glVertexAttribIPointer);
+    attrib_pointer(index, size, type, stride, pointer);
+}
+
+void glEnableVertexAttribArray(GLuint index)
+{
+    MOCK_RECORD(glEnableVertexAttribArray);
+    enable_array(index, true);
+}
+
+void glDisableVertexAttribArray(GLuint index)
+{
+    MOCK_RECORD(glDisableVertexAttribArray);
+    enable_array(index, false);
+}
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+    MOCK_RECORD(glVertexAttribDivisor);
+    if (index >= max_attribs)
+        return;
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    state.attribs[index].divisor = divisor;
+}
+
+void glGetVertexAttribPointerv(GLuint index, GLenum, void** pointer)
+{
+    MOCK_RECORD(glGetVertexAttribPointerv);
+    if (index >= max_attribs)
+        return;
+    auto& state = arrays();
+    std::lock_guard lock{state.mutex};
+    *pointer = const_cast<void*>(state.attribs[index].pointer);
+}
+
+void glDrawArrays(GLenum, GLint first, GLsizei count)
+{
+    MOCK_RECORD(glDrawArrays);
+    draw_arrays(first, count);
+}
+
+void glDrawArraysInstanced(GLenum, GLint first, GLsizei count, GLsizei)
+{
+    MOCK_RECORD(glDrawArraysInstanced);
+    draw_arrays(first, count);
+}
+
+void glDrawElements(GLenum, GLsizei count, GLenum type, const void* indices)
+{
+    MOCK_RECORD(glDrawElements);
+    draw_elements(count, type, indices, 0);
+}
+
+void glDrawRangeElements(GLenum, GLuint, GLuint, GLsizei count, GLenum type,
+                         const void* indices)
+{
+    MOCK_RECORD(glDrawRangeElements);
+    draw_elements(count, type, indices, 0);
+}
+
+void glDrawElementsInstanced(GLenum, GLsizei count, GLenum type,
+                             const void* indices, GLsizei)
+{
+    MOCK_RECORD(glDrawElementsInstanced);
+    draw_elements(count, type, indices, 0);
+}
+
+void glDrawElementsBaseVertex(GLenum, GLsizei count, GLenum type,
+                              const void* indices, GLint basevertex)
+{
+    MOCK_RECORD(glDrawElementsBaseVertex);
+    draw_elements(count, type, indices, basevertex);
+}
+}
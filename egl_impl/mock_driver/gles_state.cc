@@ -0,0 +1,450 @@
+// the mock GLES entry points that have to answer something: strings,
+// limits, object names, compile/link status and syncs. They override the
+// weak ones of gles.cc.
+
+#include "mock_driver.h"
+
+#if MOCK_GLES_VERSION >= 2
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
+#else
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+
+namespace {
+thread_local GLenum gl_error = GL_NO_ERROR;
+
+void set_error(GLenum error)
+{
+    // the first error sticks until glGetError
+    if (gl_error == GL_NO_ERROR)
+        gl_error = error;
+}
+
+// one name space for every object type is enough for a driver that keeps
+// no objects
+std::atomic<GLuint> next_name{1};
+
+void gen_names(GLsizei n, GLuint* names)
+{
+    if (n < 0)
+        return set_error(GL_INVALID_VALUE);
+    for (GLsizei i = 0; i < n; i++)
+        names[i] = next_name.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the single-valued state of glGet*, false for what is not known
+bool get_state(GLenum pname, GLint64* value)
+{
+    switch (pname)
+    {
+    case GL_MAX_TEXTURE_SIZE:
+        *value = 16384;
+        break;
+    case GL_RED_BITS:
+    case GL_GREEN_BITS:
+    case GL_BLUE_BITS:
+    case GL_ALPHA_BITS:
+    case GL_STENCIL_BITS:
+        *value = 8;
+        break;
+    case GL_DEPTH_BITS:
+        *value = 24;
+        break;
+    case GL_SUBPIXEL_BITS:
+    case GL_PACK_ALIGNMENT:
+    case GL_UNPACK_ALIGNMENT:
+        *value = 4;
+        break;
+#if MOCK_GLES_VERSION >= 2
+    case GL_MAJOR_VERSION:
+        *value = 3;
+        break;
+    case GL_MINOR_VERSION:
+        *value = 2;
+        break;
+    case GL_MAX_CUBE_MAP_TEXTURE_SIZE:
+    case GL_MAX_RENDERBUFFER_SIZE:
+        *value = 16384;
+        break;
+    case GL_MAX_3D_TEXTURE_SIZE:
+    case GL_MAX_ARRAY_TEXTURE_LAYERS:
+        *value = 2048;
+        break;
+    case GL_MAX_VERTEX_ATTRIBS:
+    case GL_MAX_VERTEX_ATTRIB_BINDINGS:
+    case GL_MAX_TEXTURE_IMAGE_UNITS:
+    case GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS:
+    case GL_MAX_VARYING_VECTORS:
+        *value = 16;
+        break;
+    case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+        *value = 80;
+        break;
+    case GL_MAX_VERTEX_UNIFORM_VECTORS:
+    case GL_MAX_FRAGMENT_UNIFORM_VECTORS:
+    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+        *value = 256;
+        break;
+    case GL_MAX_DRAW_BUFFERS:
+    case GL_MAX_COLOR_ATTACHMENTS:
+        *value = 8;
+        break;
+    case GL_MAX_SAMPLES:
+        *value = 4;
+        break;
+    case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+        *value = 72;
+        break;
+    case GL_MAX_UNIFORM_BLOCK_SIZE:
+        *value = 65536;
+        break;
+    case GL_MAX_ELEMENT_INDEX:
+        *value = 0xffffffff;
+        break;
+    case GL_NUM_EXTENSIONS:
+    case GL_NUM_SHADER_BINARY_FORMATS:
+    case GL_NUM_PROGRAM_BINARY_FORMATS:
+    case GL_MAX_SERVER_WAIT_TIMEOUT:
+        *value = 0;
+        break;
+#else
+    case GL_MAX_TEXTURE_UNITS:
+    case GL_MAX_LIGHTS:
+        *value = 8;
+        break;
+    case GL_MAX_CLIP_PLANES:
+        *value = 6;
+        break;
+    case GL_MAX_MODELVIEW_STACK_DEPTH:
+        *value = 32;
+        break;
+    case GL_MAX_PROJECTION_STACK_DEPTH:
+    case GL_MAX_TEXTURE_STACK_DEPTH:
+        *value = 2;
+        break;
+#endif
+    default:
+        return false;
+    }
+    return true;
+}
+
+// the values of pname, a single 0 for unknown state
+template <typename T>
+void get_values(GLenum pname, T* data)
+{
+    GLint64 value = 0;
+    if (pname == GL_MAX_VIEWPORT_DIMS)
+    {
+        data[0] = data[1] = static_cast<T>(16384);
+        return;
+    }
+    get_state(pname, &value);
+    data[0] = static_cast<T>(value);
+}
+
+#if MOCK_GLES_VERSION >= 2
+struct sync_object
+{
+    mock_driver::clock_type::time_point done;
+};
+
+std::mutex sync_mutex;
+std::set<GLsync> syncs;
+
+// when the fence is done, read under the lock since another thread may
+// delete it right after; false after GL_INVALID_VALUE
+bool find_sync(GLsync sync, mock_driver::clock_type::time_point* done)
+{
+    std::lock_guard lock{sync_mutex};
+    if (!syncs.count(sync))
+    {
+        set_error(GL_INVALID_VALUE);
+        return false;
+    }
+    if (done)
+        *done = reinterpret_cast<sync_object*>(sync)->done;
+    return true;
+}
+#endif
+} // namespace
+
+extern "C" {
+GLenum glGetError(void)
+{
+    MOCK_RECORD(glGetError);
+    GLenum error = gl_error;
+    gl_error = GL_NO_ERROR;
+    return error;
+}
+
+const GLubyte* glGetString(GLenum name)
+{
+    MOCK_RECORD(glGetString);
+    const char* string;
+    switch (name)
+    {
+    case GL_VENDOR:
+        string = "EGL_ext mock";
+        break;
+    case GL_RENDERER:
+        string = "mock";
+        break;
+#if MOCK_GLES_VERSION >= 2
+    case GL_VERSION:
+        string = "OpenGL ES 3.2 mock";
+        break;
+    case GL_SHADING_LANGUAGE_VERSION:
+        string = "OpenGL ES GLSL ES 3.20 mock";
+        break;
+#else
+    case GL_VERSION:
+        string = "OpenGL ES-CM 1.1 mock";
+        break;
+#endif
+    case GL_EXTENSIONS:
+        string = "";
+        break;
+    default:
+        set_error(GL_INVALID_ENUM);
+        return nullptr;
+    }
+    return reinterpret_cast<const GLubyte*>(string);
+}
+
+void glGetBooleanv(GLenum pname, GLboolean* data)
+{
+    MOCK_RECORD(glGetBooleanv);
+    GLint64 value = 0;
+    get_state(pname, &value);
+    data[0] = value ? GL_TRUE : GL_FALSE;
+}
+
+void glGetFloatv(GLenum pname, GLfloat* data)
+{
+    MOCK_RECORD(glGetFloatv);
+    get_values(pname, data);
+}
+
+void glGetIntegerv(GLenum pname, GLint* data)
+{
+    MOCK_RECORD(glGetIntegerv);
+    get_values(pname, data);
+}
+
+void glGenBuffers(GLsizei n, GLuint* buffers)
+{
+    MOCK_RECORD(glGenBuffers);
+    gen_names(n, buffers);
+}
+
+void glGenTextures(GLsizei n, GLuint* textures)
+{
+    MOCK_RECORD(glGenTextures);
+    gen_names(n, textures);
+}
+
+void glFinish(void)
+{
+    MOCK_RECORD(glFinish);
+    mock_driver::wait_until(mock_driver::submit());
+}
+
+#if MOCK_GLES_VERSION >= 2
+const GLubyte* glGetStringi(GLenum name, GLuint)
+{
+    MOCK_RECORD(glGetStringi);
+    // GL_NUM_EXTENSIONS is 0
+    set_error(name == GL_EXTENSIONS ? GL_INVALID_VALUE : GL_INVALID_ENUM);
+    return nullptr;
+}
+
+void glGetInteger64v(GLenum pname, GLint64* data)
+{
+    MOCK_RECORD(glGetInteger64v);
+    get_values(pname, data);
+}
+
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers)
+{
+    MOCK_RECORD(glGenFramebuffers);
+    gen_names(n, framebuffers);
+}
+
+void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+{
+    MOCK_RECORD(glGenRenderbuffers);
+    gen_names(n, renderbuffers);
+}
+
+void glGenQueries(GLsizei n, GLuint* ids)
+{
+    MOCK_RECORD(glGenQueries);
+    gen_names(n, ids);
+}
+
+void glGenVertexArrays(GLsizei n, GLuint* arrays)
+{
+    MOCK_RECORD(glGenVertexArrays);
+    gen_names(n, arrays);
+}
+
+void glGenSamplers(GLsizei count, GLuint* samplers)
+{
+    MOCK_RECORD(glGenSamplers);
+    gen_names(count, samplers);
+}
+
+void glGenTransformFeedbacks(GLsizei n, GLuint* ids)
+{
+    MOCK_RECORD(glGenTransformFeedbacks);
+    gen_names(n, ids);
+}
+
+void glGenProgramPipelines(GLsizei n, GLuint* pipelines)
+{
+    MOCK_RECORD(glGenProgramPipelines);
+    gen_names(n, pipelines);
+}
+
+GLuint glCreateProgram(void)
+{
+    MOCK_RECORD(glCreateProgram);
+    return next_name.fetch_add(1, std::memory_order_relaxed);
+}
+
+GLuint glCreateShader(GLenum)
+{
+    MOCK_RECORD(glCreateShader);
+    return next_name.fetch_add(1, std::memory_order_relaxed);
+}
+
+GLuint glCreateShaderProgramv(GLenum, GLsizei, const GLchar* const*)
+{
+    MOCK_RECORD(glCreateShaderProgramv);
+    return next_name.fetch_add(1, std::memory_order_relaxed);
+}
+
+// every shader compiles and every program links
+void glGetShaderiv(GLuint, GLenum pname, GLint* params)
+{
+    MOCK_RECORD(glGetShaderiv);
+    *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+void glGetProgramiv(GLuint, GLenum pname, GLint* params)
+{
+    MOCK_RECORD(glGetProgramiv);
+    *params = pname == GL_LINK_STATUS || pname == GL_VALIDATE_STATUS ? GL_TRUE
+                                                                      : 0;
+}
+
+GLenum glCheckFramebufferStatus(GLenum)
+{
+    MOCK_RECORD(glCheckFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+GLsync glFenceSync(GLenum condition, GLbitfield flags)
+{
+    MOCK_RECORD(glFenceSync);
+    if (condition != GL_SYNC_GPU_COMMANDS_COMPLETE)
+    {
+        set_error(GL_INVALID_ENUM);
+        return nullptr;
+    }
+    if (flags != 0)
+    {
+        set_error(GL_INVALID_VALUE);
+        return nullptr;
+    }
+
+    auto sync = reinterpret_cast<GLsync>(
+        new sync_object{.done = mock_driver::submit()});
+    std::lock_guard lock{sync_mutex};
+    syncs.insert(sync);
+    return sync;
+}
+
+GLboolean glIsSync(GLsync sync)
+{
+    MOCK_RECORD(glIsSync);
+    std::lock_guard lock{sync_mutex};
+    return syncs.count(sync) ? GL_TRUE : GL_FALSE;
+}
+
+void glDeleteSync(GLsync sync)
+{
+    MOCK_RECORD(glDeleteSync);
+    if (!sync)
+        return;
+    std::lock_guard lock{sync_mutex};
+    if (!syncs.erase(sync))
+        return set_error(GL_INVALID_VALUE);
+    delete reinterpret_cast<sync_object*>(sync);
+}
+
+GLenum glClientWaitSync(GLsync sync, GLbitfield, GLuint64 timeout)
+{
+    MOCK_RECORD(glClientWaitSync);
+    mock_driver::clock_type::time_point done;
+    if (!find_sync(sync, &done))
+        return GL_WAIT_FAILED;
+
+    auto now = mock_driver::clock_type::now();
+    if (now >= done)
+        return GL_ALREADY_SIGNALED;
+    auto deadline =
+        now + std::chrono::nanoseconds(std::min<GLuint64>(timeout, 1ull << 62));
+    mock_driver::wait_until(std::min(done, deadline));
+    return mock_driver::clock_type::now() >= done
+               ? GL_CONDITION_SATISFIED
+               : GL_TIMEOUT_EXPIRED;
+}
+
+void glWaitSync(GLsync sync, GLbitfield, GLuint64)
+{
+    MOCK_RECORD(glWaitSync);
+    // the wait happens on the gpu, which does not exist
+    find_sync(sync, nullptr);
+}
+
+void glGetSynciv(GLsync sync, GLenum pname, GLsizei count, GLsizei* length,
+                 GLint* values)
+{
+    MOCK_RECORD(glGetSynciv);
+    mock_driver::clock_type::time_point done;
+    if (!find_sync(sync, &done) || count < 1)
+        return;
+
+    switch (pname)
+    {
+    case GL_OBJECT_TYPE:
+        values[0] = GL_SYNC_FENCE;
+        break;
+    case GL_SYNC_STATUS:
+        values[0] = mock_driver::clock_type::now() >= done
+                        ? GL_SIGNALED
+                        : GL_UNSIGNALED;
+        break;
+    case GL_SYNC_CONDITION:
+        values[0] = GL_SYNC_GPU_COMMANDS_COMPLETE;
+        break;
+    case GL_SYNC_FLAGS:
+        values[0] = 0;
+        break;
+    default:
+        return set_error(GL_INVALID_ENUM);
+    }
+    if (length)
+        *length = 1;
+}
+#endif
+}
@@ -0,0 +1,85 @@
+#include "mock_driver.h"
+#include "logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+struct call_registry
+{
+    std::mutex mutex;
+    // nodes of a map stay put, the counters hand out references to them
+    std::map<std::string, std::atomic<uint64_t>> counters;
+};
+
+call_registry& registry()
+{
+    // never destroyed, the dump at exit and late calls still find it
+    static call_registry* registry = [] {
+        if (getenv("MOCK_DRIVER_DUMP"))
+            atexit(mock_driver::dump_call_counts);
+        return new call_registry;
+    }();
+    return *registry;
+}
+
+std::atomic<uint64_t>& counter_of(const char* name)
+{
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    return reg.counters.try_emplace(name, 0).first->second;
+}
+} // namespace
+
+mock_driver::call_counter::call_counter(const char* name)
+    : count(counter_of(name))
+{
+}
+
+void mock_driver::dump_call_counts()
+{
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    for (const auto& [name, counter] : reg.counters)
+    {
+        logger::log_info() << "mock driver: " << name << " called "
+                           << counter.load() << " times";
+    }
+}
+
+mock_driver::clock_type::duration mock_driver::gpu_latency()
+{
+    static const clock_type::duration latency = [] {
+        const char* env = getenv("MOCK_GPU_LATENCY_US");
+        return std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::microseconds(env ? strtoul(env, nullptr, 10) : 0));
+    }();
+    return latency;
+}
+
+void mock_driver::wait_until(clock_type::time_point done)
+{
+    if (done > clock_type::now())
+        std::this_thread::sleep_until(done);
+}
+
+uint64_t mock_driver_call_count(const char* name)
+{
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    auto iter = reg.counters.find(name);
+    return iter != reg.counters.end() ? iter->second.load() : 0;
+}
+
+void mock_driver_reset_call_counts(void)
+{
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    for (auto& [name, counter] : reg.counters)
+        counter = 0;
+}
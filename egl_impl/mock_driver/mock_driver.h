@@ -0,0 +1,67 @@
+#ifndef EGL_MOCK_DRIVER_H_
+#define EGL_MOCK_DRIVER_H_
+
+// Shared bits of the mock vendor libEGL/libGLESv1_CM/libGLESv2. Each of the
+// three libraries has its own copy: calls are counted per library and
+// mock_driver_call_count looks up the library it was resolved from.
+//
+// MOCK_GPU_LATENCY_US  time between submitting work (a fence, glFinish,
+//                      eglSwapBuffers) and its completion
+// MOCK_DRIVER_DUMP     log the call counts when the library is unloaded,
+//                      at LOG_LEVEL=info
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+
+#define MOCK_DRIVER_API __attribute__((visibility("default")))
+
+extern "C" {
+// calls of an entry point since load or the last reset, 0 if never called
+MOCK_DRIVER_API uint64_t mock_driver_call_count(const char* name);
+MOCK_DRIVER_API void mock_driver_reset_call_counts(void);
+// the bytes the array of attribute index gave the vertices of the last
+// draw, in the order they were drawn, of the mock libGLESv2; copies at
+// most size of them and returns how many there are
+MOCK_DRIVER_API size_t mock_driver_draw_data(unsigned int index, void* data,
+                                             size_t size);
+}
+
+namespace mock_driver {
+// the count lives in the registry, which is never destroyed, so calls made
+// while the library unloads are still counted
+struct call_counter
+{
+    explicit call_counter(const char* name);
+
+    void hit()
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t>& count;
+};
+
+void dump_call_counts();
+
+using clock_type = std::chrono::steady_clock;
+
+clock_type::duration gpu_latency();
+
+// when work submitted now is done
+inline clock_type::time_point submit()
+{
+    return clock_type::now() + gpu_latency();
+}
+
+void wait_until(clock_type::time_point done);
+} // namespace mock_driver
+
+// counts the calls of the enclosing entry point
+#define MOCK_RECORD(_api)                                                      \
+    static mock_driver::call_counter _api##_calls{#_api};                      \
+    _api##_calls.hit()
+
+#endif // EGL_MOCK_DRIVER_H_
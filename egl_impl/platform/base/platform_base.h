@@ -5,6 +5,8 @@
 
 #include "platform_common/base/platform_base.h"
 
+class egl_config_table_t;
+
 class EGLBaseNativeWindow : public BaseNativeWindow {
   public:
     operator ANativeWindow*()
@@ -25,6 +27,10 @@ class platform_wrapper_t {
     virtual void prepare_swap(ANativeWindow* win, const EGLint* rects,
                               EGLint n_rects) = 0;
     virtual void finish_swap(ANativeWindow* win) = 0;
+
+    // rewrite what the driver reports for the configs, after they are
+    // read at the first eglInitialize
+    virtual void adjust_configs(egl_config_table_t& configs) {}
 };
 
 #endif // EGL_PLATFORM_BASE_H_
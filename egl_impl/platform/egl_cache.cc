@@ -0,0 +1,533 @@
+#include "egl_cache.h"
+#include "loader/loader.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace egl_wrapper;
+
+struct egl_cache_t::file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t driver;
+    uint64_t capacity;
+    // end of the last complete record, from the start of the file
+    uint64_t end;
+};
+
+struct egl_cache_t::record_header
+{
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t checksum;
+    uint32_t flags;
+    uint64_t last_use;
+};
+
+namespace {
+constexpr uint32_t cache_magic = 0x424c4745; // "EGLB"
+constexpr uint32_t cache_version = 1;
+constexpr size_t default_size_mib = 16;
+// replaced by a later record of the same key
+constexpr uint32_t record_dead = 1;
+
+constexpr size_t align8(size_t size)
+{
+    return (size + 7) & ~size_t(7);
+}
+
+uint32_t checksum(const void* key, size_t key_size, const void* value,
+                  size_t value_size)
+{
+    uint64_t hash = egl_cache_t::hash(value, value_size,
+                                      egl_cache_t::hash(key, key_size));
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// a new file of the size the cache maps, next to path under a name of its
+// own so nothing planted there is followed; renamed into place by the
+// caller
+int create_file(const std::string& path, size_t capacity, std::string* tmp)
+{
+    *tmp = path + ".XXXXXX";
+    int fd = mkostemp(tmp->data(), O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    // allocated up front, a store into a hole of a full disk is a SIGBUS
+    if (posix_fallocate(fd, 0, capacity) != 0)
+    {
+        ::close(fd);
+        unlink(tmp->c_str());
+        return -1;
+    }
+    return fd;
+}
+
+void set_blob(const void* key, EGLsizeiANDROID key_size, const void* value,
+              EGLsizeiANDROID value_size)
+{
+    if (key_size > 0 && value_size > 0)
+        egl_cache_t::get().set(key, key_size, value, value_size);
+}
+
+EGLsizeiANDROID get_blob(const void* key, EGLsizeiANDROID key_size,
+                         void* value, EGLsizeiANDROID value_size)
+{
+    if (key_size <= 0 || value_size < 0)
+        return 0;
+    return egl_cache_t::get().get(key, key_size, value, value_size);
+}
+} // namespace
+
+egl_cache_t& egl_cache_t::get()
+{
+    // never destroyed, the driver may store a blob while the process exits
+    static auto* cache = new egl_cache_t{};
+    return *cache;
+}
+
+egl_cache_t::~egl_cache_t()
+{
+    close();
+}
+
+std::string egl_cache_t::directory()
+{
+    // never a shared one, another user could plant files or links there
+    std::string dir;
+    if (const char* env = getenv("XDG_CACHE_HOME"); env && *env == '/')
+        dir = env;
+    else if (const char* env = getenv("HOME"); env && *env == '/')
+        dir = std::string(env) + "/.cache";
+    else
+        return {};
+    // XDG_CACHE_HOME need not exist yet
+    mkdir(dir.c_str(), 0700);
+    dir += "/EGL_ext";
+    mkdir(dir.c_str(), 0700);
+
+    struct stat st{};
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+        st.st_uid != getuid() || (st.st_mode & 0777) != 0700)
+    {
+        logger::log_warn() << "cache directory " << dir
+                           << " is not private to this user";
+        return {};
+    }
+    return dir;
+}
+
+uint64_t egl_cache_t::hash(const void* data, size_t size, uint64_t hash)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+uint64_t egl_cache_t::driver_build(const void* driver_symbol,
+                                   std::initializer_list<const char*> strings)
+{
+    std::string build;
+    for (const char* str : strings)
+    {
+        if (str)
+            build = build + str + '\n';
+    }
+    Dl_info info{};
+    struct stat st{};
+    if (dladdr(driver_symbol, &info) && info.dli_fname &&
+        stat(info.dli_fname, &st) == 0)
+    {
+        build = build + info.dli_fname + '\n' + std::to_string(st.st_size) +
+                '\n' + std::to_string(st.st_mtime);
+    }
+    return hash(build.data(), build.size());
+}
+
+size_t egl_cache_t::file_size()
+{
+    size_t size_mib = default_size_mib;
+    if (const char* env = getenv("EGL_BLOB_CACHE_SIZE"); env)
+    {
+        if (size_t value = strtoul(env, nullptr, 10); value > 0)
+            size_mib = value;
+    }
+    return size_mib << 20;
+}
+
+void egl_cache_t::initialize(EGLDisplay dpy)
+{
+    if (initialized)
+        return;
+    initialized = true;
+
+    if (!utils::gen_env_option<bool>("EGL_BLOB_CACHE", {{"0", false}}, true))
+        return;
+
+    auto system = g_egl_system;
+    const char* extensions = system->egl.eglQueryString(dpy, EGL_EXTENSIONS);
+    if (!system->egl.ext.eglSetBlobCacheFuncsANDROID || !extensions ||
+        !strstr(extensions, "EGL_ANDROID_blob_cache"))
+    {
+        logger::log_info() << "driver has no EGL_ANDROID_blob_cache";
+        return;
+    }
+
+    uint64_t driver = driver_build(
+        reinterpret_cast<void*>(system->egl.eglInitialize),
+        {system->egl.eglQueryString(dpy, EGL_VENDOR),
+         system->egl.eglQueryString(dpy, EGL_VERSION)});
+
+    std::string dir = directory();
+    char name[64];
+    snprintf(name, sizeof(name), "/blob_cache_%016llx.bin",
+             static_cast<unsigned long long>(driver));
+    if (dir.empty() || !open(dir + name, driver, file_size()))
+        return;
+
+    system->egl.ext.eglSetBlobCacheFuncsANDROID(dpy, set_blob, get_blob);
+    driver_installed = true;
+}
+
+egl_cache_t::file_header* egl_cache_t::header() const
+{
+    return reinterpret_cast<file_header*>(base);
+}
+
+egl_cache_t::record_header* egl_cache_t::record(uint64_t offset) const
+{
+    return reinterpret_cast<record_header*>(base + offset);
+}
+
+bool egl_cache_t::open(const std::string& path, uint64_t driver,
+                       size_t capacity)
+{
+    std::lock_guard lock{mutex};
+    close();
+    if (capacity < 4 * sizeof(file_header))
+        return false;
+
+    this->path = path;
+    this->driver = driver;
+    this->capacity = capacity;
+
+    writable = take_lock();
+
+    int fd = ::open(path.c_str(),
+                    (writable ? O_RDWR : O_RDONLY) | O_NOFOLLOW | O_CLOEXEC);
+    bool valid = false;
+    if (fd >= 0)
+    {
+        file_header head{};
+        struct stat st{};
+        valid = fstat(fd, &st) == 0 && (size_t)st.st_size == capacity &&
+                pread(fd, &head, sizeof(head), 0) == sizeof(head) &&
+                head.magic == cache_magic && head.version == cache_version &&
+                head.driver == driver && head.capacity == capacity &&
+                head.end >= sizeof(head) && head.end <= capacity;
+    }
+
+    if (!valid && writable)
+    {
+        // readers may still map the old file, so it is replaced rather
+        // than truncated
+        if (fd >= 0)
+            ::close(fd);
+        std::string tmp;
+        fd = create_file(path, capacity, &tmp);
+        if (fd >= 0)
+        {
+            file_header head{.magic = cache_magic,
+                             .version = cache_version,
+                             .driver = driver,
+                             .capacity = capacity,
+                             .end = sizeof(file_header)};
+            valid = pwrite(fd, &head, sizeof(head), 0) == sizeof(head) &&
+                    rename(tmp.c_str(), path.c_str()) == 0;
+            if (!valid)
+                unlink(tmp.c_str());
+        }
+    }
+
+    if (!valid || !map(fd, writable))
+    {
+        logger::log_warn() << "blob cache " << path << " not usable";
+        if (fd >= 0)
+            ::close(fd);
+        close();
+        return false;
+    }
+    ::close(fd);
+
+    load_index();
+    logger::log_info() << "blob cache " << path << ": " << index.size()
+                       << " entries" << (writable ? "" : ", read only");
+    return true;
+}
+
+bool egl_cache_t::take_lock()
+{
+    // the file itself is replaced on eviction, so the lock is on another.
+    // an open file description lock, a forked child opening the file
+    // again does not get it
+    lock_fd = ::open((path + ".lock").c_str(),
+                     O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (lock_fd < 0)
+        return false;
+
+    struct flock fl{};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    lock_pid = getpid();
+    return fcntl(lock_fd, F_OFD_SETLK, &fl) == 0;
+}
+
+bool egl_cache_t::still_writable()
+{
+    // a forked child shares the parent's lock through the inherited fd,
+    // it has to take one of its own
+    if (writable && lock_pid != getpid())
+    {
+        ::close(lock_fd);
+        lock_fd = -1;
+        writable = take_lock();
+    }
+    return writable;
+}
+
+void egl_cache_t::close()
+{
+    index.clear();
+    if (base)
+    {
+        munmap(base, capacity);
+        base = nullptr;
+    }
+    if (lock_fd >= 0)
+    {
+        ::close(lock_fd);
+        lock_fd = -1;
+    }
+    writable = false;
+}
+
+bool egl_cache_t::map(int fd, bool writable)
+{
+    void* addr = mmap(nullptr, capacity,
+                      PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd,
+                      0);
+    if (addr == MAP_FAILED)
+        return false;
+    base = static_cast<uint8_t*>(addr);
+    return true;
+}
+
+void egl_cache_t::load_index()
+{
+    index.clear();
+    clock = 0;
+
+    uint64_t end = __atomic_load_n(&header()->end, __ATOMIC_ACQUIRE);
+    uint64_t offset = sizeof(file_header);
+    while (offset + sizeof(record_header) <= end)
+    {
+        record_header* r = record(offset);
+        uint64_t size = align8(sizeof(record_header) + uint64_t(r->key_size) +
+                               r->value_size);
+        if (r->key_size == 0 || offset + size > end)
+        {
+            // torn by a crash, the space is taken again
+            if (writable)
+                __atomic_store_n(&header()->end, offset, __ATOMIC_RELEASE);
+            break;
+        }
+
+        if (!(r->flags & record_dead))
+        {
+            std::string_view key{
+                reinterpret_cast<const char*>(r + 1), r->key_size};
+            if (auto [iter, inserted] = index.try_emplace(key, offset);
+                !inserted)
+            {
+                if (writable)
+                    record(iter->second)->flags |= record_dead;
+                iter->second = offset;
+            }
+        }
+        clock = std::max(clock, r->last_use);
+        offset += size;
+    }
+}
+
+size_t egl_cache_t::get(const void* key, size_t key_size, void* value,
+                        size_t value_size)
+{
+    std::lock_guard lock{mutex};
+    if (!base)
+        return 0;
+    still_writable();
+
+    auto iter =
+        index.find({static_cast<const char*>(key), key_size});
+    if (iter == index.end())
+        return 0;
+
+    record_header* r = record(iter->second);
+    const uint8_t* data = reinterpret_cast<uint8_t*>(r + 1) + r->key_size;
+    if (checksum(r + 1, r->key_size, data, r->value_size) != r->checksum)
+    {
+        logger::log_warn() << "blob cache record at " << iter->second
+                           << " is corrupt";
+        if (writable)
+            r->flags |= record_dead;
+        index.erase(iter);
+        return 0;
+    }
+
+    if (writable)
+        r->last_use = ++clock;
+    if (value && value_size >= r->value_size)
+        memcpy(value, data, r->value_size);
+    return r->value_size;
+}
+
+void egl_cache_t::set(const void* key, size_t key_size, const void* value,
+                      size_t value_size)
+{
+    std::lock_guard lock{mutex};
+    if (!base || !still_writable())
+        return;
+
+    // a blob a quarter of the file would evict everything else
+    size_t size = align8(sizeof(record_header) + key_size + value_size);
+    if (size > capacity / 4)
+        return;
+
+    uint64_t old = 0;
+    if (auto iter = index.find({static_cast<const char*>(key), key_size});
+        iter != index.end())
+    {
+        old = iter->second;
+        record_header* r = record(old);
+        if (r->value_size == value_size &&
+            memcmp(reinterpret_cast<uint8_t*>(r + 1) + key_size, value,
+                   value_size) == 0)
+        {
+            r->last_use = ++clock;
+            return;
+        }
+    }
+
+    if (!append(key, key_size, value, value_size))
+    {
+        // eviction moves the records, the old one is gone with it
+        if (!evict(size) || !append(key, key_size, value, value_size))
+            return;
+        old = 0;
+    }
+    if (old)
+        record(old)->flags |= record_dead;
+}
+
+bool egl_cache_t::append(const void* key, size_t key_size, const void* value,
+                         size_t value_size)
+{
+    uint64_t offset = header()->end;
+    uint64_t size = align8(sizeof(record_header) + key_size + value_size);
+    if (offset + size > capacity)
+        return false;
+
+    record_header* r = record(offset);
+    r->key_size = key_size;
+    r->value_size = value_size;
+    r->checksum = checksum(key, key_size, value, value_size);
+    r->flags = 0;
+    r->last_use = ++clock;
+    uint8_t* data = reinterpret_cast<uint8_t*>(r + 1);
+    memcpy(data, key, key_size);
+    memcpy(data + key_size, value, value_size);
+
+    // the record counts from here on
+    __atomic_store_n(&header()->end, offset + size, __ATOMIC_RELEASE);
+    index.insert_or_assign(
+        std::string_view{reinterpret_cast<const char*>(data), key_size},
+        offset);
+    return true;
+}
+
+bool egl_cache_t::evict(size_t needed)
+{
+    std::vector<record_header*> live;
+    live.reserve(index.size());
+    for (const auto& [key, offset] : index)
+        live.push_back(record(offset));
+    std::sort(live.begin(), live.end(),
+              [](const record_header* a, const record_header* b) {
+                  return a->last_use > b->last_use;
+              });
+
+    // keep the most recent half, so the next eviction is far away
+    size_t budget = (capacity - sizeof(file_header)) / 2;
+    budget = std::min(budget, capacity - sizeof(file_header) - needed);
+
+    std::string tmp;
+    int fd = create_file(path, capacity, &tmp);
+    if (fd < 0)
+        return false;
+    void* addr =
+        mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    auto target = static_cast<uint8_t*>(addr);
+    uint64_t end = sizeof(file_header);
+    size_t kept = 0;
+    for (const record_header* r : live)
+    {
+        size_t size =
+            align8(sizeof(record_header) + r->key_size + r->value_size);
+        if (end + size - sizeof(file_header) > budget)
+            break;
+        memcpy(target + end, r, size);
+        end += size;
+        kept++;
+    }
+    *reinterpret_cast<file_header*>(target) = {.magic = cache_magic,
+                                               .version = cache_version,
+                                               .driver = driver,
+                                               .capacity = capacity,
+                                               .end = end};
+
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        munmap(addr, capacity);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    logger::log_info() << "blob cache evicted " << live.size() - kept
+                       << " of " << live.size() << " entries";
+    munmap(base, capacity);
+    base = target;
+    load_index();
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef EGL_CACHE_H_
+#define EGL_CACHE_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// The blob cache handed to the driver through EGL_ANDROID_blob_cache, so
+// compiled shaders outlive the process.
+//
+// It is one file per driver build, mapped whole and of a fixed size: a
+// header and then records appended one after the other. A record counts
+// once the header's end covers it, its checksum is checked when it is
+// read, and the file is only ever replaced as a whole by rename, so a
+// crash at any point leaves a usable cache. When the file is full the
+// least recently used records are dropped.
+//
+// Only one process writes the file; others opening it meanwhile read from
+// it and drop what they would store.
+//
+// EGL_BLOB_CACHE       0 to leave the driver without a cache
+// EGL_BLOB_CACHE_SIZE  size of a cache file in MiB, 16 by default
+class egl_cache_t {
+  public:
+    static egl_cache_t& get();
+
+    // hand the callbacks to the driver if it takes them, once per process
+    void initialize(EGLDisplay dpy);
+    // the driver caches what it compiles itself
+    bool installed() const
+    {
+        return driver_installed;
+    }
+
+    // where the cache files live, $XDG_CACHE_HOME/EGL_ext or
+    // $HOME/.cache/EGL_ext, created if missing; empty unless it is a
+    // directory of this user only
+    static std::string directory();
+    // FNV-1a, chained through hash
+    static uint64_t hash(const void* data, size_t size,
+                         uint64_t hash = 0xcbf29ce484222325ull);
+    // identity of the loaded driver library and what it reports, so a
+    // driver update starts a new cache
+    static uint64_t driver_build(const void* driver_symbol,
+                                 std::initializer_list<const char*> strings);
+    // EGL_BLOB_CACHE_SIZE
+    static size_t file_size();
+
+    // map the file, creating or resetting it unless it is one of the same
+    // driver and size
+    bool open(const std::string& path, uint64_t driver, size_t capacity);
+    void close();
+
+    void set(const void* key, size_t key_size, const void* value,
+             size_t value_size);
+    // size of the value, copied only if it fits; 0 when not cached
+    size_t get(const void* key, size_t key_size, void* value,
+               size_t value_size);
+
+    egl_cache_t() = default;
+    ~egl_cache_t();
+
+    egl_cache_t(const egl_cache_t&) = delete;
+    egl_cache_t& operator=(const egl_cache_t&) = delete;
+
+  private:
+    struct file_header;
+    struct record_header;
+
+    file_header* header() const;
+    record_header* record(uint64_t offset) const;
+
+    // take the writer lock, false when another process holds it
+    bool take_lock();
+    // writable, checked again in a forked child
+    bool still_writable();
+    bool map(int fd, bool writable);
+    void load_index();
+    bool append(const void* key, size_t key_size, const void* value,
+                size_t value_size);
+    bool evict(size_t needed);
+
+    std::mutex mutex;
+    std::string path;
+    uint64_t driver = 0;
+    size_t capacity = 0;
+    // held while this process writes the file
+    int lock_fd = -1;
+    pid_t lock_pid = 0;
+    bool writable = false;
+    uint8_t* base = nullptr;
+    uint64_t clock = 0;
+    // keys point into the mapping, offsets are of record headers
+    std::unordered_map<std::string_view, uint64_t> index;
+    bool initialized = false;
+    bool driver_installed = false;
+};
+
+#endif // EGL_CACHE_H_
@@ -0,0 +1,234 @@
+#include "egl_compile_pool.h"
+#include "loader/loader.h"
+
+#include "logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+using namespace egl_wrapper;
+
+egl_compile_pool_t::~egl_compile_pool_t()
+{
+    stop();
+}
+
+void egl_compile_pool_t::probe(EGLDisplay dpy, EGLConfig config,
+                               EGLContext share, EGLint client_version)
+{
+    std::unique_lock lock{mutex};
+    if (probed)
+        return;
+    probed = true;
+
+    size_t threads = 0;
+    if (const char* env = getenv("EGL_PARALLEL_COMPILE"); env)
+        threads = strtoul(env, nullptr, 10);
+    if (threads == 0)
+        return;
+
+    auto system = g_egl_system;
+    const auto& gl = system->hooks[egl_system_t::GLESv2_INDEX].gl;
+    if (!gl.glFenceSync || !gl.glClientWaitSync || !gl.glDeleteSync)
+        return;
+    auto extensions = (const char*)gl.glGetString(GL_EXTENSIONS);
+    if (extensions && strstr(extensions, "GL_KHR_parallel_shader_compile"))
+        return;
+
+    // a pbuffer for every worker unless the driver binds no surface
+    auto egl_extensions = system->egl.eglQueryString(dpy, EGL_EXTENSIONS);
+    bool surfaceless = egl_extensions &&
+                       strstr(egl_extensions, "EGL_KHR_surfaceless_context");
+    const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION,
+                                      client_version, EGL_NONE};
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+
+    display = dpy;
+    for (size_t i = 0; i < threads; i++)
+    {
+        EGLContext ctx = system->egl.eglCreateContext(dpy, config, share,
+                                                      context_attribs);
+        if (!ctx)
+            break;
+        EGLSurface surface = EGL_NO_SURFACE;
+        if (!surfaceless &&
+            !(surface = system->egl.eglCreatePbufferSurface(dpy, config,
+                                                            pbuffer_attribs)))
+        {
+            system->egl.eglDestroyContext(dpy, ctx);
+            break;
+        }
+        contexts.push_back(ctx);
+        surfaces.push_back(surface);
+    }
+    // what failed above is not the app's error
+    system->egl.eglGetError();
+
+    max_running = contexts.size();
+    for (size_t i = 0; i < contexts.size(); i++)
+        workers.emplace_back(&egl_compile_pool_t::run_worker, this, i);
+    finished.wait(lock, [&] { return bound + bind_failed >= workers.size(); });
+    if (workers.empty() || bind_failed)
+    {
+        logger::log_warn() << "no worker context for parallel compiling";
+        lock.unlock();
+        stop();
+        return;
+    }
+
+    logger::log_info() << "compiling shaders on " << workers.size()
+                       << " threads";
+    active = true;
+}
+
+void egl_compile_pool_t::submit(GLuint object,
+                                const std::vector<GLuint>& after, work_t work)
+{
+    std::unique_lock lock{mutex};
+    if (max_running == 0)
+    {
+        lock.unlock();
+        wait(object);
+        for (GLuint other : after)
+            wait(other);
+        work(g_egl_system->hooks[egl_system_t::GLESv2_INDEX].gl);
+        return;
+    }
+
+    // the jobs of one object run in order
+    finished.wait(lock, [&] {
+        auto iter = busy.find(object);
+        return iter == busy.end() || *iter->second;
+    });
+
+    job next{std::make_shared<bool>(false), {}, std::move(work)};
+    for (GLuint other : after)
+    {
+        if (auto iter = busy.find(other); iter != busy.end())
+            next.after.push_back(iter->second);
+    }
+    busy[object] = next.done;
+    busy_count = busy.size();
+    jobs.push_back(std::move(next));
+    queued.notify_one();
+}
+
+void egl_compile_pool_t::wait(GLuint object)
+{
+    if (busy_count.load(std::memory_order_acquire) == 0)
+        return;
+
+    std::unique_lock lock{mutex};
+    finished.wait(lock, [&] {
+        auto iter = busy.find(object);
+        return iter == busy.end() || *iter->second;
+    });
+    busy.erase(object);
+    busy_count = busy.size();
+}
+
+bool egl_compile_pool_t::completed(GLuint object)
+{
+    std::lock_guard lock{mutex};
+    auto iter = busy.find(object);
+    if (iter == busy.end())
+        return true;
+    if (!*iter->second)
+        return false;
+    busy.erase(iter);
+    busy_count = busy.size();
+    return true;
+}
+
+void egl_compile_pool_t::set_max_threads(GLuint count)
+{
+    std::lock_guard lock{mutex};
+    max_running = std::min<size_t>(count, workers.size());
+    queued.notify_all();
+}
+
+void egl_compile_pool_t::run_worker(size_t index)
+{
+    auto system = g_egl_system;
+    const auto& gl = system->hooks[egl_system_t::GLESv2_INDEX].gl;
+    bool ok = system->egl.eglMakeCurrent(display, surfaces[index],
+                                         surfaces[index], contexts[index]);
+    {
+        std::lock_guard lock{mutex};
+        ok ? bound++ : bind_failed = true;
+    }
+    finished.notify_all();
+    if (!ok)
+        return;
+
+    for (;;)
+    {
+        job next;
+        {
+            std::unique_lock lock{mutex};
+            // jobs queued before glMaxShaderCompilerThreadsKHR(0) still run
+            queued.wait(lock, [&] {
+                return stopping || (!jobs.empty() &&
+                                    running < std::max<size_t>(max_running, 1));
+            });
+            if (jobs.empty())
+                break;
+            next = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+
+            // queued before this one, so already taken by other workers
+            finished.wait(lock, [&] {
+                return std::all_of(next.after.begin(), next.after.end(),
+                                   [](const auto& done) { return *done; });
+            });
+        }
+
+        next.work(gl);
+        // complete for every context of the share group from here on
+        if (GLsync fence = gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            fence)
+        {
+            gl.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                GL_TIMEOUT_IGNORED);
+            gl.glDeleteSync(fence);
+        }
+
+        {
+            std::lock_guard lock{mutex};
+            *next.done = true;
+            running--;
+        }
+        finished.notify_all();
+        queued.notify_one();
+    }
+
+    system->egl.eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                               EGL_NO_CONTEXT);
+}
+
+void egl_compile_pool_t::stop()
+{
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+        active = false;
+    }
+    queued.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+
+    auto system = g_egl_system;
+    for (EGLContext ctx : contexts)
+        system->egl.eglDestroyContext(display, ctx);
+    for (EGLSurface surface : surfaces)
+    {
+        if (surface != EGL_NO_SURFACE)
+            system->egl.eglDestroySurface(display, surface);
+    }
+    contexts.clear();
+    surfaces.clear();
+}
@@ -0,0 +1,93 @@
+#ifndef EGL_COMPILE_POOL_H_
+#define EGL_COMPILE_POOL_H_
+
+#include "loader/hooks.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// GL_KHR_parallel_shader_compile for drivers without it: glCompileShader
+// and glLinkProgram return at once and run on worker threads, each with a
+// context of the app's share group.
+//
+// A job ends with a fence the worker waits for, so what it did is complete
+// for every context before it counts as done. Any other call on the
+// shader or program waits for that, except COMPLETION_STATUS_KHR which
+// only asks.
+//
+// One per share group.
+//
+// EGL_PARALLEL_COMPILE  number of worker threads, off when unset or 0
+class egl_compile_pool_t {
+  public:
+    using gl_t = egl_wrapper::gl_hooks_t::gl_t;
+    using work_t = std::function<void(const gl_t&)>;
+
+    egl_compile_pool_t() = default;
+    ~egl_compile_pool_t();
+
+    // start the workers if asked for and the driver has no such extension,
+    // once; share is the driver's context they share objects with
+    void probe(EGLDisplay dpy, EGLConfig config, EGLContext share,
+               EGLint client_version);
+    bool enabled() const
+    {
+        return active.load(std::memory_order_acquire);
+    }
+
+    // run work on a worker after what was submitted for the object and
+    // for the objects in after
+    void submit(GLuint object, const std::vector<GLuint>& after, work_t work);
+    // block until what was submitted for the object is done
+    void wait(GLuint object);
+    // COMPLETION_STATUS_KHR
+    bool completed(GLuint object);
+    // glMaxShaderCompilerThreadsKHR, 0 compiles on the calling thread
+    void set_max_threads(GLuint count);
+
+    egl_compile_pool_t(const egl_compile_pool_t&) = delete;
+    egl_compile_pool_t& operator=(const egl_compile_pool_t&) = delete;
+
+  private:
+    struct job
+    {
+        std::shared_ptr<bool> done;
+        std::vector<std::shared_ptr<bool>> after;
+        work_t work;
+    };
+
+    void run_worker(size_t index);
+    void stop();
+
+    std::mutex mutex;
+    // a job was queued, or the pool stops
+    std::condition_variable queued;
+    // a job is done, or a worker bound its context
+    std::condition_variable finished;
+    std::deque<job> jobs;
+    // the last job of each shader or program, until it is waited for
+    std::unordered_map<GLuint, std::shared_ptr<bool>> busy;
+    std::atomic<size_t> busy_count{0};
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    std::vector<EGLContext> contexts;
+    std::vector<EGLSurface> surfaces;
+    std::vector<std::thread> workers;
+    size_t bound = 0;
+    bool bind_failed = false;
+    size_t running = 0;
+    size_t max_running = 0;
+    bool stopping = false;
+
+    bool probed = false;
+    std::atomic<bool> active{false};
+};
+
+#endif // EGL_COMPILE_POOL_H_
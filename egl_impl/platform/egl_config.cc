@@ -0,0 +1,339 @@
+#include "egl_config.h"
+#include "loader/loader.h"
+
+#include "logger.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace egl_wrapper;
+
+// clang-format off
+const egl_config_table_t::attrib_info egl_config_table_t::attribs[] = {
+    {EGL_BUFFER_SIZE,                match_at_least, 0},
+    {EGL_RED_SIZE,                   match_at_least, 0},
+    {EGL_GREEN_SIZE,                 match_at_least, 0},
+    {EGL_BLUE_SIZE,                  match_at_least, 0},
+    {EGL_LUMINANCE_SIZE,             match_at_least, 0},
+    {EGL_ALPHA_SIZE,                 match_at_least, 0},
+    {EGL_ALPHA_MASK_SIZE,            match_at_least, 0},
+    {EGL_BIND_TO_TEXTURE_RGB,        match_exact,    EGL_DONT_CARE},
+    {EGL_BIND_TO_TEXTURE_RGBA,       match_exact,    EGL_DONT_CARE},
+    {EGL_COLOR_BUFFER_TYPE,          match_exact,    EGL_RGB_BUFFER},
+    {EGL_CONFIG_CAVEAT,              match_exact,    EGL_DONT_CARE},
+    {EGL_CONFIG_ID,                  match_exact,    EGL_DONT_CARE},
+    {EGL_CONFORMANT,                 match_mask,     0},
+    {EGL_DEPTH_SIZE,                 match_at_least, 0},
+    {EGL_LEVEL,                      match_exact,    0},
+    {EGL_MAX_PBUFFER_WIDTH,          match_ignored,  0},
+    {EGL_MAX_PBUFFER_HEIGHT,         match_ignored,  0},
+    {EGL_MAX_PBUFFER_PIXELS,         match_ignored,  0},
+    {EGL_MAX_SWAP_INTERVAL,          match_exact,    EGL_DONT_CARE},
+    {EGL_MIN_SWAP_INTERVAL,          match_exact,    EGL_DONT_CARE},
+    {EGL_NATIVE_RENDERABLE,          match_exact,    EGL_DONT_CARE},
+    {EGL_NATIVE_VISUAL_ID,           match_ignored,  0},
+    {EGL_NATIVE_VISUAL_TYPE,         match_exact,    EGL_DONT_CARE},
+    {EGL_RENDERABLE_TYPE,            match_mask,     EGL_OPENGL_ES_BIT},
+    {EGL_SAMPLE_BUFFERS,             match_at_least, 0},
+    {EGL_SAMPLES,                    match_at_least, 0},
+    {EGL_STENCIL_SIZE,               match_at_least, 0},
+    {EGL_SURFACE_TYPE,               match_mask,     EGL_WINDOW_BIT},
+    {EGL_TRANSPARENT_TYPE,           match_exact,    EGL_NONE},
+    {EGL_TRANSPARENT_RED_VALUE,      match_exact,    EGL_DONT_CARE},
+    {EGL_TRANSPARENT_GREEN_VALUE,    match_exact,    EGL_DONT_CARE},
+    {EGL_TRANSPARENT_BLUE_VALUE,     match_exact,    EGL_DONT_CARE},
+    {EGL_RECORDABLE_ANDROID,         match_exact,    EGL_DONT_CARE},
+    {EGL_FRAMEBUFFER_TARGET_ANDROID, match_exact,    EGL_DONT_CARE},
+    {EGL_COLOR_COMPONENT_TYPE_EXT,   match_exact,    EGL_COLOR_COMPONENT_TYPE_FIXED_EXT},
+};
+// clang-format on
+
+const size_t egl_config_table_t::attrib_count =
+    sizeof(attribs) / sizeof(attribs[0]);
+
+namespace {
+template <size_t N>
+bool one_of(EGLint value, const EGLint (&list)[N])
+{
+    return value == EGL_DONT_CARE ||
+           std::find(std::begin(list), std::end(list), value) != std::end(list);
+}
+
+// whether eglChooseConfig takes the value, the driver raises
+// EGL_BAD_ATTRIBUTE for the rest
+bool valid_value(const egl_config_table_t::attrib_info& info, EGLint value)
+{
+    switch (info.attribute)
+    {
+    case EGL_BIND_TO_TEXTURE_RGB:
+    case EGL_BIND_TO_TEXTURE_RGBA:
+    case EGL_NATIVE_RENDERABLE:
+    case EGL_RECORDABLE_ANDROID:
+    case EGL_FRAMEBUFFER_TARGET_ANDROID:
+        return one_of(value, {EGL_TRUE, EGL_FALSE});
+    case EGL_COLOR_BUFFER_TYPE:
+        return one_of(value, {EGL_RGB_BUFFER, EGL_LUMINANCE_BUFFER});
+    case EGL_CONFIG_CAVEAT:
+        return one_of(value,
+                      {EGL_NONE, EGL_SLOW_CONFIG, EGL_NON_CONFORMANT_CONFIG});
+    case EGL_TRANSPARENT_TYPE:
+        return one_of(value, {EGL_NONE, EGL_TRANSPARENT_RGB});
+    case EGL_COLOR_COMPONENT_TYPE_EXT:
+        return one_of(value, {EGL_COLOR_COMPONENT_TYPE_FIXED_EXT,
+                              EGL_COLOR_COMPONENT_TYPE_FLOAT_EXT});
+    }
+    // sizes and counts
+    if (info.rule == egl_config_table_t::match_at_least)
+        return value >= 0 || value == EGL_DONT_CARE;
+    return true;
+}
+} // namespace
+
+int egl_config_table_t::column(EGLint attribute)
+{
+    for (size_t i = 0; i < attrib_count; i++)
+    {
+        if (attribs[i].attribute == attribute)
+            return i;
+    }
+    return -1;
+}
+
+void egl_config_table_t::load(EGLDisplay dpy)
+{
+    if (loaded())
+        return;
+
+    auto system = g_egl_system;
+    EGLint count = 0;
+    if (!system->egl.eglGetConfigs(dpy, nullptr, 0, &count) || count <= 0)
+        return;
+
+    std::vector<EGLConfig> configs(count);
+    if (!system->egl.eglGetConfigs(dpy, configs.data(), count, &count))
+        return;
+    configs.resize(count);
+
+    values.assign(configs.size() * attrib_count, 0);
+    known.set();
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        for (size_t col = 0; col < attrib_count; col++)
+        {
+            if (!known[col])
+                continue;
+            if (!system->egl.eglGetConfigAttrib(dpy, configs[i],
+                                                attribs[col].attribute,
+                                                &values[i * attrib_count + col]))
+            {
+                // an extension the driver lacks, leave it to the driver
+                known.reset(col);
+            }
+        }
+    }
+    // the failed queries above are not the caller's errors
+    system->egl.eglGetError();
+
+    index_of.clear();
+    for (size_t i = 0; i < configs.size(); i++)
+        index_of.emplace(configs[i], i);
+    handles = std::move(configs);
+
+    logger::log_info() << "cached " << handles.size() << " configs with "
+                       << known.count() << " attributes";
+}
+
+void egl_config_table_t::set_value(size_t index, EGLint attribute,
+                                   EGLint value)
+{
+    if (int col = column(attribute); col >= 0 && index < handles.size())
+        values[index * attrib_count + col] = value;
+}
+
+void egl_config_table_t::get_configs(EGLConfig* configs, EGLint config_size,
+                                     EGLint* num_config) const
+{
+    EGLint count = handles.size();
+    if (configs)
+    {
+        count = std::min(count, std::max(config_size, 0));
+        std::copy_n(handles.begin(), count, configs);
+    }
+    *num_config = count;
+}
+
+bool egl_config_table_t::get_attrib(EGLConfig config, EGLint attribute,
+                                    EGLint* value) const
+{
+    auto iter = index_of.find(config);
+    int col = column(attribute);
+    if (iter == index_of.end() || col < 0 || !known[col])
+        return false;
+
+    *value = this->value(iter->second, col);
+    return true;
+}
+
+bool egl_config_table_t::choose(const EGLint* attrib_list, EGLConfig* configs,
+                                EGLint config_size, EGLint* num_config) const
+{
+    // what is asked per column, defaults first, later entries win
+    EGLint wanted[64];
+    std::bitset<64> listed;
+    for (size_t col = 0; col < attrib_count; col++)
+        wanted[col] = attribs[col].default_value;
+
+    while (attrib_list && *attrib_list != EGL_NONE)
+    {
+        int col = column(attrib_list[0]);
+        if (col < 0 || !known[col] ||
+            !valid_value(attribs[col], attrib_list[1]))
+            return false;
+        wanted[col] = attrib_list[1];
+        listed.set(col);
+        attrib_list += 2;
+    }
+
+    // a default on an attribute the driver lacks must not filter out
+    // every config
+    for (size_t col = 0; col < attrib_count; col++)
+    {
+        if (!known[col] && !listed[col])
+            wanted[col] = EGL_DONT_CARE;
+    }
+
+    const int id_col = column(EGL_CONFIG_ID);
+    const int transparent_col = column(EGL_TRANSPARENT_TYPE);
+    const bool by_id = wanted[id_col] != EGL_DONT_CARE;
+
+    auto matches = [&](size_t index) {
+        if (by_id)
+            return value(index, id_col) == wanted[id_col];
+
+        for (size_t col = 0; col < attrib_count; col++)
+        {
+            EGLint want = wanted[col];
+            if (want == EGL_DONT_CARE)
+                continue;
+
+            switch (attribs[col].attribute)
+            {
+            case EGL_TRANSPARENT_RED_VALUE:
+            case EGL_TRANSPARENT_GREEN_VALUE:
+            case EGL_TRANSPARENT_BLUE_VALUE:
+                if (wanted[transparent_col] != EGL_TRANSPARENT_RGB)
+                    continue;
+                break;
+            }
+
+            EGLint have = value(index, col);
+            switch (attribs[col].rule)
+            {
+            case match_at_least:
+                if (have < want)
+                    return false;
+                break;
+            case match_exact:
+                if (have != want)
+                    return false;
+                break;
+            case match_mask:
+                if ((have & want) != want)
+                    return false;
+                break;
+            case match_ignored:
+                break;
+            }
+        }
+        return true;
+    };
+
+    std::vector<size_t> found;
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        if (matches(i))
+            found.push_back(i);
+    }
+
+    if (configs)
+    {
+        // the sort order of the EGL spec; native visual type is left out as
+        // it is implementation defined
+        const bool luminance =
+            wanted[column(EGL_COLOR_BUFFER_TYPE)] == EGL_LUMINANCE_BUFFER;
+        std::vector<int> color_cols{};
+        for (EGLint attribute :
+             {EGL_RED_SIZE, EGL_GREEN_SIZE, EGL_BLUE_SIZE, EGL_LUMINANCE_SIZE,
+              EGL_ALPHA_SIZE})
+        {
+            bool rgb_only = attribute != EGL_LUMINANCE_SIZE &&
+                            attribute != EGL_ALPHA_SIZE;
+            if (luminance && rgb_only)
+                continue;
+            if (!luminance && attribute == EGL_LUMINANCE_SIZE)
+                continue;
+            int col = column(attribute);
+            if (wanted[col] != EGL_DONT_CARE && wanted[col] > 0)
+                color_cols.push_back(col);
+        }
+
+        auto color_bits = [&](size_t index) {
+            EGLint bits = 0;
+            for (int col : color_cols)
+                bits += value(index, col);
+            return bits;
+        };
+
+        std::vector<int> ascending{};
+        for (EGLint attribute :
+             {EGL_CONFIG_CAVEAT, EGL_COLOR_COMPONENT_TYPE_EXT,
+              EGL_COLOR_BUFFER_TYPE})
+        {
+            if (int col = column(attribute); known[col])
+                ascending.push_back(col);
+        }
+        std::vector<int> tie_break{};
+        for (EGLint attribute :
+             {EGL_BUFFER_SIZE, EGL_SAMPLE_BUFFERS, EGL_SAMPLES, EGL_DEPTH_SIZE,
+              EGL_STENCIL_SIZE, EGL_ALPHA_MASK_SIZE, EGL_CONFIG_ID})
+        {
+            if (int col = column(attribute); known[col])
+                tie_break.push_back(col);
+        }
+
+        // caveat and the other enums happen to order by value:
+        // EGL_NONE < EGL_SLOW_CONFIG < EGL_NON_CONFORMANT_CONFIG,
+        // EGL_RGB_BUFFER < EGL_LUMINANCE_BUFFER, fixed < float
+        std::stable_sort(found.begin(), found.end(),
+                         [&](size_t a, size_t b) {
+                             for (int col : ascending)
+                             {
+                                 if (value(a, col) != value(b, col))
+                                     return value(a, col) < value(b, col);
+                             }
+                             if (EGLint bits_a = color_bits(a),
+                                 bits_b = color_bits(b);
+                                 bits_a != bits_b)
+                             {
+                                 return bits_a > bits_b;
+                             }
+                             for (int col : tie_break)
+                             {
+                                 if (value(a, col) != value(b, col))
+                                     return value(a, col) < value(b, col);
+                             }
+                             return false;
+                         });
+
+        EGLint count = std::min<EGLint>(found.size(), std::max(config_size, 0));
+        for (EGLint i = 0; i < count; i++)
+            configs[i] = handles[found[i]];
+        *num_config = count;
+    }
+    else
+    {
+        *num_config = found.size();
+    }
+    return true;
+}
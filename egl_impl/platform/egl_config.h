@@ -0,0 +1,93 @@
+#ifndef EGL_CONFIG_H_
+#define EGL_CONFIG_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stddef.h>
+
+#include <atomic>
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+// The attributes of every config of a display, read from the driver once at
+// the first eglInitialize. eglGetConfigs, eglGetConfigAttrib and most
+// eglChooseConfig calls are answered from it without calling the driver.
+class egl_config_table_t {
+  public:
+    enum match_rule
+    {
+        match_at_least,
+        match_exact,
+        match_mask,
+        match_ignored,
+    };
+
+    struct attrib_info
+    {
+        EGLint attribute;
+        match_rule rule;
+        // what eglChooseConfig assumes when the list leaves it out
+        EGLint default_value;
+    };
+
+    // the kept attributes, in column order
+    static const attrib_info attribs[];
+    static const size_t attrib_count;
+
+    // column of the attribute, -1 when it is not kept
+    static int column(EGLint attribute);
+
+    // read the configs of the driver's display, once
+    void load(EGLDisplay dpy);
+    bool loaded() const
+    {
+        return !handles.empty();
+    }
+
+    // answer from the table only while the display is initialized
+    void publish(bool initialized)
+    {
+        ready.store(initialized && loaded(), std::memory_order_release);
+    }
+    bool usable() const
+    {
+        return ready.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        return handles.size();
+    }
+    EGLConfig handle(size_t index) const
+    {
+        return handles[index];
+    }
+    // the attribute as the driver reported it, or as a platform overrode it
+    EGLint value(size_t index, int col) const
+    {
+        return values[index * attrib_count + col];
+    }
+    void set_value(size_t index, EGLint attribute, EGLint value);
+
+    void get_configs(EGLConfig* configs, EGLint config_size,
+                     EGLint* num_config) const;
+    // false when the driver has to answer: unknown config or attribute
+    bool get_attrib(EGLConfig config, EGLint attribute, EGLint* value) const;
+    // false when the driver has to answer: an attribute the table does not
+    // keep, EGL_MATCH_NATIVE_PIXMAP, or a value it does not take, for which
+    // the driver raises EGL_BAD_ATTRIBUTE
+    bool choose(const EGLint* attrib_list, EGLConfig* configs,
+                EGLint config_size, EGLint* num_config) const;
+
+  private:
+    std::vector<EGLConfig> handles;
+    std::unordered_map<EGLConfig, size_t> index_of;
+    std::vector<EGLint> values;
+    // columns the driver answered for every config
+    std::bitset<64> known;
+    std::atomic<bool> ready{false};
+};
+
+#endif // EGL_CONFIG_H_
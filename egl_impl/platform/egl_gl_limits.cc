@@ -0,0 +1,169 @@
+#include "egl_gl_limits.h"
+
+#include "utils.h"
+
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+
+#include <limits.h>
+
+#include <algorithm>
+
+namespace {
+struct limit_info
+{
+    GLenum pname;
+    // values it has
+    GLint count;
+    // wider than GLint, read with glGetInteger64v
+    bool wide;
+};
+
+// clang-format off
+constexpr limit_info limit_list[] = {
+    // OpenGL ES 2.0
+    {GL_MAX_TEXTURE_SIZE,                              1, false},
+    {GL_MAX_CUBE_MAP_TEXTURE_SIZE,                     1, false},
+    {GL_MAX_RENDERBUFFER_SIZE,                         1, false},
+    {GL_MAX_VIEWPORT_DIMS,                             2, false},
+    {GL_MAX_VERTEX_ATTRIBS,                            1, false},
+    {GL_MAX_VERTEX_UNIFORM_VECTORS,                    1, false},
+    {GL_MAX_FRAGMENT_UNIFORM_VECTORS,                  1, false},
+    {GL_MAX_VARYING_VECTORS,                           1, false},
+    {GL_MAX_TEXTURE_IMAGE_UNITS,                       1, false},
+    {GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS,                1, false},
+    {GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,              1, false},
+    {GL_SUBPIXEL_BITS,                                 1, false},
+    {GL_NUM_COMPRESSED_TEXTURE_FORMATS,                1, false},
+    {GL_NUM_SHADER_BINARY_FORMATS,                     1, false},
+    // OpenGL ES 3.0, rejected by the others
+    {GL_MAJOR_VERSION,                                 1, false},
+    {GL_MINOR_VERSION,                                 1, false},
+    {GL_MAX_3D_TEXTURE_SIZE,                           1, false},
+    {GL_MAX_ARRAY_TEXTURE_LAYERS,                      1, false},
+    {GL_MAX_COLOR_ATTACHMENTS,                         1, false},
+    {GL_MAX_DRAW_BUFFERS,                              1, false},
+    {GL_MAX_SAMPLES,                                   1, false},
+    {GL_MAX_ELEMENTS_INDICES,                          1, false},
+    {GL_MAX_ELEMENTS_VERTICES,                         1, false},
+    {GL_MAX_ELEMENT_INDEX,                             1, true},
+    {GL_MAX_SERVER_WAIT_TIMEOUT,                       1, true},
+    {GL_MAX_VERTEX_UNIFORM_COMPONENTS,                 1, false},
+    {GL_MAX_FRAGMENT_UNIFORM_COMPONENTS,               1, false},
+    {GL_MAX_VERTEX_UNIFORM_BLOCKS,                     1, false},
+    {GL_MAX_FRAGMENT_UNIFORM_BLOCKS,                   1, false},
+    {GL_MAX_COMBINED_UNIFORM_BLOCKS,                   1, false},
+    {GL_MAX_UNIFORM_BUFFER_BINDINGS,                   1, false},
+    {GL_MAX_UNIFORM_BLOCK_SIZE,                        1, true},
+    {GL_MAX_COMBINED_VERTEX_UNIFORM_COMPONENTS,        1, true},
+    {GL_MAX_COMBINED_FRAGMENT_UNIFORM_COMPONENTS,      1, true},
+    {GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,               1, false},
+    {GL_MAX_VARYING_COMPONENTS,                        1, false},
+    {GL_MAX_VERTEX_OUTPUT_COMPONENTS,                  1, false},
+    {GL_MAX_FRAGMENT_INPUT_COMPONENTS,                 1, false},
+    {GL_MIN_PROGRAM_TEXEL_OFFSET,                      1, false},
+    {GL_MAX_PROGRAM_TEXEL_OFFSET,                      1, false},
+    {GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS, 1, false},
+    {GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS,       1, false},
+    {GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS,    1, false},
+    {GL_NUM_PROGRAM_BINARY_FORMATS,                    1, false},
+};
+// clang-format on
+} // namespace
+
+bool egl_gl_limits_t::enabled()
+{
+    static bool enabled = utils::gen_env_option<bool>("EGL_GL_LIMITS_CACHE",
+                                                      {{"0", false}}, true);
+    return enabled;
+}
+
+void egl_gl_limits_t::load(const gl_t& gl)
+{
+    if (loaded() || !gl.glGetIntegerv || !gl.glGetError)
+        return;
+
+    // a context this new has no error of the app to lose; a lost one
+    // keeps returning one, and nothing is kept then
+    for (int i = 0; i < 8 && gl.glGetError() != GL_NO_ERROR; i++)
+        ;
+
+    for (const auto& info : limit_list)
+    {
+        limit_t limit{info.pname, info.count, {}};
+        if (info.wide)
+        {
+            if (!gl.glGetInteger64v)
+                continue;
+            gl.glGetInteger64v(info.pname, limit.values);
+        }
+        else
+        {
+            GLint values[2] = {};
+            gl.glGetIntegerv(info.pname, values);
+            limit.values[0] = values[0];
+            limit.values[1] = values[1];
+        }
+        // a limit of a version or extension the context does not have
+        if (gl.glGetError() != GL_NO_ERROR)
+            continue;
+        limits.push_back(limit);
+    }
+
+    std::sort(limits.begin(), limits.end(),
+              [](const limit_t& a, const limit_t& b) {
+                  return a.pname < b.pname;
+              });
+}
+
+const egl_gl_limits_t::limit_t* egl_gl_limits_t::find(GLenum pname) const
+{
+    auto it = std::lower_bound(
+        limits.begin(), limits.end(), pname,
+        [](const limit_t& limit, GLenum pname) { return limit.pname < pname; });
+    if (it == limits.end() || it->pname != pname)
+        return nullptr;
+    return &*it;
+}
+
+bool egl_gl_limits_t::get(GLenum pname, GLboolean* data) const
+{
+    auto limit = find(pname);
+    if (!limit)
+        return false;
+    for (GLint i = 0; i < limit->count; i++)
+        data[i] = limit->values[i] ? GL_TRUE : GL_FALSE;
+    return true;
+}
+
+bool egl_gl_limits_t::get(GLenum pname, GLint* data) const
+{
+    auto limit = find(pname);
+    if (!limit)
+        return false;
+    // as the driver does, a wider value is clamped
+    for (GLint i = 0; i < limit->count; i++)
+        data[i] = static_cast<GLint>(
+            std::clamp<GLint64>(limit->values[i], INT_MIN, INT_MAX));
+    return true;
+}
+
+bool egl_gl_limits_t::get(GLenum pname, GLint64* data) const
+{
+    auto limit = find(pname);
+    if (!limit)
+        return false;
+    for (GLint i = 0; i < limit->count; i++)
+        data[i] = limit->values[i];
+    return true;
+}
+
+bool egl_gl_limits_t::get(GLenum pname, GLfloat* data) const
+{
+    auto limit = find(pname);
+    if (!limit)
+        return false;
+    for (GLint i = 0; i < limit->count; i++)
+        data[i] = static_cast<GLfloat>(limit->values[i]);
+    return true;
+}
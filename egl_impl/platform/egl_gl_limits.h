@@ -0,0 +1,53 @@
+#ifndef EGL_GL_LIMITS_H_
+#define EGL_GL_LIMITS_H_
+
+#include "loader/hooks.h"
+
+#include <vector>
+
+// The implementation limits of a context, read from the driver at its
+// first eglMakeCurrent. glGet* of one of them is answered from here, as
+// some drivers flush their command stream on any glGet.
+//
+// Under EGL_GL_THREAD the driver thread keeps a copy, so the app thread
+// answers them without waiting for it.
+//
+// Only values no call can change are kept: sizes that depend on the bound
+// framebuffer, such as GL_RED_BITS or GL_SAMPLES, still go to the driver.
+//
+// EGL_GL_LIMITS_CACHE  0 to ask the driver every time
+class EGLAPI egl_gl_limits_t {
+  public:
+    using gl_t = egl_wrapper::gl_hooks_t::gl_t;
+
+    // EGL_GL_LIMITS_CACHE
+    static bool enabled();
+
+    // read the limits the context knows, once, with it current
+    void load(const gl_t& gl);
+    bool loaded() const
+    {
+        return !limits.empty();
+    }
+
+    // false when pname is not kept, the driver answers then
+    bool get(GLenum pname, GLboolean* data) const;
+    bool get(GLenum pname, GLint* data) const;
+    bool get(GLenum pname, GLint64* data) const;
+    bool get(GLenum pname, GLfloat* data) const;
+
+  private:
+    struct limit_t
+    {
+        GLenum pname;
+        GLint count;
+        GLint64 values[2];
+    };
+
+    const limit_t* find(GLenum pname) const;
+
+    // sorted by pname
+    std::vector<limit_t> limits;
+};
+
+#endif // EGL_GL_LIMITS_H_
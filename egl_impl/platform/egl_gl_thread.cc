@@ -0,0 +1,146 @@
+#include "egl_gl_thread.h"
+#include "egl_tls.h"
+#include "loader/loader.h"
+
+#include "utils.h"
+
+#include <stdlib.h>
+
+using namespace egl_wrapper;
+
+namespace {
+// checks before sleeping, a call often comes back sooner than a wakeup
+constexpr int spins = 2000;
+
+thread_local std::shared_ptr<egl_gl_thread_t> current_thread;
+} // namespace
+
+egl_gl_thread_t::egl_gl_thread_t()
+{
+    ring = static_cast<uint8_t*>(aligned_alloc(alignment, capacity));
+    thread = std::thread(&egl_gl_thread_t::run, this);
+}
+
+egl_gl_thread_t::~egl_gl_thread_t()
+{
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+    free(ring);
+}
+
+bool egl_gl_thread_t::enabled()
+{
+    static bool enabled =
+        utils::gen_env_option<bool>("EGL_GL_THREAD", {{"1", true}});
+    return enabled;
+}
+
+egl_gl_thread_t* egl_gl_thread_t::current()
+{
+    return current_thread.get();
+}
+
+void egl_gl_thread_t::set_current(std::shared_ptr<egl_gl_thread_t> thread)
+{
+    current_thread = std::move(thread);
+}
+
+void egl_gl_thread_t::finish()
+{
+    wait_for(head.load(std::memory_order_relaxed));
+}
+
+void* egl_gl_thread_t::reserve(size_t size)
+{
+    uint64_t position = head.load(std::memory_order_relaxed);
+    size_t offset = position % capacity;
+    if (offset + size > capacity)
+    {
+        // no room before the end, the rest of it is skipped
+        size_t skip = capacity - offset;
+        wait_for(position + skip + size - capacity);
+        auto wrap = reinterpret_cast<command*>(ring + offset);
+        wrap->run = nullptr;
+        wrap->size = skip;
+        commit(skip);
+        return ring;
+    }
+
+    if (position + size > capacity)
+        wait_for(position + size - capacity);
+    return ring + offset;
+}
+
+void egl_gl_thread_t::commit(size_t size)
+{
+    head.store(head.load(std::memory_order_relaxed) + size);
+    if (driver_idle.load())
+    {
+        std::lock_guard lock{mutex};
+        wake.notify_all();
+    }
+}
+
+void egl_gl_thread_t::wait_for(uint64_t position)
+{
+    for (int i = 0; i < spins; i++)
+    {
+        if (tail.load(std::memory_order_acquire) >= position)
+            return;
+    }
+
+    std::unique_lock lock{mutex};
+    app_waiting = true;
+    wake.wait(lock, [&] { return tail.load() >= position; });
+    app_waiting = false;
+}
+
+void egl_gl_thread_t::run()
+{
+    auto system = g_egl_system;
+    const auto& gl = system->hooks[egl_system_t::GLESv2_INDEX].gl;
+
+    uint64_t position = 0;
+    for (;;)
+    {
+        for (int i = 0; i < spins; i++)
+        {
+            if (head.load(std::memory_order_acquire) != position)
+                break;
+        }
+        if (head.load(std::memory_order_acquire) == position)
+        {
+            std::unique_lock lock{mutex};
+            driver_idle = true;
+            wake.wait(lock,
+                      [&] { return stopping || head.load() != position; });
+            driver_idle = false;
+            if (head.load() == position)
+                break;
+        }
+
+        auto next = reinterpret_cast<command*>(ring + position % capacity);
+        size_t size = next->size;
+        if (next->run)
+            next->run(next, gl);
+        position += size;
+        tail.store(position);
+        if (app_waiting.load())
+        {
+            std::lock_guard lock{mutex};
+            wake.notify_all();
+        }
+    }
+
+    // the context goes with the thread
+    if (auto& current = egl_tls_t::getCurrent(); current.ctx)
+    {
+        system->egl.eglMakeCurrent(current.dpy, EGL_NO_SURFACE,
+                                   EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    egl_tls_t::clearTLS();
+}
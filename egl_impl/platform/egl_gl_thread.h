@@ -0,0 +1,265 @@
+#ifndef EGL_GL_THREAD_H_
+#define EGL_GL_THREAD_H_
+
+#include "egl_gl_limits.h"
+#include "loader/hooks.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// The GLES calls of a context run on a thread of its own, as Mesa's
+// glthread does: the app thread writes them into a ring and goes on while
+// the driver thread, which has the context bound, runs them.
+//
+// A call that returns something, or reads the app's memory without a
+// known size, waits until the ring ran up to it and it ran. So does every
+// EGL call on the bound context, binding and swapping included, so the
+// driver sees the calls in the order the app made them.
+//
+// One per GLES2 context, made with it.
+//
+// EGL_GL_THREAD  1 to run the calls of GLES2 contexts on a driver thread
+class EGLAPI egl_gl_thread_t {
+  public:
+    using gl_t = egl_wrapper::gl_hooks_t::gl_t;
+
+    // which vertex arrays a draw reads from the app's memory, kept on the
+    // app thread by the calls that change it
+    class vertex_arrays_t {
+      public:
+        void bind_buffer(GLenum target, GLuint buffer)
+        {
+            if (target == GL_ARRAY_BUFFER)
+                array_buffer = buffer;
+            else if (target == GL_ELEMENT_ARRAY_BUFFER)
+                vao().element_buffer = buffer;
+        }
+        void bind_vertex_array(GLuint array)
+        {
+            bound = array;
+            current = nullptr;
+        }
+        void attrib_pointer(GLuint index, const void* pointer)
+        {
+            auto& state = vao();
+            if (index >= max_attribs)
+            {
+                state.client = ~0u;
+                return;
+            }
+            state.buffers[index] = array_buffer;
+            if (!array_buffer && pointer)
+                state.client |= 1u << index;
+            else
+                state.client &= ~(1u << index);
+        }
+        // a deleted buffer is unbound, and the arrays of the bound VAO
+        // that used it read the app's memory from then on
+        void delete_buffers(GLsizei n, const GLuint* buffers)
+        {
+            auto& state = vao();
+            for (GLsizei i = 0; buffers && i < n; i++)
+            {
+                if (!buffers[i])
+                    continue;
+                if (array_buffer == buffers[i])
+                    array_buffer = 0;
+                if (state.element_buffer == buffers[i])
+                    state.element_buffer = 0;
+                for (GLuint index = 0; index < max_attribs; index++)
+                {
+                    if (state.buffers[index] == buffers[i])
+                    {
+                        state.buffers[index] = 0;
+                        state.client |= 1u << index;
+                    }
+                }
+            }
+        }
+        void delete_vertex_arrays(GLsizei n, const GLuint* arrays)
+        {
+            for (GLsizei i = 0; arrays && i < n; i++)
+            {
+                if (!arrays[i])
+                    continue;
+                if (bound == arrays[i])
+                    bound = 0;
+                vaos.erase(arrays[i]);
+            }
+            current = nullptr;
+        }
+        // a draw reads vertices, or indices when indexed, of the app
+        bool reads_client(bool indexed)
+        {
+            auto& state = vao();
+            return state.client || (indexed && !state.element_buffer);
+        }
+
+      private:
+        static constexpr GLuint max_attribs = 32;
+
+        struct vao_state
+        {
+            uint32_t client = 0;
+            GLuint element_buffer = 0;
+            GLuint buffers[max_attribs] = {};
+        };
+
+        vao_state& vao()
+        {
+            if (!current)
+                current = &vaos[bound];
+            return *current;
+        }
+
+        GLuint array_buffer = 0;
+        GLuint bound = 0;
+        vao_state* current = nullptr;
+        std::unordered_map<GLuint, vao_state> vaos;
+    };
+
+    egl_gl_thread_t();
+    ~egl_gl_thread_t();
+
+    // EGL_GL_THREAD
+    static bool enabled();
+    // the one running the calls of the context bound on this thread, null
+    // when they run on this thread
+    static egl_gl_thread_t* current();
+    static void set_current(std::shared_ptr<egl_gl_thread_t> thread);
+
+    // a context is bound on one app thread at a time, false if it is
+    // bound on another
+    bool bind()
+    {
+        return !bound.exchange(true);
+    }
+    void unbind()
+    {
+        bound = false;
+    }
+
+    // run f(gl) on the driver thread
+    template <typename F>
+    void post(F&& f);
+    // run f(gl, copy) on the driver thread with a copy of size bytes at
+    // data, false when they do not fit in the ring
+    template <typename F>
+    bool post(const void* data, size_t size, F&& f);
+    // run f(gl) on the driver thread and return what it returns
+    template <typename F>
+    auto call(F&& f);
+    // wait until everything posted ran
+    void finish();
+
+    vertex_arrays_t vertex_arrays;
+    // of the context, copied once it bound there, for the app thread
+    egl_gl_limits_t limits;
+
+    egl_gl_thread_t(const egl_gl_thread_t&) = delete;
+    egl_gl_thread_t& operator=(const egl_gl_thread_t&) = delete;
+
+  private:
+    struct command
+    {
+        // runs and destroys the record, null to go on at the ring's start
+        void (*run)(command* self, const gl_t& gl);
+        size_t size;
+    };
+
+    template <typename F>
+    struct record
+    {
+        command header;
+        F f;
+
+        static void run(command* self, const gl_t& gl)
+        {
+            auto r = reinterpret_cast<record*>(self);
+            r->f(gl, static_cast<const void*>(r + 1));
+            r->~record();
+        }
+    };
+
+    // room for size bytes at the head, once the driver thread made it
+    void* reserve(size_t size);
+    void commit(size_t size);
+    // until the driver thread ran up to position
+    void wait_for(uint64_t position);
+    void run();
+
+    static constexpr size_t capacity = 1 << 20;
+    static constexpr size_t alignment = 16;
+
+    uint8_t* ring = nullptr;
+    // bytes written and bytes run so far
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> driver_idle{false};
+    std::atomic<bool> app_waiting{false};
+    bool stopping = false;
+
+    std::atomic<bool> bound{false};
+    std::thread thread;
+};
+
+template <typename F>
+void egl_gl_thread_t::post(F&& f)
+{
+    post(nullptr, 0,
+         [f = std::forward<F>(f)](const gl_t& gl, const void*) { f(gl); });
+}
+
+template <typename F>
+bool egl_gl_thread_t::post(const void* data, size_t size, F&& f)
+{
+    using record_t = record<std::decay_t<F>>;
+    static_assert(alignof(record_t) <= alignment);
+
+    if (size > capacity / 4)
+        return false;
+    size_t total = (sizeof(record_t) + size + alignment - 1) & ~(alignment - 1);
+    if (total > capacity / 4)
+        return false;
+
+    auto r = new (reserve(total))
+        record_t{{&record_t::run, total}, std::forward<F>(f)};
+    if (size)
+        memcpy(static_cast<void*>(r + 1), data, size);
+    commit(total);
+    return true;
+}
+
+template <typename F>
+auto egl_gl_thread_t::call(F&& f)
+{
+    using result_t = decltype(f(std::declval<const gl_t&>()));
+    if constexpr (std::is_void_v<result_t>)
+    {
+        post([&f](const gl_t& gl) { f(gl); });
+        finish();
+    }
+    else
+    {
+        result_t result{};
+        post([&f, &result](const gl_t& gl) { result = f(gl); });
+        finish();
+        return result;
+    }
+}
+
+#endif // EGL_GL_THREAD_H_
@@ -1,6 +1,7 @@
 #include "loader/loader.h"
 #include "egl_object.h"
 #include "egl_tls.h"
+#include "egl_cache.h"
 
 #include "platform/platform.h"
 
@@ -46,7 +47,7 @@ EGLDisplay egl_display_t::getFromNativeDisplay(EGLenum platform,
                        << std::showbase << std::hex << platform;
 
     std::lock_guard lock{mutex};
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (g_dpy)
     {
         if (disp == g_dpy->ndpy)
@@ -128,13 +129,23 @@ EGLBoolean egl_display_t::initialize(EGLint* major, EGLint* minor)
     }
     platform_initialized = true;
 
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if ((rval = system->egl.eglInitialize(dpy, &this->major, &this->minor)))
     {
         if (major)
             *major = this->major;
         if (minor)
             *minor = this->minor;
+
+        if (!configs.loaded() && utils::gen_env_option<bool>(
+                                     "EGL_CONFIG_CACHE", {{"0", false}}, true))
+        {
+            configs.load(dpy);
+            if (platform_wrapper)
+                platform_wrapper->adjust_configs(configs);
+        }
+        configs.publish(true);
+        egl_cache_t::get().initialize(dpy);
     }
     else
     {
@@ -149,7 +160,7 @@ EGLBoolean egl_display_t::initialize(EGLint* major, EGLint* minor)
 EGLBoolean egl_display_t::terminate(EGLDisplay dpy)
 {
     std::lock_guard lock{mutex};
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (g_dpy && g_dpy->dpy == dpy)
     {
         if (g_dpy->platform_wrapper && g_dpy->platform_initialized)
@@ -157,6 +168,8 @@ EGLBoolean egl_display_t::terminate(EGLDisplay dpy)
             g_dpy->platform_wrapper->terminate();
         }
         g_dpy->platform_initialized = false;
+        g_dpy->configs.publish(false);
+        egl_tls_t::invalidateCurrent();
 
         logger::log_info() << "call native eglTerminate";
         return system->egl.eglTerminate(dpy);
@@ -179,7 +192,7 @@ EGLContext egl_context_t::createNativeContext(EGLDisplay dpy, EGLConfig config,
                                               const EGLint* attrib_list)
 {
     std::lock_guard lock{mutex};
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     auto context =
         system->egl.eglCreateContext(dpy, config, share_list, attrib_list);
     if (!context)
@@ -188,7 +201,22 @@ EGLContext egl_context_t::createNativeContext(EGLDisplay dpy, EGLConfig config,
     auto uctx = std::make_unique<egl_context_t>();
     uctx->display = dpy;
     uctx->ctx = context;
+    uctx->config = config;
     uctx->version = egl_system_t::GLESv1_INDEX;
+    uctx->client_version = 1;
+    egl_state_filter_t::share_group_t share_group;
+    if (auto iter = g_ctx_map.find(share_list); iter != g_ctx_map.end())
+    {
+        uctx->programs = iter->second->programs;
+        uctx->compiler = iter->second->compiler;
+        if (iter->second->state_filter)
+            share_group = iter->second->state_filter->share_group();
+    }
+    else
+    {
+        uctx->programs = std::make_shared<egl_program_cache_t>();
+        uctx->compiler = std::make_shared<egl_compile_pool_t>();
+    }
     if (attrib_list)
     {
         while (*attrib_list != EGL_NONE)
@@ -197,6 +225,7 @@ EGLContext egl_context_t::createNativeContext(EGLDisplay dpy, EGLConfig config,
             EGLint value = *attrib_list++;
             if (attr == EGL_CONTEXT_CLIENT_VERSION)
             {
+                uctx->client_version = value;
                 if (value == 1)
                 {
                     uctx->version = egl_system_t::GLESv1_INDEX;
@@ -208,6 +237,25 @@ EGLContext egl_context_t::createNativeContext(EGLDisplay dpy, EGLConfig config,
             }
         }
     }
+    if (uctx->version == egl_system_t::GLESv2_INDEX &&
+        egl_gl_thread_t::enabled())
+    {
+        uctx->gl_thread = std::make_shared<egl_gl_thread_t>();
+        system->gl_threaded = true;
+    }
+    if (uctx->version == egl_system_t::GLESv2_INDEX &&
+        egl_vertex_stream_t::enabled())
+    {
+        uctx->vertex_stream = std::make_unique<egl_vertex_stream_t>();
+        system->vertex_streamed = true;
+    }
+    if (uctx->version == egl_system_t::GLESv2_INDEX &&
+        egl_state_filter_t::enabled())
+    {
+        uctx->state_filter =
+            std::make_unique<egl_state_filter_t>(std::move(share_group));
+        system->state_filtered = true;
+    }
     g_ctx_map.insert({context, std::move(uctx)});
     return context;
 }
@@ -215,11 +263,13 @@ EGLContext egl_context_t::createNativeContext(EGLDisplay dpy, EGLConfig config,
 EGLBoolean egl_context_t::destroy(EGLDisplay dpy, EGLContext ctx)
 {
     std::lock_guard lock{mutex};
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
 
     EGLBoolean rval = EGL_FALSE;
     if (auto iter = g_ctx_map.find(ctx); iter != g_ctx_map.end())
     {
+        // before the handle dies, so no thread can skip a check on it
+        egl_tls_t::invalidateCurrent();
         if ((rval = system->egl.eglDestroyContext(dpy, ctx)) == EGL_TRUE)
         {
             g_ctx_map.erase(iter);
@@ -230,12 +280,22 @@ EGLBoolean egl_context_t::destroy(EGLDisplay dpy, EGLContext ctx)
 
 void egl_context_t::makeCurrent(EGLSurface draw, EGLSurface read)
 {
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (gl_extensions.empty())
     {
         gl_extensions =
             (const char*)system->hooks[version].gl.glGetString(GL_EXTENSIONS);
 
+        if (version == egl_system_t::GLESv2_INDEX)
+        {
+            compiler->probe(display, config, ctx, client_version);
+            if (compiler->enabled())
+            {
+                gl_extensions += " GL_KHR_parallel_shader_compile";
+                system->shaders_compiled = true;
+            }
+        }
+
         if (size_t pos = 0;
             (pos = gl_extensions.find("GL_EXT_read_format_bgra")) !=
             gl_extensions.npos)
@@ -320,5 +380,15 @@ void egl_context_t::makeCurrent(EGLSurface draw, EGLSurface read)
         {
             tokenized_gl_extensions.push_back(str);
         }
+
+        if (version == egl_system_t::GLESv2_INDEX &&
+            egl_gl_limits_t::enabled())
+            limits.load(system->hooks[version].gl);
     }
+
+    if (version == egl_system_t::GLESv2_INDEX)
+        programs->probe(system->hooks[version].gl);
+    // the checks above bind objects of their own
+    if (state_filter)
+        state_filter->invalidate();
 }
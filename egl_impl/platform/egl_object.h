@@ -2,9 +2,17 @@
 #define ANDROID_EGL_DISPLAY_H
 
 #include <EGL/egl.h>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "egl_compile_pool.h"
+#include "egl_config.h"
+#include "egl_gl_limits.h"
+#include "egl_gl_thread.h"
+#include "egl_program_cache.h"
+#include "egl_state_filter.h"
+#include "egl_vertex_stream.h"
 #include "platform/platform.h"
 
 class egl_object_t {
@@ -20,6 +28,7 @@ class egl_display_t {
     EGLint minor;
 
     bool platform_initialized;
+    egl_config_table_t configs;
 
     std::unique_ptr<platform_wrapper_t> platform_wrapper;
     struct server_wlegl* wlegl_global;
@@ -41,10 +50,28 @@ class egl_context_t : public egl_object_t {
   public:
     EGLDisplay display;
     EGLContext ctx;
+    EGLConfig config;
 
     EGLint version;
+    EGLint client_version;
     std::string gl_extensions;
     std::vector<std::string> tokenized_gl_extensions;
+    // read at the first eglMakeCurrent
+    egl_gl_limits_t limits;
+    // shared with the contexts of the share group
+    std::shared_ptr<egl_program_cache_t> programs;
+    std::shared_ptr<egl_compile_pool_t> compiler;
+    // the program glUseProgram bound, and whether it is linked again on a
+    // worker, for the next draw or glUniform* to wait for and bind again
+    GLuint used_program = 0;
+    bool relinked = false;
+    // runs its GL calls when EGL_GL_THREAD is set, held by the app thread
+    // it is bound on as well
+    std::shared_ptr<egl_gl_thread_t> gl_thread;
+    // copies client vertex arrays into buffers when EGL_VERTEX_STREAM is set
+    std::unique_ptr<egl_vertex_stream_t> vertex_stream;
+    // drops state calls that change nothing when EGL_STATE_FILTER is set
+    std::unique_ptr<egl_state_filter_t> state_filter;
 
     egl_context_t() = default;
     ~egl_context_t() = default;
@@ -20,15 +20,20 @@
 #include "egl_platform_entries.h"
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <EGL/eglext_wlegl.h>
 
 #include <dlfcn.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <string>
 #include <unordered_map>
 
+#include "egl_compile_pool.h"
+#include "egl_gl_thread.h"
 #include "egl_object.h"
+#include "egl_program_cache.h"
 #include "egl_tls.h"
 #include "loader/loader.h"
 
@@ -64,6 +69,8 @@ const char* const gClientExtensionString =
 // clang-format on
 
 __eglMustCastToProperFunctionPointerType findProcAddress(const char* name);
+__eglMustCastToProperFunctionPointerType findWrappedProcAddress(
+    const char* name);
 
 // Note: This only works for existing GLenum's that are all 32bits.
 // If you have 64bit attributes (e.g. pointers) you shouldn't be calling this.
@@ -100,6 +107,31 @@ inline void clearError()
 
 auto setGLHooksThreadSpecific = setGlThreadSpecific;
 
+EGLint eglGetErrorImpl(void);
+
+namespace {
+// runs f on the driver thread after the GL calls before it, and brings its
+// error back to the app thread
+template <typename F>
+auto onGlThread(egl_gl_thread_t* thread, F&& f)
+{
+    EGLint error = EGL_SUCCESS;
+    auto rval = thread->call([&](const gl_hooks_t::gl_t&) {
+        auto result = f();
+        error = eglGetErrorImpl();
+        return result;
+    });
+    if (error != EGL_SUCCESS)
+        egl_tls_t::setErrorImpl(error);
+    return rval;
+}
+} // namespace
+
+// an EGL call on the bound context runs where its GL calls run
+#define RUN_ON_GL_THREAD(_impl, ...)                                           \
+    if (auto thread = egl_gl_thread_t::current())                              \
+        return onGlThread(thread, [&] { return _impl(__VA_ARGS__); });
+
 namespace {
     std::mutex mutex{};
     std::unordered_map<EGLSurface, ANativeWindow*> g_surface_window_map{};
@@ -179,7 +211,15 @@ EGLBoolean eglGetConfigsImpl(EGLDisplay dpy, EGLConfig* configs,
                              EGLint config_size, EGLint* num_config)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    egl_display_t* dp = get_display(dpy);
+    if (dp && dp->configs.usable() && num_config)
+    {
+        dp->configs.get_configs(configs, config_size, num_config);
+        egl_tls_t::skipDriver();
+        return EGL_TRUE;
+    }
+
+    auto system = g_egl_system;
     return system->egl.eglGetConfigs(dpy, configs, config_size, num_config);
 }
 
@@ -188,7 +228,15 @@ EGLBoolean eglChooseConfigImpl(EGLDisplay dpy, const EGLint* attrib_list,
                                EGLint* num_config)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    egl_display_t* dp = get_display(dpy);
+    if (dp && dp->configs.usable() && num_config &&
+        dp->configs.choose(attrib_list, configs, config_size, num_config))
+    {
+        egl_tls_t::skipDriver();
+        return EGL_TRUE;
+    }
+
+    auto system = g_egl_system;
     return system->egl.eglChooseConfig(dpy, attrib_list, configs, config_size,
                                        num_config);
 }
@@ -197,7 +245,15 @@ EGLBoolean eglGetConfigAttribImpl(EGLDisplay dpy, EGLConfig config,
                                   EGLint attribute, EGLint* value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    egl_display_t* dp = get_display(dpy);
+    if (dp && dp->configs.usable() && value &&
+        dp->configs.get_attrib(config, attribute, value))
+    {
+        egl_tls_t::skipDriver();
+        return EGL_TRUE;
+    }
+
+    auto system = g_egl_system;
     return system->egl.eglGetConfigAttrib(dpy, config, attribute, value);
 }
 
@@ -243,7 +299,7 @@ EGLSurface eglCreateWindowSurfaceImpl(EGLDisplay dpy, EGLConfig config,
                                       const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     egl_display_t* dp = get_display(dpy);
     if (!dp)
         return setError(EGL_BAD_DISPLAY, EGL_NO_SURFACE);
@@ -257,7 +313,7 @@ EGLSurface eglCreatePlatformWindowSurfaceImpl(EGLDisplay dpy, EGLConfig config,
                                               const EGLAttrib* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     egl_display_t* dp = get_display(dpy);
     if (!dp)
         return setError(EGL_BAD_DISPLAY, EGL_NO_SURFACE);
@@ -290,7 +346,7 @@ EGLSurface eglCreatePlatformPixmapSurfaceImpl(EGLDisplay dpy, EGLConfig config,
                                               const EGLAttrib* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return system->egl.eglCreatePlatformPixmapSurface(
         dpy, config, native_pixmap, attrib_list);
 }
@@ -300,7 +356,7 @@ EGLSurface eglCreatePixmapSurfaceImpl(EGLDisplay dpy, EGLConfig config,
                                       const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return system->egl.eglCreatePixmapSurface(dpy, config, pixmap, attrib_list);
 }
 
@@ -308,7 +364,7 @@ EGLSurface eglCreatePbufferSurfaceImpl(EGLDisplay dpy, EGLConfig config,
                                        const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return system->egl.eglCreatePbufferSurface(dpy, config, attrib_list);
 }
 
@@ -318,7 +374,7 @@ EGLSurface eglCreatePlatformWindowSurfaceEXTImpl(EGLDisplay dpy,
                                                  const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     egl_display_t* dp = get_display(dpy);
     if (!dp)
         return setError(EGL_BAD_DISPLAY, EGL_NO_SURFACE);
@@ -351,11 +407,13 @@ EGLSurface eglCreatePlatformWindowSurfaceEXTImpl(EGLDisplay dpy,
 EGLBoolean eglDestroySurfaceImpl(EGLDisplay dpy, EGLSurface surface)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     egl_display_t* dp = get_display(dpy);
     if (!dp)
         return setError(EGL_BAD_DISPLAY, EGL_FALSE);
 
+    // before the handle dies, so no thread can skip a check on it
+    egl_tls_t::invalidateCurrent();
     EGLBoolean rval = system->egl.eglDestroySurface(dpy, surface);
     if (rval == EGL_TRUE)
     {
@@ -379,7 +437,7 @@ EGLBoolean eglQuerySurfaceImpl(EGLDisplay dpy, EGLSurface surface,
                                EGLint attribute, EGLint* value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
 
     return system->egl.eglQuerySurface(dpy, surface, attribute, value);
 }
@@ -403,10 +461,113 @@ EGLBoolean eglDestroyContextImpl(EGLDisplay dpy, EGLContext ctx)
     return egl_context_t::destroy(dpy, ctx);
 }
 
+namespace {
+// binds ctx on the calling thread, or releases with EGL_NO_CONTEXT
+EGLBoolean bindContext(EGLDisplay dpy, EGLSurface draw, EGLSurface read,
+                       EGLContext ctx, egl_context_t* ctx_wrap,
+                       uint64_t generation)
+{
+    auto system = g_egl_system;
+    auto& current = egl_tls_t::getCurrent();
+    EGLBoolean rval = system->egl.eglMakeCurrent(dpy, draw, read, ctx);
+    if (rval == EGL_TRUE)
+    {
+        if (ctx)
+        {
+            ctx_wrap->makeCurrent(draw, read);
+            setGLHooksThreadSpecific(&system->hooks[ctx_wrap->version]);
+            current = {dpy, draw, read, ctx, generation};
+        }
+        else
+        {
+            current = {};
+        }
+    }
+    return rval;
+}
+
+// a context with a driver thread is bound there, the app thread only
+// records it; what was bound before is released first, as it may hold the
+// same surfaces, so nothing is bound after a failure
+EGLBoolean bindThreadedContext(EGLDisplay dpy, EGLSurface draw,
+                               EGLSurface read, EGLContext ctx,
+                               egl_context_t* ctx_wrap, uint64_t generation)
+{
+    auto system = g_egl_system;
+    auto& current = egl_tls_t::getCurrent();
+    auto old_thread = egl_gl_thread_t::current();
+    auto new_thread = ctx_wrap ? ctx_wrap->gl_thread : nullptr;
+    bool same_thread = new_thread && new_thread.get() == old_thread;
+    if (new_thread && !same_thread && !new_thread->bind())
+        return setError(EGL_BAD_ACCESS, EGL_FALSE);
+
+    if (old_thread && !same_thread)
+    {
+        EGLDisplay old_dpy = current.dpy;
+        old_thread->call([&](const gl_hooks_t::gl_t&) {
+            bindContext(old_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        EGL_NO_CONTEXT, nullptr, 0);
+        });
+        old_thread->unbind();
+        egl_gl_thread_t::set_current(nullptr);
+        current = {};
+    }
+    else if (!old_thread && current.ctx)
+    {
+        bindContext(current.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                    EGL_NO_CONTEXT, nullptr, 0);
+    }
+
+    if (!new_thread)
+    {
+        if (!ctx)
+            return EGL_TRUE;
+        return bindContext(dpy, draw, read, ctx, ctx_wrap, generation);
+    }
+
+    EGLint error = EGL_SUCCESS;
+    EGLBoolean rval = new_thread->call([&](const gl_hooks_t::gl_t&) {
+        EGLBoolean bound =
+            bindContext(dpy, draw, read, ctx, ctx_wrap, generation);
+        if (bound != EGL_TRUE)
+            error = system->egl.eglGetError();
+        return bound;
+    });
+    if (rval != EGL_TRUE)
+    {
+        // the driver keeps a binding it did not replace
+        if (!same_thread)
+            new_thread->unbind();
+        return setError(error, EGL_FALSE);
+    }
+
+    // read at the first bind, and not changed after
+    if (!new_thread->limits.loaded())
+        new_thread->limits = ctx_wrap->limits;
+    egl_gl_thread_t::set_current(std::move(new_thread));
+    setGLHooksThreadSpecific(&system->hooks[ctx_wrap->version]);
+    current = {dpy, draw, read, ctx, generation};
+    return EGL_TRUE;
+}
+} // namespace
+
 EGLBoolean eglMakeCurrentImpl(EGLDisplay dpy, EGLSurface draw, EGLSurface read,
                               EGLContext ctx)
 {
     clearError();
+    auto& current = egl_tls_t::getCurrent();
+    uint64_t generation =
+        egl_tls_t::generation.load(std::memory_order_acquire);
+    // toolkits rebind the same context around every operation; nothing
+    // bound since was destroyed, so the driver would only say yes again
+    if (ctx != EGL_NO_CONTEXT && ctx == current.ctx && draw == current.draw &&
+        read == current.read && dpy == current.dpy &&
+        generation == current.generation) [[likely]]
+    {
+        egl_tls_t::skipDriver();
+        return EGL_TRUE;
+    }
+
     if (!egl_display_t::get(dpy))
         return setError(EGL_BAD_DISPLAY, EGL_FALSE);
 
@@ -418,59 +579,65 @@ EGLBoolean eglMakeCurrentImpl(EGLDisplay dpy, EGLSurface draw, EGLSurface read,
             return setError(EGL_BAD_CONTEXT, EGL_FALSE);
     }
 
-    auto system = egl_system_t::loader::getInstance().system;
-    EGLBoolean rval = system->egl.eglMakeCurrent(dpy, draw, read, ctx);
-    if (rval == EGL_TRUE)
-    {
-        if (ctx)
-        {
-            ctx_wrap->makeCurrent(draw, read);
-            setGLHooksThreadSpecific(&system->hooks[ctx_wrap->version]);
-        }
-    }
-    return rval;
+    if (egl_gl_thread_t::current() || (ctx_wrap && ctx_wrap->gl_thread))
+        return bindThreadedContext(dpy, draw, read, ctx, ctx_wrap,
+                                   generation);
+    return bindContext(dpy, draw, read, ctx, ctx_wrap, generation);
 }
 
 EGLBoolean eglQueryContextImpl(EGLDisplay dpy, EGLContext ctx, EGLint attribute,
                                EGLint* value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return system->egl.eglQueryContext(dpy, ctx, attribute, value);
 }
 
+// every binding goes through eglMakeCurrentImpl, which records it; a
+// context destroyed while current stays current until released
 EGLContext eglGetCurrentContextImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
-    return system->egl.eglGetCurrentContext();
+    egl_tls_t::skipDriver();
+    return egl_tls_t::getCurrent().ctx;
 }
 
 EGLSurface eglGetCurrentSurfaceImpl(EGLint readdraw)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
-    return system->egl.eglGetCurrentSurface(readdraw);
+    egl_tls_t::skipDriver();
+    const auto& current = egl_tls_t::getCurrent();
+    switch (readdraw)
+    {
+    case EGL_DRAW:
+        return current.draw;
+    case EGL_READ:
+        return current.read;
+    default:
+        return setError(EGL_BAD_PARAMETER, EGL_NO_SURFACE);
+    }
 }
 
 EGLDisplay eglGetCurrentDisplayImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
-    return system->egl.eglGetCurrentDisplay();
+    egl_tls_t::skipDriver();
+    return egl_tls_t::getCurrent().dpy;
 }
 
 EGLBoolean eglWaitGLImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglWaitGLImpl);
+    auto system = g_egl_system;
     return system->egl.eglWaitGL();
 }
 
 EGLBoolean eglWaitNativeImpl(EGLint engine)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglWaitNativeImpl, engine);
+    auto system = g_egl_system;
 
     return system->egl.eglWaitNative(engine);
 }
@@ -478,8 +645,11 @@ EGLBoolean eglWaitNativeImpl(EGLint engine)
 EGLint eglGetErrorImpl(void)
 {
     EGLint err = EGL_SUCCESS;
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     err = system->egl.eglGetError();
+    // the last call never reached the driver, its error is older
+    if (egl_tls_t::driverSkipped())
+        err = EGL_SUCCESS;
     if (err == EGL_SUCCESS)
     {
         err = egl_tls_t::getError();
@@ -492,11 +662,20 @@ eglGetProcAddressImpl(const char* procname)
 {
     clearError();
     __eglMustCastToProperFunctionPointerType addr;
+    auto system = g_egl_system;
+    // what the driver returns runs where it is called and past the state
+    // the wrapper keeps, the app's calls need to go through libGLESv2;
+    // asked before any context is made, as apps load their pointers first
+    if (strncmp(procname, "gl", 2) == 0 &&
+        (egl_gl_thread_t::enabled() || egl_vertex_stream_t::enabled() ||
+         egl_state_filter_t::enabled()) &&
+        (addr = findWrappedProcAddress(procname)))
+        return addr;
+
     addr = findProcAddress(procname);
     if (addr)
         return addr;
 
-    auto system = egl_system_t::loader::getInstance().system;
     if (system->egl.eglGetProcAddress)
         addr = system->egl.eglGetProcAddress(procname);
 
@@ -507,7 +686,9 @@ EGLBoolean eglSwapBuffersWithDamageKHRImpl(EGLDisplay dpy, EGLSurface draw,
                                            const EGLint* rects, EGLint n_rects)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglSwapBuffersWithDamageKHRImpl, dpy, draw, rects,
+                     n_rects);
+    auto system = g_egl_system;
     EGLBoolean rval = EGL_TRUE;
     egl_display_t* dp = get_display(dpy);
     if (!dp)
@@ -566,7 +747,8 @@ EGLBoolean eglCopyBuffersImpl(EGLDisplay dpy, EGLSurface surface,
                               NativePixmapType target)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglCopyBuffersImpl, dpy, surface, target);
+    auto system = g_egl_system;
 
     return system->egl.eglCopyBuffers(dpy, surface, target);
 }
@@ -575,7 +757,7 @@ const char* eglQueryStringImpl(EGLDisplay dpy, EGLint name)
 {
     clearError();
     static std::string extensions;
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (dpy == EGL_NO_DISPLAY && name == EGL_EXTENSIONS)
     {
         // Return list of client extensions
@@ -589,6 +771,7 @@ const char* eglQueryStringImpl(EGLDisplay dpy, EGLint name)
     if (name == EGL_EXTENSIONS)
     {
         extensions += " EGL_WL_bind_wayland_display";
+        extensions += " EGL_WLEGL_query_wayland_buffer";
     }
 
     return extensions.c_str();
@@ -602,7 +785,7 @@ EGLBoolean eglSurfaceAttribImpl(EGLDisplay dpy, EGLSurface surface,
                                 EGLint attribute, EGLint value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
 
     return system->egl.eglSurfaceAttrib(dpy, surface, attribute, value);
 }
@@ -611,7 +794,8 @@ EGLBoolean eglBindTexImageImpl(EGLDisplay dpy, EGLSurface surface,
                                EGLint buffer)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglBindTexImageImpl, dpy, surface, buffer);
+    auto system = g_egl_system;
 
     return system->egl.eglBindTexImage(dpy, surface, buffer);
 }
@@ -620,7 +804,8 @@ EGLBoolean eglReleaseTexImageImpl(EGLDisplay dpy, EGLSurface surface,
                                   EGLint buffer)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglReleaseTexImageImpl, dpy, surface, buffer);
+    auto system = g_egl_system;
 
     return system->egl.eglReleaseTexImage(dpy, surface, buffer);
 }
@@ -628,7 +813,8 @@ EGLBoolean eglReleaseTexImageImpl(EGLDisplay dpy, EGLSurface surface,
 EGLBoolean eglSwapIntervalImpl(EGLDisplay dpy, EGLint interval)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglSwapIntervalImpl, dpy, interval);
+    auto system = g_egl_system;
 
     return system->egl.eglSwapInterval(dpy, interval);
 }
@@ -640,7 +826,8 @@ EGLBoolean eglSwapIntervalImpl(EGLDisplay dpy, EGLint interval)
 EGLBoolean eglWaitClientImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglWaitClientImpl);
+    auto system = g_egl_system;
 
     EGLBoolean res;
     if (system->egl.eglWaitClient)
@@ -659,7 +846,7 @@ EGLBoolean eglBindAPIImpl(EGLenum api)
     clearError();
     // bind this API on all EGLs
     EGLBoolean res = EGL_TRUE;
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglBindAPI)
     {
         res = system->egl.eglBindAPI(api);
@@ -670,7 +857,7 @@ EGLBoolean eglBindAPIImpl(EGLenum api)
 EGLenum eglQueryAPIImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglQueryAPI)
     {
         return system->egl.eglQueryAPI();
@@ -683,7 +870,12 @@ EGLenum eglQueryAPIImpl(void)
 EGLBoolean eglReleaseThreadImpl(void)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
+    if (egl_gl_thread_t::current())
+    {
+        eglMakeCurrentImpl(egl_tls_t::getCurrent().dpy, EGL_NO_SURFACE,
+                           EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
     if (system->egl.eglReleaseThread)
     {
         system->egl.eglReleaseThread();
@@ -699,7 +891,7 @@ EGLSurface eglCreatePbufferFromClientBufferImpl(EGLDisplay dpy, EGLenum buftype,
                                                 const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglCreatePbufferFromClientBuffer)
     {
         return system->egl.eglCreatePbufferFromClientBuffer(
@@ -776,10 +968,83 @@ EGLBoolean eglQueryWaylandBufferWLImpl(EGLDisplay dpy,
     case EGL_HEIGHT:
         *value = native_buffer->height;
         return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_USAGE_WLEGL:
+        *value = static_cast<EGLint>(native_buffer->usage);
+        return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_USAGE_HI_WLEGL:
+        *value = static_cast<EGLint>(native_buffer->usage >> 32);
+        return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_STRIDE_WLEGL:
+        *value = native_buffer->stride;
+        return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_ANDROID_FORMAT_WLEGL:
+        *value = native_buffer->format;
+        return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_OPAQUE_WLEGL:
+        // formats without an alpha channel, the compositor can skip blending
+        switch (native_buffer->format)
+        {
+        case AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM:
+        case AHARDWAREBUFFER_FORMAT_R8G8B8_UNORM:
+        case AHARDWAREBUFFER_FORMAT_R5G6B5_UNORM:
+        case AHARDWAREBUFFER_FORMAT_Y8Cb8Cr8_420:
+            *value = EGL_TRUE;
+            break;
+        default:
+            *value = EGL_FALSE;
+            break;
+        }
+        return EGL_TRUE;
+    case EGL_WAYLAND_BUFFER_CPU_ACCESS_WLEGL:
+        *value = (native_buffer->usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                                          AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK))
+                     ? EGL_TRUE
+                     : EGL_FALSE;
+        return EGL_TRUE;
     }
     return EGL_FALSE;
 }
 
+EGLBoolean eglGetWaylandBufferNativeHandleWLEGLImpl(EGLDisplay dpy,
+                                                    struct wl_resource* buffer,
+                                                    const native_handle_t** handle)
+{
+    clearError();
+    egl_display_t* dp = get_display(dpy);
+    if (!dp)
+        return setError(EGL_BAD_DISPLAY, EGL_FALSE);
+
+    auto gralloc_buffer = get_gralloc_buffer_from_resource(buffer);
+    if (!gralloc_buffer || !handle)
+        return setError(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    *handle = gralloc_buffer->handle;
+    return EGL_TRUE;
+}
+
+EGLBoolean
+eglGetWaylandBufferHardwareBufferWLEGLImpl(EGLDisplay dpy,
+                                           struct wl_resource* buffer,
+                                           struct AHardwareBuffer** hardware_buffer)
+{
+    clearError();
+    egl_display_t* dp = get_display(dpy);
+    if (!dp)
+        return setError(EGL_BAD_DISPLAY, EGL_FALSE);
+
+    auto gralloc_buffer = get_gralloc_buffer_from_resource(buffer);
+    if (!gralloc_buffer || !hardware_buffer)
+        return setError(EGL_BAD_PARAMETER, EGL_FALSE);
+
+    // only the libnativewindow backend has one
+    auto ahb = gralloc_buffer->get_hardware_buffer();
+    if (!ahb)
+        return setError(EGL_BAD_ACCESS, EGL_FALSE);
+
+    *hardware_buffer = ahb;
+    return EGL_TRUE;
+}
+
 // ----------------------------------------------------------------------------
 // EGL_EGLEXT_VERSION 3
 // ----------------------------------------------------------------------------
@@ -788,7 +1053,7 @@ EGLBoolean eglLockSurfaceKHRImpl(EGLDisplay dpy, EGLSurface surface,
                                  const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.ext.eglLockSurfaceKHR)
     {
         return system->egl.ext.eglLockSurfaceKHR(dpy, surface, attrib_list);
@@ -799,7 +1064,7 @@ EGLBoolean eglLockSurfaceKHRImpl(EGLDisplay dpy, EGLSurface surface,
 EGLBoolean eglUnlockSurfaceKHRImpl(EGLDisplay dpy, EGLSurface surface)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.ext.eglUnlockSurfaceKHR)
     {
         return system->egl.ext.eglUnlockSurfaceKHR(dpy, surface);
@@ -816,9 +1081,17 @@ EGLImageKHR eglCreateImageTmpl(EGLDisplay dpy, EGLContext ctx, EGLenum target,
                                FuncType eglCreateImageFunc)
 {
     EGLImageKHR result = EGL_NO_IMAGE_KHR;
+    struct wl_resource* resource = nullptr;
     if (target == EGL_WAYLAND_BUFFER_WL)
     {
-        buffer = get_buffer_from_resource((struct wl_resource*)buffer);
+        resource = (struct wl_resource*)buffer;
+        // compositors create an image on every attach, hand out the one
+        // made for the buffer last time
+        result = acquire_buffer_image(resource, dpy);
+        if (result != EGL_NO_IMAGE_KHR)
+            return result;
+
+        buffer = get_buffer_from_resource(resource);
         target = EGL_NATIVE_BUFFER_ANDROID;
         ctx = EGL_NO_CONTEXT;
         attrib_list = nullptr;
@@ -828,6 +1101,15 @@ EGLImageKHR eglCreateImageTmpl(EGLDisplay dpy, EGLContext ctx, EGLenum target,
     {
         result = eglCreateImageFunc(dpy, ctx, target, buffer, attrib_list);
     }
+
+    if (resource && result != EGL_NO_IMAGE_KHR)
+    {
+        auto system = g_egl_system;
+        destroy_image_func destroy = system->egl.eglDestroyImage
+                                         ? system->egl.eglDestroyImage
+                                         : system->egl.ext.eglDestroyImageKHR;
+        cache_buffer_image(resource, dpy, result, destroy);
+    }
     return result;
 }
 
@@ -836,7 +1118,9 @@ EGLImageKHR eglCreateImageKHRImpl(EGLDisplay dpy, EGLContext ctx,
                                   const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglCreateImageKHRImpl, dpy, ctx, target, buffer,
+                     attrib_list);
+    auto system = g_egl_system;
     return eglCreateImageTmpl(dpy, ctx, target, buffer, attrib_list,
                               system->egl.ext.eglCreateImageKHR);
 }
@@ -846,7 +1130,8 @@ EGLImage eglCreateImageImpl(EGLDisplay dpy, EGLContext ctx, EGLenum target,
                             const EGLAttrib* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglCreateImageImpl, dpy, ctx, target, buffer, attrib_list);
+    auto system = g_egl_system;
     if (system->egl.eglCreateImage)
     {
         return eglCreateImageTmpl(dpy, ctx, target, buffer, attrib_list,
@@ -864,6 +1149,10 @@ EGLBoolean eglDestroyImageTmpl(EGLDisplay dpy, EGLImageKHR img,
 {
     clearError();
     EGLBoolean result = EGL_FALSE;
+    // images of wl_buffers live until the buffer is destroyed
+    if (release_buffer_image(dpy, img))
+        return EGL_TRUE;
+
     if (destroyImageFunc)
     {
         result = destroyImageFunc(dpy, img);
@@ -874,14 +1163,14 @@ EGLBoolean eglDestroyImageTmpl(EGLDisplay dpy, EGLImageKHR img,
 EGLBoolean eglDestroyImageKHRImpl(EGLDisplay dpy, EGLImageKHR img)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return eglDestroyImageTmpl(dpy, img, system->egl.ext.eglDestroyImageKHR);
 }
 
 EGLBoolean eglDestroyImageImpl(EGLDisplay dpy, EGLImageKHR img)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglDestroyImage)
     {
         return eglDestroyImageTmpl(dpy, img, system->egl.eglDestroyImage);
@@ -916,7 +1205,8 @@ EGLSyncKHR eglCreateSyncKHRImpl(EGLDisplay dpy, EGLenum type,
                                 const EGLint* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglCreateSyncKHRImpl, dpy, type, attrib_list);
+    auto system = g_egl_system;
     return eglCreateSyncTmpl(dpy, type, attrib_list,
                              system->egl.ext.eglCreateSyncKHR);
 }
@@ -925,7 +1215,8 @@ EGLSync eglCreateSyncImpl(EGLDisplay dpy, EGLenum type,
                           const EGLAttrib* attrib_list)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglCreateSyncImpl, dpy, type, attrib_list);
+    auto system = g_egl_system;
     if (system->egl.eglCreateSync)
     {
         return eglCreateSyncTmpl(dpy, type, attrib_list,
@@ -953,14 +1244,14 @@ EGLBoolean eglDestroySyncTmpl(EGLDisplay dpy, EGLSyncKHR sync,
 EGLBoolean eglDestroySyncKHRImpl(EGLDisplay dpy, EGLSyncKHR sync)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return eglDestroySyncTmpl(dpy, sync, system->egl.ext.eglDestroySyncKHR);
 }
 
 EGLBoolean eglDestroySyncImpl(EGLDisplay dpy, EGLSyncKHR sync)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglDestroySync)
     {
         return eglDestroySyncTmpl(dpy, sync, system->egl.eglDestroySync);
@@ -973,7 +1264,7 @@ EGLBoolean eglSignalSyncKHRImpl(EGLDisplay dpy, EGLSyncKHR sync, EGLenum mode)
 {
     clearError();
     EGLBoolean result = EGL_FALSE;
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.ext.eglSignalSyncKHR)
     {
         result = system->egl.ext.eglSignalSyncKHR(dpy, sync, mode);
@@ -998,7 +1289,8 @@ EGLint eglClientWaitSyncKHRImpl(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags,
                                 EGLTimeKHR timeout)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglClientWaitSyncKHRImpl, dpy, sync, flags, timeout);
+    auto system = g_egl_system;
     return eglClientWaitSyncTmpl(dpy, sync, flags, timeout,
                                  system->egl.ext.eglClientWaitSyncKHR);
 }
@@ -1007,7 +1299,8 @@ EGLint eglClientWaitSyncImpl(EGLDisplay dpy, EGLSync sync, EGLint flags,
                              EGLTimeKHR timeout)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglClientWaitSyncImpl, dpy, sync, flags, timeout);
+    auto system = g_egl_system;
     if (system->egl.eglClientWaitSync)
     {
         return eglClientWaitSyncTmpl(dpy, sync, flags, timeout,
@@ -1035,7 +1328,7 @@ EGLBoolean eglGetSyncAttribImpl(EGLDisplay dpy, EGLSync sync, EGLint attribute,
                                 EGLAttrib* value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (system->egl.eglGetSyncAttrib)
     {
         return eglGetSyncAttribTmpl(dpy, sync, attribute, value,
@@ -1057,7 +1350,7 @@ EGLBoolean eglGetSyncAttribKHRImpl(EGLDisplay dpy, EGLSyncKHR sync,
                                    EGLint attribute, EGLint* value)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     return eglGetSyncAttribTmpl(dpy, sync, attribute, value,
                                 system->egl.ext.eglGetSyncAttribKHR);
 }
@@ -1072,7 +1365,7 @@ ReturnType eglWaitSyncTmpl(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags,
                            FuncType eglWaitSyncFunc)
 {
     ReturnType result = EGL_FALSE;
-    auto system = egl_system_t::loader::getInstance().system;
+    auto system = g_egl_system;
     if (eglWaitSyncFunc)
     {
         result = eglWaitSyncFunc(dpy, sync, flags);
@@ -1086,7 +1379,8 @@ typedef EGLBoolean(EGLAPIENTRYP PFNEGLWAITSYNC)(EGLDisplay dpy, EGLSync sync,
 EGLint eglWaitSyncKHRImpl(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglWaitSyncKHRImpl, dpy, sync, flags);
+    auto system = g_egl_system;
     return eglWaitSyncTmpl<EGLint>(dpy, sync, flags,
                                    system->egl.ext.eglWaitSyncKHR);
 }
@@ -1094,7 +1388,8 @@ EGLint eglWaitSyncKHRImpl(EGLDisplay dpy, EGLSyncKHR sync, EGLint flags)
 EGLBoolean eglWaitSyncImpl(EGLDisplay dpy, EGLSync sync, EGLint flags)
 {
     clearError();
-    auto system = egl_system_t::loader::getInstance().system;
+    RUN_ON_GL_THREAD(eglWaitSyncImpl, dpy, sync, flags);
+    auto system = g_egl_system;
     if (system->egl.eglWaitSync)
     {
         return eglWaitSyncTmpl<EGLBoolean>(dpy, sync, flags,
@@ -1109,8 +1404,7 @@ const GLubyte* glGetStringImpl(GLenum name)
 {
     if (name == GL_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             if (auto ctx_wrap = egl_context_t::get(ctx); ctx_wrap)
@@ -1131,8 +1425,7 @@ const GLubyte* glGetStringiImpl(GLenum name, GLuint index)
 {
     if (name == GL_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             auto ctx_wrap = egl_context_t::get(ctx);
@@ -1151,12 +1444,39 @@ const GLubyte* glGetStringiImpl(GLenum name, GLuint index)
     return ret;
 }
 
+namespace {
+// the wrapper of the bound context, kept until a context is destroyed
+// for the calls made with every draw
+egl_context_t* bound_context()
+{
+    static thread_local struct
+    {
+        EGLContext ctx = EGL_NO_CONTEXT;
+        uint64_t generation = 0;
+        egl_context_t* ctx_wrap = nullptr;
+    } cached;
+
+    EGLContext ctx = egl_tls_t::getCurrent().ctx;
+    uint64_t generation =
+        egl_tls_t::generation.load(std::memory_order_acquire);
+    if (ctx != cached.ctx || generation != cached.generation)
+        cached = {ctx, generation, ctx ? egl_context_t::get(ctx) : nullptr};
+    return cached.ctx_wrap;
+}
+
+// null without a current context
+const egl_gl_limits_t* current_limits()
+{
+    auto ctx_wrap = bound_context();
+    return ctx_wrap ? &ctx_wrap->limits : nullptr;
+}
+} // namespace
+
 void glGetBooleanvImpl(GLenum pname, GLboolean* data)
 {
     if (pname == GL_NUM_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             if (auto ctx_wrap = egl_context_t::get(ctx); ctx_wrap)
@@ -1167,6 +1487,9 @@ void glGetBooleanvImpl(GLenum pname, GLboolean* data)
         }
     }
 
+    if (auto limits = current_limits(); limits && limits->get(pname, data))
+        return;
+
     gl_hooks_t::gl_t const* const _c = &getGlThreadSpecific()->gl;
     if (_c)
         _c->glGetBooleanv(pname, data);
@@ -1176,8 +1499,7 @@ void glGetFloatvImpl(GLenum pname, GLfloat* data)
 {
     if (pname == GL_NUM_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             auto ctx_wrap = egl_context_t::get(ctx);
@@ -1189,6 +1511,9 @@ void glGetFloatvImpl(GLenum pname, GLfloat* data)
         }
     }
 
+    if (auto limits = current_limits(); limits && limits->get(pname, data))
+        return;
+
     gl_hooks_t::gl_t const* const _c = &getGlThreadSpecific()->gl;
     if (_c)
         _c->glGetFloatv(pname, data);
@@ -1198,8 +1523,7 @@ void glGetIntegervImpl(GLenum pname, GLint* data)
 {
     if (pname == GL_NUM_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             if (auto ctx_wrap = egl_context_t::get(ctx); ctx_wrap)
@@ -1210,6 +1534,9 @@ void glGetIntegervImpl(GLenum pname, GLint* data)
         }
     }
 
+    if (auto limits = current_limits(); limits && limits->get(pname, data))
+        return;
+
     gl_hooks_t::gl_t const* const _c = &getGlThreadSpecific()->gl;
     if (_c)
         _c->glGetIntegerv(pname, data);
@@ -1219,8 +1546,7 @@ void glGetInteger64vImpl(GLenum pname, GLint64* data)
 {
     if (pname == GL_NUM_EXTENSIONS)
     {
-        auto system = egl_system_t::loader::getInstance().system;
-        EGLContext ctx = system->egl.eglGetCurrentContext();
+        EGLContext ctx = egl_tls_t::getCurrent().ctx;
         if (ctx)
         {
             if (auto ctx_wrap = egl_context_t::get(ctx); ctx_wrap)
@@ -1231,60 +1557,1166 @@ void glGetInteger64vImpl(GLenum pname, GLint64* data)
         }
     }
 
+    if (auto limits = current_limits(); limits && limits->get(pname, data))
+        return;
+
     gl_hooks_t::gl_t const* const _c = &getGlThreadSpecific()->gl;
     if (_c)
         _c->glGetInteger64v(pname, data);
 }
 
-#undef GL_ENTRY
-#undef EGL_ENTRY
-#define GL_ENTRY(_r, _api, ...) _api ## Impl,
-#define EGL_ENTRY(_r, _api, ...) _api ## Impl,
-void fullPlatformImpl(platform_impl_t& pImpl)
+namespace {
+const gl_hooks_t::gl_t& gles2()
 {
-    // clang-format off
-    platform_impl_t impl = {
-        #include "loader/platform_entries.in"
+    return g_egl_system->hooks[egl_system_t::GLESv2_INDEX].gl;
+}
+
+egl_vertex_stream_t* current_stream()
+{
+    auto ctx_wrap = bound_context();
+    return ctx_wrap ? ctx_wrap->vertex_stream.get() : nullptr;
+}
+
+egl_state_filter_t* current_filter()
+{
+    auto ctx_wrap = bound_context();
+    return ctx_wrap ? ctx_wrap->state_filter.get() : nullptr;
+}
+
+egl_program_cache_t* current_programs()
+{
+    auto ctx_wrap = bound_context();
+    if (!ctx_wrap || !ctx_wrap->programs || !ctx_wrap->programs->enabled())
+        return nullptr;
+    return ctx_wrap->programs.get();
+}
+
+egl_compile_pool_t* current_compiler()
+{
+    if (!g_egl_system->shaders_compiled.load(std::memory_order_relaxed))
+        return nullptr;
+    auto ctx_wrap = bound_context();
+    if (!ctx_wrap || !ctx_wrap->compiler || !ctx_wrap->compiler->enabled())
+        return nullptr;
+    return ctx_wrap->compiler.get();
+}
+
+// a compile or link still running on a worker is finished first
+void wait_compiled(GLuint object)
+{
+    if (auto compiler = current_compiler(); compiler)
+        compiler->wait(object);
+}
+
+// the bound program linked again on a worker is waited for and bound
+// again, before a draw or glUniform* uses it
+void wait_relinked()
+{
+    if (!g_egl_system->shaders_compiled.load(std::memory_order_relaxed))
+        return;
+    auto ctx_wrap = bound_context();
+    if (!ctx_wrap || !ctx_wrap->relinked)
+        return;
+    ctx_wrap->relinked = false;
+    ctx_wrap->compiler->wait(ctx_wrap->used_program);
+    gles2().glUseProgram(ctx_wrap->used_program);
+}
+} // namespace
+
+void glShaderSourceImpl(GLuint shader, GLsizei count,
+                        const GLchar* const* string, const GLint* length)
+{
+    wait_compiled(shader);
+    if (auto programs = current_programs(); programs)
+        programs->shader_source(gles2(), shader, count, string, length);
+    else
+        gles2().glShaderSource(shader, count, string, length);
+}
+
+void glCompileShaderImpl(GLuint shader)
+{
+    // the workers may outlive the context
+    std::shared_ptr<egl_program_cache_t> programs;
+    if (current_programs())
+        programs = bound_context()->programs;
+    auto compile = [programs, shader](const gl_hooks_t::gl_t& gl) {
+        if (programs)
+            programs->compile_shader(gl, shader);
+        else
+            gl.glCompileShader(shader);
     };
-    // clang-format on
 
-    memcpy(&pImpl, &impl, sizeof(platform_impl_t));
+    if (auto compiler = current_compiler(); compiler)
+        compiler->submit(shader, {}, compile);
+    else
+        compile(gles2());
 }
-#undef GL_ENTRY
-#undef EGL_ENTRY
 
-/*
- * EGL entry-points exposed to 3rd party applications
- *
- */
+void glGetShaderivImpl(GLuint shader, GLenum pname, GLint* params)
+{
+    if (auto compiler = current_compiler(); compiler)
+    {
+        if (pname == GL_COMPLETION_STATUS_KHR)
+        {
+            *params = compiler->completed(shader) ? GL_TRUE : GL_FALSE;
+            return;
+        }
+        compiler->wait(shader);
+    }
 
-// clang-format off
-static const std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType> sEntryMap = {
-#undef EGL_ENTRY
-#undef GL_ENTRY
-#define EGL_ENTRY(_r, _api, ...) {#_api, (__eglMustCastToProperFunctionPointerType)_api ## Impl},
-#define GL_ENTRY(_r, _api, ...)  {#_api, (__eglMustCastToProperFunctionPointerType)_api ## Impl},
+    if (auto programs = current_programs();
+        programs && programs->get_shader(shader, pname, params))
+        return;
+    gles2().glGetShaderiv(shader, pname, params);
+}
 
-#include "loader/platform_entries.in"
+void glGetShaderInfoLogImpl(GLuint shader, GLsizei bufSize, GLsizei* length,
+                            GLchar* infoLog)
+{
+    wait_compiled(shader);
+    if (auto programs = current_programs();
+        programs &&
+        programs->get_shader_info_log(shader, bufSize, length, infoLog))
+        return;
+    gles2().glGetShaderInfoLog(shader, bufSize, length, infoLog);
+}
 
-#undef GL_ENTRY
-#undef EGL_ENTRY
+void glGetShaderSourceImpl(GLuint shader, GLsizei bufSize, GLsizei* length,
+                           GLchar* source)
+{
+    wait_compiled(shader);
+    gles2().glGetShaderSource(shader, bufSize, length, source);
+}
 
-    // EGL_EXT_platform_base
-    { "eglGetPlatformDisplayEXT", (__eglMustCastToProperFunctionPointerType)eglGetPlatformDisplayEXTImpl },
-    { "eglCreatePlatformWindowSurfaceEXT", (__eglMustCastToProperFunctionPointerType)eglCreatePlatformWindowSurfaceEXTImpl },
+void glDeleteShaderImpl(GLuint shader)
+{
+    wait_compiled(shader);
+    if (auto programs = current_programs(); programs)
+        programs->delete_shader(gles2(), shader);
+    else
+        gles2().glDeleteShader(shader);
+}
 
-    // EGL_WL_bind_wayland_display
-    { "eglBindWaylandDisplayWL", (__eglMustCastToProperFunctionPointerType)eglBindWaylandDisplayWLImpl },
-    { "eglUnbindWaylandDisplayWL", (__eglMustCastToProperFunctionPointerType)eglUnbindWaylandDisplayWLImpl },
-    { "eglQueryWaylandBufferWL", (__eglMustCastToProperFunctionPointerType)eglQueryWaylandBufferWLImpl },
-};
-// clang-format on
+void glAttachShaderImpl(GLuint program, GLuint shader)
+{
+    // a shader being compiled can be attached, the link waits for it
+    wait_compiled(program);
+    gles2().glAttachShader(program, shader);
+}
 
-__eglMustCastToProperFunctionPointerType findProcAddress(const char* name)
+void glDetachShaderImpl(GLuint program, GLuint shader)
 {
-    if (auto iter = sEntryMap.find(name); iter != sEntryMap.end())
-        return iter->second;
+    wait_compiled(program);
+    gles2().glDetachShader(program, shader);
+}
+
+void glLinkProgramImpl(GLuint program)
+{
+    if (auto filter = current_filter(); filter)
+        filter->linked_program(program);
+    std::shared_ptr<egl_program_cache_t> programs;
+    if (current_programs())
+        programs = bound_context()->programs;
+    auto link = [programs, program](const gl_hooks_t::gl_t& gl) {
+        if (programs)
+            programs->link_program(gl, program);
+        else
+            gl.glLinkProgram(program);
+    };
+
+    auto compiler = current_compiler();
+    if (!compiler)
+        return link(gles2());
+
+    // the shaders attached now are the ones the link compiles with
+    compiler->wait(program);
+    GLint count = 0;
+    gles2().glGetProgramiv(program, GL_ATTACHED_SHADERS, &count);
+    std::vector<GLuint> attached(count > 0 ? count : 0);
+    if (count > 0)
+        gles2().glGetAttachedShaders(program, count, &count, attached.data());
+    attached.resize(count > 0 ? count : 0);
+    compiler->submit(program, attached, link);
+    if (auto ctx_wrap = bound_context(); ctx_wrap->used_program == program)
+        ctx_wrap->relinked = true;
+}
+
+void glGetProgramivImpl(GLuint program, GLenum pname, GLint* params)
+{
+    if (auto compiler = current_compiler(); compiler)
+    {
+        if (pname == GL_COMPLETION_STATUS_KHR)
+        {
+            *params = compiler->completed(program) ? GL_TRUE : GL_FALSE;
+            return;
+        }
+        compiler->wait(program);
+    }
+    gles2().glGetProgramiv(program, pname, params);
+}
+
+void glGetProgramInfoLogImpl(GLuint program, GLsizei bufSize, GLsizei* length,
+                             GLchar* infoLog)
+{
+    wait_compiled(program);
+    gles2().glGetProgramInfoLog(program, bufSize, length, infoLog);
+}
+
+void glDeleteProgramImpl(GLuint program)
+{
+    wait_compiled(program);
+    if (auto programs = current_programs(); programs)
+        programs->delete_program(program);
+    gles2().glDeleteProgram(program);
+}
+
+void glBindAttribLocationImpl(GLuint program, GLuint index,
+                              const GLchar* name)
+{
+    wait_compiled(program);
+    if (auto programs = current_programs(); programs)
+        programs->bind_attrib_location(program, index, name);
+    gles2().glBindAttribLocation(program, index, name);
+}
+
+void glProgramParameteriImpl(GLuint program, GLenum pname, GLint value)
+{
+    if (!gles2().glProgramParameteri)
+        return;
+    wait_compiled(program);
+    if (auto programs = current_programs(); programs)
+        programs->program_parameter(program, pname, value);
+    gles2().glProgramParameteri(program, pname, value);
+}
+
+void glTransformFeedbackVaryingsImpl(GLuint program, GLsizei count,
+                                     const GLchar* const* varyings,
+                                     GLenum bufferMode)
+{
+    if (!gles2().glTransformFeedbackVaryings)
+        return;
+    wait_compiled(program);
+    if (auto programs = current_programs(); programs)
+        programs->transform_feedback_varyings(program, count, varyings,
+                                              bufferMode);
+    gles2().glTransformFeedbackVaryings(program, count, varyings, bufferMode);
+}
+
+void glValidateProgramImpl(GLuint program)
+{
+    wait_compiled(program);
+    gles2().glValidateProgram(program);
+}
+
+void glUseProgramImpl(GLuint program)
+{
+    if (auto filter = current_filter();
+        filter && !filter->use_program(program))
+        return;
+    // binding it again after the link is what makes it visible here
+    wait_compiled(program);
+    gles2().glUseProgram(program);
+    if (auto ctx_wrap = bound_context(); ctx_wrap)
+    {
+        ctx_wrap->used_program = program;
+        ctx_wrap->relinked = false;
+    }
+}
+
+void glUseProgramStagesImpl(GLuint pipeline, GLbitfield stages,
+                            GLuint program)
+{
+    if (!gles2().glUseProgramStages)
+        return;
+    wait_compiled(program);
+    gles2().glUseProgramStages(pipeline, stages, program);
+}
+
+void glGetProgramBinaryImpl(GLuint program, GLsizei bufSize, GLsizei* length,
+                            GLenum* binaryFormat, void* binary)
+{
+    if (!gles2().glGetProgramBinary)
+        return;
+    wait_compiled(program);
+    gles2().glGetProgramBinary(program, bufSize, length, binaryFormat, binary);
+}
+
+void glProgramBinaryImpl(GLuint program, GLenum binaryFormat,
+                         const void* binary, GLsizei length)
+{
+    if (!gles2().glProgramBinary)
+        return;
+    if (auto filter = current_filter(); filter)
+        filter->linked_program(program);
+    wait_compiled(program);
+    gles2().glProgramBinary(program, binaryFormat, binary, length);
+}
+
+GLint glGetAttribLocationImpl(GLuint program, const GLchar* name)
+{
+    wait_compiled(program);
+    return gles2().glGetAttribLocation(program, name);
+}
+
+GLint glGetUniformLocationImpl(GLuint program, const GLchar* name)
+{
+    wait_compiled(program);
+    return gles2().glGetUniformLocation(program, name);
+}
+
+GLint glGetFragDataLocationImpl(GLuint program, const GLchar* name)
+{
+    if (!gles2().glGetFragDataLocation)
+        return -1;
+    wait_compiled(program);
+    return gles2().glGetFragDataLocation(program, name);
+}
+
+void glGetActiveAttribImpl(GLuint program, GLuint index, GLsizei bufSize,
+                           GLsizei* length, GLint* size, GLenum* type,
+                           GLchar* name)
+{
+    wait_compiled(program);
+    gles2().glGetActiveAttrib(program, index, bufSize, length, size, type,
+                              name);
+}
+
+void glGetActiveUniformImpl(GLuint program, GLuint index, GLsizei bufSize,
+                            GLsizei* length, GLint* size, GLenum* type,
+                            GLchar* name)
+{
+    wait_compiled(program);
+    gles2().glGetActiveUniform(program, index, bufSize, length, size, type,
+                               name);
+}
+
+void glGetUniformIndicesImpl(GLuint program, GLsizei uniformCount,
+                             const GLchar* const* uniformNames,
+                             GLuint* uniformIndices)
+{
+    if (!gles2().glGetUniformIndices)
+        return;
+    wait_compiled(program);
+    gles2().glGetUniformIndices(program, uniformCount, uniformNames,
+                                uniformIndices);
+}
+
+void glGetActiveUniformsivImpl(GLuint program, GLsizei uniformCount,
+                               const GLuint* uniformIndices, GLenum pname,
+                               GLint* params)
+{
+    if (!gles2().glGetActiveUniformsiv)
+        return;
+    wait_compiled(program);
+    gles2().glGetActiveUniformsiv(program, uniformCount, uniformIndices,
+                                  pname, params);
+}
+
+GLuint glGetUniformBlockIndexImpl(GLuint program,
+                                  const GLchar* uniformBlockName)
+{
+    if (!gles2().glGetUniformBlockIndex)
+        return GL_INVALID_INDEX;
+    wait_compiled(program);
+    return gles2().glGetUniformBlockIndex(program, uniformBlockName);
+}
+
+void glGetActiveUniformBlockivImpl(GLuint program, GLuint uniformBlockIndex,
+                                   GLenum pname, GLint* params)
+{
+    if (!gles2().glGetActiveUniformBlockiv)
+        return;
+    wait_compiled(program);
+    gles2().glGetActiveUniformBlockiv(program, uniformBlockIndex, pname,
+                                      params);
+}
+
+void glGetActiveUniformBlockNameImpl(GLuint program, GLuint uniformBlockIndex,
+                                     GLsizei bufSize, GLsizei* length,
+                                     GLchar* uniformBlockName)
+{
+    if (!gles2().glGetActiveUniformBlockName)
+        return;
+    wait_compiled(program);
+    gles2().glGetActiveUniformBlockName(program, uniformBlockIndex, bufSize,
+                                        length, uniformBlockName);
+}
+
+void glUniformBlockBindingImpl(GLuint program, GLuint uniformBlockIndex,
+                               GLuint uniformBlockBinding)
+{
+    if (!gles2().glUniformBlockBinding)
+        return;
+    wait_compiled(program);
+    gles2().glUniformBlockBinding(program, uniformBlockIndex,
+                                  uniformBlockBinding);
+}
+
+void glGetUniformfvImpl(GLuint program, GLint location, GLfloat* params)
+{
+    wait_compiled(program);
+    gles2().glGetUniformfv(program, location, params);
+}
+
+void glGetUniformivImpl(GLuint program, GLint location, GLint* params)
+{
+    wait_compiled(program);
+    gles2().glGetUniformiv(program, location, params);
+}
+
+void glGetUniformuivImpl(GLuint program, GLint location, GLuint* params)
+{
+    if (!gles2().glGetUniformuiv)
+        return;
+    wait_compiled(program);
+    gles2().glGetUniformuiv(program, location, params);
+}
+
+// GL_KHR_parallel_shader_compile, from eglGetProcAddress
+void glMaxShaderCompilerThreadsKHRImpl(GLuint count)
+{
+    if (auto compiler = current_compiler(); compiler)
+        compiler->set_max_threads(count);
+    else if (auto system = g_egl_system;
+             system->glext.glMaxShaderCompilerThreadsKHR)
+        system->glext.glMaxShaderCompilerThreadsKHR(count);
+}
+
+// a uniform goes to the executable a pending link of the bound program
+// makes
+#define RELINKED_CALL(_api, ...)                                               \
+    wait_relinked();                                                           \
+    if (gles2()._api)                                                          \
+        gles2()._api(__VA_ARGS__);
+
+void glUniform1fImpl(GLint location, GLfloat v0)
+{
+    RELINKED_CALL(glUniform1f, location, v0);
+}
+
+void glUniform1fvImpl(GLint location, GLsizei count, const GLfloat* value)
+{
+    RELINKED_CALL(glUniform1fv, location, count, value);
+}
+
+void glUniform1iImpl(GLint location, GLint v0)
+{
+    RELINKED_CALL(glUniform1i, location, v0);
+}
+
+void glUniform1ivImpl(GLint location, GLsizei count, const GLint* value)
+{
+    RELINKED_CALL(glUniform1iv, location, count, value);
+}
+
+void glUniform2fImpl(GLint location, GLfloat v0, GLfloat v1)
+{
+    RELINKED_CALL(glUniform2f, location, v0, v1);
+}
+
+void glUniform2fvImpl(GLint location, GLsizei count, const GLfloat* value)
+{
+    RELINKED_CALL(glUniform2fv, location, count, value);
+}
+
+void glUniform2iImpl(GLint location, GLint v0, GLint v1)
+{
+    RELINKED_CALL(glUniform2i, location, v0, v1);
+}
+
+void glUniform2ivImpl(GLint location, GLsizei count, const GLint* value)
+{
+    RELINKED_CALL(glUniform2iv, location, count, value);
+}
+
+void glUniform3fImpl(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    RELINKED_CALL(glUniform3f, location, v0, v1, v2);
+}
+
+void glUniform3fvImpl(GLint location, GLsizei count, const GLfloat* value)
+{
+    RELINKED_CALL(glUniform3fv, location, count, value);
+}
+
+void glUniform3iImpl(GLint location, GLint v0, GLint v1, GLint v2)
+{
+    RELINKED_CALL(glUniform3i, location, v0, v1, v2);
+}
+
+void glUniform3ivImpl(GLint location, GLsizei count, const GLint* value)
+{
+    RELINKED_CALL(glUniform3iv, location, count, value);
+}
+
+void glUniform4fImpl(GLint location, GLfloat v0, GLfloat v1, GLfloat v2,
+                     GLfloat v3)
+{
+    RELINKED_CALL(glUniform4f, location, v0, v1, v2, v3);
+}
+
+void glUniform4fvImpl(GLint location, GLsizei count, const GLfloat* value)
+{
+    RELINKED_CALL(glUniform4fv, location, count, value);
+}
+
+void glUniform4iImpl(GLint location, GLint v0, GLint v1, GLint v2, GLint v3)
+{
+    RELINKED_CALL(glUniform4i, location, v0, v1, v2, v3);
+}
+
+void glUniform4ivImpl(GLint location, GLsizei count, const GLint* value)
+{
+    RELINKED_CALL(glUniform4iv, location, count, value);
+}
+
+void glUniformMatrix2fvImpl(GLint location, GLsizei count, GLboolean transpose,
+                            const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix2fv, location, count, transpose, value);
+}
+
+void glUniformMatrix3fvImpl(GLint location, GLsizei count, GLboolean transpose,
+                            const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix3fv, location, count, transpose, value);
+}
+
+void glUniformMatrix4fvImpl(GLint location, GLsizei count, GLboolean transpose,
+                            const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix4fv, location, count, transpose, value);
+}
+
+void glUniformMatrix2x3fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix2x3fv, location, count, transpose, value);
+}
+
+void glUniformMatrix3x2fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix3x2fv, location, count, transpose, value);
+}
+
+void glUniformMatrix2x4fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix2x4fv, location, count, transpose, value);
+}
+
+void glUniformMatrix4x2fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix4x2fv, location, count, transpose, value);
+}
+
+void glUniformMatrix3x4fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix3x4fv, location, count, transpose, value);
+}
+
+void glUniformMatrix4x3fvImpl(GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat* value)
+{
+    RELINKED_CALL(glUniformMatrix4x3fv, location, count, transpose, value);
+}
+
+void glUniform1uiImpl(GLint location, GLuint v0)
+{
+    RELINKED_CALL(glUniform1ui, location, v0);
+}
+
+void glUniform2uiImpl(GLint location, GLuint v0, GLuint v1)
+{
+    RELINKED_CALL(glUniform2ui, location, v0, v1);
+}
+
+void glUniform3uiImpl(GLint location, GLuint v0, GLuint v1, GLuint v2)
+{
+    RELINKED_CALL(glUniform3ui, location, v0, v1, v2);
+}
+
+void glUniform4uiImpl(GLint location, GLuint v0, GLuint v1, GLuint v2,
+                      GLuint v3)
+{
+    RELINKED_CALL(glUniform4ui, location, v0, v1, v2, v3);
+}
+
+void glUniform1uivImpl(GLint location, GLsizei count, const GLuint* value)
+{
+    RELINKED_CALL(glUniform1uiv, location, count, value);
+}
+
+void glUniform2uivImpl(GLint location, GLsizei count, const GLuint* value)
+{
+    RELINKED_CALL(glUniform2uiv, location, count, value);
+}
+
+void glUniform3uivImpl(GLint location, GLsizei count, const GLuint* value)
+{
+    RELINKED_CALL(glUniform3uiv, location, count, value);
+}
+
+void glUniform4uivImpl(GLint location, GLsizei count, const GLuint* value)
+{
+    RELINKED_CALL(glUniform4uiv, location, count, value);
+}
+
+#undef RELINKED_CALL
+
+void glBindBufferImpl(GLenum target, GLuint buffer)
+{
+    if (auto filter = current_filter();
+        filter && !filter->bind_buffer(target, buffer))
+        return;
+    if (auto stream = current_stream(); stream)
+        stream->bind_buffer(gles2(), target, buffer);
+    else
+        gles2().glBindBuffer(target, buffer);
+}
+
+void glBindVertexArrayImpl(GLuint array)
+{
+    if (auto stream = current_stream(); stream)
+        stream->bind_vertex_array(gles2(), array);
+    else if (gles2().glBindVertexArray)
+        gles2().glBindVertexArray(array);
+}
+
+void glDeleteBuffersImpl(GLsizei n, const GLuint* buffers)
+{
+    if (auto stream = current_stream(); stream)
+        stream->delete_buffers(gles2(), n, buffers);
+    else
+        gles2().glDeleteBuffers(n, buffers);
+    if (auto filter = current_filter(); filter)
+        filter->deleted_buffers(n, buffers);
+}
+
+void glVertexAttribPointerImpl(GLuint index, GLint size, GLenum type,
+                               GLboolean normalized, GLsizei stride,
+                               const void* pointer)
+{
+    if (auto stream = current_stream(); stream)
+        stream->attrib_pointer(gles2(), index, size, type, normalized, false,
+                               stride, pointer);
+    else
+        gles2().glVertexAttribPointer(index, size, type, normalized, stride,
+                                      pointer);
+}
+
+void glVertexAttribIPointerImpl(GLuint index, GLint size, GLenum type,
+                                GLsizei stride, const void* pointer)
+{
+    if (auto stream = current_stream(); stream)
+        stream->attrib_pointer(gles2(), index, size, type, GL_FALSE, true,
+                               stride, pointer);
+    else if (gles2().glVertexAttribIPointer)
+        gles2().glVertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void glEnableVertexAttribArrayImpl(GLuint index)
+{
+    if (auto stream = current_stream(); stream)
+        stream->enable_array(gles2(), index, true);
+    else
+        gles2().glEnableVertexAttribArray(index);
+}
+
+void glDisableVertexAttribArrayImpl(GLuint index)
+{
+    if (auto stream = current_stream(); stream)
+        stream->enable_array(gles2(), index, false);
+    else
+        gles2().glDisableVertexAttribArray(index);
+}
+
+void glVertexAttribDivisorImpl(GLuint index, GLuint divisor)
+{
+    if (auto stream = current_stream(); stream)
+        stream->attrib_divisor(gles2(), index, divisor);
+    else if (gles2().glVertexAttribDivisor)
+        gles2().glVertexAttribDivisor(index, divisor);
+}
+
+void glDrawArraysImpl(GLenum mode, GLint first, GLsizei count)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->draw_arrays(gles2(), mode, first, count);
+    else
+        gles2().glDrawArrays(mode, first, count);
+}
+
+void glDrawElementsImpl(GLenum mode, GLsizei count, GLenum type,
+                        const void* indices)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->draw_elements(gles2(), mode, count, type, indices, false, 0,
+                              0);
+    else
+        gles2().glDrawElements(mode, count, type, indices);
+}
+
+void glDrawRangeElementsImpl(GLenum mode, GLuint start, GLuint end,
+                             GLsizei count, GLenum type, const void* indices)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->draw_elements(gles2(), mode, count, type, indices, true, start,
+                              end);
+    else if (gles2().glDrawRangeElements)
+        gles2().glDrawRangeElements(mode, start, end, count, type, indices);
+}
+
+// instanced, base vertex and indirect draws and the queries see the app's
+// own arrays
+void glDrawArraysInstancedImpl(GLenum mode, GLint first, GLsizei count,
+                               GLsizei instancecount)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawArraysInstanced)
+        gles2().glDrawArraysInstanced(mode, first, count, instancecount);
+}
+
+void glDrawElementsInstancedImpl(GLenum mode, GLsizei count, GLenum type,
+                                 const void* indices, GLsizei instancecount)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawElementsInstanced)
+        gles2().glDrawElementsInstanced(mode, count, type, indices,
+                                        instancecount);
+}
+
+void glDrawElementsBaseVertexImpl(GLenum mode, GLsizei count, GLenum type,
+                                  const void* indices, GLint basevertex)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawElementsBaseVertex)
+        gles2().glDrawElementsBaseVertex(mode, count, type, indices,
+                                         basevertex);
+}
+
+void glDrawRangeElementsBaseVertexImpl(GLenum mode, GLuint start, GLuint end,
+                                       GLsizei count, GLenum type,
+                                       const void* indices, GLint basevertex)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawRangeElementsBaseVertex)
+        gles2().glDrawRangeElementsBaseVertex(mode, start, end, count, type,
+                                              indices, basevertex);
+}
+
+void glDrawElementsInstancedBaseVertexImpl(GLenum mode, GLsizei count,
+                                           GLenum type, const void* indices,
+                                           GLsizei instancecount,
+                                           GLint basevertex)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawElementsInstancedBaseVertex)
+        gles2().glDrawElementsInstancedBaseVertex(mode, count, type, indices,
+                                                  instancecount, basevertex);
+}
+
+void glDrawArraysIndirectImpl(GLenum mode, const void* indirect)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawArraysIndirect)
+        gles2().glDrawArraysIndirect(mode, indirect);
+}
+
+void glDrawElementsIndirectImpl(GLenum mode, GLenum type,
+                                const void* indirect)
+{
+    wait_relinked();
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glDrawElementsIndirect)
+        gles2().glDrawElementsIndirect(mode, type, indirect);
+}
+
+void glGetVertexAttribivImpl(GLuint index, GLenum pname, GLint* params)
+{
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    gles2().glGetVertexAttribiv(index, pname, params);
+}
+
+void glGetVertexAttribPointervImpl(GLuint index, GLenum pname, void** pointer)
+{
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    gles2().glGetVertexAttribPointerv(index, pname, pointer);
+}
+
+void glGetVertexAttribfvImpl(GLuint index, GLenum pname, GLfloat* params)
+{
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    gles2().glGetVertexAttribfv(index, pname, params);
+}
+
+void glGetVertexAttribIivImpl(GLuint index, GLenum pname, GLint* params)
+{
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glGetVertexAttribIiv)
+        gles2().glGetVertexAttribIiv(index, pname, params);
+}
+
+void glGetVertexAttribIuivImpl(GLuint index, GLenum pname, GLuint* params)
+{
+    if (auto stream = current_stream(); stream)
+        stream->restore(gles2());
+    if (gles2().glGetVertexAttribIuiv)
+        gles2().glGetVertexAttribIuiv(index, pname, params);
+}
+
+void glDeleteVertexArraysImpl(GLsizei n, const GLuint* arrays)
+{
+    if (auto stream = current_stream(); stream)
+        stream->delete_vertex_arrays(gles2(), n, arrays);
+    else if (gles2().glDeleteVertexArrays)
+        gles2().glDeleteVertexArrays(n, arrays);
+}
+
+// a call the filter drops changes nothing the driver has
+#define FILTER_STATE_CALL(_check, _api, ...)                                   \
+    if (auto filter = current_filter(); filter && !filter->_check)             \
+        return;                                                                \
+    gles2()._api(__VA_ARGS__);
+
+void glActiveTextureImpl(GLenum texture)
+{
+    FILTER_STATE_CALL(active_texture(texture), glActiveTexture, texture);
+}
+
+void glBindTextureImpl(GLenum target, GLuint texture)
+{
+    FILTER_STATE_CALL(bind_texture(target, texture), glBindTexture, target,
+                      texture);
+}
+
+void glBindFramebufferImpl(GLenum target, GLuint framebuffer)
+{
+    FILTER_STATE_CALL(bind_framebuffer(target, framebuffer),
+                      glBindFramebuffer, target, framebuffer);
+}
+
+void glBindRenderbufferImpl(GLenum target, GLuint renderbuffer)
+{
+    FILTER_STATE_CALL(bind_renderbuffer(target, renderbuffer),
+                      glBindRenderbuffer, target, renderbuffer);
+}
+
+void glEnableImpl(GLenum cap)
+{
+    FILTER_STATE_CALL(enable(cap, true), glEnable, cap);
+}
+
+void glDisableImpl(GLenum cap)
+{
+    FILTER_STATE_CALL(enable(cap, false), glDisable, cap);
+}
+
+void glBlendFuncImpl(GLenum sfactor, GLenum dfactor)
+{
+    FILTER_STATE_CALL(blend_func(sfactor, dfactor, sfactor, dfactor),
+                      glBlendFunc, sfactor, dfactor);
+}
+
+void glBlendFuncSeparateImpl(GLenum sfactorRGB, GLenum dfactorRGB,
+                             GLenum sfactorAlpha, GLenum dfactorAlpha)
+{
+    FILTER_STATE_CALL(
+        blend_func(sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha),
+        glBlendFuncSeparate, sfactorRGB, dfactorRGB, sfactorAlpha,
+        dfactorAlpha);
+}
+
+void glBlendEquationImpl(GLenum mode)
+{
+    FILTER_STATE_CALL(blend_equation(mode, mode), glBlendEquation, mode);
+}
+
+void glBlendEquationSeparateImpl(GLenum modeRGB, GLenum modeAlpha)
+{
+    FILTER_STATE_CALL(blend_equation(modeRGB, modeAlpha),
+                      glBlendEquationSeparate, modeRGB, modeAlpha);
+}
+
+void glViewportImpl(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    FILTER_STATE_CALL(viewport(x, y, width, height), glViewport, x, y, width,
+                      height);
+}
+
+void glScissorImpl(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    FILTER_STATE_CALL(scissor(x, y, width, height), glScissor, x, y, width,
+                      height);
+}
+
+void glColorMaskImpl(GLboolean red, GLboolean green, GLboolean blue,
+                     GLboolean alpha)
+{
+    FILTER_STATE_CALL(color_mask(red, green, blue, alpha), glColorMask, red,
+                      green, blue, alpha);
+}
+
+void glDepthMaskImpl(GLboolean flag)
+{
+    FILTER_STATE_CALL(depth_mask(flag), glDepthMask, flag);
+}
+
+void glDepthFuncImpl(GLenum func)
+{
+    FILTER_STATE_CALL(depth_func(func), glDepthFunc, func);
+}
+
+void glCullFaceImpl(GLenum mode)
+{
+    FILTER_STATE_CALL(cull_face(mode), glCullFace, mode);
+}
+
+void glFrontFaceImpl(GLenum mode)
+{
+    FILTER_STATE_CALL(front_face(mode), glFrontFace, mode);
+}
+
+#undef FILTER_STATE_CALL
+
+void glDeleteTexturesImpl(GLsizei n, const GLuint* textures)
+{
+    gles2().glDeleteTextures(n, textures);
+    if (auto filter = current_filter(); filter)
+        filter->deleted_textures(n, textures);
+}
+
+void glDeleteFramebuffersImpl(GLsizei n, const GLuint* framebuffers)
+{
+    gles2().glDeleteFramebuffers(n, framebuffers);
+    if (auto filter = current_filter(); filter)
+        filter->deleted_framebuffers(n, framebuffers);
+}
+
+void glDeleteRenderbuffersImpl(GLsizei n, const GLuint* renderbuffers)
+{
+    gles2().glDeleteRenderbuffers(n, renderbuffers);
+    if (auto filter = current_filter(); filter)
+        filter->deleted_renderbuffers(n, renderbuffers);
+}
+
+#undef GL_ENTRY
+#undef EGL_ENTRY
+#define GL_ENTRY(_r, _api, ...) _api ## Impl,
+#define EGL_ENTRY(_r, _api, ...) _api ## Impl,
+void fullPlatformImpl(platform_impl_t& pImpl)
+{
+    // clang-format off
+    platform_impl_t impl = {
+        #include "loader/platform_entries.in"
+    };
+    // clang-format on
+
+    memcpy(&pImpl, &impl, sizeof(platform_impl_t));
+}
+#undef GL_ENTRY
+#undef EGL_ENTRY
+
+/*
+ * EGL entry-points exposed to 3rd party applications
+ *
+ */
+
+// clang-format off
+static const std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType> sEntryMap = {
+#undef EGL_ENTRY
+#undef GL_ENTRY
+#define EGL_ENTRY(_r, _api, ...) {#_api, (__eglMustCastToProperFunctionPointerType)_api ## Impl},
+#define GL_ENTRY(_r, _api, ...)  {#_api, (__eglMustCastToProperFunctionPointerType)_api ## Impl},
+
+#include "loader/platform_entries.in"
+
+#undef GL_ENTRY
+#undef EGL_ENTRY
+
+    // EGL_EXT_platform_base
+    { "eglGetPlatformDisplayEXT", (__eglMustCastToProperFunctionPointerType)eglGetPlatformDisplayEXTImpl },
+    { "eglCreatePlatformWindowSurfaceEXT", (__eglMustCastToProperFunctionPointerType)eglCreatePlatformWindowSurfaceEXTImpl },
+
+    // EGL_WL_bind_wayland_display
+    { "eglBindWaylandDisplayWL", (__eglMustCastToProperFunctionPointerType)eglBindWaylandDisplayWLImpl },
+    { "eglUnbindWaylandDisplayWL", (__eglMustCastToProperFunctionPointerType)eglUnbindWaylandDisplayWLImpl },
+    { "eglQueryWaylandBufferWL", (__eglMustCastToProperFunctionPointerType)eglQueryWaylandBufferWLImpl },
+
+    // EGL_WLEGL_query_wayland_buffer
+    { "eglGetWaylandBufferNativeHandleWLEGL", (__eglMustCastToProperFunctionPointerType)eglGetWaylandBufferNativeHandleWLEGLImpl },
+    { "eglGetWaylandBufferHardwareBufferWLEGL", (__eglMustCastToProperFunctionPointerType)eglGetWaylandBufferHardwareBufferWLEGLImpl },
+
+    // GL_KHR_parallel_shader_compile
+    { "glMaxShaderCompilerThreadsKHR", (__eglMustCastToProperFunctionPointerType)glMaxShaderCompilerThreadsKHRImpl },
+};
+// clang-format on
+
+__eglMustCastToProperFunctionPointerType findProcAddress(const char* name)
+{
+    if (auto iter = sEntryMap.find(name); iter != sEntryMap.end())
+        return iter->second;
+    return nullptr;
+}
+
+namespace {
+template <auto a, auto b>
+constexpr bool same_entry = false;
+template <auto a>
+constexpr bool same_entry<a, a> = true;
+
+// an extension of the driver, called on the driver thread when the bound
+// context has one
+template <typename T, T gl_hooks_t::gl_ext_t::*api>
+struct gl_ext_thunk;
+
+template <typename R, typename... Args,
+          R (*gl_hooks_t::gl_ext_t::*api)(Args...)>
+struct gl_ext_thunk<R (*)(Args...), api>
+{
+    static R call(Args... args)
+    {
+        auto fn = g_egl_system->glext.*api;
+        auto thread = egl_gl_thread_t::current();
+        if (!thread)
+            return fn(args...);
+
+        auto& vertex_arrays = thread->vertex_arrays;
+        using ext = gl_hooks_t::gl_ext_t;
+        if constexpr (same_entry<api, &ext::glBindVertexArrayOES>)
+            vertex_arrays.bind_vertex_array(args...);
+        else if constexpr (same_entry<api, &ext::glDeleteVertexArraysOES>)
+            vertex_arrays.delete_vertex_arrays(args...);
+        return thread->call([&](const gl_hooks_t::gl_t&) {
+            return fn(args...);
+        });
+    }
+};
+
+// a core function libGLESv2 does not export, the GLES1 ones, called on
+// the driver thread the same way
+template <typename T, T gl_hooks_t::gl_t::*api>
+struct gl_thunk;
+
+template <typename R, typename... Args, R (*gl_hooks_t::gl_t::*api)(Args...)>
+struct gl_thunk<R (*)(Args...), api>
+{
+    static R call(Args... args)
+    {
+        auto thread = egl_gl_thread_t::current();
+        if (!thread)
+            return (getGlThreadSpecific()->gl.*api)(args...);
+        return thread->call([&](const gl_hooks_t::gl_t& gl) {
+            return (gl.*api)(args...);
+        });
+    }
+};
+
+// clang-format off
+const std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType> sGlThunkMap = {
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) {#_api, (__eglMustCastToProperFunctionPointerType)gl_thunk<decltype(gl_hooks_t::gl_t::_api), &gl_hooks_t::gl_t::_api>::call},
+
+#include "loader/entries.in"
+
+#undef GL_ENTRY
+};
+
+// where each hook of gl_t is
+const std::unordered_map<std::string_view, size_t> sGlHookOffsetMap = {
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) {#_api, offsetof(gl_hooks_t::gl_t, _api)},
+
+#include "loader/entries.in"
+
+#undef GL_ENTRY
+};
+
+const std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType> sGlExtThunkMap = {
+#undef GL_ENTRY
+#define GL_ENTRY(_r, _api, ...) {#_api, (__eglMustCastToProperFunctionPointerType)gl_ext_thunk<decltype(gl_hooks_t::gl_ext_t::_api), &gl_hooks_t::gl_ext_t::_api>::call},
+
+#include "loader/gles_ext_entries.in"
+
+#undef GL_ENTRY
+};
+// clang-format on
+} // namespace
+
+__eglMustCastToProperFunctionPointerType findWrappedProcAddress(
+    const char* name)
+{
+    auto system = g_egl_system;
+    auto driver_has = [system, name] {
+        return system->egl.eglGetProcAddress &&
+               system->egl.eglGetProcAddress(name);
+    };
+
+    // the core functions of libGLESv2 already go through the thread and
+    // the wrapper's own entries
+    static void* gles2 = [] {
+        void* lib = dlopen("libGLESv2.so.2", RTLD_LAZY | RTLD_NOLOAD);
+        return lib ? lib : dlopen("libGLESv2.so.2", RTLD_LAZY);
+    }();
+
+    // so do the OES and EXT names of those the wrapper implements, such as
+    // glBindFramebufferOES, once the driver's hook of the core name is set
+    auto has_hook = [system](const std::string& core) {
+        using hook_t = __eglMustCastToProperFunctionPointerType;
+        auto iter = sGlHookOffsetMap.find(core);
+        if (iter == sGlHookOffsetMap.end())
+            return false;
+        auto* gl = reinterpret_cast<const char*>(
+            &system->hooks[egl_system_t::GLESv2_INDEX].gl);
+        return *reinterpret_cast<const hook_t*>(gl + iter->second) != nullptr;
+    };
+    std::string_view view{name};
+    if (gles2 && view.size() > 5 &&
+        (view.substr(view.size() - 3) == "OES" ||
+         view.substr(view.size() - 3) == "EXT"))
+    {
+        std::string core{view.substr(0, view.size() - 3)};
+        if (findProcAddress(core.c_str()) && has_hook(core) && driver_has())
+        {
+            if (auto addr = dlsym(gles2, core.c_str()); addr)
+                return (__eglMustCastToProperFunctionPointerType)addr;
+        }
+    }
+
+    if (auto iter = sGlExtThunkMap.find(name); iter != sGlExtThunkMap.end())
+        return driver_has() ? iter->second : nullptr;
+
+    if (gles2)
+    {
+        if (auto addr = dlsym(gles2, name); addr)
+            return (__eglMustCastToProperFunctionPointerType)addr;
+    }
+
+    if (auto iter = sGlThunkMap.find(name); iter != sGlThunkMap.end())
+        return driver_has() ? iter->second : nullptr;
     return nullptr;
 }
 
@@ -0,0 +1,381 @@
+#include "egl_program_cache.h"
+#include "egl_cache.h"
+#include "loader/loader.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace egl_wrapper;
+
+namespace {
+// records of known good shaders and of program binaries
+constexpr char shader_tag = 'S';
+constexpr char program_tag = 'P';
+constexpr uint8_t shader_compiled = 1;
+
+constexpr uint64_t second_basis = 0x84222325cbf29ce4ull;
+
+std::mutex store_mutex;
+// opened by the first share group the cache is turned on for
+egl_cache_t* store = nullptr;
+
+bool open_store(const egl_program_cache_t::gl_t& gl)
+{
+    std::lock_guard lock{store_mutex};
+    static bool tried = false;
+    if (tried)
+        return store != nullptr;
+    tried = true;
+
+    uint64_t driver = egl_cache_t::driver_build(
+        reinterpret_cast<void*>(gl.glLinkProgram),
+        {(const char*)gl.glGetString(GL_VENDOR),
+         (const char*)gl.glGetString(GL_RENDERER),
+         (const char*)gl.glGetString(GL_VERSION)});
+
+    std::string dir = egl_cache_t::directory();
+    char name[64];
+    snprintf(name, sizeof(name), "/program_cache_%016llx.bin",
+             static_cast<unsigned long long>(driver));
+    auto cache = std::make_unique<egl_cache_t>();
+    if (dir.empty() ||
+        !cache->open(dir + name, driver, egl_cache_t::file_size()))
+        return false;
+    store = cache.release();
+    return true;
+}
+
+template <typename Digest>
+std::string record_key(char tag, const Digest& digest)
+{
+    std::string key(1 + sizeof(digest), tag);
+    memcpy(key.data() + 1, &digest, sizeof(digest));
+    return key;
+}
+} // namespace
+
+void egl_program_cache_t::probe(const gl_t& gl)
+{
+    std::lock_guard lock{mutex};
+    if (probed)
+        return;
+    probed = true;
+
+    int mode = utils::gen_env_option<int>("EGL_PROGRAM_CACHE",
+                                          {{"0", 0}, {"1", 1}}, -1);
+    if (mode == 0 || (mode < 0 && egl_cache_t::get().installed()))
+        return;
+    if (!gl.glProgramBinary || !gl.glGetProgramBinary ||
+        !gl.glProgramParameteri)
+        return;
+
+    // program binaries are core from OpenGL ES 3.0 on
+    auto version = (const char*)gl.glGetString(GL_VERSION);
+    if (!version || strncmp(version, "OpenGL ES ", 10) != 0 ||
+        atoi(version + 10) < 3)
+        return;
+
+    GLint count = 0;
+    gl.glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    if (count <= 0)
+        return;
+    formats.resize(count);
+    gl.glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+    active = open_store(gl);
+}
+
+void egl_program_cache_t::shader_source(const gl_t& gl, GLuint shader,
+                                        GLsizei count,
+                                        const GLchar* const* string,
+                                        const GLint* length)
+{
+    std::lock_guard lock{mutex};
+    auto& record = shaders[shader];
+    if (record.deleted)
+        record = {};
+    // the compile put off is of the source replaced now
+    if (record.pending)
+        flush(gl, shader, record);
+
+    gl.glShaderSource(shader, count, string, length);
+
+    record.has_source = count >= 0 && string;
+    // a source compiles to something else as another stage; asked after
+    // the driver took the source, so an error is still that call's
+    GLint type = GL_NONE;
+    gl.glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+    digest source{};
+    source.high = second_basis;
+    source.low = egl_cache_t::hash(&type, sizeof(type), source.low);
+    source.high = egl_cache_t::hash(&type, sizeof(type), source.high);
+    for (GLsizei i = 0; record.has_source && i < count; i++)
+    {
+        if (!string[i])
+        {
+            record.has_source = false;
+            break;
+        }
+        size_t size = length && length[i] >= 0 ? length[i] : strlen(string[i]);
+        source.low = egl_cache_t::hash(string[i], size, source.low);
+        source.high = egl_cache_t::hash(string[i], size, source.high);
+    }
+    record.source = source;
+}
+
+void egl_program_cache_t::compile_shader(const gl_t& gl, GLuint shader)
+{
+    std::lock_guard lock{mutex};
+    auto iter = shaders.find(shader);
+    if (iter == shaders.end() || !iter->second.has_source)
+    {
+        gl.glCompileShader(shader);
+        return;
+    }
+
+    auto& record = iter->second;
+    record.compiled = record.source;
+    record.has_compiled = true;
+    // only a source that compiled before can report success unseen
+    std::string key = record_key(shader_tag, record.compiled);
+    record.pending = store->get(key.data(), key.size(), nullptr, 0) > 0;
+    if (!record.pending)
+        gl.glCompileShader(shader);
+}
+
+bool egl_program_cache_t::get_shader(GLuint shader, GLenum pname,
+                                     GLint* params)
+{
+    std::lock_guard lock{mutex};
+    auto iter = shaders.find(shader);
+    if (iter == shaders.end() || !iter->second.pending || !params)
+        return false;
+
+    switch (pname)
+    {
+    case GL_COMPILE_STATUS:
+        *params = GL_TRUE;
+        return true;
+    case GL_INFO_LOG_LENGTH:
+        *params = 0;
+        return true;
+    }
+    return false;
+}
+
+bool egl_program_cache_t::get_shader_info_log(GLuint shader,
+                                              GLsizei buf_size,
+                                              GLsizei* length,
+                                              GLchar* info_log)
+{
+    std::lock_guard lock{mutex};
+    auto iter = shaders.find(shader);
+    if (iter == shaders.end() || !iter->second.pending || buf_size < 0)
+        return false;
+
+    if (length)
+        *length = 0;
+    if (buf_size > 0 && info_log)
+        info_log[0] = '\0';
+    return true;
+}
+
+void egl_program_cache_t::delete_shader(const gl_t& gl, GLuint shader)
+{
+    std::lock_guard lock{mutex};
+    if (auto iter = shaders.find(shader); iter != shaders.end())
+    {
+        if (iter->second.pending)
+            iter->second.deleted = true;
+        else
+            shaders.erase(iter);
+    }
+    gl.glDeleteShader(shader);
+}
+
+void egl_program_cache_t::link_program(const gl_t& gl, GLuint program)
+{
+    std::lock_guard lock{mutex};
+    GLint count = 0;
+    gl.glGetProgramiv(program, GL_ATTACHED_SHADERS, &count);
+    std::vector<GLuint> attached(std::max(count, 0));
+    if (count > 0)
+        gl.glGetAttachedShaders(program, count, &count, attached.data());
+    attached.resize(std::max(count, 0));
+
+    // the shaders as compiled, in an order not depending on attaching
+    std::vector<std::pair<uint64_t, uint64_t>> parts;
+    bool cacheable = !attached.empty();
+    for (GLuint shader : attached)
+    {
+        auto iter = shaders.find(shader);
+        if (iter == shaders.end() || !iter->second.has_compiled)
+        {
+            cacheable = false;
+            break;
+        }
+        parts.emplace_back(iter->second.compiled.low,
+                           iter->second.compiled.high);
+    }
+    std::sort(parts.begin(), parts.end());
+
+    std::string state;
+    for (const auto& part : parts)
+        state.append(reinterpret_cast<const char*>(&part), sizeof(part));
+    if (auto iter = programs.find(program); iter != programs.end())
+    {
+        const auto& record = iter->second;
+        for (const auto& [name, index] : record.attribs)
+            state += "a" + name + '\0' + std::to_string(index) + '\0';
+        for (const auto& name : record.varyings)
+            state += "v" + name + '\0';
+        state += "m" + std::to_string(record.varying_mode) + "s" +
+                 std::to_string(record.separable);
+    }
+    digest link_state{egl_cache_t::hash(state.data(), state.size()),
+                      egl_cache_t::hash(state.data(), state.size(),
+                                        second_basis)};
+    std::string key = record_key(program_tag, link_state);
+
+    if (!cacheable || !load_binary(gl, program, key))
+    {
+        for (GLuint shader : attached)
+        {
+            if (auto iter = shaders.find(shader);
+                iter != shaders.end() && iter->second.pending)
+                flush(gl, shader, iter->second);
+        }
+        gl.glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                               GL_TRUE);
+        gl.glLinkProgram(program);
+        if (cacheable)
+            store_binary(gl, program, key);
+    }
+
+    // shaders deleted while their compile was put off are gone once no
+    // program holds them
+    for (auto iter = shaders.begin(); iter != shaders.end();)
+    {
+        if (iter->second.deleted && !gl.glIsShader(iter->first))
+            iter = shaders.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void egl_program_cache_t::delete_program(GLuint program)
+{
+    std::lock_guard lock{mutex};
+    programs.erase(program);
+}
+
+void egl_program_cache_t::bind_attrib_location(GLuint program, GLuint index,
+                                               const GLchar* name)
+{
+    std::lock_guard lock{mutex};
+    if (name)
+        programs[program].attribs[name] = index;
+}
+
+void egl_program_cache_t::program_parameter(GLuint program, GLenum pname,
+                                            GLint value)
+{
+    std::lock_guard lock{mutex};
+    if (pname == GL_PROGRAM_SEPARABLE)
+        programs[program].separable = value;
+}
+
+void egl_program_cache_t::transform_feedback_varyings(
+    GLuint program, GLsizei count, const GLchar* const* varyings,
+    GLenum buffer_mode)
+{
+    std::lock_guard lock{mutex};
+    auto& record = programs[program];
+    record.varyings.clear();
+    for (GLsizei i = 0; varyings && i < count; i++)
+        record.varyings.emplace_back(varyings[i] ? varyings[i] : "");
+    record.varying_mode = buffer_mode;
+}
+
+void egl_program_cache_t::flush(const gl_t& gl, GLuint shader,
+                                shader_record& record)
+{
+    record.pending = false;
+    gl.glCompileShader(shader);
+}
+
+bool egl_program_cache_t::load_binary(const gl_t& gl, GLuint program,
+                                      const std::string& key)
+{
+    size_t size = store->get(key.data(), key.size(), nullptr, 0);
+    if (size <= sizeof(GLenum))
+        return false;
+    std::vector<uint8_t> value(size);
+    if (store->get(key.data(), key.size(), value.data(), size) != size)
+        return false;
+
+    GLenum format;
+    memcpy(&format, value.data(), sizeof(format));
+    if (std::find(formats.begin(), formats.end(), (GLint)format) ==
+        formats.end())
+        return false;
+
+    gl.glProgramBinary(program, format, value.data() + sizeof(format),
+                       size - sizeof(format));
+    GLint status = GL_FALSE;
+    gl.glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+        logger::log_info() << "program binary rejected, linking " << program
+                           << " from source";
+    return status == GL_TRUE;
+}
+
+void egl_program_cache_t::store_binary(const gl_t& gl, GLuint program,
+                                       const std::string& key)
+{
+    GLint status = GL_FALSE;
+    gl.glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+        return;
+
+    GLint length = 0;
+    gl.glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<uint8_t> value(sizeof(GLenum) + length);
+    GLenum format = GL_NONE;
+    GLsizei written = 0;
+    gl.glGetProgramBinary(program, length, &written, &format,
+                          value.data() + sizeof(format));
+    if (written <= 0)
+        return;
+    memcpy(value.data(), &format, sizeof(format));
+    store->set(key.data(), key.size(), value.data(),
+               sizeof(format) + written);
+
+    // every shader of a linked program compiled
+    GLint count = 0;
+    gl.glGetProgramiv(program, GL_ATTACHED_SHADERS, &count);
+    std::vector<GLuint> attached(std::max(count, 0));
+    if (count > 0)
+        gl.glGetAttachedShaders(program, count, &count, attached.data());
+    for (GLsizei i = 0; i < count; i++)
+    {
+        if (auto iter = shaders.find(attached[i]); iter != shaders.end())
+        {
+            std::string shader_key =
+                record_key(shader_tag, iter->second.compiled);
+            store->set(shader_key.data(), shader_key.size(), &shader_compiled,
+                       sizeof(shader_compiled));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef EGL_PROGRAM_CACHE_H_
+#define EGL_PROGRAM_CACHE_H_
+
+#include "loader/hooks.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binaries of linked programs kept on disk, for drivers that compile every
+// shader again as they take no EGL_ANDROID_blob_cache.
+//
+// A compile is put off when the same source compiled before, and reports
+// success. A link of such shaders loads the binary stored for the same
+// sources and link state and compiles nothing. Anything the cache cannot
+// answer, a binary the driver rejects included, is compiled and linked
+// from the source as the app asked.
+//
+// One per share group, as shaders and programs are shared by it.
+//
+// EGL_PROGRAM_CACHE  0 to never use it, 1 to use it even when the driver
+//                    has a blob cache
+class egl_program_cache_t {
+  public:
+    using gl_t = egl_wrapper::gl_hooks_t::gl_t;
+
+    // turn it on if the current context can load program binaries, once
+    void probe(const gl_t& gl);
+    bool enabled() const
+    {
+        return active.load(std::memory_order_acquire);
+    }
+
+    void shader_source(const gl_t& gl, GLuint shader, GLsizei count,
+                       const GLchar* const* string, const GLint* length);
+    void compile_shader(const gl_t& gl, GLuint shader);
+    // false when the driver has to answer
+    bool get_shader(GLuint shader, GLenum pname, GLint* params);
+    bool get_shader_info_log(GLuint shader, GLsizei buf_size,
+                             GLsizei* length, GLchar* info_log);
+    void delete_shader(const gl_t& gl, GLuint shader);
+
+    void link_program(const gl_t& gl, GLuint program);
+    void delete_program(GLuint program);
+    void bind_attrib_location(GLuint program, GLuint index,
+                              const GLchar* name);
+    void program_parameter(GLuint program, GLenum pname, GLint value);
+    void transform_feedback_varyings(GLuint program, GLsizei count,
+                                     const GLchar* const* varyings,
+                                     GLenum buffer_mode);
+
+  private:
+    struct digest
+    {
+        uint64_t low = 0;
+        uint64_t high = 0;
+    };
+
+    struct shader_record
+    {
+        digest source;
+        // of the source at the last compile, what a link uses
+        digest compiled;
+        bool has_source = false;
+        bool has_compiled = false;
+        // compile put off
+        bool pending = false;
+        // deleted while pending, kept for the program it is attached to
+        bool deleted = false;
+    };
+
+    // the state a link bakes into the binary
+    struct program_record
+    {
+        std::map<std::string, GLuint> attribs;
+        std::vector<std::string> varyings;
+        GLenum varying_mode = GL_NONE;
+        GLint separable = GL_FALSE;
+    };
+
+    void flush(const gl_t& gl, GLuint shader, shader_record& record);
+    bool load_binary(const gl_t& gl, GLuint program, const std::string& key);
+    void store_binary(const gl_t& gl, GLuint program, const std::string& key);
+
+    std::mutex mutex;
+    bool probed = false;
+    std::atomic<bool> active{false};
+    std::vector<GLint> formats;
+    std::unordered_map<GLuint, shader_record> shaders;
+    std::unordered_map<GLuint, program_record> programs;
+};
+
+#endif // EGL_PROGRAM_CACHE_H_
@@ -0,0 +1,308 @@
+#include "egl_state_filter.h"
+
+#include "utils.h"
+#include "logger.h"
+
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+// clang-format off
+constexpr GLenum texture_target_list[] = {
+    GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_EXTERNAL_OES,
+    GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY,
+};
+
+constexpr GLenum cap_list[] = {
+    GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_DITHER,
+    GL_POLYGON_OFFSET_FILL, GL_SAMPLE_ALPHA_TO_COVERAGE, GL_SAMPLE_COVERAGE,
+    GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_RASTERIZER_DISCARD,
+    GL_PRIMITIVE_RESTART_FIXED_INDEX,
+};
+// clang-format on
+
+// position of value in list, -1 when it is not there
+template <size_t N>
+int index_of(const GLenum (&list)[N], GLenum value)
+{
+    auto it = std::find(std::begin(list), std::end(list), value);
+    return it == std::end(list) ? -1 : static_cast<int>(it - std::begin(list));
+}
+
+// the binding of a deleted object goes back to 0
+void unbind(GLuint& binding, GLsizei n, const GLuint* names)
+{
+    for (GLsizei i = 0; names && i < n; i++)
+    {
+        if (names[i] && binding == names[i])
+            binding = 0;
+    }
+}
+} // namespace
+
+egl_state_filter_t::egl_state_filter_t(share_group_t share_group)
+    : deletions{share_group ? std::move(share_group)
+                            : std::make_shared<std::atomic<uint64_t>>(0)}
+{
+    static_assert(std::size(texture_target_list) == texture_targets);
+    static_assert(std::size(cap_list) == caps);
+    seen_deletions = deletions->load(std::memory_order_acquire);
+    invalidate();
+}
+
+egl_state_filter_t::~egl_state_filter_t()
+{
+    log_counters();
+}
+
+void egl_state_filter_t::log_counters() const
+{
+    logger::log_info() << "state filter dropped " << stats.filtered << " of "
+                       << stats.calls << " calls";
+}
+
+void egl_state_filter_t::count(bool dropped)
+{
+    stats.calls++;
+    if (dropped)
+        stats.filtered++;
+    if (stats.calls % log_period == 0)
+        log_counters();
+}
+
+bool egl_state_filter_t::enabled()
+{
+    static bool enabled =
+        utils::gen_env_option<bool>("EGL_STATE_FILTER", {{"1", true}});
+    return enabled;
+}
+
+void egl_state_filter_t::invalidate()
+{
+    active_unit = unknown;
+    forget_objects();
+    std::fill(std::begin(capabilities), std::end(capabilities), unknown);
+    blend.known = false;
+    blend_equations.known = false;
+    viewport_rect.known = false;
+    scissor_rect.known = false;
+    color_writes = unknown;
+    depth_writes = unknown;
+    depth_test_func = unknown;
+    cull_face_mode = unknown;
+    front_face_mode = unknown;
+}
+
+void egl_state_filter_t::forget_objects()
+{
+    for (auto& unit : textures)
+        std::fill(std::begin(unit), std::end(unit), unknown);
+    array_buffer = unknown;
+    draw_framebuffer = unknown;
+    read_framebuffer = unknown;
+    renderbuffer = unknown;
+    program = unknown;
+}
+
+void egl_state_filter_t::check_deletions()
+{
+    uint64_t current = deletions->load(std::memory_order_acquire);
+    if (current != seen_deletions)
+    {
+        seen_deletions = current;
+        forget_objects();
+    }
+}
+
+void egl_state_filter_t::deleted()
+{
+    uint64_t previous = deletions->fetch_add(1, std::memory_order_acq_rel);
+    if (previous != seen_deletions)
+        forget_objects();
+    seen_deletions = previous + 1;
+}
+
+bool egl_state_filter_t::update(GLuint& shadowed, GLuint value)
+{
+    bool same = shadowed == value;
+    count(same);
+    shadowed = value;
+    return !same;
+}
+
+template <typename T>
+bool egl_state_filter_t::update(shadow_t<T>& shadowed, const T& value)
+{
+    bool changed = shadowed.set(value);
+    count(!changed);
+    return changed;
+}
+
+bool egl_state_filter_t::active_texture(GLenum unit)
+{
+    // an error leaves the unit as it was
+    if (unit < GL_TEXTURE0 || unit - GL_TEXTURE0 >= max_units)
+    {
+        active_unit = unknown;
+        return true;
+    }
+    return update(active_unit, unit - GL_TEXTURE0);
+}
+
+bool egl_state_filter_t::bind_texture(GLenum target, GLuint texture)
+{
+    check_deletions();
+    int index = index_of(texture_target_list, target);
+    if (index < 0 || active_unit == unknown)
+        return true;
+    return update(textures[active_unit][index], texture);
+}
+
+bool egl_state_filter_t::bind_buffer(GLenum target, GLuint buffer)
+{
+    // the others belong to a vertex array object or are also set by
+    // glBindBufferBase
+    if (target != GL_ARRAY_BUFFER)
+        return true;
+    check_deletions();
+    return update(array_buffer, buffer);
+}
+
+bool egl_state_filter_t::bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+    check_deletions();
+    switch (target)
+    {
+    case GL_FRAMEBUFFER:
+        if (draw_framebuffer == framebuffer && read_framebuffer == framebuffer)
+            return update(draw_framebuffer, framebuffer);
+        draw_framebuffer = framebuffer;
+        read_framebuffer = framebuffer;
+        count(false);
+        return true;
+    case GL_DRAW_FRAMEBUFFER:
+        return update(draw_framebuffer, framebuffer);
+    case GL_READ_FRAMEBUFFER:
+        return update(read_framebuffer, framebuffer);
+    }
+    return true;
+}
+
+bool egl_state_filter_t::bind_renderbuffer(GLenum target, GLuint renderbuffer)
+{
+    if (target != GL_RENDERBUFFER)
+        return true;
+    check_deletions();
+    return update(this->renderbuffer, renderbuffer);
+}
+
+bool egl_state_filter_t::use_program(GLuint program)
+{
+    check_deletions();
+    return update(this->program, program);
+}
+
+bool egl_state_filter_t::enable(GLenum cap, bool enable)
+{
+    int index = index_of(cap_list, cap);
+    if (index < 0)
+        return true;
+    return update(capabilities[index], enable);
+}
+
+bool egl_state_filter_t::blend_func(GLenum src_rgb, GLenum dst_rgb,
+                                    GLenum src_alpha, GLenum dst_alpha)
+{
+    return update(blend, blend_func_t{src_rgb, dst_rgb, src_alpha, dst_alpha});
+}
+
+bool egl_state_filter_t::blend_equation(GLenum rgb, GLenum alpha)
+{
+    return update(blend_equations, uint64_t{rgb} << 32 | alpha);
+}
+
+bool egl_state_filter_t::viewport(GLint x, GLint y, GLsizei width,
+                                  GLsizei height)
+{
+    // the driver takes nothing from a call it fails
+    if (width < 0 || height < 0)
+        return true;
+    return update(viewport_rect, rect_t{x, y, width, height});
+}
+
+bool egl_state_filter_t::scissor(GLint x, GLint y, GLsizei width,
+                                 GLsizei height)
+{
+    if (width < 0 || height < 0)
+        return true;
+    return update(scissor_rect, rect_t{x, y, width, height});
+}
+
+bool egl_state_filter_t::color_mask(GLboolean red, GLboolean green,
+                                    GLboolean blue, GLboolean alpha)
+{
+    GLuint mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) |
+                  (alpha ? 8 : 0);
+    return update(color_writes, mask);
+}
+
+bool egl_state_filter_t::depth_mask(GLboolean flag)
+{
+    return update(depth_writes, flag ? 1 : 0);
+}
+
+bool egl_state_filter_t::depth_func(GLenum func)
+{
+    return update(depth_test_func, func);
+}
+
+bool egl_state_filter_t::cull_face(GLenum mode)
+{
+    return update(cull_face_mode, mode);
+}
+
+bool egl_state_filter_t::front_face(GLenum mode)
+{
+    return update(front_face_mode, mode);
+}
+
+void egl_state_filter_t::deleted_textures(GLsizei n, const GLuint* textures)
+{
+    for (auto& unit : this->textures)
+    {
+        for (auto& binding : unit)
+            unbind(binding, n, textures);
+    }
+    deleted();
+}
+
+void egl_state_filter_t::deleted_buffers(GLsizei n, const GLuint* buffers)
+{
+    unbind(array_buffer, n, buffers);
+    deleted();
+}
+
+void egl_state_filter_t::deleted_framebuffers(GLsizei n,
+                                              const GLuint* framebuffers)
+{
+    // not shared, nothing for the other contexts to forget
+    unbind(draw_framebuffer, n, framebuffers);
+    unbind(read_framebuffer, n, framebuffers);
+}
+
+void egl_state_filter_t::deleted_renderbuffers(GLsizei n,
+                                               const GLuint* renderbuffers)
+{
+    unbind(renderbuffer, n, renderbuffers);
+    deleted();
+}
+
+void egl_state_filter_t::linked_program(GLuint program)
+{
+    // binding it again is how a program linked on a worker takes effect
+    if (this->program == program)
+        this->program = unknown;
+}
@@ -0,0 +1,162 @@
+#ifndef EGL_STATE_FILTER_H_
+#define EGL_STATE_FILTER_H_
+
+#include "loader/hooks.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+// A shadow of the bindings and fixed function state of a context, so a
+// call setting what is already set never reaches the driver. UI toolkits
+// bind the same texture and program and enable blending before every
+// quad.
+//
+// Nothing is assumed of a context: a value is known once a call set it,
+// and forgotten when the wrapper makes the context current, since it may
+// have changed it itself then. Deleting an object unbinds it in the
+// context deleting it; in the other contexts of its share group only its
+// name may come back for a new object, so they forget their bindings.
+//
+// One per GLES2 context, made with it; the counters are logged every
+// log_period calls and when it goes.
+//
+// EGL_STATE_FILTER  1 to drop state calls that change nothing
+class egl_state_filter_t {
+  public:
+    // deletions in the share group
+    using share_group_t = std::shared_ptr<std::atomic<uint64_t>>;
+
+    struct counters_t
+    {
+        uint64_t calls = 0;
+        uint64_t filtered = 0;
+    };
+
+    explicit egl_state_filter_t(share_group_t share_group);
+    ~egl_state_filter_t();
+
+    // EGL_STATE_FILTER
+    static bool enabled();
+
+    // each returns false when the call changes nothing and is dropped
+    bool active_texture(GLenum unit);
+    bool bind_texture(GLenum target, GLuint texture);
+    bool bind_buffer(GLenum target, GLuint buffer);
+    bool bind_framebuffer(GLenum target, GLuint framebuffer);
+    bool bind_renderbuffer(GLenum target, GLuint renderbuffer);
+    bool use_program(GLuint program);
+    bool enable(GLenum cap, bool enable);
+    bool blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha,
+                    GLenum dst_alpha);
+    bool blend_equation(GLenum rgb, GLenum alpha);
+    bool viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    bool scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+    bool color_mask(GLboolean red, GLboolean green, GLboolean blue,
+                    GLboolean alpha);
+    bool depth_mask(GLboolean flag);
+    bool depth_func(GLenum func);
+    bool cull_face(GLenum mode);
+    bool front_face(GLenum mode);
+
+    // after the driver deleted or relinked them
+    void deleted_textures(GLsizei n, const GLuint* textures);
+    void deleted_buffers(GLsizei n, const GLuint* buffers);
+    void deleted_framebuffers(GLsizei n, const GLuint* framebuffers);
+    void deleted_renderbuffers(GLsizei n, const GLuint* renderbuffers);
+    void linked_program(GLuint program);
+
+    // forget everything, the driver's state may differ now
+    void invalidate();
+
+    share_group_t share_group() const { return deletions; }
+    const counters_t& counters() const { return stats; }
+
+    egl_state_filter_t(const egl_state_filter_t&) = delete;
+    egl_state_filter_t& operator=(const egl_state_filter_t&) = delete;
+
+  private:
+    static constexpr GLuint unknown = ~0u;
+    static constexpr uint64_t log_period = 1 << 20;
+    static constexpr GLuint max_units = 32;
+    // 2D, cube map, external, 3D, 2D array
+    static constexpr int texture_targets = 5;
+    // the capabilities of glEnable it knows
+    static constexpr int caps = 11;
+
+    // a value of several parts, set by one call
+    template <typename T>
+    struct shadow_t
+    {
+        bool known = false;
+        T value{};
+
+        bool set(const T& v)
+        {
+            if (known && value == v)
+                return false;
+            known = true;
+            value = v;
+            return true;
+        }
+    };
+
+    // a call seen, and whether it was dropped
+    void count(bool dropped);
+    void log_counters() const;
+    // counted, and false when the value is already what the driver has
+    bool update(GLuint& shadowed, GLuint value);
+    template <typename T>
+    bool update(shadow_t<T>& shadowed, const T& value);
+    // another context of the share group deleted objects
+    void check_deletions();
+    // this one did
+    void deleted();
+    void forget_objects();
+
+    GLuint active_unit = unknown;
+    GLuint textures[max_units][texture_targets];
+    GLuint array_buffer = unknown;
+    GLuint draw_framebuffer = unknown;
+    GLuint read_framebuffer = unknown;
+    GLuint renderbuffer = unknown;
+    GLuint program = unknown;
+    GLuint capabilities[caps];
+
+    struct blend_func_t
+    {
+        GLenum src_rgb, dst_rgb, src_alpha, dst_alpha;
+        bool operator==(const blend_func_t& o) const
+        {
+            return src_rgb == o.src_rgb && dst_rgb == o.dst_rgb &&
+                   src_alpha == o.src_alpha && dst_alpha == o.dst_alpha;
+        }
+    };
+    struct rect_t
+    {
+        GLint x, y;
+        GLsizei width, height;
+        bool operator==(const rect_t& o) const
+        {
+            return x == o.x && y == o.y && width == o.width &&
+                   height == o.height;
+        }
+    };
+
+    shadow_t<blend_func_t> blend;
+    shadow_t<uint64_t> blend_equations;
+    shadow_t<rect_t> viewport_rect;
+    shadow_t<rect_t> scissor_rect;
+    GLuint color_writes = unknown;
+    GLuint depth_writes = unknown;
+    GLuint depth_test_func = unknown;
+    GLuint cull_face_mode = unknown;
+    GLuint front_face_mode = unknown;
+
+    share_group_t deletions;
+    uint64_t seen_deletions = 0;
+    counters_t stats;
+};
+
+#endif // EGL_STATE_FILTER_H_
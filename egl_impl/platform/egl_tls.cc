@@ -4,15 +4,7 @@ namespace egl_wrapper {
 
 thread_local egl_tls_t egl_tls{};
 
-void egl_tls_t::clearError()
-{
-    egl_tls.error = EGL_SUCCESS;
-}
-
-EGLint egl_tls_t::getError()
-{
-    return egl_tls.error;
-}
+std::atomic<uint64_t> egl_tls_t::generation{0};
 
 void egl_tls_t::setErrorImpl(EGLint err)
 {
@@ -22,6 +14,8 @@ void egl_tls_t::setErrorImpl(EGLint err)
 void egl_tls_t::clearTLS()
 {
     egl_tls.error = EGL_SUCCESS;
+    egl_tls.driver_skipped = false;
+    egl_tls.current = {};
 }
 
 thread_local gl_hooks_t const* tls_hook{};
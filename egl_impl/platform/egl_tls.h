@@ -5,18 +5,79 @@
 
 #include <EGL/egl.h>
 
+#include <atomic>
+
 namespace egl_wrapper {
 class egl_tls_t {
     EGLint error = EGL_SUCCESS;
+    // the last entry point was answered without calling the driver, so
+    // the driver's error is from an older call
+    bool driver_skipped = false;
 
   public:
+    // what eglMakeCurrent bound on this thread, EGL_NO_* when nothing
+    struct current_t
+    {
+        EGLDisplay dpy = EGL_NO_DISPLAY;
+        EGLSurface draw = EGL_NO_SURFACE;
+        EGLSurface read = EGL_NO_SURFACE;
+        EGLContext ctx = EGL_NO_CONTEXT;
+        // generation when it was bound
+        uint64_t generation = 0;
+    } current;
+
+    // bumped whenever a context or surface is destroyed or a display
+    // terminated; a binding recorded before may name a dead handle and
+    // must be checked by the driver again
+    static std::atomic<uint64_t> generation;
+
+    // every entry point clears the error, inline to keep that to a store
     static void clearError();
     static EGLint getError();
     static void setErrorImpl(EGLint);
 
+    static void skipDriver();
+    static bool driverSkipped();
+
+    static current_t& getCurrent();
+    static void invalidateCurrent();
+
     static void clearTLS();
 };
 
+extern thread_local egl_tls_t egl_tls;
+
+inline void egl_tls_t::clearError()
+{
+    egl_tls.error = EGL_SUCCESS;
+    egl_tls.driver_skipped = false;
+}
+
+inline EGLint egl_tls_t::getError()
+{
+    return egl_tls.error;
+}
+
+inline void egl_tls_t::skipDriver()
+{
+    egl_tls.driver_skipped = true;
+}
+
+inline bool egl_tls_t::driverSkipped()
+{
+    return egl_tls.driver_skipped;
+}
+
+inline egl_tls_t::current_t& egl_tls_t::getCurrent()
+{
+    return egl_tls.current;
+}
+
+inline void egl_tls_t::invalidateCurrent()
+{
+    generation.fetch_add(1, std::memory_order_release);
+}
+
 #define setError(_e, _r)                                                       \
     ({                                                                         \
         ::egl_wrapper::egl_tls_t::setErrorImpl(_e);                            \
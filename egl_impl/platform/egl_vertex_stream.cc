@@ -0,0 +1,467 @@
+#include "egl_vertex_stream.h"
+
+#include "utils.h"
+
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr uint32_t bit(GLuint index)
+{
+    return 1u << index;
+}
+
+// bytes of one vertex of an array, 0 for a type it does not know
+GLsizei element_bytes(GLint size, GLenum type)
+{
+    switch (type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return size;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+    case GL_HALF_FLOAT_OES:
+        return size * 2;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+    case GL_FIXED:
+        return size * 4;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return 4;
+    }
+    return 0;
+}
+
+GLsizei index_bytes(GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    case GL_UNSIGNED_INT:
+        return 4;
+    }
+    return 0;
+}
+
+constexpr GLintptr align(GLintptr offset)
+{
+    return (offset + 15) & ~GLintptr{15};
+}
+
+// lowest and highest index, false when the highest is the primitive
+// restart index of its type, which the driver may take as such
+template <typename T>
+bool index_range(const void* indices, GLsizei count, GLuint& lo, GLuint& hi)
+{
+    auto begin = static_cast<const T*>(indices);
+    auto [min, max] = std::minmax_element(begin, begin + count);
+    lo = *min;
+    hi = *max;
+    return *max != std::numeric_limits<T>::max();
+}
+
+// the restart index stays what it is
+template <typename T>
+void rebase(const void* indices, GLsizei count, GLuint base, uint8_t* to)
+{
+    constexpr T restart = std::numeric_limits<T>::max();
+    auto from = static_cast<const T*>(indices);
+    auto out = reinterpret_cast<T*>(to);
+    for (GLsizei i = 0; i < count; i++)
+        out[i] = from[i] == restart ? restart : static_cast<T>(from[i] - base);
+}
+} // namespace
+
+bool egl_vertex_stream_t::enabled()
+{
+    static bool enabled =
+        utils::gen_env_option<bool>("EGL_VERTEX_STREAM", {{"1", true}});
+    return enabled;
+}
+
+void egl_vertex_stream_t::probe(const gl_t& gl)
+{
+    probed = true;
+    GLint max_vertex_attribs = 0;
+    gl.glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &max_vertex_attribs);
+    attrib_count = std::clamp<GLint>(max_vertex_attribs, 0, max_attribs);
+}
+
+bool egl_vertex_stream_t::default_vertex_array(const gl_t& gl)
+{
+    if (!probed)
+        probe(gl);
+    return vertex_array == 0;
+}
+
+void egl_vertex_stream_t::bind_buffer(const gl_t& gl, GLenum target,
+                                      GLuint buffer)
+{
+    gl.glBindBuffer(target, buffer);
+    if (target == GL_ARRAY_BUFFER)
+        array_buffer = buffer;
+    else if (target == GL_ELEMENT_ARRAY_BUFFER && default_vertex_array(gl))
+        element_buffer = buffer;
+}
+
+void egl_vertex_stream_t::bind_vertex_array(const gl_t& gl, GLuint array)
+{
+    if (!gl.glBindVertexArray)
+        return;
+    gl.glBindVertexArray(array);
+    vertex_array = array;
+}
+
+void egl_vertex_stream_t::delete_vertex_arrays(const gl_t& gl, GLsizei n,
+                                               const GLuint* arrays)
+{
+    if (!gl.glDeleteVertexArrays)
+        return;
+    gl.glDeleteVertexArrays(n, arrays);
+    // deleting the bound one binds 0 again
+    for (GLsizei i = 0; arrays && i < n; i++)
+    {
+        if (arrays[i] && arrays[i] == vertex_array)
+            vertex_array = 0;
+    }
+}
+
+void egl_vertex_stream_t::delete_buffers(const gl_t& gl, GLsizei n,
+                                         const GLuint* buffers)
+{
+    gl.glDeleteBuffers(n, buffers);
+    // only the bindings of the bound vertex array object are reset
+    bool tracked = default_vertex_array(gl);
+    for (GLsizei i = 0; buffers && i < n; i++)
+    {
+        if (!buffers[i])
+            continue;
+        if (array_buffer == buffers[i])
+            array_buffer = 0;
+        if (!tracked)
+            continue;
+        if (element_buffer == buffers[i])
+            element_buffer = 0;
+        for (GLuint index = 0; index < attrib_count; index++)
+        {
+            // left without memory, the draws go to the driver as they are
+            if (attribs[index].buffer == buffers[i])
+            {
+                attribs[index].buffer = 0;
+                attribs[index].pointer = nullptr;
+            }
+        }
+    }
+}
+
+void egl_vertex_stream_t::attrib_pointer(const gl_t& gl, GLuint index,
+                                         GLint size, GLenum type,
+                                         GLboolean normalized, bool integer,
+                                         GLsizei stride, const void* pointer)
+{
+    if (integer && !gl.glVertexAttribIPointer)
+        return;
+    if (integer)
+        gl.glVertexAttribIPointer(index, size, type, stride, pointer);
+    else
+        gl.glVertexAttribPointer(index, size, type, normalized, stride,
+                                 pointer);
+    if (!default_vertex_array(gl) || index >= attrib_count)
+        return;
+
+    auto& attrib = attribs[index];
+    attrib.size = size;
+    attrib.type = type;
+    attrib.normalized = normalized;
+    attrib.integer = integer;
+    attrib.stride = stride;
+    attrib.buffer = array_buffer;
+    attrib.pointer = pointer;
+    redirected &= ~bit(index);
+}
+
+void egl_vertex_stream_t::enable_array(const gl_t& gl, GLuint index,
+                                       bool enable)
+{
+    if (enable)
+        gl.glEnableVertexAttribArray(index);
+    else
+        gl.glDisableVertexAttribArray(index);
+    if (default_vertex_array(gl) && index < attrib_count)
+        attribs[index].enabled = enable;
+}
+
+void egl_vertex_stream_t::attrib_divisor(const gl_t& gl, GLuint index,
+                                         GLuint divisor)
+{
+    if (!gl.glVertexAttribDivisor)
+        return;
+    gl.glVertexAttribDivisor(index, divisor);
+    if (default_vertex_array(gl) && index < attrib_count)
+        attribs[index].divisor = divisor;
+}
+
+uint32_t egl_vertex_stream_t::client_arrays(bool& all_client)
+{
+    uint32_t arrays = 0;
+    all_client = true;
+    for (GLuint index = 0; index < attrib_count; index++)
+    {
+        const auto& attrib = attribs[index];
+        if (!attrib.enabled)
+            continue;
+        if (attrib.buffer)
+        {
+            all_client = false;
+            continue;
+        }
+        // read per instance, not from the first vertex on
+        if (!attrib.pointer || attrib.divisor ||
+            !element_bytes(attrib.size, attrib.type))
+            return 0;
+        arrays |= bit(index);
+    }
+    return arrays;
+}
+
+GLintptr egl_vertex_stream_t::reserve(const gl_t& gl, ring_t& ring,
+                                      GLsizeiptr size)
+{
+    if (size > ring.capacity)
+        return -1;
+
+    if (!ring.buffer)
+        gl.glGenBuffers(1, &ring.buffer);
+    gl.glBindBuffer(ring.target, ring.buffer);
+    if (ring.size == 0 || ring.offset + size > ring.size)
+    {
+        // the draws still reading the old storage keep it, the driver
+        // hands out new storage instead of waiting for them
+        gl.glBufferData(ring.target, ring.capacity, nullptr, GL_STREAM_DRAW);
+        ring.size = ring.capacity;
+        ring.offset = 0;
+    }
+
+    GLintptr offset = ring.offset;
+    ring.offset = align(offset + size);
+    return offset;
+}
+
+bool egl_vertex_stream_t::stream_vertices(const gl_t& gl, uint32_t arrays,
+                                          GLuint first, GLuint last)
+{
+    // interleaved arrays overlap and are copied once
+    spans.clear();
+    GLsizeiptr total = 0;
+    for (GLuint index = 0; index < attrib_count; index++)
+    {
+        if (!(arrays & bit(index)))
+            continue;
+        const auto& attrib = attribs[index];
+        GLsizei bytes = element_bytes(attrib.size, attrib.type);
+        GLsizei stride = attrib.stride ? attrib.stride : bytes;
+        auto begin = static_cast<const uint8_t*>(attrib.pointer) +
+                     size_t{first} * stride;
+        auto end = begin + size_t{last - first} * stride + bytes;
+
+        auto span = std::find_if(spans.begin(), spans.end(), [&](auto& s) {
+            return s.stride == stride && begin < s.end && s.begin < end;
+        });
+        if (span != spans.end())
+        {
+            span->begin = std::min(span->begin, begin);
+            span->end = std::max(span->end, end);
+        }
+        else
+        {
+            spans.push_back({begin, end, stride, 0});
+        }
+    }
+    for (const auto& span : spans)
+        total += align(span.end - span.begin) + 16;
+
+    GLintptr offset = reserve(gl, vertex_ring, total);
+    if (offset < 0)
+    {
+        gl.glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+        return false;
+    }
+
+    // at the alignment the app's memory has, which the driver may expect
+    for (auto& span : spans)
+    {
+        span.offset = align(offset) + (uintptr_t(span.begin) & 15);
+        gl.glBufferSubData(GL_ARRAY_BUFFER, span.offset,
+                           span.end - span.begin, span.begin);
+        offset = span.offset + (span.end - span.begin);
+    }
+
+    for (GLuint index = 0; index < attrib_count; index++)
+    {
+        if (!(arrays & bit(index)))
+            continue;
+        const auto& attrib = attribs[index];
+        GLsizei stride = attrib.stride
+                             ? attrib.stride
+                             : element_bytes(attrib.size, attrib.type);
+        auto begin = static_cast<const uint8_t*>(attrib.pointer) +
+                     size_t{first} * stride;
+        auto span = std::find_if(spans.begin(), spans.end(), [&](auto& s) {
+            return s.stride == stride && s.begin <= begin && begin < s.end;
+        });
+        auto pointer =
+            reinterpret_cast<const void*>(span->offset + (begin - span->begin));
+        if (attrib.integer)
+            gl.glVertexAttribIPointer(index, attrib.size, attrib.type, stride,
+                                      pointer);
+        else
+            gl.glVertexAttribPointer(index, attrib.size, attrib.type,
+                                     attrib.normalized, stride, pointer);
+    }
+    redirected |= arrays;
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+    return true;
+}
+
+void egl_vertex_stream_t::restore(const gl_t& gl)
+{
+    if (!redirected || !default_vertex_array(gl))
+        return;
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+    for (GLuint index = 0; index < attrib_count; index++)
+    {
+        if (!(redirected & bit(index)))
+            continue;
+        const auto& attrib = attribs[index];
+        if (attrib.integer)
+            gl.glVertexAttribIPointer(index, attrib.size, attrib.type,
+                                      attrib.stride, attrib.pointer);
+        else
+            gl.glVertexAttribPointer(index, attrib.size, attrib.type,
+                                     attrib.normalized, attrib.stride,
+                                     attrib.pointer);
+    }
+    gl.glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+    redirected = 0;
+}
+
+void egl_vertex_stream_t::draw_arrays(const gl_t& gl, GLenum mode,
+                                      GLint first, GLsizei count)
+{
+    if (!default_vertex_array(gl))
+        return gl.glDrawArrays(mode, first, count);
+
+    bool all_client = false;
+    uint32_t arrays = client_arrays(all_client);
+    if (!arrays || first < 0 || count <= 0)
+    {
+        restore(gl);
+        return gl.glDrawArrays(mode, first, count);
+    }
+
+    // arrays of buffers are read from first on, so are the copies then
+    GLuint base = all_client ? first : 0;
+    if (!stream_vertices(gl, arrays, base, first + count - 1))
+    {
+        restore(gl);
+        return gl.glDrawArrays(mode, first, count);
+    }
+    gl.glDrawArrays(mode, first - base, count);
+}
+
+void egl_vertex_stream_t::draw_elements(const gl_t& gl, GLenum mode,
+                                        GLsizei count, GLenum type,
+                                        const void* indices, bool ranged,
+                                        GLuint start, GLuint end)
+{
+    auto draw = [&](GLuint start, GLuint end, const void* indices) {
+        if (ranged && gl.glDrawRangeElements)
+            gl.glDrawRangeElements(mode, start, end, count, type, indices);
+        else if (!ranged)
+            gl.glDrawElements(mode, count, type, indices);
+    };
+    if (!default_vertex_array(gl))
+        return draw(start, end, indices);
+
+    bool all_client = false;
+    uint32_t arrays = client_arrays(all_client);
+    GLsizei bytes = index_bytes(type);
+    // the indices of an element buffer cannot be read, only a given range
+    // of vertices is copied then
+    if (element_buffer)
+    {
+        if (!arrays || !ranged || start > end ||
+            !stream_vertices(gl, arrays, 0, end))
+            restore(gl);
+        return draw(start, end, indices);
+    }
+    if (!indices || count <= 0 || !bytes ||
+        GLsizeiptr{count} * bytes > index_ring.capacity)
+    {
+        restore(gl);
+        return draw(start, end, indices);
+    }
+
+    GLuint lo = start;
+    GLuint hi = end;
+    bool restartless = true;
+    if (!ranged)
+    {
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE:
+            restartless = index_range<GLubyte>(indices, count, lo, hi);
+            break;
+        case GL_UNSIGNED_SHORT:
+            restartless = index_range<GLushort>(indices, count, lo, hi);
+            break;
+        default:
+            restartless = index_range<GLuint>(indices, count, lo, hi);
+            break;
+        }
+    }
+    GLuint base = arrays && all_client ? lo : 0;
+    if (!restartless || lo > hi ||
+        (arrays && !stream_vertices(gl, arrays, base, hi)))
+    {
+        restore(gl);
+        return draw(start, end, indices);
+    }
+
+    const void* data = indices;
+    if (base)
+    {
+        rebased.resize(static_cast<size_t>(count) * bytes);
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE:
+            rebase<GLubyte>(indices, count, base, rebased.data());
+            break;
+        case GL_UNSIGNED_SHORT:
+            rebase<GLushort>(indices, count, base, rebased.data());
+            break;
+        default:
+            rebase<GLuint>(indices, count, base, rebased.data());
+            break;
+        }
+        data = rebased.data();
+    }
+
+    GLintptr offset = reserve(gl, index_ring, GLsizeiptr{count} * bytes);
+    gl.glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset,
+                       GLsizeiptr{count} * bytes, data);
+    draw(lo - base, hi - base, reinterpret_cast<const void*>(offset));
+    gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+}
@@ -0,0 +1,116 @@
+#ifndef EGL_VERTEX_STREAM_H_
+#define EGL_VERTEX_STREAM_H_
+
+#include "loader/hooks.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+// Vertex arrays and indices in the app's memory, copied into buffers of
+// the wrapper at draw time, so the driver only ever draws from buffers.
+//
+// A draw copies the vertices of the index range it uses into a ring
+// buffer, orphaned when it is full, and points the arrays there. The app
+// still sees its own pointers: they go back into the driver before a call
+// that would read them other than a streamed draw.
+//
+// One per GLES2 context, for its vertex array object 0; draws of other
+// vertex array objects, from an element buffer, of instanced arrays in the
+// app's memory, or too big for the ring go to the driver as they are.
+//
+// The binding of vertex array objects is the one glBindVertexArray set,
+// the OES entry points reach it through the wrapper too.
+//
+// EGL_VERTEX_STREAM  1 to stream client arrays into buffers
+class egl_vertex_stream_t {
+  public:
+    using gl_t = egl_wrapper::gl_hooks_t::gl_t;
+
+    // EGL_VERTEX_STREAM
+    static bool enabled();
+
+    // the calls that change what is tracked, made on the driver too
+    void bind_buffer(const gl_t& gl, GLenum target, GLuint buffer);
+    void bind_vertex_array(const gl_t& gl, GLuint array);
+    void delete_vertex_arrays(const gl_t& gl, GLsizei n, const GLuint* arrays);
+    void delete_buffers(const gl_t& gl, GLsizei n, const GLuint* buffers);
+    void attrib_pointer(const gl_t& gl, GLuint index, GLint size, GLenum type,
+                        GLboolean normalized, bool integer, GLsizei stride,
+                        const void* pointer);
+    void enable_array(const gl_t& gl, GLuint index, bool enable);
+    void attrib_divisor(const gl_t& gl, GLuint index, GLuint divisor);
+
+    void draw_arrays(const gl_t& gl, GLenum mode, GLint first, GLsizei count);
+    // start and end are known for glDrawRangeElements
+    void draw_elements(const gl_t& gl, GLenum mode, GLsizei count,
+                       GLenum type, const void* indices, bool ranged,
+                       GLuint start, GLuint end);
+    // before any other call reading the arrays of vertex array object 0
+    void restore(const gl_t& gl);
+
+  private:
+    static constexpr GLuint max_attribs = 32;
+
+    struct attrib_t
+    {
+        bool enabled = false;
+        GLint size = 4;
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        bool integer = false;
+        GLsizei stride = 0;
+        GLuint divisor = 0;
+        GLuint buffer = 0;
+        const void* pointer = nullptr;
+    };
+
+    struct ring_t
+    {
+        GLenum target;
+        GLsizeiptr capacity;
+        GLuint buffer = 0;
+        GLsizeiptr size = 0;
+        GLintptr offset = 0;
+    };
+
+    // the memory of one or more arrays sharing a stride, copied at once
+    struct span_t
+    {
+        const uint8_t* begin;
+        const uint8_t* end;
+        GLsizei stride;
+        GLintptr offset;
+    };
+
+    // the limits of the context, on the first call
+    void probe(const gl_t& gl);
+    // true when vertex array object 0 is bound
+    bool default_vertex_array(const gl_t& gl);
+    // enabled arrays in the app's memory, 0 when none or one is unusable
+    uint32_t client_arrays(bool& all_client);
+    // copies vertices first to last of the client arrays, false when they
+    // do not fit
+    bool stream_vertices(const gl_t& gl, uint32_t arrays, GLuint first,
+                         GLuint last);
+    // offset of size bytes in the ring, bound to its target, -1 when they
+    // do not fit
+    GLintptr reserve(const gl_t& gl, ring_t& ring, GLsizeiptr size);
+
+    attrib_t attribs[max_attribs];
+    GLuint attrib_count = 0;
+    // arrays the driver reads from the ring instead of the app's memory
+    uint32_t redirected = 0;
+
+    GLuint array_buffer = 0;
+    GLuint element_buffer = 0;
+    GLuint vertex_array = 0;
+    bool probed = false;
+
+    ring_t vertex_ring{GL_ARRAY_BUFFER, 4 << 20};
+    ring_t index_ring{GL_ELEMENT_ARRAY_BUFFER, 1 << 20};
+    std::vector<span_t> spans;
+    std::vector<uint8_t> rebased;
+};
+
+#endif // EGL_VERTEX_STREAM_H_
@@ -1,4 +1,5 @@
 #include "platform_wayland.h"
+#include "egl_config.h"
 #include "gralloc_adapter.h"
 #include "logger.h"
 #include "wayland-android-server-protocol-core.h"
@@ -7,28 +8,46 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <android/hardware_buffer.h>
 #include <sync/sync.h>
 #include <wayland-egl-backend.h>
 #include <EGL/egl.h>
 
-#include <vector>
+#include <algorithm>
+#include <limits>
 #include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace {
-struct wl_buffer_listener wlbuffer_listener = {
+// fd slots of android_wlegl.create_buffer_with_fds
+constexpr int wlegl_max_request_fds = 4;
+} // namespace
+
+struct wl_buffer_listener WaylandNativeWindowBuffer::release_listener = {
     // clang-format off
     .release = +[](void* data, struct wl_buffer* buffer) {
-        auto window = static_cast<WaylandNativeWindow*>(data);
-        window->releaseBuffer(buffer);
+        // picked up by the next dequeueBuffer
+        auto native_buffer = static_cast<WaylandNativeWindowBuffer*>(data);
+        native_buffer->released.store(true, std::memory_order_release);
     },
     // clang-format on
 };
-} // namespace
 
-WaylandNativeWindow::WaylandNativeWindow(struct wl_display* display,
-                                         struct wl_egl_window* win,
-                                         struct android_wlegl* wlegl) :
+bool wayland_dmabuf_formats::supports(uint32_t fourcc, uint64_t modifier) const
+{
+    if (implicit_modifiers)
+        modifier = gralloc_dmabuf_layout::modifier_invalid;
+    return modifiers.count({fourcc, modifier}) != 0;
+}
+
+WaylandNativeWindow::WaylandNativeWindow(
+    struct wl_display* display, struct wl_egl_window* win,
+    struct android_wlegl* wlegl, struct zwp_linux_dmabuf_v1* dmabuf,
+    const wayland_dmabuf_formats* dmabuf_formats, struct wl_shm* shm,
+    const std::set<uint32_t>* shm_formats) :
     m_window(win),
     m_width(win->width),
     m_height(win->height),
@@ -36,6 +55,7 @@ WaylandNativeWindow::WaylandNativeWindow(struct wl_display* display,
     m_defaultHeight(win->height),
     m_usage(AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
             AHARDWAREBUFFER_USAGE_GPU_FRAMEBUFFER),
+    m_required_usage(0),
     m_format(AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM),
     m_damage_rects(nullptr),
     m_damage_n_rects(0),
@@ -43,7 +63,12 @@ WaylandNativeWindow::WaylandNativeWindow(struct wl_display* display,
     throttle_callback(nullptr),
     m_display(display),
     m_display_wrapper((struct wl_display*)wl_proxy_create_wrapper(display)),
-    m_wlegl_wrapper((struct android_wlegl*)wl_proxy_create_wrapper(wlegl)),
+    m_wlegl_wrapper(
+        wlegl ? (struct android_wlegl*)wl_proxy_create_wrapper(wlegl) : nullptr),
+    m_dmabuf_wrapper(dmabuf ? (struct zwp_linux_dmabuf_v1*)
+                                  wl_proxy_create_wrapper(dmabuf)
+                            : nullptr),
+    m_dmabuf_formats(dmabuf_formats),
     m_surface_wrapper(
         (struct wl_surface*)wl_proxy_create_wrapper(win->surface)),
     event_queue(
@@ -51,8 +76,22 @@ WaylandNativeWindow::WaylandNativeWindow(struct wl_display* display,
     valid(true)
 {
     wl_proxy_set_queue((struct wl_proxy*)m_display_wrapper, event_queue);
-    wl_proxy_set_queue((struct wl_proxy*)m_wlegl_wrapper, event_queue);
+    if (m_wlegl_wrapper)
+        wl_proxy_set_queue((struct wl_proxy*)m_wlegl_wrapper, event_queue);
+    if (m_dmabuf_wrapper)
+        wl_proxy_set_queue((struct wl_proxy*)m_dmabuf_wrapper, event_queue);
     wl_proxy_set_queue((struct wl_proxy*)m_surface_wrapper, event_queue);
+    if (shm)
+    {
+        m_shm_presenter = std::make_unique<wayland_shm_presenter>(
+            display, shm, shm_formats, event_queue);
+        // without android_wlegl most buffers end up read back by the cpu
+        if (!m_wlegl_wrapper)
+        {
+            m_required_usage = AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN;
+            m_usage |= m_required_usage;
+        }
+    }
     if (wl_display_roundtrip(display) < 0)
     {
         valid = false;
@@ -76,6 +115,7 @@ WaylandNativeWindow::WaylandNativeWindow(struct wl_display* display,
 WaylandNativeWindow::~WaylandNativeWindow()
 {
     removeAllBuffers();
+    m_shm_presenter = nullptr;
 
     if (throttle_callback)
     {
@@ -100,6 +140,11 @@ WaylandNativeWindow::~WaylandNativeWindow()
         wl_proxy_wrapper_destroy(m_wlegl_wrapper);
         m_wlegl_wrapper = nullptr;
     }
+    if (m_dmabuf_wrapper)
+    {
+        wl_proxy_wrapper_destroy(m_dmabuf_wrapper);
+        m_dmabuf_wrapper = nullptr;
+    }
     if (m_display_wrapper)
     {
         wl_proxy_wrapper_destroy(m_display_wrapper);
@@ -120,35 +165,17 @@ void WaylandNativeWindow::resize(uint32_t width, uint32_t height)
     m_defaultHeight = m_height = height;
 }
 
-void WaylandNativeWindow::releaseBuffer(struct wl_buffer* buf)
+void WaylandNativeWindow::drainReleasedBuffers()
 {
-    std::lock_guard lock{m_mutex};
-    auto iter = posted.begin();
-    for (; iter != posted.end(); iter++)
+    for (auto& native_buffer : m_bufList)
     {
-        if ((*iter)->wlbuffer == buf)
-            break;
-    }
+        if (!native_buffer->released.exchange(false, std::memory_order_acquire))
+            continue;
 
-    if (iter != posted.end())
-    {
-        auto native_buffer = *iter;
-        posted.erase(iter);
         native_buffer->busy = false;
-        return;
-    }
-
-    auto buf_iter = m_bufList.begin();
-    for (; buf_iter != m_bufList.end(); buf_iter++)
-    {
-        if ((*buf_iter)->wlbuffer == buf)
-            break;
+        // a buffer attached again without a new frame is posted twice
+        posted.remove(native_buffer);
     }
-    if (buf_iter == m_bufList.end())
-        return;
-
-    auto& native_buffer = *buf_iter;
-    native_buffer->busy = false;
 }
 
 int WaylandNativeWindow::setSwapInterval(int interval)
@@ -207,14 +234,64 @@ void WaylandNativeWindow::finish_swap()
             return;
     }
 
-    if (native_buffer->wlbuffer == nullptr)
+    if (native_buffer->wlbuffer == nullptr && !native_buffer->shm_only)
+    {
+        if (!m_dmabuf_wrapper ||
+            !native_buffer->create_dmabuf_wl_buffer(
+                m_display, m_dmabuf_wrapper, *m_dmabuf_formats, event_queue))
+        {
+            if (m_wlegl_wrapper)
+                native_buffer->create_wl_buffer(m_display_wrapper,
+                                                m_wlegl_wrapper, event_queue);
+        }
+        if (native_buffer->wlbuffer)
+        {
+            wl_buffer_add_listener(native_buffer->wlbuffer,
+                                   &WaylandNativeWindowBuffer::release_listener,
+                                   native_buffer);
+            wl_proxy_set_queue((struct wl_proxy*)native_buffer->wlbuffer,
+                               event_queue);
+        }
+        else if (m_shm_presenter &&
+                 m_shm_presenter->supports(native_buffer->format))
+        {
+            native_buffer->shm_only = true;
+        }
+        else
+        {
+            // nothing the compositor could take, keep the last frame
+            logger::log_error() << "cannot share buffer with the compositor";
+            lock.lock();
+            native_buffer->busy = false;
+            return;
+        }
+    }
+
+    // EGL counts damage rows from the bottom, wayland from the top
+    std::vector<ARect> damage;
+    if (m_damage_n_rects != 0 && m_damage_rects != nullptr)
     {
-        native_buffer->create_wl_buffer(m_display_wrapper, m_wlegl_wrapper,
-                                        event_queue);
-        wl_buffer_add_listener(native_buffer->wlbuffer, &wlbuffer_listener,
-                               this);
-        wl_proxy_set_queue((struct wl_proxy*)native_buffer->wlbuffer,
-                           event_queue);
+        damage.reserve(m_damage_n_rects);
+        for (int i = 0; i < m_damage_n_rects; i++)
+        {
+            const EGLint* rect = &m_damage_rects[4 * i];
+            int inv_y = native_buffer->height - (rect[1] + rect[3]);
+            damage.push_back(
+                {rect[0], inv_y, rect[0] + rect[2], inv_y + rect[3]});
+        }
+    }
+
+    struct wl_buffer* wlbuffer = native_buffer->wlbuffer;
+    if (native_buffer->shm_only)
+    {
+        wlbuffer = m_shm_presenter->present(*native_buffer->m_buffer,
+                                            damage.data(), damage.size());
+        // copied out, the compositor never sees this buffer
+        lock.lock();
+        native_buffer->busy = false;
+        lock.unlock();
+        if (!wlbuffer)
+            return;
     }
 
     if (m_swap_interval > 0)
@@ -224,15 +301,13 @@ void WaylandNativeWindow::finish_swap()
         wl_proxy_set_queue((struct wl_proxy*)throttle_callback, event_queue);
     }
 
-    wl_surface_attach(m_surface_wrapper, native_buffer->wlbuffer, 0, 0);
-    if (m_damage_n_rects != 0 && m_damage_rects != nullptr)
+    wl_surface_attach(m_surface_wrapper, wlbuffer, 0, 0);
+    if (!damage.empty())
     {
-        for (int i = 0; i < m_damage_n_rects; i++)
+        for (const auto& rect : damage)
         {
-            const EGLint* rect = &m_damage_rects[4 * i];
-            int inv_y = native_buffer->height - (rect[1] + rect[3]);
-            wl_surface_damage(m_surface_wrapper, rect[0], inv_y, rect[2],
-                              rect[3]);
+            wl_surface_damage(m_surface_wrapper, rect.left, rect.top,
+                              rect.right - rect.left, rect.bottom - rect.top);
         }
     }
     else
@@ -250,7 +325,8 @@ void WaylandNativeWindow::finish_swap()
     wl_display_flush(m_display);
 
     lock.lock();
-    posted.push_back(native_buffer);
+    if (!native_buffer->shm_only)
+        posted.push_back(native_buffer);
 
     m_window->attached_width = native_buffer->width;
     m_window->attached_height = native_buffer->height;
@@ -270,8 +346,12 @@ int WaylandNativeWindow::dequeueBuffer(BaseNativeWindowBuffer** buffer,
     wl_display_dispatch_queue_pending(m_display, event_queue);
 
     std::unique_lock lock{m_mutex};
+    if (m_bufList.empty())
+        allocateBuffers();
+    drainReleasedBuffers();
+
     auto iter = m_bufList.begin();
-    for (; iter != m_bufList.begin(); iter++)
+    for (; iter != m_bufList.end(); iter++)
     {
         if ((*iter)->busy)
             continue;
@@ -304,6 +384,7 @@ int WaylandNativeWindow::dequeueBuffer(BaseNativeWindowBuffer** buffer,
                 return -1;
             }
             lock.lock();
+            drainReleasedBuffers();
         }
     }
 
@@ -311,6 +392,8 @@ int WaylandNativeWindow::dequeueBuffer(BaseNativeWindowBuffer** buffer,
     if (native_buffer->width != m_width || native_buffer->height != m_height ||
         native_buffer->format != m_format || native_buffer->usage != m_usage)
     {
+        // the old one may go away with this, it is no longer on screen
+        posted.remove(native_buffer);
         native_buffer =
             new WaylandNativeWindowBuffer(m_width, m_height, m_format, m_usage);
     }
@@ -423,9 +506,10 @@ int WaylandNativeWindow::setBuffersDimensions(int width, int height)
 int WaylandNativeWindow::setUsage(uint64_t usage)
 {
     std::lock_guard lock{m_mutex};
-    if ((usage | AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE) != m_usage)
+    usage |= AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE | m_required_usage;
+    if (usage != m_usage)
     {
-        m_usage = usage | AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE;
+        m_usage = usage;
     }
 
     return NO_ERROR;
@@ -441,14 +525,36 @@ int WaylandNativeWindow::setBufferCount(int cnt)
         /* Decreasing buffer count, remove from beginning */
         for (int i = 0; i <= (int)m_bufList.size() - cnt; i++)
         {
+            posted.remove(m_bufList.front());
             m_bufList.pop_front();
         }
     }
     return NO_ERROR;
 }
 
+void WaylandNativeWindow::allocateBuffers()
+{
+    // set up the whole swapchain with one gralloc call, dequeueBuffer still
+    // allocates one by one if the backend cannot give us all of them.
+    AHardwareBuffer_Desc desc = {
+        .width = static_cast<uint32_t>(m_width),
+        .height = static_cast<uint32_t>(m_height),
+        .layers = 1,
+        .format = static_cast<uint32_t>(m_format),
+        .usage = m_usage,
+    };
+
+    auto adapter = gralloc_loader::getInstance().get_adapter();
+    for (auto& buffer :
+         adapter->allocate_buffers(m_bufCount, desc, buffer_owner::surface))
+    {
+        m_bufList.push_back(new WaylandNativeWindowBuffer(std::move(buffer)));
+    }
+}
+
 void WaylandNativeWindow::removeAllBuffers()
 {
+    posted.clear();
     m_bufList.clear();
 }
 
@@ -462,6 +568,25 @@ void WaylandNativeWindowBuffer::create_wl_buffer(struct wl_display* display,
     void* ints_data = wl_array_add(&ints, handle->numInts * sizeof(int));
     memcpy(ints_data, &handle->data[handle->numFds],
            handle->numInts * sizeof(int));
+
+    // version 2 takes the whole handle in one request, the unused fd
+    // slots are filled up with the first fd
+    if (android_wlegl_get_version(wlegl) >=
+            ANDROID_WLEGL_CREATE_BUFFER_WITH_FDS_SINCE_VERSION &&
+        handle->numFds >= 1 && handle->numFds <= wlegl_max_request_fds)
+    {
+        const int* fds = &handle->data[0];
+        auto fd = [&](int i) { return i < handle->numFds ? fds[i] : fds[0]; };
+        wlbuffer = android_wlegl_create_buffer_with_fds(
+            wlegl, width, height, stride, format, usage, handle->numFds,
+            &ints, fd(0), fd(1), fd(2), fd(3));
+        wl_array_release(&ints);
+
+        if (wlbuffer)
+            wl_proxy_set_queue((struct wl_proxy*)wlbuffer, queue);
+        return;
+    }
+
     wlegl_handle = android_wlegl_create_handle(wlegl, handle->numFds, &ints);
     wl_array_release(&ints);
 
@@ -484,6 +609,80 @@ void WaylandNativeWindowBuffer::create_wl_buffer(struct wl_display* display,
     wl_proxy_set_queue((struct wl_proxy*)wlbuffer, queue);
 }
 
+bool WaylandNativeWindowBuffer::create_dmabuf_wl_buffer(
+    struct wl_display* display, struct zwp_linux_dmabuf_v1* dmabuf,
+    const wayland_dmabuf_formats& formats, struct wl_event_queue* queue)
+{
+    gralloc_dmabuf_layout layout = {};
+    if (!m_buffer || !m_buffer->export_dmabuf(&layout) ||
+        !formats.supports(layout.fourcc, layout.modifier))
+        return false;
+
+    auto params = zwp_linux_dmabuf_v1_create_params(dmabuf);
+    if (!params)
+        return false;
+    wl_proxy_set_queue((struct wl_proxy*)params, queue);
+
+    for (int i = 0; i < layout.num_planes; i++)
+    {
+        zwp_linux_buffer_params_v1_add(
+            params, layout.planes[i].fd, i, layout.planes[i].offset,
+            layout.planes[i].stride, static_cast<uint32_t>(layout.modifier >> 32),
+            static_cast<uint32_t>(layout.modifier));
+    }
+
+    bool immed = zwp_linux_dmabuf_v1_get_version(dmabuf) >=
+                 ZWP_LINUX_BUFFER_PARAMS_V1_CREATE_IMMED_SINCE_VERSION;
+    if (layout.known && immed)
+    {
+        // failures are protocol errors the format check avoids
+        wlbuffer = zwp_linux_buffer_params_v1_create_immed(
+            params, width, height, layout.fourcc, 0);
+    }
+    else
+    {
+        // a guessed layout the compositor may refuse, wait for its answer
+        // so the caller can fall back to android_wlegl
+        struct result_t
+        {
+            struct wl_buffer* buffer;
+            bool done;
+        } result = {};
+        static const zwp_linux_buffer_params_v1_listener params_listener = {
+            // clang-format off
+            .created = +[](void* data, struct zwp_linux_buffer_params_v1*,
+                           struct wl_buffer* buffer) {
+                auto result = static_cast<result_t*>(data);
+                result->buffer = buffer;
+                result->done = true;
+            },
+            .failed = +[](void* data, struct zwp_linux_buffer_params_v1*) {
+                static_cast<result_t*>(data)->done = true;
+            },
+            // clang-format on
+        };
+        zwp_linux_buffer_params_v1_add_listener(params, &params_listener,
+                                                &result);
+        zwp_linux_buffer_params_v1_create(params, width, height,
+                                          layout.fourcc, 0);
+        while (!result.done)
+        {
+            if (wl_display_dispatch_queue(display, queue) == -1)
+                break;
+        }
+        wlbuffer = result.buffer;
+        if (!wlbuffer)
+            logger::log_warn() << "compositor refused the dmabuf buffer";
+    }
+    zwp_linux_buffer_params_v1_destroy(params);
+
+    if (!wlbuffer)
+        return false;
+
+    wl_proxy_set_queue((struct wl_proxy*)wlbuffer, queue);
+    return true;
+}
+
 WaylandNativeWindowBuffer::~WaylandNativeWindowBuffer()
 {
     if (wlbuffer)
@@ -500,7 +699,9 @@ wayland_wrapper_t::wayland_wrapper_t(struct wl_display* display) :
     own_display(false),
     event_queue(nullptr),
     registry(nullptr),
-    wlegl(nullptr)
+    wlegl(nullptr),
+    dmabuf(nullptr),
+    shm(nullptr)
 {
 }
 
@@ -534,6 +735,34 @@ EGLBoolean wayland_wrapper_t::initialize()
     }
     registry = wl_display_get_registry(display_wrapper);
 
+    static const zwp_linux_dmabuf_v1_listener dmabuf_listener = {
+        // clang-format off
+        .format = +[](void* data, struct zwp_linux_dmabuf_v1* dmabuf,
+                      uint32_t format) {
+            auto self = static_cast<wayland_wrapper_t*>(data);
+            // deprecated by the modifier event since version 3
+            if (self->dmabuf_formats.implicit_modifiers)
+                self->dmabuf_formats.modifiers.emplace(
+                    format, gralloc_dmabuf_layout::modifier_invalid);
+        },
+        .modifier = +[](void* data, struct zwp_linux_dmabuf_v1* dmabuf,
+                        uint32_t format, uint32_t modifier_hi,
+                        uint32_t modifier_lo) {
+            auto self = static_cast<wayland_wrapper_t*>(data);
+            self->dmabuf_formats.modifiers.emplace(
+                format, static_cast<uint64_t>(modifier_hi) << 32 | modifier_lo);
+        },
+        // clang-format on
+    };
+
+    static const wl_shm_listener shm_listener = {
+        // clang-format off
+        .format = +[](void* data, struct wl_shm* shm, uint32_t format) {
+            static_cast<wayland_wrapper_t*>(data)->shm_formats.insert(format);
+        },
+        // clang-format on
+    };
+
     static const wl_registry_listener registry_listener = {
         // clang-format off
         .global = +[] (void *data, struct wl_registry *wl_registry,
@@ -542,18 +771,36 @@ EGLBoolean wayland_wrapper_t::initialize()
 
             if (strcmp(interface, "android_wlegl") == 0) {
                 self->wlegl = static_cast<struct android_wlegl*>(wl_registry_bind(wl_registry, name,
-                    &android_wlegl_interface, std::min(1U, version)));
+                    &android_wlegl_interface, std::min(2U, version)));
+            } else if (strcmp(interface, "zwp_linux_dmabuf_v1") == 0 && version >= 2) {
+                self->dmabuf = static_cast<struct zwp_linux_dmabuf_v1*>(wl_registry_bind(wl_registry, name,
+                    &zwp_linux_dmabuf_v1_interface, std::min(3U, version)));
+                self->dmabuf_formats.implicit_modifiers = version < 3;
+                zwp_linux_dmabuf_v1_add_listener(self->dmabuf, &dmabuf_listener, self);
+            } else if (strcmp(interface, "wl_shm") == 0) {
+                self->shm = static_cast<struct wl_shm*>(wl_registry_bind(wl_registry, name,
+                    &wl_shm_interface, 1));
+                wl_shm_add_listener(self->shm, &shm_listener, self);
             }
         },
         // clang-format on
     };
     wl_registry_add_listener(registry, &registry_listener, this);
+    // the second roundtrip collects the dmabuf and shm formats
     if (wl_display_roundtrip_queue(display, event_queue) < 0 ||
-        wlegl == nullptr)
+        ((dmabuf || shm) &&
+         wl_display_roundtrip_queue(display, event_queue) < 0) ||
+        (wlegl == nullptr && dmabuf == nullptr && shm == nullptr))
     {
-        logger::log_error() << "cannot find android_wlegl";
+        logger::log_error()
+            << "cannot find android_wlegl, zwp_linux_dmabuf_v1 or wl_shm";
         return EGL_FALSE;
     }
+    if (wlegl == nullptr)
+    {
+        logger::log_info() << "no android_wlegl, buffers the compositor "
+                              "cannot import are copied through wl_shm";
+    }
 
     return EGL_TRUE;
 }
@@ -565,6 +812,18 @@ EGLBoolean wayland_wrapper_t::terminate()
         android_wlegl_destroy(wlegl);
         wlegl = nullptr;
     }
+    if (dmabuf)
+    {
+        zwp_linux_dmabuf_v1_destroy(dmabuf);
+        dmabuf = nullptr;
+    }
+    dmabuf_formats = {};
+    if (shm)
+    {
+        wl_shm_destroy(shm);
+        shm = nullptr;
+    }
+    shm_formats.clear();
     if (registry)
     {
         wl_registry_destroy(registry);
@@ -595,7 +854,8 @@ ANativeWindow* wayland_wrapper_t::create_window(void* native_window)
 {
     auto window = static_cast<EGLNativeWindowType>(native_window);
     android_wrap::sp wayland_window =
-        new WaylandNativeWindow{display, window, wlegl};
+        new WaylandNativeWindow{display, window, wlegl, dmabuf,
+                                &dmabuf_formats, shm, &shm_formats};
     if (wayland_window->valid)
     {
         return wayland_window.release();
@@ -622,43 +882,175 @@ void wayland_wrapper_t::finish_swap(ANativeWindow* win)
     wayland_window->finish_swap();
 }
 
+void wayland_wrapper_t::adjust_configs(egl_config_table_t& configs)
+{
+    // clients match wl_shm and dmabuf formats against the visual, so report
+    // the DRM fourcc of the driver's pixel format as Mesa does
+    const int col = egl_config_table_t::column(EGL_NATIVE_VISUAL_ID);
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        if (uint32_t fourcc =
+                gralloc_adapter_t::drm_fourcc(configs.value(i, col));
+            fourcc)
+        {
+            configs.set_value(i, EGL_NATIVE_VISUAL_ID, fourcc);
+        }
+    }
+}
+
 // server wl_egl impl
 namespace {
+// sanity bounds of a single request, checked before any gralloc call
+constexpr int wlegl_max_handle_fds = 32;
+constexpr int wlegl_max_handle_ints = 1024;
+constexpr int32_t wlegl_max_dimension = 16384;
+// the error enum of android_wlegl got limit_exceeded in this version
+constexpr int wlegl_limit_exceeded_since = 2;
+
+// default_value when unset or 0, max_value at most
+uint64_t env_limit(const char* key, uint64_t default_value,
+                   uint64_t max_value)
+{
+    if (const char* env = getenv(key); env)
+    {
+        if (uint64_t value = strtoull(env, nullptr, 10); value > 0)
+            return std::min(value, max_value);
+    }
+    return default_value;
+}
+
+// what one client holds in the compositor: fds of handles and buffers, live
+// buffers and their estimated size. freed with the client, resources
+// destroyed after that find nothing to give back.
+struct wlegl_client
+{
+    struct wl_listener destroy_listener;
+    int fds = 0;
+    int buffers = 0;
+    uint64_t bytes = 0;
+};
+
+void wlegl_client_destroyed(struct wl_listener* listener, void* data)
+{
+    wlegl_client* usage = wl_container_of(listener, usage, destroy_listener);
+    delete usage;
+}
+
+wlegl_client* get_wlegl_client(struct wl_client* client, bool create)
+{
+    auto listener =
+        wl_client_get_destroy_listener(client, wlegl_client_destroyed);
+    if (listener)
+    {
+        wlegl_client* usage = wl_container_of(listener, usage, destroy_listener);
+        return usage;
+    }
+    if (!create)
+        return nullptr;
+
+    auto usage = new wlegl_client{};
+    usage->destroy_listener.notify = wlegl_client_destroyed;
+    wl_client_add_destroy_listener(client, &usage->destroy_listener);
+    return usage;
+}
+
+// posts limit_exceeded on resource (no_memory to version 1 clients, which
+// do not know it) and returns false if the client would go over any of its
+// limits
+bool charge_client(server_wlegl* wlegl, struct wl_resource* resource, int fds,
+                   int buffers, uint64_t bytes)
+{
+    auto usage = get_wlegl_client(wl_resource_get_client(resource), true);
+    if (usage->fds + fds > wlegl->max_client_fds ||
+        usage->buffers + buffers > wlegl->max_client_buffers ||
+        usage->bytes + bytes > wlegl->max_client_bytes)
+    {
+        logger::log_error()
+            << "client over its limits, fds: " << usage->fds << "+" << fds
+            << ", buffers: " << usage->buffers << "+" << buffers
+            << ", bytes: " << usage->bytes << "+" << bytes;
+        if (wl_resource_get_version(resource) >= wlegl_limit_exceeded_since)
+            wl_resource_post_error(resource,
+                                   ANDROID_WLEGL_ERROR_LIMIT_EXCEEDED,
+                                   "client resource limit exceeded");
+        else
+            wl_resource_post_no_memory(resource);
+        return false;
+    }
+
+    usage->fds += fds;
+    usage->buffers += buffers;
+    usage->bytes += bytes;
+    return true;
+}
+
+void uncharge_client(struct wl_client* client, int fds, int buffers,
+                     uint64_t bytes)
+{
+    auto usage = get_wlegl_client(client, false);
+    if (!usage)
+        return;
+
+    usage->fds -= fds;
+    usage->buffers -= buffers;
+    usage->bytes -= bytes;
+}
+
+// estimated size of the buffer, posts bad_value and returns false for
+// anything gralloc should never see
+bool validate_buffer(struct wl_resource* resource, int32_t width,
+                     int32_t height, int32_t stride, int32_t format,
+                     uint64_t* bytes)
+{
+    if (width <= 0 || height <= 0 || width > wlegl_max_dimension ||
+        height > wlegl_max_dimension || stride < width ||
+        stride > wlegl_max_dimension * 4)
+    {
+        wl_resource_post_error(resource, ANDROID_WLEGL_ERROR_BAD_VALUE,
+                               "bad buffer size %dx%d, stride %d", width,
+                               height, stride);
+        return false;
+    }
+
+    // vendor formats count like rgba
+    int bpp = 4, plane_x2 = 2;
+    gralloc_adapter_t::format_info(format, &bpp, &plane_x2);
+    *bytes = static_cast<uint64_t>(stride) * height * bpp * plane_x2 / 2;
+    return true;
+}
+
 struct wlegl_handle
 {
+    struct wl_client* client;
     struct wl_resource* resource;
-    std::vector<int> ints;
-    std::vector<int> fds;
-    int num_ints;
-    int num_fds;
+    // sized by create_handle, add_fd fills the fds in place and
+    // create_buffer hands it over to gralloc
     native_handle_t* native_handle = nullptr;
+    int num_fds;
+    int fds_added = 0;
+    // fds charged to the client in create_handle until create_buffer
+    int charged_fds = 0;
     std::shared_ptr<gralloc_adapter_t> adapter =
         gralloc_loader::getInstance().get_adapter();
 
     ~wlegl_handle()
     {
-        for (auto fd : fds)
-        {
-            close(fd);
-        }
+        uncharge_client(client, charged_fds, 0, 0);
+        if (!native_handle)
+            return;
 
-        if (native_handle)
-        {
-            adapter->cutils.vptr.native_handle_close(native_handle);
-            adapter->cutils.vptr.native_handle_delete(native_handle);
-        }
+        // only the fds received so far are ours to close
+        native_handle->numFds = fds_added;
+        adapter->cutils.vptr.native_handle_close(native_handle);
+        adapter->cutils.vptr.native_handle_delete(native_handle);
     }
-    native_handle_t* get_native_buffer()
+    // the complete handle, ownership and the fd charge go to the caller
+    native_handle_t* release_native_buffer()
     {
-        if (native_handle)
-            return native_handle;
-
-        native_handle =
-            adapter->cutils.vptr.native_handle_create(num_fds, num_ints);
-        memcpy(&native_handle->data[0], fds.data(), fds.size() * sizeof(int));
-        memcpy(&native_handle->data[num_fds], ints.data(),
-               ints.size() * sizeof(int));
-        return native_handle;
+        if (!native_handle || fds_added != num_fds)
+            return nullptr;
+        charged_fds = 0;
+        return std::exchange(native_handle, nullptr);
     }
     static wlegl_handle* from(struct wl_resource* handle);
 };
@@ -668,13 +1060,13 @@ struct android_wlegl_handle_interface wlegl_handle_impl = {
     .add_fd = +[](struct wl_client *client, struct wl_resource *resource,
                   int32_t fd) {
         auto self = static_cast<wlegl_handle*>(wl_resource_get_user_data(resource));
-        if (self->fds.size() >= self->num_fds) {
+        if (!self->native_handle || self->fds_added >= self->num_fds) {
             close(fd);
             wl_resource_post_error(resource, ANDROID_WLEGL_HANDLE_ERROR_TOO_MANY_FDS,
                                    "too many fd");
             return;
         }
-        self->fds.push_back(fd);
+        self->native_handle->data[self->fds_added++] = fd;
     },
     .destroy = +[](struct wl_client *client, struct wl_resource *resource) {
         wl_resource_destroy(resource);
@@ -691,13 +1083,59 @@ wlegl_handle* wlegl_handle::from(struct wl_resource* handle)
         return nullptr;
 }
 
+struct wlegl_image
+{
+    EGLDisplay display;
+    EGLImage image;
+    destroy_image_func destroy;
+    int user_refs;
+    bool buffer_alive;
+};
+
+// every cached image, for eglDestroyImage to find its entry
+std::mutex wlegl_images_mutex;
+std::unordered_map<EGLImage, std::shared_ptr<wlegl_image>> wlegl_images;
+
 struct wlegl_buffer
 {
+    struct wl_client* client;
     struct wl_resource* resource;
     server_wlegl* wlegl;
     android_wrap::sp<RemoteWindowBuffer> buf;
+    // one per EGLDisplay the buffer was attached on, usually one
+    std::vector<std::shared_ptr<wlegl_image>> images;
+    bool release_pending = false;
+    int charged_fds;
+    uint64_t charged_bytes;
+
+    ~wlegl_buffer()
+    {
+        uncharge_client(client, charged_fds, 1, charged_bytes);
 
-    ~wlegl_buffer() = default;
+        if (release_pending)
+        {
+            auto iter =
+                wlegl->pending_releases.find(wl_resource_get_client(resource));
+            if (iter != wlegl->pending_releases.end())
+            {
+                auto& pending = iter->second;
+                pending.erase(
+                    std::remove(pending.begin(), pending.end(), resource),
+                    pending.end());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{wlegl_images_mutex};
+        for (auto& image : images)
+        {
+            image->buffer_alive = false;
+            if (image->user_refs > 0)
+                continue;
+
+            wlegl_images.erase(image->image);
+            image->destroy(image->display, image->image);
+        }
+    }
     static wlegl_buffer* from(struct wl_resource* buffer);
 };
 
@@ -718,49 +1156,156 @@ wlegl_buffer* wlegl_buffer::from(struct wl_resource* resource)
         return nullptr;
 }
 
+// takes over the handle and its fd charge. every failure posts an error,
+// the client never keeps using an id the server did not create.
+void create_wlegl_buffer(struct wl_client* client, struct wl_resource* resource,
+                         uint32_t id, int32_t width, int32_t height,
+                         int32_t stride, int32_t format, int32_t usage,
+                         native_handle_t* native_handle)
+{
+    auto self = static_cast<server_wlegl*>(wl_resource_get_user_data(resource));
+    auto adapter = gralloc_loader::getInstance().get_adapter();
+    int num_fds = native_handle->numFds;
+    uint64_t bytes = 0;
+    if (!validate_buffer(resource, width, height, stride, format, &bytes) ||
+        !charge_client(self, resource, 0, 1, bytes))
+    {
+        adapter->cutils.vptr.native_handle_close(native_handle);
+        adapter->cutils.vptr.native_handle_delete(native_handle);
+        uncharge_client(client, num_fds, 0, 0);
+        return;
+    }
+
+    // the handle is consumed, kept by the buffer when the backend can
+    auto out_buffer = adapter->adopt_buffer(native_handle, width, height,
+                                            stride, format, usage);
+    if (!out_buffer)
+    {
+        uncharge_client(client, num_fds, 1, bytes);
+        wl_resource_post_error(resource, ANDROID_WLEGL_ERROR_BAD_HANDLE,
+                               "import buffer failed.");
+        return;
+    }
+
+    auto buffer = new wlegl_buffer{};
+    buffer->buf = new RemoteWindowBuffer{out_buffer};
+    buffer->wlegl = self;
+    buffer->client = client;
+    buffer->charged_fds = num_fds;
+    buffer->charged_bytes = bytes;
+    buffer->resource = wl_resource_create(client, &wl_buffer_interface,
+                                          wl_buffer_interface.version, id);
+    if (!buffer->resource)
+    {
+        delete buffer;
+        wl_client_post_no_memory(client);
+        return;
+    }
+    // clang-format off
+    wl_resource_set_implementation(buffer->resource, &wlegl_buffer_impl, buffer,
+                                   +[](struct wl_resource *resource) {
+        delete static_cast<wlegl_buffer*>(wl_resource_get_user_data(resource));
+    });
+    // clang-format on
+}
+
 struct android_wlegl_interface server_wlegl_impl = {
     // clang-format off
     .create_handle = +[](struct wl_client *client, struct wl_resource *resource,
                          uint32_t id, int32_t num_fds,
                          struct wl_array *ints) {
-        if (num_fds < 0) {
+        auto self = static_cast<server_wlegl*>(wl_resource_get_user_data(resource));
+        int num_ints = ints->size / sizeof(int);
+        if (num_fds < 0 || num_fds > wlegl_max_handle_fds ||
+            num_ints > wlegl_max_handle_ints) {
             wl_resource_post_error(resource, ANDROID_WLEGL_ERROR_BAD_VALUE,
-                                    "num_fds %d is invalid.", num_fds);
+                                    "num_fds %d, num_ints %d is invalid.",
+                                    num_fds, num_ints);
             return;
         }
+        // the fds are charged up front, add_fd can never go over the limit
+        if (!charge_client(self, resource, num_fds, 0, 0))
+            return;
+
         auto handle = new wlegl_handle{};
+        handle->client = client;
+        handle->charged_fds = num_fds;
         handle->num_fds = num_fds;
-        handle->num_ints = ints->size / sizeof(int);
-        handle->ints.resize(handle->num_ints);
-        memcpy(handle->ints.data(), ints->data, handle->ints.size() * sizeof(int));
+        handle->native_handle =
+            handle->adapter->cutils.vptr.native_handle_create(num_fds, num_ints);
+        if (handle->native_handle)
+            memcpy(&handle->native_handle->data[num_fds], ints->data,
+                   num_ints * sizeof(int));
         handle->resource = wl_resource_create(client, &android_wlegl_handle_interface,
-                                              android_wlegl_interface.version, id);
+                                              android_wlegl_handle_interface.version, id);
+        if (!handle->resource) {
+            delete handle;
+            wl_client_post_no_memory(client);
+            return;
+        }
         wl_resource_set_implementation(handle->resource, &wlegl_handle_impl, handle,
                                        +[](struct wl_resource *resource) {
             delete static_cast<wlegl_handle*>(wl_resource_get_user_data(resource));
         });
+        if (!handle->native_handle)
+            wl_resource_post_no_memory(resource);
     },
     .create_buffer = +[](struct wl_client *client, struct wl_resource *resource,
                          uint32_t id, int32_t width, int32_t height, int32_t stride,
                          int32_t format, int32_t usage,
                          struct wl_resource* native_handle) {
+        auto handle = native_handle ? wlegl_handle::from(native_handle) : nullptr;
+        auto buffer_handle = handle ? handle->release_native_buffer() : nullptr;
+        if (!buffer_handle) {
+            wl_resource_post_error(resource, ANDROID_WLEGL_ERROR_BAD_HANDLE,
+                                   "native handle is incomplete or used.");
+            return;
+        }
+        create_wlegl_buffer(client, resource, id, width, height, stride, format,
+                            usage, buffer_handle);
+    },
+    .create_buffer_with_fds = +[](struct wl_client *client, struct wl_resource *resource,
+                                  uint32_t id, int32_t width, int32_t height,
+                                  int32_t stride, int32_t format, int32_t usage,
+                                  int32_t num_fds, struct wl_array *ints,
+                                  int32_t fd0, int32_t fd1, int32_t fd2, int32_t fd3) {
         auto self = static_cast<server_wlegl*>(wl_resource_get_user_data(resource));
-        auto handle = wlegl_handle::from(native_handle);
-        auto buffer = new wlegl_buffer{};
+        int fds[wlegl_max_request_fds] = {fd0, fd1, fd2, fd3};
+        int num_ints = ints->size / sizeof(int);
+        if (num_fds < 1 || num_fds > wlegl_max_request_fds ||
+            num_ints > wlegl_max_handle_ints) {
+            for (auto fd : fds)
+                close(fd);
+            wl_resource_post_error(resource, ANDROID_WLEGL_ERROR_BAD_VALUE,
+                                   "num_fds %d, num_ints %d is invalid.",
+                                   num_fds, num_ints);
+            return;
+        }
+        // padding, see the protocol
+        for (int i = num_fds; i < wlegl_max_request_fds; i++)
+            close(fds[i]);
+
+        if (!charge_client(self, resource, num_fds, 0, 0)) {
+            for (int i = 0; i < num_fds; i++)
+                close(fds[i]);
+            return;
+        }
+
+        // the handle is built straight from the request
         auto adapter = gralloc_loader::getInstance().get_adapter();
-        auto out_buffer = adapter->import_buffer(handle->get_native_buffer(),
-                                                 width, height, stride, format, usage);
-        if (!out_buffer) {
-            delete buffer;
+        auto native_handle = adapter->cutils.vptr.native_handle_create(num_fds, num_ints);
+        if (!native_handle) {
+            for (int i = 0; i < num_fds; i++)
+                close(fds[i]);
+            uncharge_client(client, num_fds, 0, 0);
+            wl_resource_post_no_memory(resource);
             return;
         }
-        buffer->buf = new RemoteWindowBuffer{out_buffer};
-        buffer->wlegl = self;
-        buffer->resource = wl_resource_create(client, &wl_buffer_interface, wl_buffer_interface.version, id);
-        wl_resource_set_implementation(buffer->resource, &wlegl_buffer_impl, buffer,
-                                       +[](struct wl_resource *resource) {
-            delete static_cast<wlegl_buffer*>(wl_resource_get_user_data(resource));
-        });
+        memcpy(&native_handle->data[0], fds, num_fds * sizeof(int));
+        memcpy(&native_handle->data[num_fds], ints->data, num_ints * sizeof(int));
+
+        create_wlegl_buffer(client, resource, id, width, height, stride, format,
+                            usage, native_handle);
     },
     // clang-format on
 };
@@ -770,6 +1315,12 @@ struct server_wlegl* create_server_wlegl(struct wl_display* display)
 {
     auto wlegl = new server_wlegl{};
     wlegl->display = display;
+    constexpr int max_count = std::numeric_limits<int>::max();
+    wlegl->max_client_fds = env_limit("WLEGL_MAX_CLIENT_FDS", 1024, max_count);
+    wlegl->max_client_buffers =
+        env_limit("WLEGL_MAX_CLIENT_BUFFERS", 256, max_count);
+    wlegl->max_client_bytes =
+        env_limit("WLEGL_MAX_CLIENT_MB", 2048, UINT64_MAX >> 20) << 20;
     // clang-format off
     wlegl->global = wl_global_create(display,
         &android_wlegl_interface, android_wlegl_interface.version,
@@ -786,12 +1337,144 @@ struct server_wlegl* create_server_wlegl(struct wl_display* display)
 
 void delete_server_wlegl(struct server_wlegl* wlegl)
 {
+    if (wlegl->release_idle)
+        wl_event_source_remove(wlegl->release_idle);
+    // the buffers may outlive the global, forget them
+    for (auto& [client, pending] : wlegl->pending_releases)
+    {
+        for (auto resource : pending)
+            wlegl_buffer::from(resource)->release_pending = false;
+    }
+
     wl_global_destroy(wlegl->global);
     delete wlegl;
 }
 
+void queue_buffer_release(struct wl_resource* resource)
+{
+    auto buffer = wlegl_buffer::from(resource);
+    if (!buffer)
+    {
+        wl_buffer_send_release(resource);
+        return;
+    }
+    if (buffer->release_pending)
+        return;
+
+    auto wlegl = buffer->wlegl;
+    buffer->release_pending = true;
+    wlegl->pending_releases[wl_resource_get_client(resource)].push_back(
+        resource);
+
+    if (!wlegl->release_idle)
+    {
+        auto loop = wl_display_get_event_loop(wlegl->display);
+        // clang-format off
+        wlegl->release_idle = wl_event_loop_add_idle(loop,
+            +[](void* data) {
+            auto wlegl = static_cast<server_wlegl*>(data);
+            // idle sources are gone once dispatched
+            wlegl->release_idle = nullptr;
+            flush_buffer_releases(wlegl);
+        }, wlegl);
+        // clang-format on
+    }
+}
+
+void flush_buffer_releases(struct server_wlegl* wlegl)
+{
+    if (wlegl->release_idle)
+    {
+        wl_event_source_remove(wlegl->release_idle);
+        wlegl->release_idle = nullptr;
+    }
+
+    for (auto& [client, pending] : wlegl->pending_releases)
+    {
+        if (pending.empty())
+            continue;
+
+        for (auto resource : pending)
+        {
+            wlegl_buffer::from(resource)->release_pending = false;
+            wl_buffer_send_release(resource);
+        }
+        wl_client_flush(client);
+    }
+    wlegl->pending_releases.clear();
+}
+
 EGLClientBuffer get_buffer_from_resource(struct wl_resource* resource)
 {
     auto buffer = wlegl_buffer::from(resource);
+    if (!buffer)
+        return nullptr;
     return buffer->buf->getNativeBuffer();
 }
+
+std::shared_ptr<gralloc_buffer>
+get_gralloc_buffer_from_resource(struct wl_resource* resource)
+{
+    auto buffer = wlegl_buffer::from(resource);
+    if (!buffer)
+        return nullptr;
+    return buffer->buf->get_buffer();
+}
+
+EGLImage acquire_buffer_image(struct wl_resource* resource, EGLDisplay dpy)
+{
+    auto buffer = wlegl_buffer::from(resource);
+    if (!buffer)
+        return EGL_NO_IMAGE;
+
+    std::lock_guard<std::mutex> lock{wlegl_images_mutex};
+    for (auto& image : buffer->images)
+    {
+        if (image->display == dpy)
+        {
+            image->user_refs++;
+            return image->image;
+        }
+    }
+    return EGL_NO_IMAGE;
+}
+
+void cache_buffer_image(struct wl_resource* resource, EGLDisplay dpy,
+                        EGLImage image, destroy_image_func destroy)
+{
+    auto buffer = wlegl_buffer::from(resource);
+    if (!buffer || image == EGL_NO_IMAGE || !destroy)
+        return;
+
+    auto entry = std::make_shared<wlegl_image>(wlegl_image{
+        .display = dpy,
+        .image = image,
+        .destroy = destroy,
+        .user_refs = 1,
+        .buffer_alive = true,
+    });
+
+    std::lock_guard<std::mutex> lock{wlegl_images_mutex};
+    buffer->images.push_back(entry);
+    wlegl_images[image] = std::move(entry);
+}
+
+bool release_buffer_image(EGLDisplay dpy, EGLImage image)
+{
+    std::lock_guard<std::mutex> lock{wlegl_images_mutex};
+    auto iter = wlegl_images.find(image);
+    if (iter == wlegl_images.end() || iter->second->display != dpy)
+        return false;
+
+    auto entry = iter->second;
+    if (entry->user_refs > 0)
+        entry->user_refs--;
+
+    // keep the image for the next attach while the wl_buffer lives
+    if (entry->user_refs == 0 && !entry->buffer_alive)
+    {
+        wlegl_images.erase(iter);
+        entry->destroy(entry->display, entry->image);
+    }
+    return true;
+}
@@ -7,6 +7,7 @@
 #include <wayland-client-protocol-core.h>
 #include <wayland-android-server-protocol-core.h>
 #include <wayland-android-client-protocol-core.h>
+#include <linux-dmabuf-unstable-v1-client-protocol-core.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
 
@@ -14,18 +15,39 @@
 #include "platform_base.h"
 
 #include "platform_common/wayland/platform_wayland.h"
+#include "shm_presenter.h"
 
 #include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// format/modifier pairs the compositor takes through zwp_linux_dmabuf_v1
+struct wayland_dmabuf_formats
+{
+    std::set<std::pair<uint32_t, uint64_t>> modifiers;
+    // before version 3 only formats are advertised, with implicit modifiers
+    bool implicit_modifiers = false;
+
+    bool supports(uint32_t fourcc, uint64_t modifier) const;
+};
 
 class WaylandNativeWindowBuffer;
 class WaylandNativeWindow : public EGLBaseNativeWindow {
   public:
+    // any of wlegl, dmabuf and shm may be null. dmabuf is preferred for the
+    // buffers which can be exported as dma-bufs, then wlegl, and shm copies
+    // whatever neither of them can share
     WaylandNativeWindow(struct wl_display* display, struct wl_egl_window* win,
-                        struct android_wlegl* wlegl);
+                        struct android_wlegl* wlegl,
+                        struct zwp_linux_dmabuf_v1* dmabuf,
+                        const wayland_dmabuf_formats* dmabuf_formats,
+                        struct wl_shm* shm,
+                        const std::set<uint32_t>* shm_formats);
     ~WaylandNativeWindow();
 
     void resize(uint32_t width, uint32_t height);
-    void releaseBuffer(struct wl_buffer* buf);
 
     virtual int setSwapInterval(int interval) override;
     void prepare_swap(const EGLint* damage_rects, EGLint damage_n_rects);
@@ -59,13 +81,20 @@ class WaylandNativeWindow : public EGLBaseNativeWindow {
     virtual int setBufferCount(int cnt) override;
 
   private:
+    void allocateBuffers();
     void removeAllBuffers();
+    // move every buffer the compositor released since the last call back
+    // to the free set, m_mutex held
+    void drainReleasedBuffers();
 
     mutable std::mutex m_mutex;
     struct wl_display* m_display;
     struct wl_display* m_display_wrapper;
     struct wl_egl_window* m_window;
     struct android_wlegl* m_wlegl_wrapper;
+    struct zwp_linux_dmabuf_v1* m_dmabuf_wrapper;
+    const wayland_dmabuf_formats* m_dmabuf_formats;
+    std::unique_ptr<wayland_shm_presenter> m_shm_presenter;
     struct wl_surface* m_surface_wrapper;
 
     std::list<android_wrap::sp<WaylandNativeWindowBuffer>> m_bufList;
@@ -79,6 +108,8 @@ class WaylandNativeWindow : public EGLBaseNativeWindow {
     uint32_t m_defaultWidth;
     uint32_t m_defaultHeight;
     uint64_t m_usage;
+    // or'ed into every usage, cpu reads for the shm copy
+    uint64_t m_required_usage;
     int m_swap_interval;
 
     int m_bufCount;
@@ -95,6 +126,10 @@ class WaylandNativeWindowBuffer : public BaseNativeWindowBuffer {
     struct wl_buffer* wlbuffer;
     bool busy; // this buffer is being used;
     bool youngest; // this buffer isn't rendered
+    bool shm_only; // the compositor cannot take it, copied through wl_shm
+    // set by the wl_buffer.release listener, no lock taken there
+    std::atomic<bool> released{false};
+    static struct wl_buffer_listener release_listener;
 
   protected:
     WaylandNativeWindowBuffer(uint32_t width, uint32_t height, uint32_t format,
@@ -106,7 +141,8 @@ class WaylandNativeWindowBuffer : public BaseNativeWindowBuffer {
         ANativeWindowBuffer::usage_deprecated = usage;
         ANativeWindowBuffer::usage = usage;
         auto adapter = gralloc_loader::getInstance().get_adapter();
-        m_buffer = adapter->allocate_buffer(width, height, format, usage);
+        m_buffer = adapter->allocate_buffer(width, height, format, usage,
+                                            buffer_owner::surface);
         if (m_buffer)
         {
             ANativeWindowBuffer::handle = m_buffer->handle;
@@ -114,11 +150,31 @@ class WaylandNativeWindowBuffer : public BaseNativeWindowBuffer {
         }
         busy = false;
 //        youngest = true;
+        shm_only = false;
+        wlbuffer = nullptr;
+    }
+    WaylandNativeWindowBuffer(std::shared_ptr<gralloc_buffer> buffer) :
+        m_buffer(std::move(buffer))
+    {
+        ANativeWindowBuffer::width = m_buffer->width;
+        ANativeWindowBuffer::height = m_buffer->height;
+        ANativeWindowBuffer::format = m_buffer->format;
+        ANativeWindowBuffer::usage_deprecated = m_buffer->usage;
+        ANativeWindowBuffer::usage = m_buffer->usage;
+        ANativeWindowBuffer::handle = m_buffer->handle;
+        ANativeWindowBuffer::stride = m_buffer->stride;
+        busy = false;
+        shm_only = false;
         wlbuffer = nullptr;
     }
     void create_wl_buffer(struct wl_display* display,
                           struct android_wlegl* wlegl,
                           struct wl_event_queue* queue);
+    // false if the buffer or the compositor cannot do it
+    bool create_dmabuf_wl_buffer(struct wl_display* display,
+                                 struct zwp_linux_dmabuf_v1* dmabuf,
+                                 const wayland_dmabuf_formats& formats,
+                                 struct wl_event_queue* queue);
 
   public:
     ~WaylandNativeWindowBuffer();
@@ -131,6 +187,10 @@ class wayland_wrapper_t : public platform_wrapper_t {
     struct wl_event_queue* event_queue;
     struct wl_registry* registry;
     struct android_wlegl* wlegl;
+    struct zwp_linux_dmabuf_v1* dmabuf;
+    wayland_dmabuf_formats dmabuf_formats;
+    struct wl_shm* shm;
+    std::set<uint32_t> shm_formats;
 
   public:
     wayland_wrapper_t(struct wl_display* display);
@@ -143,6 +203,7 @@ class wayland_wrapper_t : public platform_wrapper_t {
     virtual void prepare_swap(ANativeWindow* win, const EGLint* rects,
                               EGLint n_rects) override;
     virtual void finish_swap(ANativeWindow* win) override;
+    virtual void adjust_configs(egl_config_table_t& configs) override;
 };
 
 // form server
@@ -161,15 +222,50 @@ class RemoteWindowBuffer : public BaseNativeWindowBuffer {
         usage = m_buffer->usage;
         ANativeWindowBuffer::handle = m_buffer->handle;
     }
+
+    const std::shared_ptr<gralloc_buffer>& get_buffer() const
+    {
+        return m_buffer;
+    }
 };
 
 struct server_wlegl
 {
     struct wl_display* display;
     struct wl_global* global;
+    // wl_buffer resources queued by queue_buffer_release, per client
+    std::unordered_map<struct wl_client*, std::vector<struct wl_resource*>>
+        pending_releases;
+    struct wl_event_source* release_idle = nullptr;
+    // what each client may hold at once, from WLEGL_MAX_CLIENT_FDS,
+    // WLEGL_MAX_CLIENT_BUFFERS and WLEGL_MAX_CLIENT_MB
+    int max_client_fds;
+    int max_client_buffers;
+    uint64_t max_client_bytes;
 };
 struct server_wlegl* create_server_wlegl(struct wl_display* display);
 void delete_server_wlegl(struct server_wlegl* wlegl);
 EGLClientBuffer get_buffer_from_resource(struct wl_resource* resource);
+// the gralloc buffer behind a wl_egl wl_buffer, for compositors handing it
+// to scanout or an overlay plane instead of texturing from it
+std::shared_ptr<gralloc_buffer>
+get_gralloc_buffer_from_resource(struct wl_resource* resource);
+
+// Optional replacement for wl_buffer_send_release: releases of wl_egl
+// buffers are held back and sent per client with one flush, by
+// flush_buffer_releases at the end of a frame or when the event loop goes
+// idle. Other buffers are released right away.
+void queue_buffer_release(struct wl_resource* resource);
+void flush_buffer_releases(struct server_wlegl* wlegl);
+
+// EGLImages created from a wl_buffer are cached on the buffer and shared by
+// every eglCreateImage of it on the same display. The vendor image is
+// destroyed when the wl_buffer is gone and every eglDestroyImage came in.
+using destroy_image_func = EGLBoolean (*)(EGLDisplay, EGLImage);
+EGLImage acquire_buffer_image(struct wl_resource* resource, EGLDisplay dpy);
+void cache_buffer_image(struct wl_resource* resource, EGLDisplay dpy,
+                        EGLImage image, destroy_image_func destroy);
+// returns false if image is not a cached wl_buffer image
+bool release_buffer_image(EGLDisplay dpy, EGLImage image);
 
 #endif // EGL_PLATFORM_WAYLAND_H_
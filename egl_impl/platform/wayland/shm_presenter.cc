@@ -0,0 +1,347 @@
+#include "shm_presenter.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <android/hardware_buffer.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+// at most this many shm buffers per window, the compositor holds one or two
+constexpr size_t max_slots = 3;
+// a slot with more pending rects than this is copied as a whole
+constexpr size_t max_slot_rects = 16;
+
+constexpr uint32_t fourcc_code(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 |
+           static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+}
+
+// wl_shm uses DRM fourcc codes except for its two mandatory formats
+uint32_t shm_format_of(uint32_t fourcc)
+{
+    if (fourcc == fourcc_code('A', 'R', '2', '4'))
+        return WL_SHM_FORMAT_ARGB8888;
+    if (fourcc == fourcc_code('X', 'R', '2', '4'))
+        return WL_SHM_FORMAT_XRGB8888;
+    return fourcc;
+}
+
+int create_memfd(const char* name)
+{
+#ifdef SYS_memfd_create
+    return syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// swap the first and third byte of every pixel, RGBA <-> BGRA
+void swap_rb(uint32_t* dst, const uint32_t* src, size_t n)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16x4_t px = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint8x16_t r = px.val[0];
+        px.val[0] = px.val[2];
+        px.val[2] = r;
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + i), px);
+    }
+#elif defined(__SSE2__)
+    const __m128i ga_mask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i px =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i rb = _mm_andnot_si128(ga_mask, px);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        px = _mm_or_si128(_mm_and_si128(px, ga_mask), rb);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), px);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t px = src[i];
+        dst[i] = (px & 0xff00ff00) | (px >> 16 & 0xff) | (px & 0xff) << 16;
+    }
+}
+} // namespace
+
+struct wayland_shm_presenter::slot
+{
+    int fd = -1;
+    void* data = MAP_FAILED;
+    size_t size = 0;
+    struct wl_shm_pool* pool = nullptr;
+    struct wl_buffer* wlbuffer = nullptr;
+
+    int width = 0;
+    int height = 0;
+    int stride = 0; // in bytes
+    uint32_t shm_format = 0;
+    bool busy = false;
+
+    // what changed since this slot was written last
+    std::vector<ARect> damage;
+    bool full_damage = true;
+
+    static struct wl_buffer_listener release_listener;
+};
+
+struct wl_buffer_listener wayland_shm_presenter::slot::release_listener = {
+    // clang-format off
+    .release = +[](void* data, struct wl_buffer* buffer) {
+        static_cast<slot*>(data)->busy = false;
+    },
+    // clang-format on
+};
+
+wayland_shm_presenter::wayland_shm_presenter(struct wl_display* display,
+                                             struct wl_shm* shm,
+                                             const std::set<uint32_t>* formats,
+                                             struct wl_event_queue* queue) :
+    m_display(display),
+    m_shm_wrapper((struct wl_shm*)wl_proxy_create_wrapper(shm)),
+    m_formats(formats),
+    m_queue(queue)
+{
+    wl_proxy_set_queue((struct wl_proxy*)m_shm_wrapper, m_queue);
+}
+
+wayland_shm_presenter::~wayland_shm_presenter()
+{
+    for (auto& s : m_slots)
+        release_slot(s.get());
+    m_slots.clear();
+
+    if (m_shm_wrapper)
+    {
+        wl_proxy_wrapper_destroy(m_shm_wrapper);
+        m_shm_wrapper = nullptr;
+    }
+}
+
+bool wayland_shm_presenter::pick_format(int format, uint32_t* shm_format,
+                                        conversion* convert) const
+{
+    uint32_t fourcc = gralloc_adapter_t::drm_fourcc(format);
+    if (fourcc == 0)
+        return false;
+
+    *shm_format = shm_format_of(fourcc);
+    *convert = conversion::none;
+    if (m_formats->count(*shm_format))
+        return true;
+
+    // GL renders RGBA, wl_shm only has to know BGRA
+    *convert = conversion::swap_rb;
+    if (fourcc == fourcc_code('A', 'B', '2', '4'))
+        *shm_format = WL_SHM_FORMAT_ARGB8888;
+    else if (fourcc == fourcc_code('X', 'B', '2', '4'))
+        *shm_format = WL_SHM_FORMAT_XRGB8888;
+    else
+        return false;
+    return m_formats->count(*shm_format) != 0;
+}
+
+bool wayland_shm_presenter::supports(int format) const
+{
+    uint32_t shm_format;
+    conversion convert;
+    return pick_format(format, &shm_format, &convert);
+}
+
+bool wayland_shm_presenter::init_slot(slot* s, int width, int height,
+                                      uint32_t shm_format, int bpp)
+{
+    s->width = width;
+    s->height = height;
+    s->stride = width * bpp;
+    s->shm_format = shm_format;
+    s->size = static_cast<size_t>(s->stride) * height;
+    s->damage.clear();
+    s->full_damage = true;
+
+    s->fd = create_memfd("egl-shm");
+    if (s->fd < 0)
+    {
+        logger::log_error() << "memfd_create failed, errno: " << errno;
+        return false;
+    }
+    if (ftruncate(s->fd, s->size) < 0)
+    {
+        logger::log_error() << "resize shm buffer to " << s->size
+                            << " failed, errno: " << errno;
+        return false;
+    }
+    s->data = mmap(nullptr, s->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   s->fd, 0);
+    if (s->data == MAP_FAILED)
+    {
+        logger::log_error() << "mmap shm buffer failed, errno: " << errno;
+        return false;
+    }
+
+    s->pool = wl_shm_create_pool(m_shm_wrapper, s->fd, s->size);
+    s->wlbuffer = wl_shm_pool_create_buffer(s->pool, 0, width, height,
+                                            s->stride, shm_format);
+    if (!s->wlbuffer)
+        return false;
+    wl_buffer_add_listener(s->wlbuffer, &slot::release_listener, s);
+    return true;
+}
+
+void wayland_shm_presenter::release_slot(slot* s)
+{
+    if (s->wlbuffer)
+    {
+        wl_buffer_destroy(s->wlbuffer);
+        s->wlbuffer = nullptr;
+    }
+    if (s->pool)
+    {
+        wl_shm_pool_destroy(s->pool);
+        s->pool = nullptr;
+    }
+    if (s->data != MAP_FAILED)
+    {
+        munmap(s->data, s->size);
+        s->data = MAP_FAILED;
+    }
+    if (s->fd >= 0)
+    {
+        close(s->fd);
+        s->fd = -1;
+    }
+    s->busy = false;
+}
+
+wayland_shm_presenter::slot*
+wayland_shm_presenter::acquire_slot(int width, int height,
+                                    uint32_t shm_format, int bpp)
+{
+    for (;;)
+    {
+        slot* stale = nullptr;
+        for (auto& s : m_slots)
+        {
+            if (s->busy)
+                continue;
+            if (s->width == width && s->height == height &&
+                s->shm_format == shm_format)
+                return s.get();
+            stale = s.get();
+        }
+
+        if (!stale && m_slots.size() < max_slots)
+        {
+            m_slots.push_back(std::make_unique<slot>());
+            stale = m_slots.back().get();
+        }
+        if (stale)
+        {
+            // resized or new, written as a whole the first time
+            release_slot(stale);
+            if (init_slot(stale, width, height, shm_format, bpp))
+                return stale;
+            release_slot(stale);
+            return nullptr;
+        }
+
+        if (wl_display_dispatch_queue(m_display, m_queue) == -1)
+        {
+            logger::log_error() << "waiting for a free shm buffer failed";
+            return nullptr;
+        }
+    }
+}
+
+struct wl_buffer* wayland_shm_presenter::present(gralloc_buffer& buffer,
+                                                 const ARect* rects,
+                                                 int n_rects)
+{
+    uint32_t shm_format;
+    conversion convert;
+    int bpp, plane_x2;
+    if (!pick_format(buffer.format, &shm_format, &convert) ||
+        !gralloc_adapter_t::format_info(buffer.format, &bpp, &plane_x2))
+        return nullptr;
+
+    // every slot misses this frame until it is written
+    for (auto& s : m_slots)
+    {
+        if (n_rects <= 0 || s->damage.size() + n_rects > max_slot_rects)
+            s->full_damage = true;
+        if (!s->full_damage)
+            s->damage.insert(s->damage.end(), rects, rects + n_rects);
+    }
+
+    auto s = acquire_slot(buffer.width, buffer.height, shm_format, bpp);
+    if (!s)
+        return nullptr;
+
+    const ARect bounds = {0, 0, buffer.width, buffer.height};
+    void* vaddr = nullptr;
+    if (buffer.lock(AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, bounds, &vaddr) !=
+            0 ||
+        !vaddr)
+    {
+        logger::log_error() << "cannot lock buffer for the shm copy";
+        return nullptr;
+    }
+
+    const size_t src_stride = static_cast<size_t>(buffer.stride) * bpp;
+    auto copy_rect = [&](ARect r) {
+        r.left = std::clamp(r.left, 0, s->width);
+        r.right = std::clamp(r.right, r.left, s->width);
+        r.top = std::clamp(r.top, 0, s->height);
+        r.bottom = std::clamp(r.bottom, r.top, s->height);
+        const size_t offset = static_cast<size_t>(r.left) * bpp;
+        const size_t pixels = r.right - r.left;
+        auto src = static_cast<const uint8_t*>(vaddr) + r.top * src_stride +
+                   offset;
+        auto dst = static_cast<uint8_t*>(s->data) +
+                   static_cast<size_t>(r.top) * s->stride + offset;
+        for (int y = r.top; y < r.bottom; y++)
+        {
+            if (convert == conversion::swap_rb)
+                swap_rb(reinterpret_cast<uint32_t*>(dst),
+                        reinterpret_cast<const uint32_t*>(src), pixels);
+            else
+                memcpy(dst, src, pixels * bpp);
+            src += src_stride;
+            dst += s->stride;
+        }
+    };
+
+    if (s->full_damage)
+    {
+        copy_rect(bounds);
+    }
+    else
+    {
+        for (const auto& r : s->damage)
+            copy_rect(r);
+    }
+    buffer.unlock();
+
+    s->damage.clear();
+    s->full_damage = false;
+    s->busy = true;
+    return s->wlbuffer;
+}
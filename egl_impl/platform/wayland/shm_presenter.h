@@ -0,0 +1,61 @@
+#ifndef EGL_PLATFORM_WAYLAND_SHM_PRESENTER_H_
+#define EGL_PLATFORM_WAYLAND_SHM_PRESENTER_H_
+
+#include <wayland-client-protocol-core.h>
+#include <android/rect.h>
+
+#include "gralloc_adapter.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+// Last resort for compositors which take neither android_wlegl nor the
+// buffer as a dma-buf: the rendered gralloc buffer is read back through a
+// cpu lock and copied into a small ring of wl_shm buffers. Every shm buffer
+// remembers what changed since it was last written, so a frame only copies
+// its damage plus what the buffer missed while the compositor held it.
+class wayland_shm_presenter {
+  public:
+    // formats as announced by wl_shm.format, shm may not be a wrapper
+    wayland_shm_presenter(struct wl_display* display, struct wl_shm* shm,
+                          const std::set<uint32_t>* formats,
+                          struct wl_event_queue* queue);
+    ~wayland_shm_presenter();
+
+    wayland_shm_presenter(const wayland_shm_presenter&) = delete;
+    wayland_shm_presenter& operator=(const wayland_shm_presenter&) = delete;
+
+    // whether buffers of an AHardwareBuffer format can be shown
+    bool supports(int format) const;
+
+    // copy the damaged part of buffer into a free shm buffer, waiting for
+    // the compositor to release one if needed. rects are in buffer
+    // coordinates with the origin at the top left, none means everything.
+    // returns the wl_buffer to attach or nullptr, the presenter keeps it.
+    struct wl_buffer* present(gralloc_buffer& buffer, const ARect* rects,
+                              int n_rects);
+
+  private:
+    enum class conversion
+    {
+        none,
+        swap_rb, // RGBA <-> BGRA, and the X variants
+    };
+    struct slot;
+
+    bool pick_format(int format, uint32_t* shm_format,
+                     conversion* convert) const;
+    slot* acquire_slot(int width, int height, uint32_t shm_format, int bpp);
+    bool init_slot(slot* s, int width, int height, uint32_t shm_format,
+                   int bpp);
+    void release_slot(slot* s);
+
+    struct wl_display* m_display;
+    struct wl_shm* m_shm_wrapper;
+    const std::set<uint32_t>* m_formats;
+    struct wl_event_queue* m_queue;
+    std::vector<std::unique_ptr<slot>> m_slots;
+};
+
+#endif // EGL_PLATFORM_WAYLAND_SHM_PRESENTER_H_
@@ -0,0 +1,65 @@
+// the shadow state of EGL_STATE_FILTER=1 without a driver: which calls of
+// two contexts sharing objects it lets through and which it drops.
+
+#include "egl_state_filter.h"
+
+#include <GLES3/gl3.h>
+#include <stdio.h>
+
+namespace {
+int failed = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failed++;
+}
+} // namespace
+
+int main()
+{
+    egl_state_filter_t a{nullptr};
+    egl_state_filter_t b{a.share_group()};
+
+    check(a.enable(GL_BLEND, true), "first glEnable goes through");
+    check(!a.enable(GL_BLEND, true), "same glEnable is dropped");
+    check(a.enable(GL_BLEND, false), "glDisable goes through");
+
+    check(a.bind_texture(GL_TEXTURE_2D, 3), "glBindTexture, unit unknown");
+    check(a.active_texture(GL_TEXTURE0), "glActiveTexture");
+    check(a.bind_texture(GL_TEXTURE_2D, 3), "glBindTexture");
+    check(!a.bind_texture(GL_TEXTURE_2D, 3), "same glBindTexture is dropped");
+    check(b.active_texture(GL_TEXTURE0) && b.bind_texture(GL_TEXTURE_2D, 3) &&
+              !b.bind_texture(GL_TEXTURE_2D, 3),
+          "the other context keeps its own bindings");
+
+    GLuint texture = 3;
+    a.deleted_textures(1, &texture);
+    check(!a.bind_texture(GL_TEXTURE_2D, 0),
+          "deleting unbinds in the deleting context");
+    check(b.bind_texture(GL_TEXTURE_2D, 3),
+          "deleting is forgotten in the share group");
+
+    check(a.viewport(0, 0, 1, 1), "glViewport");
+    check(!a.viewport(0, 0, 1, 1), "same glViewport is dropped");
+    check(a.viewport(0, 0, -1, 1) && a.viewport(0, 0, -1, 1),
+          "failing glViewport goes through");
+
+    check(a.bind_framebuffer(GL_FRAMEBUFFER, 1), "glBindFramebuffer");
+    check(!a.bind_framebuffer(GL_DRAW_FRAMEBUFFER, 1),
+          "GL_FRAMEBUFFER binds the draw framebuffer");
+    check(!a.bind_framebuffer(GL_FRAMEBUFFER, 1),
+          "same glBindFramebuffer is dropped");
+
+    check(a.use_program(2), "glUseProgram");
+    a.linked_program(2);
+    check(a.use_program(2), "glUseProgram after a relink goes through");
+
+    a.invalidate();
+    check(a.enable(GL_BLEND, false), "nothing is known after invalidate");
+
+    const auto& counters = a.counters();
+    check(counters.filtered == 6 && counters.calls == 15, "counters");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+// swapchain benchmark against the headless compositor. No GPU driver and no
+// gralloc HAL is involved: buffers come from the memfd backend and nothing
+// renders into them, so what is measured is the platform layer itself,
+// dequeueBuffer + queueBuffer + finish_swap, and the wayland traffic and
+// allocations they cause.
+
+#include "gralloc_adapter.h"
+#include "headless_compositor.h"
+#include "logger.h"
+#include "platform_wayland.h"
+
+#include <android/hardware_buffer.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace {
+std::atomic<uint64_t> heap_allocations{0};
+} // namespace
+
+// every thread counts, the compositor's included
+void* operator new(size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    abort();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace {
+constexpr int width = 1280;
+constexpr int height = 720;
+constexpr int warmup_frames = 30;
+
+using clock_type = std::chrono::steady_clock;
+
+struct bench_mode
+{
+    const char* name;
+    headless_compositor::options globals;
+    // a 128x128 damage rect per frame instead of the whole window
+    bool damage;
+};
+
+uint64_t gralloc_allocations()
+{
+    auto adapter = gralloc_loader::getInstance().get_adapter();
+    return adapter->allocations->get_snapshot().total.allocs;
+}
+
+bool run(const bench_mode& mode, int frames)
+{
+    headless_compositor compositor;
+    headless_surface client;
+    if (!compositor.start(mode.globals) ||
+        !client.connect(compositor.socket(), width, height))
+        return false;
+
+    bool ok = false;
+    {
+        wayland_wrapper_t wrapper{client.display};
+        ANativeWindow* win = nullptr;
+        if (wrapper.initialize() && (win = wrapper.create_window(client.window)))
+        {
+            win->setSwapInterval(win, 1);
+            const EGLint damage[] = {64, 64, 128, 128};
+            auto swap = [&] {
+                ANativeWindowBuffer* buffer = nullptr;
+                int fence = -1;
+                if (win->dequeueBuffer(win, &buffer, &fence) != 0)
+                    return false;
+                win->queueBuffer(win, buffer, -1);
+                if (mode.damage)
+                    wrapper.prepare_swap(win, damage, 1);
+                wrapper.finish_swap(win);
+                return true;
+            };
+
+            ok = true;
+            for (int i = 0; i < warmup_frames && ok; i++)
+                ok = swap();
+
+            std::vector<double> latencies;
+            latencies.reserve(frames);
+            wl_display_roundtrip(client.display);
+            uint64_t commits = compositor.commits;
+            uint64_t requests = compositor.requests;
+            uint64_t heap = heap_allocations;
+            uint64_t gralloc = gralloc_allocations();
+
+            auto begin = clock_type::now();
+            for (int i = 0; i < frames && ok; i++)
+            {
+                auto start = clock_type::now();
+                ok = swap();
+                latencies.push_back(
+                    std::chrono::duration<double, std::micro>(
+                        clock_type::now() - start)
+                        .count());
+            }
+            double seconds =
+                std::chrono::duration<double>(clock_type::now() - begin)
+                    .count();
+
+            heap = heap_allocations - heap;
+            gralloc = gralloc_allocations() - gralloc;
+            wl_display_roundtrip(client.display);
+            commits = compositor.commits - commits;
+            requests = compositor.requests - requests;
+
+            // a frame nobody could take is not committed
+            if (ok && commits != static_cast<uint64_t>(frames))
+            {
+                logger::log_error() << mode.name << ": " << commits
+                                    << " commits for " << frames << " frames";
+                ok = false;
+            }
+            if (ok)
+            {
+                std::sort(latencies.begin(), latencies.end());
+                auto percentile = [&](double p) {
+                    return latencies[static_cast<size_t>(p * (frames - 1))];
+                };
+                printf("%-12s %9.0f swaps/s  p50 %8.1f us  p99 %8.1f us  "
+                       "%5.1f requests/frame  %6.2f allocs/frame  "
+                       "%5.2f gralloc allocs/frame\n",
+                       mode.name, frames / seconds, percentile(0.5),
+                       percentile(0.99), static_cast<double>(requests) / frames,
+                       static_cast<double>(heap) / frames,
+                       static_cast<double>(gralloc) / frames);
+            }
+            wrapper.destroy_window(win);
+        }
+        wrapper.terminate();
+    }
+
+    client.disconnect();
+    compositor.stop();
+    return ok;
+}
+
+bool can_export_dmabuf()
+{
+    auto adapter = gralloc_loader::getInstance().get_adapter();
+    auto probe = adapter->allocate_buffer(
+        64, 64, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+        AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
+            AHARDWAREBUFFER_USAGE_GPU_FRAMEBUFFER);
+    gralloc_dmabuf_layout layout = {};
+    return probe && probe->export_dmabuf(&layout);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    logger::log_t::set_log_level(logger::LOG_WARN);
+
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+    if (frames <= 0)
+        frames = 2000;
+
+    // the stub gralloc, unless the caller picked a backend
+    setenv("ALWAYS_USE_MEMFD", "1", 0);
+    auto& loader = gralloc_loader::getInstance();
+    if (!loader.get_adapter())
+    {
+        logger::log_error() << "no gralloc backend";
+        return 1;
+    }
+
+    printf("backend: %d, %dx%d, %d frames\n",
+           static_cast<int>(loader.get_backend()), width, height, frames);
+
+    const bench_mode modes[] = {
+        {"wlegl", {.wlegl = true}, false},
+        {"dmabuf", {.wlegl = false, .dmabuf = true}, false},
+        {"shm", {.wlegl = false, .shm = true}, false},
+        {"shm-damage", {.wlegl = false, .shm = true}, true},
+    };
+
+    int failed = 0;
+    for (const auto& mode : modes)
+    {
+        if (mode.globals.dmabuf && !can_export_dmabuf())
+        {
+            printf("%-12s skipped, buffers cannot be exported as dma-bufs\n",
+                   mode.name);
+            continue;
+        }
+        if (!run(mode, frames))
+        {
+            printf("%-12s failed\n", mode.name);
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
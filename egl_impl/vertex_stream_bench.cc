@@ -0,0 +1,134 @@
+// cost of small draws from client arrays: a few quads drawn from the app's
+// memory, over and over, as UI toolkits do. Run it with and without
+// EGL_VERTEX_STREAM=1 to compare the driver's own copies with the
+// wrapper's ring buffers; with the mock driver the draw itself is free.
+
+#include "logger.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+template <typename Call>
+double ns_per_call(Call&& call, int iterations)
+{
+    auto begin = clock_type::now();
+    for (int i = 0; i < iterations; i++)
+        call();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  clock_type::now() - begin)
+                  .count();
+    return static_cast<double>(ns) / iterations;
+}
+
+struct vertex_t
+{
+    GLfloat position[2];
+    GLfloat uv[2];
+    GLubyte color[4];
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    logger::log_t::set_log_level(logger::LOG_WARN);
+
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (iterations <= 0)
+        iterations = 1000000;
+    int quads = argc > 2 ? atoi(argv[2]) : 8;
+    if (quads <= 0)
+        quads = 8;
+
+    // pbuffers only, the default display must not turn into a wayland one
+    unsetenv("WAYLAND_DISPLAY");
+    EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (!eglInitialize(dpy, nullptr, nullptr))
+    {
+        logger::log_error() << "eglInitialize failed: " << std::hex
+                            << eglGetError();
+        return 1;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+    EGLContext ctx = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (eglChooseConfig(dpy, config_attribs, &config, 1, &count) && count)
+    {
+        ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, context_attribs);
+        surface = eglCreatePbufferSurface(dpy, config, pbuffer_attribs);
+    }
+    if (ctx == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(dpy, surface, surface, ctx))
+    {
+        logger::log_error() << "cannot make a pbuffer context current";
+        return 1;
+    }
+
+    std::vector<vertex_t> vertices(quads * 4);
+    std::vector<GLushort> indices(quads * 6);
+    for (int i = 0; i < quads; i++)
+    {
+        for (int corner = 0; corner < 4; corner++)
+        {
+            GLfloat x = (corner & 1) ? 1.0f : 0.0f;
+            GLfloat y = (corner & 2) ? 1.0f : 0.0f;
+            vertices[i * 4 + corner] = {
+                {x + i, y}, {x, y}, {255, 255, 255, 255}};
+        }
+        const GLushort quad[] = {0, 1, 2, 2, 1, 3};
+        for (int j = 0; j < 6; j++)
+            indices[i * 6 + j] = static_cast<GLushort>(i * 4 + quad[j]);
+    }
+
+    const char* data = reinterpret_cast<const char*>(vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t),
+                          data + offsetof(vertex_t, position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t),
+                          data + offsetof(vertex_t, uv));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex_t),
+                          data + offsetof(vertex_t, color));
+    for (GLuint index = 0; index < 3; index++)
+        glEnableVertexAttribArray(index);
+
+    const char* streamed = getenv("EGL_VERTEX_STREAM");
+    printf("%d draws each of %d quads, EGL_VERTEX_STREAM=%s\n", iterations,
+           quads, streamed ? streamed : "0");
+
+    double ns = ns_per_call(
+        [&] {
+            glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT,
+                           indices.data());
+        },
+        iterations);
+    printf("%-22s %8.1f ns\n", "glDrawElements", ns);
+
+    ns = ns_per_call([&] { glDrawArrays(GL_TRIANGLE_STRIP, 0, quads * 4); },
+                     iterations);
+    printf("%-22s %8.1f ns\n", "glDrawArrays", ns);
+
+    glFinish();
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(dpy, surface);
+    eglDestroyContext(dpy, ctx);
+    eglTerminate(dpy);
+    return 0;
+}
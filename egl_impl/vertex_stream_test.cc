@@ -0,0 +1,174 @@
+// draws from client arrays with EGL_VERTEX_STREAM=1 against the mock
+// driver: the vertices it draws are the app's, whether they were streamed
+// or went to the driver as they are, and the queries still see the app's
+// pointers. Run it with EGL_DRIVER_PATH=<build>/mock_driver; the driver is
+// loaded when libEGL is, so the variable has to be set before the process
+// starts.
+
+#include "logger.h"
+
+#include <EGL/egl.h>
+#include <GLES3/gl32.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+using draw_data_t = size_t (*)(unsigned int, void*, size_t);
+
+struct vertex_t
+{
+    GLfloat position[2];
+    GLubyte color[4];
+};
+
+int failed = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failed++;
+}
+
+// what attribute 0 read for the last draw, against the vertices given
+bool drew(draw_data_t draw_data, const vertex_t* vertices,
+          const std::vector<int>& order)
+{
+    std::vector<GLfloat> expected;
+    for (int vertex : order)
+    {
+        expected.push_back(vertices[vertex].position[0]);
+        expected.push_back(vertices[vertex].position[1]);
+    }
+    std::vector<GLfloat> data(expected.size());
+    size_t size = draw_data(0, data.data(), data.size() * sizeof(GLfloat));
+    return size == expected.size() * sizeof(GLfloat) && data == expected;
+}
+} // namespace
+
+int main()
+{
+    logger::log_t::set_log_level(logger::LOG_WARN);
+    setenv("EGL_VERTEX_STREAM", "1", 1);
+
+    // pbuffers only, the default display must not turn into a wayland one
+    unsetenv("WAYLAND_DISPLAY");
+    EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (!eglInitialize(dpy, nullptr, nullptr))
+    {
+        logger::log_error() << "eglInitialize failed: " << std::hex
+                            << eglGetError();
+        return 1;
+    }
+
+    draw_data_t draw_data = nullptr;
+    if (const char* dir = getenv("EGL_DRIVER_PATH"))
+    {
+        std::string path = std::string{dir} + "/libGLESv2.so";
+        if (void* driver = dlopen(path.c_str(), RTLD_NOW | RTLD_NOLOAD))
+            draw_data = reinterpret_cast<draw_data_t>(
+                dlsym(driver, "mock_driver_draw_data"));
+    }
+    if (!draw_data)
+    {
+        logger::log_error() << "needs the mock driver in EGL_DRIVER_PATH";
+        return 1;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+    EGLContext ctx = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (eglChooseConfig(dpy, config_attribs, &config, 1, &count) && count)
+    {
+        ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, context_attribs);
+        surface = eglCreatePbufferSurface(dpy, config, pbuffer_attribs);
+    }
+    if (ctx == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(dpy, surface, surface, ctx))
+    {
+        logger::log_error() << "cannot make a pbuffer context current";
+        return 1;
+    }
+
+    vertex_t vertices[8];
+    for (int i = 0; i < 8; i++)
+        vertices[i] = {{GLfloat(i), GLfloat(i * 10)}, {255, 0, 0, 255}};
+    const char* data = reinterpret_cast<const char*>(vertices);
+    const GLushort indices[] = {5, 2, 7, 2, 4, 5};
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t), data);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex_t),
+                          data + sizeof(vertices[0].position));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glDrawArrays(GL_TRIANGLES, 2, 3);
+    check(drew(draw_data, vertices, {2, 3, 4}), "glDrawArrays");
+
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
+    check(drew(draw_data, vertices, {5, 2, 7, 2, 4, 5}), "glDrawElements");
+
+    glDrawRangeElements(GL_TRIANGLES, 2, 7, 6, GL_UNSIGNED_SHORT, indices);
+    check(drew(draw_data, vertices, {5, 2, 7, 2, 4, 5}),
+          "glDrawRangeElements");
+
+    void* pointer = nullptr;
+    glGetVertexAttribPointerv(0, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+    check(pointer == data, "glGetVertexAttribPointerv after a draw");
+
+    // the draws the wrapper does not stream read the app's arrays
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDrawArraysInstanced(GL_TRIANGLES, 1, 3, 2);
+    check(drew(draw_data, vertices, {1, 2, 3}), "glDrawArraysInstanced");
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDrawElementsInstanced(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, indices, 2);
+    check(drew(draw_data, vertices, {5, 2, 7}), "glDrawElementsInstanced");
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDrawElementsBaseVertex(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, indices + 3,
+                             1);
+    check(drew(draw_data, vertices, {3, 5, 6}), "glDrawElementsBaseVertex");
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    pointer = nullptr;
+    glGetVertexAttribPointerv(0, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+    check(pointer == data, "glGetVertexAttribPointerv after a streamed draw");
+
+    // an instanced array is read from its start whatever first is, and is
+    // not shifted with the vertices
+    const GLfloat offsets[] = {100, 200, 300, 400};
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, offsets);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glDrawArrays(GL_TRIANGLES, 2, 3);
+    GLfloat instanced[6] = {};
+    size_t size = draw_data(2, instanced, sizeof(instanced));
+    check(drew(draw_data, vertices, {2, 3, 4}) &&
+              size == sizeof(instanced) && instanced[0] == 100 &&
+              instanced[3] == 200 && instanced[4] == 100,
+          "glDrawArrays with an instanced array");
+    glVertexAttribDivisor(2, 0);
+    glDisableVertexAttribArray(2);
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(dpy, surface);
+    eglDestroyContext(dpy, ctx);
+    eglTerminate(dpy);
+    return failed ? 1 : 0;
+}
@@ -5,14 +5,28 @@
 #include <hardware/hardware.h>
 
 #include <android/hardware_buffer.h>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 enum class backend_type : uint8_t {
     gralloc_libhardware,
     gralloc_nativewindow,
+    gralloc_memfd,
     gralloc_none
 };
 
+// who a buffer was allocated for, for allocation accounting
+enum class buffer_owner : uint8_t {
+    surface,
+    import,
+    pbuffer,
+    other,
+    count
+};
+
 class gralloc_adapter_t {
     class hardware_loader {
         void* handle = nullptr;
@@ -89,6 +103,73 @@ class gralloc_adapter_t {
     };
 
   public:
+    class buffer;
+
+    // live/peak count and bytes of the buffers of an adapter, split by
+    // format, usage and owner.
+    class allocation_tracker
+        : public std::enable_shared_from_this<allocation_tracker> {
+      public:
+        struct counter
+        {
+            uint64_t live_count;
+            uint64_t live_bytes;
+            uint64_t peak_count;
+            uint64_t peak_bytes;
+            uint64_t allocs;
+            uint64_t frees;
+        };
+
+        struct snapshot
+        {
+            double seconds; // since the tracker was created
+            counter total;
+            counter by_owner[static_cast<size_t>(buffer_owner::count)];
+            std::map<int, counter> by_format;
+            std::map<uint64_t, counter> by_usage;
+        };
+
+        allocation_tracker();
+
+        void track(buffer& buf, buffer_owner owner);
+        void untrack(const buffer& buf);
+
+        snapshot get_snapshot() const;
+        // log the snapshot with alloc/free rates since the previous dump
+        void dump();
+
+      private:
+        mutable std::mutex mutex;
+        snapshot stats{};
+        std::chrono::steady_clock::time_point start_time;
+        std::chrono::steady_clock::time_point last_dump_time;
+        uint64_t last_dump_allocs{};
+        uint64_t last_dump_frees{};
+    };
+
+    // a buffer as seen by linux-dmabuf and EGL_EXT_image_dma_buf_import,
+    // the fds stay owned by the buffer
+    struct dmabuf_layout
+    {
+        static constexpr uint64_t modifier_linear = 0;
+        // driver defined layout, whatever the allocator picked
+        static constexpr uint64_t modifier_invalid = 0x00ffffffffffffffULL;
+        static constexpr int max_planes = 4;
+
+        uint32_t fourcc;
+        uint64_t modifier;
+        // false when the layout is only what the handle suggests, the
+        // consumer may still refuse it
+        bool known;
+        int num_planes;
+        struct
+        {
+            int fd;
+            uint32_t offset;
+            uint32_t stride;
+        } planes[max_planes];
+    };
+
     class buffer {
       public:
         int width{};
@@ -106,21 +187,141 @@ class gralloc_adapter_t {
         buffer& operator=(const buffer&) = delete;
 
         virtual int lock(uint64_t usage, const ARect& rect, void** vaddr) = 0;
-        virtual int unlock() = 0;
+        // release_fence receives a sync fence (or -1) which signals when the
+        // cpu access has finished, the caller owns it.
+        virtual int unlock(int* release_fence) = 0;
+        // same as above but waits for the release fence itself.
+        int unlock();
+
+        // the AHardwareBuffer behind the buffer for backends which have
+        // one, not acquired, valid as long as this buffer.
+        virtual struct AHardwareBuffer* get_hardware_buffer() const
+        {
+            return nullptr;
+        }
+
+        // describe the buffer as dma-bufs, false if it is not backed by one
+        // or the format has no DRM fourcc. the default guesses a single
+        // plane layout for formats whose first handle fd is a dma-buf, only
+        // backends which made the buffer themselves know it.
+        virtual bool export_dmabuf(dmabuf_layout* layout);
+
+      protected:
+        // the cpu mapping kept alive in persistent mapping mode, see
+        // gralloc_adapter_t::persistent_mapping.
+        void* mapped_vaddr{};
+        uint64_t mapped_usage{};
+
+        // cache maintenance of a persistent mapping, DMA_BUF_IOCTL_SYNC on
+        // the first fd of the handle, no-op for non dma-buf backed handles.
+        int begin_cpu_access(uint64_t usage) const;
+        int end_cpu_access(uint64_t usage) const;
+
+      private:
+        friend class allocation_tracker;
+
+        std::shared_ptr<allocation_tracker> tracker;
+        buffer_owner owner = buffer_owner::other;
+        uint64_t tracked_bytes{};
     };
 
     virtual ~gralloc_adapter_t() = default;
-    virtual std::shared_ptr<gralloc_adapter_t::buffer>
-    allocate_buffer(int width, int height, int format, uint64_t usage) = 0;
-    virtual std::shared_ptr<gralloc_adapter_t::buffer>
+    std::shared_ptr<gralloc_adapter_t::buffer>
+    allocate_buffer(int width, int height, int format, uint64_t usage,
+                    buffer_owner owner = buffer_owner::other);
+
+    // imports of the same buffer (same backing fd[0] and ints) share one
+    // backend buffer as long as any of them is alive, each gets a buffer of
+    // its own whose locks only count for it. the handle is never taken
+    // over by the result.
+    std::shared_ptr<gralloc_adapter_t::buffer>
     import_buffer(buffer_handle_t handle, int width, int height, int stride,
-                  int format, uint64_t usage) = 0;
+                  int format, uint64_t usage);
+
+    // like import_buffer, but the handle (from native_handle_create) is
+    // always consumed: backends which understand it keep it as the buffer's
+    // own handle instead of cloning, otherwise it is closed and deleted.
+    std::shared_ptr<gralloc_adapter_t::buffer>
+    adopt_buffer(native_handle_t* handle, int width, int height, int stride,
+                 int format, uint64_t usage);
+
+    // allocate count buffers described by desc, all of them or none.
+    std::vector<std::shared_ptr<gralloc_adapter_t::buffer>>
+    allocate_buffers(uint32_t count, const AHardwareBuffer_Desc& desc,
+                     buffer_owner owner = buffer_owner::other);
+
+    // bytes per pixel of the first plane and the size of the whole image in
+    // units of that plane, as 2x to express 4:2:0 chroma
+    static bool format_info(int format, int* bpp, int* plane_x2);
+    // DRM fourcc of a single plane format, 0 if there is none
+    static uint32_t drm_fourcc(int format);
+
+    // every buffer allocated or imported through this adapter, dumped every
+    // GRALLOC_STATS_INTERVAL seconds when set.
+    const std::shared_ptr<allocation_tracker> allocations =
+        std::make_shared<allocation_tracker>();
+
+    // disabled by GRALLOC_DISABLE_IMPORT_CACHE.
+    bool import_cache_enabled = true;
+
+    // keep the first cpu mapping of a buffer until the buffer goes away,
+    // later lock/unlock calls only sync the cpu caches. enabled by
+    // GRALLOC_PERSISTENT_MAPPING.
+    bool persistent_mapping = false;
 
     sync_loader sync{};
     cutils_loader cutils{};
+
+  protected:
+    virtual std::shared_ptr<gralloc_adapter_t::buffer>
+    allocate_buffer_impl(int width, int height, int format,
+                         uint64_t usage) = 0;
+    // backends which can batch the allocation into one HAL call override
+    // this, the default allocates the buffers one by one.
+    virtual std::vector<std::shared_ptr<gralloc_adapter_t::buffer>>
+    allocate_buffers_impl(uint32_t count, const AHardwareBuffer_Desc& desc);
+    // backend import, always clones the handle
+    virtual std::shared_ptr<gralloc_adapter_t::buffer>
+    import_buffer_impl(buffer_handle_t handle, int width, int height,
+                       int stride, int format, uint64_t usage) = 0;
+    // backend import taking over the handle on success, the default
+    // imports a clone and releases the handle.
+    virtual std::shared_ptr<gralloc_adapter_t::buffer>
+    adopt_buffer_impl(native_handle_t* handle, int width, int height,
+                      int stride, int format, uint64_t usage);
+
+  private:
+    struct import_key
+    {
+        uint64_t dev;
+        uint64_t ino;
+        int width;
+        int height;
+        int stride;
+        int format;
+        uint64_t usage;
+        std::vector<int> ints;
+
+        bool operator<(const import_key& other) const;
+    };
+    // the backend buffer behind the imports of one buffer, and what each
+    // import hands out
+    struct shared_import;
+    class imported_buffer;
+
+    std::shared_ptr<gralloc_adapter_t::buffer>
+    import_buffer_cached(buffer_handle_t handle, int width, int height,
+                         int stride, int format, uint64_t usage, bool adopt);
+    void release_handle(buffer_handle_t handle);
+
+    std::mutex import_cache_mutex;
+    std::map<import_key, std::weak_ptr<shared_import>> import_cache;
+    size_t import_cache_prune_size = 32;
 };
 
 using gralloc_loader = gralloc_adapter_t::loader;
 using gralloc_buffer = gralloc_adapter_t::buffer;
+using gralloc_dmabuf_layout = gralloc_adapter_t::dmabuf_layout;
+using gralloc_allocation_tracker = gralloc_adapter_t::allocation_tracker;
 
 #endif
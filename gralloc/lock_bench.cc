@@ -0,0 +1,150 @@
+#include "logger.h"
+#include "gralloc_adapter.h"
+
+#include <android/hardware_buffer.h>
+#include <android/rect.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+namespace {
+constexpr int width = 1920;
+constexpr int height = 1080;
+
+using clock_type = std::chrono::steady_clock;
+
+std::shared_ptr<gralloc_buffer>
+allocate(const std::shared_ptr<gralloc_adapter_t>& adapter)
+{
+    return adapter->allocate_buffer(width, height,
+                                    AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+                                    AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN |
+                                        AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN |
+                                        AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE);
+}
+
+double elapsed_ns(clock_type::time_point begin, int iterations)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  clock_type::now() - begin)
+                  .count();
+    return static_cast<double>(ns) / iterations;
+}
+
+// lock, touch one row, unlock; the pattern of a cpu upload every frame
+double bench_lock_unlock(std::shared_ptr<gralloc_buffer> buffer,
+                         int iterations)
+{
+    ARect rect = {0, 0, buffer->width, buffer->height};
+    auto begin = clock_type::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        void* vaddr = nullptr;
+        if (buffer->lock(AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN, rect, &vaddr) !=
+                0 ||
+            !vaddr)
+        {
+            logger::log_error() << "lock failed at iteration " << i;
+            return -1;
+        }
+        memset(vaddr, i & 0xff, buffer->stride * 4);
+        buffer->unlock();
+    }
+    return elapsed_ns(begin, iterations);
+}
+
+// import + first lock of a shared buffer, the cost a consumer pays without
+// a cached mapping
+double bench_import_lock(std::shared_ptr<gralloc_adapter_t> adapter,
+                         std::shared_ptr<gralloc_buffer> buffer,
+                         int iterations)
+{
+    ARect rect = {0, 0, buffer->width, buffer->height};
+    auto begin = clock_type::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        auto imported = adapter->import_buffer(
+            buffer->handle, buffer->width, buffer->height, buffer->stride,
+            buffer->format, buffer->usage);
+        void* vaddr = nullptr;
+        if (!imported ||
+            imported->lock(AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, rect,
+                           &vaddr) != 0)
+        {
+            logger::log_error() << "import/lock failed at iteration " << i;
+            return -1;
+        }
+        volatile uint8_t sink = static_cast<uint8_t*>(vaddr)[0];
+        (void)sink;
+        imported->unlock();
+    }
+    return elapsed_ns(begin, iterations);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    logger::log_t::set_log_level(logger::LOG_WARN);
+
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    if (iterations <= 0)
+        iterations = 2000;
+
+    auto& loader = gralloc_loader::getInstance();
+    auto adapter = loader.get_adapter();
+    if (!adapter)
+    {
+        logger::log_error() << "no gralloc backend";
+        return 1;
+    }
+
+    printf("backend: %d, %dx%d, %d iterations\n",
+           static_cast<int>(loader.get_backend()), width, height, iterations);
+
+    // a memfd buffer stays mapped whatever the mode says, there is nothing
+    // to compare
+    if (loader.get_backend() == backend_type::gralloc_memfd)
+    {
+        printf("lock/unlock (always mapped): %.1f ns/iter\n",
+               bench_lock_unlock(allocate(adapter), iterations));
+    }
+    else
+    {
+        // the mode is read when a buffer maps, so each one gets buffers
+        // of its own, mapped under it only
+        bool persistent_mapping = adapter->persistent_mapping;
+        for (bool persistent : {false, true})
+        {
+            adapter->persistent_mapping = persistent;
+            auto buffer = allocate(adapter);
+            if (!buffer)
+                break;
+            printf("lock/unlock (persistent mapping %s): %.1f ns/iter\n",
+                   persistent ? "on" : "off",
+                   bench_lock_unlock(buffer, iterations));
+        }
+        adapter->persistent_mapping = persistent_mapping;
+    }
+
+    auto buffer = allocate(adapter);
+    if (!buffer)
+    {
+        logger::log_error() << "allocate buffer failed";
+        return 1;
+    }
+
+    printf("import + lock/unlock: %.1f ns/iter\n",
+           bench_import_lock(adapter, buffer, iterations));
+
+    // an import kept alive makes every later import of the buffer a cache hit
+    auto held = adapter->import_buffer(buffer->handle, buffer->width,
+                                       buffer->height, buffer->stride,
+                                       buffer->format, buffer->usage);
+    printf("import + lock/unlock (import cached): %.1f ns/iter\n",
+           bench_import_lock(adapter, buffer, iterations));
+
+    adapter->allocations->dump();
+    return 0;
+}
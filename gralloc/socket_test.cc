@@ -255,11 +255,7 @@ std::shared_ptr<gralloc_buffer> recv_buffer(int socket_fd)
     memcpy((int*)handle->data + handle->numFds, ints_array,
            numInts * sizeof(int));
 
-    auto buffer =
-        adapter->import_buffer(handle, desc->width, desc->height, desc->stride,
-                               desc->format, desc->usage);
-
-    adapter->cutils.vptr.native_handle_close(handle);
-    adapter->cutils.vptr.native_handle_delete((native_handle_t*)handle);
-    return buffer;
+    // the received fds are handed over with the handle
+    return adapter->adopt_buffer(handle, desc->width, desc->height,
+                                 desc->stride, desc->format, desc->usage);
 }
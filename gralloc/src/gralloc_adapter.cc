@@ -1,9 +1,26 @@
 #include "gralloc_adapter.h"
 
 #include <hardware/gralloc.h>
+#include <system/graphics.h>
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <linux/ioctl.h>
+#include <linux/kcmp.h>
 #include <memory>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <thread>
+#include <tuple>
 
 #ifdef __HYBRIS__
 #include <hybris/dlfcn/dlfcn.h>
@@ -15,8 +32,22 @@
 #endif
 
 #include "gralloc_libharware.h"
+#include "gralloc_memfd.h"
 #include "gralloc_nativewindow.h"
 
+#ifndef DMA_BUF_IOCTL_SYNC
+struct dma_buf_sync
+{
+    uint64_t flags;
+};
+
+#define DMA_BUF_SYNC_READ (1 << 0)
+#define DMA_BUF_SYNC_WRITE (2 << 0)
+#define DMA_BUF_SYNC_START (0 << 2)
+#define DMA_BUF_SYNC_END (1 << 2)
+#define DMA_BUF_IOCTL_SYNC _IOW('b', 0, struct dma_buf_sync)
+#endif
+
 namespace {
 auto& loader_ = gralloc_adapter_t::loader::getInstance();
 
@@ -32,6 +63,42 @@ int android_get_device_api_level() noexcept
     return (api_level > 0) ? api_level : -1;
 }
 #endif
+
+// used when libcutils.so is not around, e.g. with the memfd backend on a
+// plain linux host
+native_handle_t* fallback_native_handle_create(int numFds, int numInts)
+{
+    auto h = static_cast<native_handle_t*>(
+        malloc(sizeof(native_handle_t) + sizeof(int) * (numFds + numInts)));
+    if (!h)
+        return nullptr;
+
+    h->version = sizeof(native_handle_t);
+    h->numFds = numFds;
+    h->numInts = numInts;
+    return h;
+}
+
+int fallback_native_handle_delete(native_handle_t* h)
+{
+    if (h)
+    {
+        if (h->version != sizeof(native_handle_t))
+            return -EINVAL;
+        free(h);
+    }
+    return 0;
+}
+
+int fallback_native_handle_close(const native_handle_t* h)
+{
+    if (h->version != sizeof(native_handle_t))
+        return -EINVAL;
+
+    for (int i = 0; i < h->numFds; i++)
+        close(h->data[i]);
+    return 0;
+}
 } // namespace
 
 gralloc_loader& gralloc_loader::getInstance()
@@ -44,31 +111,70 @@ gralloc_loader::loader()
 {
     gralloc_module = nullptr;
 
+    nativewindow_handle = nullptr;
+
     bool try_libnativewindow = true;
     if (getenv("ALWAYS_USE_LIBHARDWARE") || android_get_device_api_level() < 29)
     {
         try_libnativewindow = false;
     }
 
-    if (try_libnativewindow &&
-        (nativewindow_handle = dlopen("libnativewindow.so", RTLD_NOW)) &&
-        dlsym(nativewindow_handle, "AHardwareBuffer_createFromHandle"))
+    if (getenv("ALWAYS_USE_MEMFD"))
+    {
+        adapter = std::make_shared<gralloc_memfd>();
+        backend = backend_type::gralloc_memfd;
+    }
+    else if (try_libnativewindow &&
+             (nativewindow_handle = dlopen("libnativewindow.so", RTLD_NOW)) &&
+             dlsym(nativewindow_handle, "AHardwareBuffer_createFromHandle"))
     {
         adapter = std::make_shared<gralloc_nativewindow>(nativewindow_handle);
         backend = backend_type::gralloc_nativewindow;
     }
-    else if (hardware.vptr.hw_get_module(GRALLOC_HARDWARE_MODULE_ID,
-                                         &gralloc_module) == 0)
+    else if (hardware.vptr.hw_get_module &&
+             hardware.vptr.hw_get_module(GRALLOC_HARDWARE_MODULE_ID,
+                                         &gralloc_module) == 0 &&
+             gralloc_module)
     {
         adapter = std::make_shared<gralloc_libhareware>(gralloc_module);
         backend = backend_type::gralloc_libhardware;
     }
+    else if (!getenv("DISABLE_MEMFD_GRALLOC"))
+    {
+        // no gralloc hal, e.g. a desktop linux host
+        adapter = std::make_shared<gralloc_memfd>();
+        backend = backend_type::gralloc_memfd;
+    }
     else
     {
         adapter = nullptr;
         backend = backend_type::gralloc_none;
     }
 
+    if (adapter && getenv("GRALLOC_PERSISTENT_MAPPING"))
+    {
+        adapter->persistent_mapping = true;
+    }
+
+    if (adapter && getenv("GRALLOC_DISABLE_IMPORT_CACHE"))
+    {
+        adapter->import_cache_enabled = false;
+    }
+
+    if (const char* env = getenv("GRALLOC_STATS_INTERVAL"); adapter && env)
+    {
+        if (int interval = atoi(env); interval > 0)
+        {
+            std::thread{[allocations = adapter->allocations, interval] {
+                for (;;)
+                {
+                    std::this_thread::sleep_for(std::chrono::seconds(interval));
+                    allocations->dump();
+                }
+            }}.detach();
+        }
+    }
+
     if (backend != backend_type::gralloc_nativewindow)
     {
         if (nativewindow_handle)
@@ -91,9 +197,597 @@ std::shared_ptr<gralloc_adapter_t> gralloc_loader::get_adapter() const
 
 gralloc_buffer::~buffer()
 {
+    if (tracker)
+        tracker->untrack(*this);
     handle = nullptr;
 }
 
+int gralloc_buffer::unlock()
+{
+    int release_fence = -1;
+    int rval = unlock(&release_fence);
+    if (release_fence >= 0)
+    {
+        // nobody to hand the fence to, finish the cpu access here
+        pollfd pfd = {release_fence, POLLIN, 0};
+        while (poll(&pfd, 1, -1) < 0 && (errno == EINTR || errno == EAGAIN))
+            ;
+        close(release_fence);
+    }
+    return rval;
+}
+
+namespace {
+int sync_dma_buf(buffer_handle_t handle, uint64_t usage, uint64_t flags)
+{
+    if (!handle || handle->numFds < 1)
+        return 0;
+
+    if (usage & AHARDWAREBUFFER_USAGE_CPU_READ_MASK)
+        flags |= DMA_BUF_SYNC_READ;
+    if (usage & AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)
+        flags |= DMA_BUF_SYNC_WRITE;
+    if (!(flags & (DMA_BUF_SYNC_READ | DMA_BUF_SYNC_WRITE)))
+        return 0;
+
+    struct dma_buf_sync sync = {flags};
+    int rval;
+    do
+    {
+        rval = ioctl(handle->data[0], DMA_BUF_IOCTL_SYNC, &sync);
+    } while (rval < 0 && (errno == EINTR || errno == EAGAIN));
+
+    // ashmem, memfd and friends are coherent, nothing to sync
+    if (rval < 0 && (errno == ENOTTY || errno == EINVAL || errno == EBADF))
+        return 0;
+    return rval < 0 ? -errno : 0;
+}
+} // namespace
+
+int gralloc_buffer::begin_cpu_access(uint64_t usage) const
+{
+    return sync_dma_buf(handle, usage, DMA_BUF_SYNC_START);
+}
+
+int gralloc_buffer::end_cpu_access(uint64_t usage) const
+{
+    return sync_dma_buf(handle, usage, DMA_BUF_SYNC_END);
+}
+
+namespace {
+constexpr uint32_t fourcc_code(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 |
+           static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+}
+
+bool is_dma_buf(int fd)
+{
+    char path[32], target[64] = {};
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    if (readlink(path, target, sizeof(target) - 1) < 0)
+        return false;
+    // "anon_inode:dmabuf" before dmabuffs got its own names
+    return strncmp(target, "/dmabuf:", 8) == 0 ||
+           strcmp(target, "anon_inode:dmabuf") == 0;
+}
+} // namespace
+
+bool gralloc_buffer::export_dmabuf(gralloc_dmabuf_layout* layout)
+{
+    int bpp = 0, plane_x2 = 0;
+    uint32_t fourcc = gralloc_adapter_t::drm_fourcc(format);
+    if (!fourcc || !handle || handle->numFds < 1 ||
+        !gralloc_adapter_t::format_info(format, &bpp, &plane_x2) ||
+        !is_dma_buf(handle->data[0]))
+        return false;
+
+    layout->fourcc = fourcc;
+    // the HAL may have padded, tiled or split it in planes behind our back
+    layout->known = false;
+    // cpu accessible buffers are linear, the rest is up to the allocator
+    layout->modifier = (usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                                 AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK))
+                           ? gralloc_dmabuf_layout::modifier_linear
+                           : gralloc_dmabuf_layout::modifier_invalid;
+    layout->num_planes = 1;
+    layout->planes[0].fd = handle->data[0];
+    layout->planes[0].offset = 0;
+    layout->planes[0].stride = stride * bpp;
+    return true;
+}
+
+uint32_t gralloc_adapter_t::drm_fourcc(int format)
+{
+    // DRM formats are little endian packed, AHardwareBuffer ones are in
+    // byte order
+    switch (format)
+    {
+    case AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM:
+        return fourcc_code('A', 'B', '2', '4');
+    case AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM:
+        return fourcc_code('X', 'B', '2', '4');
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        return fourcc_code('A', 'R', '2', '4');
+    case AHARDWAREBUFFER_FORMAT_R8G8B8_UNORM:
+        return fourcc_code('B', 'G', '2', '4');
+    case AHARDWAREBUFFER_FORMAT_R5G6B5_UNORM:
+        return fourcc_code('R', 'G', '1', '6');
+    case AHARDWAREBUFFER_FORMAT_R10G10B10A2_UNORM:
+        return fourcc_code('A', 'B', '3', '0');
+    case AHARDWAREBUFFER_FORMAT_R16G16B16A16_FLOAT:
+        return fourcc_code('A', 'B', '4', 'H');
+    case AHARDWAREBUFFER_FORMAT_R8_UNORM:
+        return fourcc_code('R', '8', ' ', ' ');
+    default:
+        return 0;
+    }
+}
+
+bool gralloc_adapter_t::format_info(int format, int* bpp, int* plane_x2)
+{
+    *plane_x2 = 2;
+    switch (format)
+    {
+    case AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM:
+    case AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM:
+    case AHARDWAREBUFFER_FORMAT_R10G10B10A2_UNORM:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+    case AHARDWAREBUFFER_FORMAT_D24_UNORM:
+    case AHARDWAREBUFFER_FORMAT_D24_UNORM_S8_UINT:
+    case AHARDWAREBUFFER_FORMAT_D32_FLOAT:
+        *bpp = 4;
+        return true;
+    case AHARDWAREBUFFER_FORMAT_R16G16B16A16_FLOAT:
+    case AHARDWAREBUFFER_FORMAT_D32_FLOAT_S8_UINT:
+        *bpp = 8;
+        return true;
+    case AHARDWAREBUFFER_FORMAT_R8G8B8_UNORM:
+        *bpp = 3;
+        return true;
+    case AHARDWAREBUFFER_FORMAT_R5G6B5_UNORM:
+    case AHARDWAREBUFFER_FORMAT_D16_UNORM:
+        *bpp = 2;
+        return true;
+    case AHARDWAREBUFFER_FORMAT_BLOB:
+    case AHARDWAREBUFFER_FORMAT_S8_UINT:
+    case AHARDWAREBUFFER_FORMAT_R8_UNORM:
+        *bpp = 1;
+        return true;
+    case AHARDWAREBUFFER_FORMAT_Y8Cb8Cr8_420:
+    case HAL_PIXEL_FORMAT_YV12:
+        *bpp = 1;
+        *plane_x2 = 3;
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::shared_ptr<gralloc_buffer>
+gralloc_adapter_t::allocate_buffer(int width, int height, int format,
+                                   uint64_t usage, buffer_owner owner)
+{
+    auto buf = allocate_buffer_impl(width, height, format, usage);
+    if (buf)
+        allocations->track(*buf, owner);
+    return buf;
+}
+
+std::vector<std::shared_ptr<gralloc_buffer>>
+gralloc_adapter_t::allocate_buffers(uint32_t count,
+                                    const AHardwareBuffer_Desc& desc,
+                                    buffer_owner owner)
+{
+    auto buffers = allocate_buffers_impl(count, desc);
+    for (auto& buf : buffers)
+        allocations->track(*buf, owner);
+    return buffers;
+}
+
+// the cpu lock of the backend buffer is taken once for all the imports
+// holding one, and given back when the last of them unlocks
+struct gralloc_adapter_t::shared_import
+{
+    std::shared_ptr<gralloc_buffer> buffer;
+    std::mutex mutex;
+    int locks = 0;
+    uint64_t usage = 0;
+    void* vaddr = nullptr;
+};
+
+// one per import, so an importer unlocking only gives back its own locks
+class gralloc_adapter_t::imported_buffer : public gralloc_buffer {
+    std::shared_ptr<shared_import> shared;
+    int locks = 0;
+
+  public:
+    using gralloc_buffer::unlock;
+
+    explicit imported_buffer(std::shared_ptr<shared_import> import)
+        : shared{std::move(import)}
+    {
+        auto& buf = *shared->buffer;
+        width = buf.width;
+        height = buf.height;
+        stride = buf.stride;
+        format = buf.format;
+        layerCount = buf.layerCount;
+        handle = buf.handle;
+        usage = buf.usage;
+    }
+
+    int lock(uint64_t usage, const ARect& rect, void** vaddr) override
+    {
+        (void)rect;
+        uint64_t cpu_usage = usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                                      AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK);
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        if (!shared->locks)
+        {
+            // the whole buffer, other importers may want other parts
+            ARect full = {0, 0, width, height};
+            int rval = shared->buffer->lock(usage, full, &shared->vaddr);
+            if (rval != 0)
+                return rval;
+            shared->usage = cpu_usage;
+        }
+        else if ((shared->usage & cpu_usage) != cpu_usage)
+        {
+            // another importer holds it locked for less
+            return -EBUSY;
+        }
+
+        shared->locks++;
+        locks++;
+        *vaddr = shared->vaddr;
+        return 0;
+    }
+
+    int unlock(int* release_fence) override
+    {
+        *release_fence = -1;
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        if (!locks)
+            return -EINVAL;
+
+        locks--;
+        if (--shared->locks)
+            return 0;
+        shared->vaddr = nullptr;
+        return shared->buffer->unlock(release_fence);
+    }
+
+    struct AHardwareBuffer* get_hardware_buffer() const override
+    {
+        return shared->buffer->get_hardware_buffer();
+    }
+
+    bool export_dmabuf(gralloc_dmabuf_layout* layout) override
+    {
+        return shared->buffer->export_dmabuf(layout);
+    }
+
+    ~imported_buffer() override
+    {
+        // locks the importer forgot
+        while (locks)
+            unlock();
+    }
+};
+
+namespace {
+// whether the inode of fd is its file's own; dma-bufs of kernels before
+// dmabuffs all share the one of anon_inode:dmabuf
+bool unique_inode(int fd)
+{
+    char path[32], target[64] = {};
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    if (readlink(path, target, sizeof(target) - 1) < 0)
+        return false;
+    return strncmp(target, "anon_inode:", 11) != 0;
+}
+
+// whether a and b are the same open file, nothing when the kernel has no
+// kcmp
+std::optional<bool> same_file(int a, int b)
+{
+#ifdef SYS_kcmp
+    pid_t pid = getpid();
+    long rval = syscall(SYS_kcmp, pid, pid, KCMP_FILE, a, b);
+    if (rval >= 0)
+        return rval == 0;
+#endif
+    return std::nullopt;
+}
+} // namespace
+
+bool gralloc_adapter_t::import_key::operator<(const import_key& other) const
+{
+    return std::tie(dev, ino, width, height, stride, format, usage, ints) <
+           std::tie(other.dev, other.ino, other.width, other.height,
+                    other.stride, other.format, other.usage, other.ints);
+}
+
+std::shared_ptr<gralloc_buffer>
+gralloc_adapter_t::import_buffer(buffer_handle_t handle, int width, int height,
+                                 int stride, int format, uint64_t usage)
+{
+    return import_buffer_cached(handle, width, height, stride, format, usage,
+                                false);
+}
+
+std::shared_ptr<gralloc_buffer>
+gralloc_adapter_t::adopt_buffer(native_handle_t* handle, int width, int height,
+                                int stride, int format, uint64_t usage)
+{
+    if (!handle)
+        return nullptr;
+    return import_buffer_cached(handle, width, height, stride, format, usage,
+                                true);
+}
+
+std::shared_ptr<gralloc_buffer>
+gralloc_adapter_t::adopt_buffer_impl(native_handle_t* handle, int width,
+                                     int height, int stride, int format,
+                                     uint64_t usage)
+{
+    auto buf = import_buffer_impl(handle, width, height, stride, format, usage);
+    if (buf)
+        release_handle(handle);
+    return buf;
+}
+
+void gralloc_adapter_t::release_handle(buffer_handle_t handle)
+{
+    cutils.vptr.native_handle_close(handle);
+    cutils.vptr.native_handle_delete(const_cast<native_handle_t*>(handle));
+}
+
+std::shared_ptr<gralloc_buffer>
+gralloc_adapter_t::import_buffer_cached(buffer_handle_t handle, int width,
+                                        int height, int stride, int format,
+                                        uint64_t usage, bool adopt)
+{
+    // an adopted handle was created by the caller, it is safe to take it
+    // over here
+    auto do_import = [&]() -> std::shared_ptr<gralloc_buffer> {
+        auto buf = adopt ? adopt_buffer_impl(const_cast<native_handle_t*>(
+                                                 handle),
+                                             width, height, stride, format,
+                                             usage)
+                         : import_buffer_impl(handle, width, height, stride,
+                                              format, usage);
+        if (!buf)
+        {
+            if (adopt)
+                release_handle(handle);
+            return nullptr;
+        }
+        allocations->track(*buf, buffer_owner::import);
+        return buf;
+    };
+
+    struct stat st = {};
+    if (!import_cache_enabled || !handle || handle->numFds < 1 ||
+        handle->numInts < 0 || fstat(handle->data[0], &st) < 0)
+        return do_import();
+
+    // the key finds a buffer only when its inode is unique, otherwise a
+    // hit is checked to be the same file, and without kcmp nothing is
+    // cached
+    int fd = handle->data[0];
+    bool unique = unique_inode(fd);
+    if (!unique && !same_file(fd, fd))
+        return do_import();
+
+    import_key key = {
+        .dev = static_cast<uint64_t>(st.st_dev),
+        .ino = static_cast<uint64_t>(st.st_ino),
+        .width = width,
+        .height = height,
+        .stride = stride,
+        .format = format,
+        .usage = usage,
+        .ints = {&handle->data[handle->numFds],
+                 &handle->data[handle->numFds + handle->numInts]},
+    };
+
+    std::lock_guard<std::mutex> lock{import_cache_mutex};
+    if (auto iter = import_cache.find(key); iter != import_cache.end())
+    {
+        auto shared = iter->second.lock();
+        buffer_handle_t cached = shared ? shared->buffer->handle : nullptr;
+        if (cached && cached->numFds >= 1 &&
+            same_file(fd, cached->data[0]).value_or(unique))
+        {
+            if (adopt)
+                release_handle(handle);
+            return std::make_shared<imported_buffer>(std::move(shared));
+        }
+    }
+
+    auto shared = std::make_shared<shared_import>();
+    shared->buffer = do_import();
+    if (!shared->buffer)
+        return nullptr;
+
+    if (import_cache.size() >= import_cache_prune_size)
+    {
+        // drop the buffers nobody holds anymore
+        for (auto iter = import_cache.begin(); iter != import_cache.end();)
+        {
+            if (iter->second.expired())
+                iter = import_cache.erase(iter);
+            else
+                ++iter;
+        }
+        import_cache_prune_size =
+            std::max<size_t>(32, import_cache.size() * 2);
+    }
+    import_cache[std::move(key)] = shared;
+    return std::make_shared<imported_buffer>(std::move(shared));
+}
+
+std::vector<std::shared_ptr<gralloc_buffer>>
+gralloc_adapter_t::allocate_buffers_impl(uint32_t count,
+                                         const AHardwareBuffer_Desc& desc)
+{
+    std::vector<std::shared_ptr<gralloc_buffer>> buffers{};
+    buffers.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto buf = allocate_buffer_impl(desc.width, desc.height, desc.format,
+                                        desc.usage);
+        if (!buf)
+        {
+            // drop the buffers allocated so far
+            buffers.clear();
+            break;
+        }
+        buffers.push_back(std::move(buf));
+    }
+    return buffers;
+}
+
+namespace {
+void counter_add(gralloc_allocation_tracker::counter& c, uint64_t bytes)
+{
+    c.live_count++;
+    c.live_bytes += bytes;
+    c.allocs++;
+    c.peak_count = std::max(c.peak_count, c.live_count);
+    c.peak_bytes = std::max(c.peak_bytes, c.live_bytes);
+}
+
+void counter_sub(gralloc_allocation_tracker::counter& c, uint64_t bytes)
+{
+    c.live_count--;
+    c.live_bytes -= bytes;
+    c.frees++;
+}
+
+const char* owner_name(size_t owner)
+{
+    switch (static_cast<buffer_owner>(owner))
+    {
+    case buffer_owner::surface:
+        return "surface";
+    case buffer_owner::import:
+        return "import";
+    case buffer_owner::pbuffer:
+        return "pbuffer";
+    default:
+        return "other";
+    }
+}
+} // namespace
+
+// found by ADL from logger::log_t, so not in the anonymous namespace
+static std::ostream& operator<<(std::ostream& os,
+                                const gralloc_allocation_tracker::counter& c)
+{
+    return os << "live " << c.live_count << " (" << c.live_bytes / 1024
+              << " KiB), peak " << c.peak_count << " (" << c.peak_bytes / 1024
+              << " KiB), allocs " << c.allocs << ", frees " << c.frees;
+}
+
+gralloc_allocation_tracker::allocation_tracker() :
+    start_time(std::chrono::steady_clock::now()),
+    last_dump_time(start_time)
+{}
+
+void gralloc_allocation_tracker::track(gralloc_buffer& buf,
+                                       buffer_owner owner)
+{
+    int bpp = 0, plane_x2 = 0;
+    uint64_t bytes = 0;
+    if (gralloc_adapter_t::format_info(buf.format, &bpp, &plane_x2))
+    {
+        bytes = static_cast<uint64_t>(buf.stride) * buf.height * bpp *
+                plane_x2 / 2 * std::max<uintptr_t>(buf.layerCount, 1);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    buf.tracker = shared_from_this();
+    buf.owner = owner;
+    buf.tracked_bytes = bytes;
+    counter_add(stats.total, bytes);
+    counter_add(stats.by_owner[static_cast<size_t>(owner)], bytes);
+    counter_add(stats.by_format[buf.format], bytes);
+    counter_add(stats.by_usage[buf.usage], bytes);
+}
+
+void gralloc_allocation_tracker::untrack(const gralloc_buffer& buf)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    counter_sub(stats.total, buf.tracked_bytes);
+    counter_sub(stats.by_owner[static_cast<size_t>(buf.owner)],
+                buf.tracked_bytes);
+    counter_sub(stats.by_format[buf.format], buf.tracked_bytes);
+    counter_sub(stats.by_usage[buf.usage], buf.tracked_bytes);
+}
+
+gralloc_allocation_tracker::snapshot
+gralloc_allocation_tracker::get_snapshot() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    snapshot result = stats;
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start_time)
+                         .count();
+    return result;
+}
+
+void gralloc_allocation_tracker::dump()
+{
+    auto now = std::chrono::steady_clock::now();
+    auto result = get_snapshot();
+
+    double interval;
+    uint64_t allocs, frees;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        interval =
+            std::chrono::duration<double>(now - last_dump_time).count();
+        allocs = result.total.allocs - last_dump_allocs;
+        frees = result.total.frees - last_dump_frees;
+        last_dump_time = now;
+        last_dump_allocs = result.total.allocs;
+        last_dump_frees = result.total.frees;
+    }
+
+    logger::log_warn() << "gralloc allocations after " << result.seconds
+                       << "s: " << result.total << ", " << std::fixed
+                       << std::setprecision(1)
+                       << (interval > 0 ? allocs / interval : 0)
+                       << " allocs/s, "
+                       << (interval > 0 ? frees / interval : 0)
+                       << " frees/s";
+    for (size_t i = 0; i < static_cast<size_t>(buffer_owner::count); i++)
+    {
+        if (result.by_owner[i].allocs)
+            logger::log_warn() << "  owner " << owner_name(i) << ": "
+                               << result.by_owner[i];
+    }
+    for (auto& [format, c] : result.by_format)
+    {
+        if (c.live_count)
+            logger::log_warn() << "  format " << std::showbase << std::hex
+                               << format << std::dec << ": " << c;
+    }
+    for (auto& [usage, c] : result.by_usage)
+    {
+        if (c.live_count)
+            logger::log_warn() << "  usage " << std::showbase << std::hex
+                               << usage << std::dec << ": " << c;
+    }
+
+    // the platform's own view, only libnativewindow provides one
+    if (dumpAllocationLog)
+        dumpAllocationLog();
+}
+
 #define GETVPTRFUNC(vptr, func)                                                \
     vptr.func = reinterpret_cast<decltype(vptr.func)>(dlsym(handle, #func))
 
@@ -105,6 +799,16 @@ gralloc_adapter_t::cutils_loader::cutils_loader() noexcept :
     GETVPTRFUNC(vptr, native_handle_create);
     GETVPTRFUNC(vptr, native_handle_clone);
     GETVPTRFUNC(vptr, native_handle_delete);
+
+    if (!vptr.native_handle_create || !vptr.native_handle_delete ||
+        !vptr.native_handle_close)
+    {
+        vptr.native_handle_create = fallback_native_handle_create;
+        vptr.native_handle_delete = fallback_native_handle_delete;
+        vptr.native_handle_close = fallback_native_handle_close;
+        vptr.native_handle_init = nullptr;
+        vptr.native_handle_clone = nullptr;
+    }
 }
 
 gralloc_adapter_t::cutils_loader::~cutils_loader() noexcept
@@ -156,6 +156,54 @@ class gralloc_libhareware
                 gralloc1_device, GRALLOC1_FUNCTION_GET_LAYER_COUNT);
     }
 
+    int gralloc1_create_descriptor(int width, int height, int format,
+                                   uint64_t usage, uint32_t layer_count,
+                                   gralloc1_buffer_descriptor_t* desc)
+    {
+        uint64_t producer_usage{};
+        uint64_t consumer_usage{};
+
+        android_convertGralloc0To1Usage(usage, &producer_usage,
+                                        &consumer_usage);
+
+        int rval = gralloc1_vptr.create_descriptor(gralloc1_device, desc);
+        if (rval != GRALLOC1_ERROR_NONE)
+            return rval;
+
+        rval = gralloc1_vptr.set_dimensions(gralloc1_device, *desc, width,
+                                            height);
+        if (rval == GRALLOC1_ERROR_NONE)
+        {
+            rval = gralloc1_vptr.set_consumer_usage(gralloc1_device, *desc,
+                                                    consumer_usage);
+        }
+        if (rval == GRALLOC1_ERROR_NONE)
+        {
+            rval = gralloc1_vptr.set_producer_usage(gralloc1_device, *desc,
+                                                    producer_usage);
+        }
+        if (rval == GRALLOC1_ERROR_NONE)
+        {
+            rval = gralloc1_vptr.set_format(gralloc1_device, *desc, format);
+        }
+        if (rval == GRALLOC1_ERROR_NONE)
+        {
+            if (gralloc1_support_layered_buffers)
+            {
+                rval = gralloc1_vptr.set_layer_count(gralloc1_device, *desc,
+                                                     layer_count);
+            }
+            else if (layer_count > 1)
+            {
+                rval = GRALLOC1_ERROR_UNSUPPORTED;
+            }
+        }
+
+        if (rval != GRALLOC1_ERROR_NONE)
+            gralloc1_vptr.destroy_descriptor(gralloc1_device, *desc);
+        return rval;
+    }
+
   public:
     gralloc_libhareware(const hw_module_t* gralloc_module) :
         gralloc_module(gralloc_module)
@@ -222,12 +270,26 @@ class gralloc_libhareware
         gralloc_module = nullptr;
     }
 
+  protected:
+    std::shared_ptr<gralloc_buffer>
+    allocate_buffer_impl(int width, int height, int format,
+                         uint64_t usage) override;
+    std::shared_ptr<gralloc_buffer>
+    import_buffer_impl(buffer_handle_t handle, int width, int height,
+                       int stride, int format, uint64_t usage) override;
     std::shared_ptr<gralloc_buffer>
-    allocate_buffer(int width, int height, int format, uint64_t usage) override;
-    std::shared_ptr<gralloc_buffer> import_buffer(buffer_handle_t handle,
-                                                  int width, int height,
-                                                  int stride, int format,
-                                                  uint64_t usage) override;
+    adopt_buffer_impl(native_handle_t* handle, int width, int height,
+                      int stride, int format, uint64_t usage) override;
+    std::vector<std::shared_ptr<gralloc_buffer>>
+    allocate_buffers_impl(uint32_t count,
+                          const AHardwareBuffer_Desc& desc) override;
+
+  private:
+    // retain/register an imported handle owned by buf from now on
+    std::shared_ptr<gralloc_buffer>
+    register_handle(std::shared_ptr<gralloc_buffer_libhardware> buf,
+                    buffer_handle_t out_handle, int width, int height,
+                    int stride, int format, uint64_t usage);
 };
 
 class gralloc_buffer_libhardware : public gralloc_buffer {
@@ -237,14 +299,16 @@ class gralloc_buffer_libhardware : public gralloc_buffer {
     bool locked{};
     bool was_allocated{};
 
-  public:
-    int lock(uint64_t usage, const ARect& rect, void** vaddr) override
+    // gralloc1 usage of the last lock, converted once
+    uint64_t lock_usage{};
+    uint64_t lock_producer_usage{};
+    uint64_t lock_consumer_usage{};
+
+    int hal_lock(uint64_t usage, const ARect& rect, void** vaddr)
     {
         int rval = -ENOSYS;
         if (adapter->is_gralloc1)
         {
-            uint64_t producer_usage;
-            uint64_t consumer_usage;
             gralloc1_rect_t access_region;
 
             access_region.left = rect.left;
@@ -252,12 +316,17 @@ class gralloc_buffer_libhardware : public gralloc_buffer {
             access_region.width = rect.right - rect.left;
             access_region.height = rect.bottom - rect.top;
 
-            android_convertGralloc0To1Usage(usage, &producer_usage,
-                                            &consumer_usage);
+            if (usage != lock_usage || (!lock_producer_usage &&
+                                        !lock_consumer_usage))
+            {
+                android_convertGralloc0To1Usage(usage, &lock_producer_usage,
+                                                &lock_consumer_usage);
+                lock_usage = usage;
+            }
 
-            rval = adapter->gralloc1_vptr.lock(adapter->gralloc1_device, handle,
-                                               producer_usage, consumer_usage,
-                                               &access_region, vaddr, -1);
+            rval = adapter->gralloc1_vptr.lock(
+                adapter->gralloc1_device, handle, lock_producer_usage,
+                lock_consumer_usage, &access_region, vaddr, -1);
         }
         else
         {
@@ -275,16 +344,15 @@ class gralloc_buffer_libhardware : public gralloc_buffer {
         return rval;
     }
 
-    int unlock() override
+    int hal_unlock(int* release_fence)
     {
         int rval = -ENOSYS;
+        *release_fence = -1;
 
         if (adapter->is_gralloc1)
         {
-            int releaseFence = 0;
             rval = adapter->gralloc1_vptr.unlock(adapter->gralloc1_device,
-                                                 handle, &releaseFence);
-            close(releaseFence);
+                                                 handle, release_fence);
         }
         else
         {
@@ -298,13 +366,69 @@ class gralloc_buffer_libhardware : public gralloc_buffer {
         return rval;
     }
 
+  public:
+    using gralloc_buffer::unlock;
+
+    int lock(uint64_t usage, const ARect& rect, void** vaddr) override
+    {
+        if (!adapter->persistent_mapping)
+            return hal_lock(usage, rect, vaddr);
+
+        uint64_t cpu_usage = usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                                      AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK);
+        if (!mapped_vaddr || (mapped_usage & cpu_usage) != cpu_usage)
+        {
+            // (re)map the whole buffer with every cpu usage seen so far
+            if (mapped_vaddr)
+            {
+                int release_fence = -1;
+                hal_unlock(&release_fence);
+                if (release_fence >= 0)
+                    close(release_fence);
+                mapped_vaddr = nullptr;
+            }
+
+            ARect full = {0, 0, width, height};
+            uint64_t map_usage = usage | mapped_usage;
+            int rval = hal_lock(map_usage, full, &mapped_vaddr);
+            if (rval != 0)
+            {
+                mapped_vaddr = nullptr;
+                mapped_usage = 0;
+                return rval;
+            }
+            mapped_usage = map_usage;
+        }
+        else
+        {
+            begin_cpu_access(cpu_usage);
+        }
+
+        *vaddr = mapped_vaddr;
+        return 0;
+    }
+
+    int unlock(int* release_fence) override
+    {
+        if (!mapped_vaddr)
+            return hal_unlock(release_fence);
+
+        *release_fence = -1;
+        return end_cpu_access(mapped_usage);
+    }
+
     virtual ~gralloc_buffer_libhardware()
     {
         if (!handle)
             return;
 
         if (locked)
-            unlock();
+        {
+            int release_fence = -1;
+            hal_unlock(&release_fence);
+            if (release_fence >= 0)
+                close(release_fence);
+        }
 
         logger::log_info() << "delete buffer, handle: " << handle;
 
@@ -341,8 +465,8 @@ class gralloc_buffer_libhardware : public gralloc_buffer {
 };
 
 inline std::shared_ptr<gralloc_buffer>
-gralloc_libhareware::allocate_buffer(int width, int height, int format,
-                                     uint64_t usage)
+gralloc_libhareware::allocate_buffer_impl(int width, int height, int format,
+                                          uint64_t usage)
 {
     auto buf = std::make_shared<gralloc_buffer_libhardware>();
     buf->adapter = shared_from_this();
@@ -356,46 +480,10 @@ gralloc_libhareware::allocate_buffer(int width, int height, int format,
     if (is_gralloc1)
     {
         gralloc1_buffer_descriptor_t desc;
-        uint64_t producer_usage{};
-        uint64_t consumer_usage{};
-
-        android_convertGralloc0To1Usage(usage, &producer_usage,
-                                        &consumer_usage);
 
         // create temporary description (descriptor) of buffer to allocate
-        rval = gralloc1_vptr.create_descriptor(gralloc1_device, &desc);
-        if (rval == GRALLOC1_ERROR_NONE)
-        {
-            rval = gralloc1_vptr.set_dimensions(gralloc1_device, desc, width,
-                                                height);
-        }
-        if (rval == GRALLOC1_ERROR_NONE)
-        {
-            rval = gralloc1_vptr.set_consumer_usage(gralloc1_device, desc,
-                                                    consumer_usage);
-        }
-        if (rval == GRALLOC1_ERROR_NONE)
-        {
-            rval = gralloc1_vptr.set_producer_usage(gralloc1_device, desc,
-                                                    producer_usage);
-        }
-        if (rval == GRALLOC1_ERROR_NONE)
-        {
-            rval = gralloc1_vptr.set_format(gralloc1_device, desc, format);
-        }
-        if (rval == GRALLOC1_ERROR_NONE)
-        {
-            if (gralloc1_support_layered_buffers)
-            {
-                rval = gralloc1_vptr.set_layer_count(gralloc1_device, desc,
-                                                     buf->layerCount);
-            }
-            else if (buf->layerCount > 1)
-            {
-                rval = GRALLOC1_ERROR_UNSUPPORTED;
-            }
-        }
-
+        rval = gralloc1_create_descriptor(width, height, format, usage,
+                                          buf->layerCount, &desc);
         if (rval == GRALLOC1_ERROR_NONE)
         {
             // actual allocation
@@ -404,14 +492,15 @@ gralloc_libhareware::allocate_buffer(int width, int height, int format,
             {
                 buf->handle = handle;
             }
+
+            gralloc1_vptr.destroy_descriptor(gralloc1_device, desc);
         }
 
         if (rval == GRALLOC1_ERROR_NONE)
         {
-            // get stride and release temporary descriptor
+            // get stride of new buffer
             rval = gralloc1_vptr.get_stride(gralloc1_device, handle, &stride);
         }
-        gralloc1_vptr.destroy_descriptor(gralloc1_device, desc);
     }
     else
     {
@@ -445,9 +534,9 @@ gralloc_libhareware::allocate_buffer(int width, int height, int format,
 }
 
 inline std::shared_ptr<gralloc_buffer>
-gralloc_libhareware::import_buffer(buffer_handle_t handle, int width,
-                                   int height, int stride, int format,
-                                   uint64_t usage)
+gralloc_libhareware::import_buffer_impl(buffer_handle_t handle, int width,
+                                        int height, int stride, int format,
+                                        uint64_t usage)
 {
     auto buf = std::make_shared<gralloc_buffer_libhardware>();
     buf->adapter = shared_from_this();
@@ -484,6 +573,36 @@ gralloc_libhareware::import_buffer(buffer_handle_t handle, int width,
     if (!out_handle)
         return nullptr;
 
+    auto result = register_handle(std::move(buf), out_handle, width, height,
+                                  stride, format, usage);
+    if (!result)
+    {
+        cutils.vptr.native_handle_close(out_handle);
+        cutils.vptr.native_handle_delete((native_handle_t*)out_handle);
+    }
+    return result;
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_libhareware::adopt_buffer_impl(native_handle_t* handle, int width,
+                                       int height, int stride, int format,
+                                       uint64_t usage)
+{
+    auto buf = std::make_shared<gralloc_buffer_libhardware>();
+    buf->adapter = shared_from_this();
+    buf->was_allocated = false;
+    buf->layerCount = 1;
+
+    // the buffer closes and deletes the handle like a cloned one
+    return register_handle(std::move(buf), handle, width, height, stride,
+                           format, usage);
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_libhareware::register_handle(
+    std::shared_ptr<gralloc_buffer_libhardware> buf, buffer_handle_t out_handle,
+    int width, int height, int stride, int format, uint64_t usage)
+{
     int rval = -ENOSYS;
     if (is_gralloc1)
     {
@@ -496,9 +615,6 @@ gralloc_libhareware::import_buffer(buffer_handle_t handle, int width,
 
     if (rval != 0)
     {
-        cutils.vptr.native_handle_close(out_handle);
-        cutils.vptr.native_handle_delete((native_handle_t*)out_handle);
-
         logger::log_error() << "retain buffer failed, errno: " << rval;
         return nullptr;
     }
@@ -518,4 +634,77 @@ gralloc_libhareware::import_buffer(buffer_handle_t handle, int width,
     return buf;
 }
 
+inline std::vector<std::shared_ptr<gralloc_buffer>>
+gralloc_libhareware::allocate_buffers_impl(uint32_t count,
+                                           const AHardwareBuffer_Desc& desc)
+{
+    // gralloc0 has no batch allocation, allocate one by one
+    if (!is_gralloc1 || count <= 1)
+        return gralloc_adapter_t::allocate_buffers_impl(count, desc);
+
+    std::vector<std::shared_ptr<gralloc_buffer>> buffers{};
+    uint32_t layer_count = desc.layers ? desc.layers : 1;
+
+    gralloc1_buffer_descriptor_t descriptor;
+    int rval = gralloc1_create_descriptor(desc.width, desc.height, desc.format,
+                                          desc.usage, layer_count, &descriptor);
+    if (rval != GRALLOC1_ERROR_NONE)
+    {
+        logger::log_error() << "create descriptor failed, errno: " << rval;
+        return buffers;
+    }
+
+    std::vector<gralloc1_buffer_descriptor_t> descriptors(count, descriptor);
+    std::vector<buffer_handle_t> handles(count);
+    rval = gralloc1_vptr.allocate(gralloc1_device, count, descriptors.data(),
+                                  handles.data());
+    gralloc1_vptr.destroy_descriptor(gralloc1_device, descriptor);
+
+    logger::log_info() << "create " << count << " handles width: "
+                       << desc.width << ", height: " << desc.height
+                       << std::showbase << std::hex
+                       << ", format: " << desc.format
+                       << ", usage:" << desc.usage;
+
+    // NOT_SHARED only says that every buffer got its own backing store
+    if (rval != GRALLOC1_ERROR_NONE && rval != GRALLOC1_ERROR_NOT_SHARED)
+    {
+        logger::log_error() << "allocate buffers failed, errno: " << rval;
+        return buffers;
+    }
+
+    // wrap every handle first, so the destructors free them on failure
+    buffers.reserve(count);
+    for (auto handle : handles)
+    {
+        auto buf = std::make_shared<gralloc_buffer_libhardware>();
+        buf->adapter = shared_from_this();
+        buf->was_allocated = true;
+        buf->layerCount = layer_count;
+        buf->handle = handle;
+        buf->width = desc.width;
+        buf->height = desc.height;
+        buf->format = desc.format;
+        buf->usage = desc.usage;
+        buffers.push_back(std::move(buf));
+    }
+
+    for (auto& buf : buffers)
+    {
+        uint32_t stride{};
+        rval = gralloc1_vptr.get_stride(gralloc1_device, buf->handle, &stride);
+        if (rval != GRALLOC1_ERROR_NONE || stride == 0)
+        {
+            logger::log_error() << "get stride failed, errno: " << rval;
+            buffers.clear();
+            break;
+        }
+        buf->stride = stride;
+
+        logger::log_info() << "get buffer, handle: " << buf->handle;
+    }
+
+    return buffers;
+}
+
 #endif // GRALLOC_ADAPTER_LIBHARDWARE_H_
@@ -0,0 +1,471 @@
+#ifndef GRALLOC_ADAPTER_MEMFD_H_
+#define GRALLOC_ADAPTER_MEMFD_H_
+
+#include "gralloc_adapter.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/types.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+#if __has_include(<linux/udmabuf.h>)
+#include <linux/udmabuf.h>
+#else
+struct udmabuf_create
+{
+    __u32 memfd;
+    __u32 flags;
+    __u64 offset;
+    __u64 size;
+};
+#define UDMABUF_FLAGS_CLOEXEC 0x01
+#define UDMABUF_CREATE _IOW('u', 0x42, struct udmabuf_create)
+#endif
+
+// software gralloc, every buffer is a sealed memfd shared between processes
+// by passing the fd in the native handle, like private_handle_t of the
+// reference gralloc.
+struct memfd_handle_t : public native_handle_t
+{
+    static constexpr int kMagic = 0x6d666467; // 'mfdg'
+    static constexpr int kNumFds = 1;
+    static constexpr int kNumInts = 10;
+
+    // fds
+    int fd;
+    // ints
+    int magic;
+    int width;
+    int height;
+    int stride;
+    int format;
+    int usage_lo;
+    int usage_hi;
+    int size_lo;
+    int size_hi;
+    int offset;
+
+    uint64_t usage() const
+    {
+        return static_cast<uint32_t>(usage_lo) |
+               static_cast<uint64_t>(static_cast<uint32_t>(usage_hi)) << 32;
+    }
+    uint64_t size() const
+    {
+        return static_cast<uint32_t>(size_lo) |
+               static_cast<uint64_t>(static_cast<uint32_t>(size_hi)) << 32;
+    }
+
+    static memfd_handle_t* create(int fd)
+    {
+        auto* h = static_cast<memfd_handle_t*>(calloc(1, sizeof(memfd_handle_t)));
+        if (!h)
+            return nullptr;
+        h->version = sizeof(native_handle_t);
+        h->numFds = kNumFds;
+        h->numInts = kNumInts;
+        h->fd = fd;
+        h->magic = kMagic;
+        return h;
+    }
+
+    static const memfd_handle_t* from(buffer_handle_t handle)
+    {
+        if (!handle || handle->version != sizeof(native_handle_t) ||
+            handle->numFds != kNumFds || handle->numInts != kNumInts)
+            return nullptr;
+        auto* h = reinterpret_cast<const memfd_handle_t*>(handle);
+        return h->magic == kMagic ? h : nullptr;
+    }
+};
+
+static_assert(sizeof(memfd_handle_t) ==
+                  sizeof(native_handle_t) +
+                      sizeof(int) * (memfd_handle_t::kNumFds +
+                                     memfd_handle_t::kNumInts),
+              "memfd_handle_t must be laid out as a native_handle_t");
+
+class gralloc_memfd;
+class gralloc_buffer_memfd;
+
+class gralloc_memfd : public gralloc_adapter_t,
+                      public std::enable_shared_from_this<gralloc_memfd> {
+    friend class gralloc_buffer_memfd;
+
+    // rows are padded to 16 pixels for every format a cpu can write directly
+    static constexpr int kStrideAlign = 16;
+
+    static int create_memfd(const char* name)
+    {
+#ifdef SYS_memfd_create
+        return syscall(SYS_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    // bytes of stride x height pixels, false when they overflow
+    static bool layout_size(int stride, int height, int bpp, int plane_x2,
+                            uint64_t* size)
+    {
+        uint64_t bytes = 0;
+        if (__builtin_mul_overflow(static_cast<uint64_t>(stride),
+                                   static_cast<uint64_t>(height), &bytes) ||
+            __builtin_mul_overflow(bytes, static_cast<uint64_t>(bpp * plane_x2),
+                                   &bytes))
+            return false;
+        *size = bytes / 2;
+        return true;
+    }
+
+  public:
+    gralloc_memfd()
+    {
+        logger::log_info() << "impl gralloc by memfd";
+    }
+
+  protected:
+    std::shared_ptr<gralloc_buffer>
+    allocate_buffer_impl(int width, int height, int format,
+                         uint64_t usage) override;
+    std::shared_ptr<gralloc_buffer>
+    import_buffer_impl(buffer_handle_t handle, int width, int height,
+                       int stride, int format, uint64_t usage) override;
+    std::shared_ptr<gralloc_buffer>
+    adopt_buffer_impl(native_handle_t* handle, int width, int height,
+                      int stride, int format, uint64_t usage) override;
+
+  private:
+    // a handle of this adapter whose layout lies within its file and is
+    // the one the caller describes
+    static const memfd_handle_t* check_handle(buffer_handle_t handle,
+                                              int width, int height,
+                                              int stride, int format);
+    std::shared_ptr<gralloc_buffer> wrap_handle(memfd_handle_t* h,
+                                                uint64_t usage, bool adopted);
+};
+
+class gralloc_buffer_memfd : public gralloc_buffer {
+    std::shared_ptr<gralloc_memfd> adapter;
+    memfd_handle_t* memfd_handle = nullptr;
+    // adopted handles come from native_handle_create
+    bool adopted = false;
+    int dmabuf_fd = -1;
+
+    friend class gralloc_memfd;
+
+  public:
+    using gralloc_buffer::unlock;
+
+    // the address is the buffer's start, as gralloc0 gives it, whatever
+    // the rect
+    int lock(uint64_t usage, const ARect&, void** vaddr) override
+    {
+        if (!(usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                       AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)))
+            return -EINVAL;
+
+        // mapped read/write on first lock and kept until the buffer goes
+        // away, whatever persistent_mapping says, an mmap of a memfd costs
+        // more than keeping it
+        if (!mapped_vaddr)
+        {
+            void* addr = mmap(nullptr, memfd_handle->size(),
+                              PROT_READ | PROT_WRITE, MAP_SHARED,
+                              memfd_handle->fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                logger::log_error() << "mmap buffer failed, errno: " << errno;
+                return -errno;
+            }
+            mapped_vaddr = addr;
+            mapped_usage = usage;
+        }
+
+        *vaddr = static_cast<char*>(mapped_vaddr) + memfd_handle->offset;
+        return 0;
+    }
+
+    int unlock(int* release_fence) override
+    {
+        // the mapping is MAP_SHARED, writes are already visible to every
+        // importer, nothing to flush
+        *release_fence = -1;
+        return mapped_vaddr ? 0 : -EINVAL;
+    }
+
+    // a memfd is no dma-buf, wrap it in one through /dev/udmabuf, which
+    // takes the same pages, the first time it is asked for
+    bool export_dmabuf(gralloc_dmabuf_layout* layout) override
+    {
+        int bpp = 0, plane_x2 = 0;
+        uint32_t fourcc = gralloc_adapter_t::drm_fourcc(format);
+        if (!fourcc || !gralloc_adapter_t::format_info(format, &bpp, &plane_x2))
+            return false;
+
+        if (dmabuf_fd < 0)
+        {
+            int dev = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+            if (dev < 0)
+                return false;
+
+            struct udmabuf_create create = {
+                .memfd = static_cast<__u32>(memfd_handle->fd),
+                .flags = UDMABUF_FLAGS_CLOEXEC,
+                .offset = 0,
+                .size = memfd_handle->size(),
+            };
+            dmabuf_fd = ioctl(dev, UDMABUF_CREATE, &create);
+            close(dev);
+            if (dmabuf_fd < 0)
+            {
+                logger::log_warn() << "udmabuf from memfd failed, errno: "
+                                   << errno;
+                return false;
+            }
+        }
+
+        layout->fourcc = fourcc;
+        layout->modifier = gralloc_dmabuf_layout::modifier_linear;
+        layout->known = true;
+        layout->num_planes = 1;
+        layout->planes[0].fd = dmabuf_fd;
+        layout->planes[0].offset = memfd_handle->offset;
+        layout->planes[0].stride = stride * bpp;
+        return true;
+    }
+
+    virtual ~gralloc_buffer_memfd()
+    {
+        if (!memfd_handle)
+            return;
+
+        if (mapped_vaddr)
+            munmap(mapped_vaddr, memfd_handle->size());
+        if (dmabuf_fd >= 0)
+            close(dmabuf_fd);
+
+        logger::log_info() << "delete buffer: " << (void*)memfd_handle;
+        close(memfd_handle->fd);
+        if (adopted)
+            adapter->cutils.vptr.native_handle_delete(memfd_handle);
+        else
+            free(memfd_handle);
+        memfd_handle = nullptr;
+    }
+};
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_memfd::allocate_buffer_impl(int width, int height, int format,
+                                    uint64_t usage)
+{
+    int bpp = 0, plane_x2 = 0;
+    if (width <= 0 || height <= 0 || width > INT_MAX - kStrideAlign ||
+        !format_info(format, &bpp, &plane_x2))
+    {
+        logger::log_error() << "unsupported buffer width: " << width
+                            << ", height: " << height << std::showbase
+                            << std::hex << ", format: " << format;
+        return nullptr;
+    }
+
+    int stride = format == AHARDWAREBUFFER_FORMAT_BLOB
+                     ? width
+                     : (width + kStrideAlign - 1) & ~(kStrideAlign - 1);
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t size = 0;
+    if (!layout_size(stride, height, bpp, plane_x2, &size) ||
+        __builtin_add_overflow(size, page_size - 1, &size))
+    {
+        logger::log_error() << "buffer too large, width: " << width
+                            << ", height: " << height;
+        return nullptr;
+    }
+    size &= ~(page_size - 1);
+
+    int fd = create_memfd("gralloc-memfd");
+    if (fd < 0)
+    {
+        logger::log_error() << "memfd_create failed, errno: " << errno;
+        return nullptr;
+    }
+
+    if (ftruncate(fd, size) < 0)
+    {
+        logger::log_error() << "resize memfd to " << size
+                            << " failed, errno: " << errno;
+        close(fd);
+        return nullptr;
+    }
+    // importers size their mapping from the handle, pin the file size
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+
+    auto* h = memfd_handle_t::create(fd);
+    if (!h)
+    {
+        close(fd);
+        return nullptr;
+    }
+    h->width = width;
+    h->height = height;
+    h->stride = stride;
+    h->format = format;
+    h->usage_lo = static_cast<int>(usage);
+    h->usage_hi = static_cast<int>(usage >> 32);
+    h->size_lo = static_cast<int>(size);
+    h->size_hi = static_cast<int>(size >> 32);
+    h->offset = 0;
+
+    auto buf = std::make_shared<gralloc_buffer_memfd>();
+    buf->adapter = shared_from_this();
+    buf->memfd_handle = h;
+    buf->handle = h;
+    buf->width = width;
+    buf->height = height;
+    buf->stride = stride;
+    buf->format = format;
+    buf->usage = usage;
+    buf->layerCount = 1;
+
+    logger::log_info() << "create handle width: " << width
+                       << ", height: " << height << ", stride: " << stride
+                       << ", size: " << size << std::showbase << std::hex
+                       << ", format: " << format << ", usage:" << usage;
+    return buf;
+}
+
+inline const memfd_handle_t*
+gralloc_memfd::check_handle(buffer_handle_t handle, int width, int height,
+                            int stride, int format)
+{
+    auto* h = memfd_handle_t::from(handle);
+    if (!h)
+    {
+        logger::log_error() << "import buffer failed, not a memfd handle: "
+                            << (void*)handle;
+        return nullptr;
+    }
+
+    // every field comes from another process, the layout it describes
+    // must lie within the file
+    int bpp = 0, plane_x2 = 0;
+    if (h->width <= 0 || h->height <= 0 || h->stride < h->width ||
+        h->offset < 0 || !format_info(h->format, &bpp, &plane_x2))
+    {
+        logger::log_error() << "import buffer failed, bad layout";
+        return nullptr;
+    }
+    uint64_t end = 0;
+    if (!layout_size(h->stride, h->height, bpp, plane_x2, &end) ||
+        __builtin_add_overflow(end, static_cast<uint64_t>(h->offset), &end))
+    {
+        logger::log_error() << "import buffer failed, bad layout";
+        return nullptr;
+    }
+
+    struct stat st = {};
+    if (fstat(h->fd, &st) < 0 ||
+        static_cast<uint64_t>(st.st_size) < h->size() || h->size() < end)
+    {
+        logger::log_error() << "import buffer failed, bad memfd size";
+        return nullptr;
+    }
+
+    if (h->width != width || h->height != height || h->stride != stride ||
+        h->format != format)
+    {
+        logger::log_error() << "import buffer failed, handle is " << h->width
+                            << "x" << h->height << ", stride: " << h->stride
+                            << ", asked for " << width << "x" << height
+                            << ", stride: " << stride << std::showbase
+                            << std::hex << ", format: " << h->format
+                            << " and " << format;
+        return nullptr;
+    }
+    return h;
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_memfd::wrap_handle(memfd_handle_t* h, uint64_t usage, bool adopted)
+{
+    auto buf = std::make_shared<gralloc_buffer_memfd>();
+    buf->adapter = shared_from_this();
+    buf->memfd_handle = h;
+    buf->adopted = adopted;
+    buf->handle = h;
+    buf->width = h->width;
+    buf->height = h->height;
+    buf->stride = h->stride;
+    buf->format = h->format;
+    buf->usage = usage ? usage : h->usage();
+    buf->layerCount = 1;
+
+    logger::log_info() << "get buffer: " << (void*)buf.get()
+                       << ", handle: " << (void*)h << ", width: " << h->width
+                       << ", height: " << h->height
+                       << ", stride: " << h->stride << std::showbase
+                       << std::hex << ", format: " << h->format
+                       << ", usage: " << buf->usage;
+    return buf;
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_memfd::import_buffer_impl(buffer_handle_t handle, int width,
+                                  int height, int stride, int format,
+                                  uint64_t usage)
+{
+    auto* src = check_handle(handle, width, height, stride, format);
+    if (!src)
+        return nullptr;
+
+    int fd = fcntl(src->fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        logger::log_error() << "dup memfd failed, errno: " << errno;
+        return nullptr;
+    }
+
+    auto* h = memfd_handle_t::create(fd);
+    if (!h)
+    {
+        close(fd);
+        return nullptr;
+    }
+    memcpy(&h->magic, &src->magic, sizeof(int) * memfd_handle_t::kNumInts);
+
+    return wrap_handle(h, usage, false);
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_memfd::adopt_buffer_impl(native_handle_t* handle, int width,
+                                 int height, int stride, int format,
+                                 uint64_t usage)
+{
+    // same layout, the handle becomes the buffer's own
+    if (!check_handle(handle, width, height, stride, format))
+        return nullptr;
+
+    return wrap_handle(reinterpret_cast<memfd_handle_t*>(handle), usage, true);
+}
+
+#endif // GRALLOC_ADAPTER_MEMFD_H_
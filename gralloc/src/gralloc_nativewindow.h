@@ -5,6 +5,7 @@
 #include "logger.h"
 #include <string.h>
 #include <dlfcn.h>
+#include <unistd.h>
 
 // clang-format off
 enum CreateFromHandleMethod {
@@ -74,49 +75,118 @@ class gralloc_nativewindow
         dlclose(nativewindow_handle);
     }
 
+  protected:
     std::shared_ptr<gralloc_buffer>
-    allocate_buffer(int width, int height, int format, uint64_t usage) override;
-    std::shared_ptr<gralloc_buffer> import_buffer(buffer_handle_t handle,
-                                                  int width, int height,
-                                                  int stride, int format,
-                                                  uint64_t usage) override;
+    allocate_buffer_impl(int width, int height, int format,
+                         uint64_t usage) override;
+    std::shared_ptr<gralloc_buffer>
+    import_buffer_impl(buffer_handle_t handle, int width, int height,
+                       int stride, int format, uint64_t usage) override;
+    std::shared_ptr<gralloc_buffer>
+    adopt_buffer_impl(native_handle_t* handle, int width, int height,
+                      int stride, int format, uint64_t usage) override;
+
+  private:
+    std::shared_ptr<gralloc_buffer>
+    create_from_handle(buffer_handle_t handle, int width, int height,
+                       int stride, int format, uint64_t usage,
+                       CreateFromHandleMethod method);
 };
 
 #undef GETVPTRFUNC
 
 class gralloc_buffer_nativewindow : public gralloc_buffer {
     std::shared_ptr<gralloc_nativewindow> adapter;
-    struct AHardwareBuffer* ahb;
-    bool locked;
+    struct AHardwareBuffer* ahb{};
+    bool locked{};
 
     friend class gralloc_nativewindow;
 
-  public:
-    int lock(uint64_t usage, const ARect& rect, void** vaddr) override
+    int ahb_lock(uint64_t usage, const ARect* rect, void** vaddr)
     {
         int rval =
-            adapter->vptr.AHardwareBuffer_lock(ahb, usage, -1, &rect, vaddr);
+            adapter->vptr.AHardwareBuffer_lock(ahb, usage, -1, rect, vaddr);
         if (rval == 0)
             locked = true;
         return rval;
     }
 
-    int unlock() override
+    int ahb_unlock(int* release_fence)
     {
-        int fance = -1;
-        int rval = adapter->vptr.AHardwareBuffer_unlock(ahb, &fance);
+        *release_fence = -1;
+        int rval = adapter->vptr.AHardwareBuffer_unlock(ahb, release_fence);
         if (rval == 0)
             locked = false;
         return rval;
     }
 
+  public:
+    using gralloc_buffer::unlock;
+
+    struct AHardwareBuffer* get_hardware_buffer() const override
+    {
+        return ahb;
+    }
+
+    int lock(uint64_t usage, const ARect& rect, void** vaddr) override
+    {
+        if (!adapter->persistent_mapping)
+            return ahb_lock(usage, &rect, vaddr);
+
+        uint64_t cpu_usage = usage & (AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                                      AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK);
+        if (!mapped_vaddr || (mapped_usage & cpu_usage) != cpu_usage)
+        {
+            // (re)map the whole buffer with every cpu usage seen so far
+            if (mapped_vaddr)
+            {
+                int release_fence = -1;
+                ahb_unlock(&release_fence);
+                if (release_fence >= 0)
+                    close(release_fence);
+                mapped_vaddr = nullptr;
+            }
+
+            uint64_t map_usage = usage | mapped_usage;
+            int rval = ahb_lock(map_usage, nullptr, &mapped_vaddr);
+            if (rval != 0)
+            {
+                mapped_vaddr = nullptr;
+                mapped_usage = 0;
+                return rval;
+            }
+            mapped_usage = map_usage;
+        }
+        else
+        {
+            begin_cpu_access(cpu_usage);
+        }
+
+        *vaddr = mapped_vaddr;
+        return 0;
+    }
+
+    int unlock(int* release_fence) override
+    {
+        if (!mapped_vaddr)
+            return ahb_unlock(release_fence);
+
+        *release_fence = -1;
+        return end_cpu_access(mapped_usage);
+    }
+
     virtual ~gralloc_buffer_nativewindow()
     {
         if (!ahb)
             return;
 
         if (locked)
-            unlock();
+        {
+            int release_fence = -1;
+            ahb_unlock(&release_fence);
+            if (release_fence >= 0)
+                close(release_fence);
+        }
 
         logger::log_info() << "delete buffer: " << ahb;
         adapter->vptr.AHardwareBuffer_release(ahb);
@@ -125,8 +195,8 @@ class gralloc_buffer_nativewindow : public gralloc_buffer {
 };
 
 inline std::shared_ptr<gralloc_buffer>
-gralloc_nativewindow::allocate_buffer(int width, int height, int format,
-                                      uint64_t usage)
+gralloc_nativewindow::allocate_buffer_impl(int width, int height, int format,
+                                           uint64_t usage)
 {
     int rval = 0;
     auto buf = std::make_shared<gralloc_buffer_nativewindow>();
@@ -166,27 +236,46 @@ gralloc_nativewindow::allocate_buffer(int width, int height, int format,
 }
 
 inline std::shared_ptr<gralloc_buffer>
-gralloc_nativewindow::import_buffer(buffer_handle_t handle, int width,
-                                    int height, int stride, int format,
-                                    uint64_t usage)
+gralloc_nativewindow::import_buffer_impl(buffer_handle_t handle, int width,
+                                         int height, int stride, int format,
+                                         uint64_t usage)
+{
+    return create_from_handle(handle, width, height, stride, format, usage,
+                              AHARDWAREBUFFER_CREATE_FROM_HANDLE_METHOD_CLONE);
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_nativewindow::adopt_buffer_impl(native_handle_t* handle, int width,
+                                        int height, int stride, int format,
+                                        uint64_t usage)
+{
+    // REGISTER hands the handle over to the AHardwareBuffer
+    return create_from_handle(
+        handle, width, height, stride, format, usage,
+        AHARDWAREBUFFER_CREATE_FROM_HANDLE_METHOD_REGISTER);
+}
+
+inline std::shared_ptr<gralloc_buffer>
+gralloc_nativewindow::create_from_handle(buffer_handle_t handle, int width,
+                                         int height, int stride, int format,
+                                         uint64_t usage,
+                                         CreateFromHandleMethod method)
 {
     int rval = 0;
     auto buf = std::make_shared<gralloc_buffer_nativewindow>();
     buf->adapter = shared_from_this();
     buf->layerCount = 1;
 
-    AHardwareBuffer_Desc desc = {
-        .width = static_cast<uint32_t>(width),
-        .height = static_cast<uint32_t>(height),
-        .layers = static_cast<uint32_t>(buf->layerCount),
-        .format = static_cast<uint32_t>(format),
-        .usage = usage,
-        .stride = static_cast<uint32_t>(stride),
-    };
+    AHardwareBuffer_Desc desc = {};
+    desc.width = static_cast<uint32_t>(width);
+    desc.height = static_cast<uint32_t>(height);
+    desc.layers = static_cast<uint32_t>(buf->layerCount);
+    desc.format = static_cast<uint32_t>(format);
+    desc.usage = usage;
+    desc.stride = static_cast<uint32_t>(stride);
 
-    rval = vptr.AHardwareBuffer_createFromHandle(
-        &desc, handle, AHARDWAREBUFFER_CREATE_FROM_HANDLE_METHOD_CLONE,
-        &buf->ahb);
+    rval = vptr.AHardwareBuffer_createFromHandle(&desc, handle, method,
+                                                 &buf->ahb);
 
     if (rval != 0)
     {
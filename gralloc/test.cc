@@ -3,7 +3,57 @@
 
 #include <android/hardware_buffer.h>
 #include <android/rect.h>
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+int failed = 0;
+
+bool is_dma_buf(int fd)
+{
+    char path[32], target[64] = {};
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    if (readlink(path, target, sizeof(target) - 1) < 0)
+        return false;
+    return strncmp(target, "/dmabuf:", 8) == 0 ||
+           strcmp(target, "anon_inode:dmabuf") == 0;
+}
+
+// the exported fd is a dma-buf holding what was written through the lock
+bool check_dmabuf(const gralloc_dmabuf_layout& layout, int stride, int height)
+{
+    int fd = layout.planes[0].fd;
+    struct stat st = {};
+    if (fd < 0 || fstat(fd, &st) < 0 || !is_dma_buf(fd))
+    {
+        logger::log_error() << "export_dmabuf gave no dma-buf, fd: " << fd;
+        return false;
+    }
+
+    size_t size = layout.planes[0].offset +
+                  static_cast<size_t>(layout.planes[0].stride) * height;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        logger::log_error() << "mmap dmabuf failed, errno: " << errno;
+        return false;
+    }
+    uint32_t pixel = *reinterpret_cast<const uint32_t*>(
+        static_cast<const char*>(addr) + layout.planes[0].offset);
+    munmap(addr, size);
+    if (pixel != 0xaabbccdd || layout.planes[0].stride < stride * 4)
+    {
+        logger::log_error() << "dmabuf holds " << std::showbase << std::hex
+                            << pixel << ", not what was written";
+        return false;
+    }
+    return true;
+}
+} // namespace
 
 int main()
 {
@@ -35,6 +85,28 @@ int main()
         vaddr = nullptr;
     }
 
+    gralloc_dmabuf_layout layout = {};
+    if (buffer->export_dmabuf(&layout))
+    {
+        logger::log_info() << "dmabuf fd: " << layout.planes[0].fd
+                           << ", stride: " << layout.planes[0].stride
+                           << std::showbase << std::hex
+                           << ", fourcc: " << layout.fourcc
+                           << ", modifier: " << layout.modifier;
+        if (!check_dmabuf(layout, buffer->stride, buffer->height))
+            failed++;
+    }
+    else if (is_dma_buf(buffer->handle->data[0]) ||
+             access("/dev/udmabuf", F_OK) == 0)
+    {
+        logger::log_error() << "export_dmabuf failed";
+        failed++;
+    }
+    else
+    {
+        logger::log_info() << "buffer cannot be exported as dmabuf, skipped";
+    }
+
     auto buffer_ =
         adapter->import_buffer(buffer->handle, buffer->width, buffer->height,
                                buffer->stride, buffer->format, buffer->usage);
@@ -50,7 +122,14 @@ int main()
                 << "get vaddr " << vaddr << ", read vaddr[0]: " << std::showbase
                 << std::hex << ((uint32_t*)vaddr)[0];
 
+            if (((uint32_t*)vaddr)[0] != 0xaabbccdd)
+                failed++;
             char c = getchar();
         }
+        else
+        {
+            failed++;
+        }
     }
+    return failed ? 1 : 0;
 }